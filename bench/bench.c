@@ -0,0 +1,849 @@
+#include "datagen.h"
+
+#include "aggregate.h"
+#include "cmd_parse.h"
+#include "database.h"
+#include "error.h"
+#include "store_manager.h"
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// number of generated rows appended to the database at once by the load
+#define LOAD_CHUNK_ROWS (1UL << 16)
+#define BENCH_DB_NAME "bench.db"
+
+struct bench_options {
+	// number of rows loaded before the other benchmarks
+	uint64_t rows;
+	// number of operations of a micro-benchmark
+	uint64_t ops;
+	// number of repetitions of a macro-benchmark
+	uint64_t reps;
+	// directory of the database files
+	const char *dir;
+	// comma separated names of the benchmarks to run(NULL for all of them)
+	const char *only;
+	// file the rows are written to as CSV, instead of running the benchmarks
+	const char *csv_path;
+	struct datagen_config gen;
+	struct db_config db;
+};
+
+/*
+ * The state shared by the benchmarks, which run in order on the same
+ * database.
+ */
+struct bench_ctx {
+	const struct bench_options *opts;
+	struct datagen *gen;
+	struct db_manager db;
+	// number of rows appended so far, removed or not
+	uint64_t nr_rows;
+	uint64_t rng;
+	FILE *null_out;
+};
+
+/*
+ * The latencies of the operations of a benchmark, in nanoseconds.
+ */
+struct latencies {
+	uint64_t *ns;
+	size_t count;
+	size_t capacity;
+};
+
+struct benchmark {
+	const char *name;
+	// "micro" for single entry operations, "macro" for the others
+	const char *kind;
+	/*
+	 * @brief run the operations of the benchmark, recording their latencies
+	 * @param ctx the state of the benchmarks
+	 * @param lat the latencies of the operations
+	 * @param items set to the number of entries processed, for the throughput
+	 * @return the status of the operations
+	 */
+	enum status (*run)(struct bench_ctx *ctx, struct latencies *lat,
+					   uint64_t *items);
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void record_latency(struct latencies *lat, uint64_t ns)
+{
+	if (lat->count == lat->capacity) {
+		lat->capacity = lat->capacity ? lat->capacity * 2 : 256;
+		lat->ns = realloc(lat->ns, lat->capacity * sizeof(*lat->ns));
+		DIE(lat->ns == NULL, "Error allocating latencies");
+	}
+	lat->ns[lat->count++] = ns;
+}
+
+static uint64_t next_random(struct bench_ctx *ctx)
+{
+	// splitmix64
+	uint64_t x = (ctx->rng += 0x9e3779b97f4a7c15ULL);
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+// a random row among the loaded ones
+static uint64_t random_row(struct bench_ctx *ctx)
+{
+	return next_random(ctx) % ctx->opts->rows;
+}
+
+static enum status bench_load(struct bench_ctx *ctx, struct latencies *lat,
+							  uint64_t *items)
+{
+	uint64_t rows = ctx->opts->rows;
+	size_t chunk = rows < LOAD_CHUNK_ROWS ? rows : LOAD_CHUNK_ROWS;
+	enum status status = STATUS_OK;
+
+	struct store_item *batch = malloc(chunk * sizeof(*batch));
+	DIE(batch == NULL, "Error allocating rows");
+
+	for (uint64_t row = 0; row < rows && status == STATUS_OK;) {
+		size_t n = rows - row < chunk ? rows - row : chunk;
+
+		for (size_t i = 0; i < n; ++i)
+			datagen_item(ctx->gen, row + i, &batch[i]);
+
+		uint64_t start = now_ns();
+		status = append_entries(&ctx->db, batch, n);
+		record_latency(lat, now_ns() - start);
+		row += n;
+	}
+	free(batch);
+
+	ctx->nr_rows = rows;
+	*items = rows;
+	return status == STATUS_OK ? commit_database(&ctx->db) : status;
+}
+
+static enum status bench_find_by_key(struct bench_ctx *ctx,
+									 struct latencies *lat, uint64_t *items)
+{
+	struct store_item item;
+
+	for (uint64_t i = 0; i < ctx->opts->ops; ++i) {
+		int64_t barcode = datagen_barcode(random_row(ctx));
+
+		uint64_t start = now_ns();
+		enum status status = find_entry_by_key(&ctx->db, barcode, &item);
+		record_latency(lat, now_ns() - start);
+		if (status != STATUS_OK)
+			return status;
+	}
+
+	*items = ctx->opts->ops;
+	return STATUS_OK;
+}
+
+static enum status bench_update_by_key(struct bench_ctx *ctx,
+									   struct latencies *lat, uint64_t *items)
+{
+	for (uint64_t i = 0; i < ctx->opts->ops; ++i) {
+		int64_t barcode = datagen_barcode(random_row(ctx));
+		int quantity = (int)(i % 1000);
+
+		uint64_t start = now_ns();
+		enum status status = update_entries_by_key(&ctx->db, barcode,
+												   &quantity, update_quantity);
+		record_latency(lat, now_ns() - start);
+		if (status != STATUS_OK)
+			return status;
+	}
+
+	*items = ctx->opts->ops;
+	return commit_database(&ctx->db);
+}
+
+static enum status bench_update_by_key_scan(struct bench_ctx *ctx,
+											struct latencies *lat,
+											uint64_t *items)
+{
+	for (uint64_t i = 0; i < ctx->opts->reps; ++i) {
+		int64_t barcode = datagen_barcode(random_row(ctx));
+		int quantity = (int)(i % 1000);
+
+		uint64_t start = now_ns();
+		enum status status = update_items_matching(
+			&ctx->db, &barcode, matches_barcode, &quantity, update_quantity);
+		record_latency(lat, now_ns() - start);
+		if (status != STATUS_OK)
+			return status;
+	}
+
+	*items = ctx->opts->reps * ctx->db.nr_slots;
+	return commit_database(&ctx->db);
+}
+
+// the category of a random row
+static void random_category(struct bench_ctx *ctx, char *category)
+{
+	struct store_item item;
+
+	datagen_item(ctx->gen, random_row(ctx), &item);
+	memcpy(category, item.category, ITEM_CATEGORY_MAX_LEN);
+}
+
+static enum status bench_update_by_category(struct bench_ctx *ctx,
+											struct latencies *lat,
+											uint64_t *items)
+{
+	char category[ITEM_CATEGORY_MAX_LEN];
+
+	*items = 0;
+	for (uint64_t i = 0; i < ctx->opts->reps; ++i) {
+		int quantity = (int)(i % 1000);
+
+		random_category(ctx, category);
+		*items += count_group_entries(&ctx->db, category);
+
+		uint64_t start = now_ns();
+		enum status status = update_entries_by_group(
+			&ctx->db, category, &quantity, update_quantity);
+		record_latency(lat, now_ns() - start);
+		if (status != STATUS_OK)
+			return status;
+	}
+
+	return commit_database(&ctx->db);
+}
+
+static enum status bench_update_by_category_scan(struct bench_ctx *ctx,
+												 struct latencies *lat,
+												 uint64_t *items)
+{
+	char category[ITEM_CATEGORY_MAX_LEN];
+
+	for (uint64_t i = 0; i < ctx->opts->reps; ++i) {
+		int quantity = (int)(i % 1000);
+
+		random_category(ctx, category);
+
+		uint64_t start = now_ns();
+		enum status status = update_items_matching(
+			&ctx->db, category, matches_category, &quantity, update_quantity);
+		record_latency(lat, now_ns() - start);
+		if (status != STATUS_OK)
+			return status;
+	}
+
+	*items = ctx->opts->reps * ctx->db.nr_slots;
+	return commit_database(&ctx->db);
+}
+
+/*
+ * @brief search the names derived from the names of random rows
+ * @param ctx the state of the benchmarks
+ * @param lat the latencies of the searches
+ * @param count the number of searches
+ * @param mode how the names are matched
+ * @return the status of the searches
+ */
+static enum status search_names(struct bench_ctx *ctx, struct latencies *lat,
+								uint64_t count, enum text_match mode)
+{
+	struct store_item item;
+
+	for (uint64_t i = 0; i < count; ++i) {
+		datagen_item(ctx->gen, random_row(ctx), &item);
+
+		// the names are "<noun> <adjective> <number>"
+		char *pattern = item.name;
+		if (mode == TEXT_MATCH_PREFIX) {
+			// the names with the same words and a number starting the same
+			item.name[strlen(item.name) - 1] = '\0';
+		} else if (mode == TEXT_MATCH_SUBSTRING) {
+			// the names with the same adjective and a number starting the same
+			pattern = strchr(item.name, ' ') + 1;
+			pattern[strlen(pattern) - 1] = '\0';
+		}
+
+		uint64_t start = now_ns();
+		enum status status =
+			dump_database_by_text(&ctx->db, dump_store_item_csv, pattern, mode,
+								  ctx->null_out);
+		record_latency(lat, now_ns() - start);
+		if (status != STATUS_OK)
+			return status;
+	}
+
+	return STATUS_OK;
+}
+
+static enum status bench_search_name(struct bench_ctx *ctx,
+									 struct latencies *lat, uint64_t *items)
+{
+	*items = ctx->opts->ops;
+	return search_names(ctx, lat, ctx->opts->ops, TEXT_MATCH_EXACT);
+}
+
+static enum status bench_search_name_prefix(struct bench_ctx *ctx,
+											struct latencies *lat,
+											uint64_t *items)
+{
+	*items = ctx->opts->reps;
+	return search_names(ctx, lat, ctx->opts->reps, TEXT_MATCH_PREFIX);
+}
+
+static enum status bench_search_name_substring(struct bench_ctx *ctx,
+											   struct latencies *lat,
+											   uint64_t *items)
+{
+	*items = ctx->opts->reps;
+	return search_names(ctx, lat, ctx->opts->reps, TEXT_MATCH_SUBSTRING);
+}
+
+static enum status bench_dump(struct bench_ctx *ctx, struct latencies *lat,
+							  uint64_t *items)
+{
+	for (uint64_t i = 0; i < ctx->opts->reps; ++i) {
+		uint64_t start = now_ns();
+		dump_database(&ctx->db, dump_store_item_csv, NULL, NULL,
+					  ctx->null_out);
+		record_latency(lat, now_ns() - start);
+	}
+
+	*items = ctx->opts->reps * ctx->db.nr_slots;
+	return STATUS_OK;
+}
+
+static enum status bench_dump_by_category(struct bench_ctx *ctx,
+										  struct latencies *lat,
+										  uint64_t *items)
+{
+	char category[ITEM_CATEGORY_MAX_LEN];
+
+	*items = 0;
+	for (uint64_t i = 0; i < ctx->opts->reps; ++i) {
+		random_category(ctx, category);
+		*items += count_group_entries(&ctx->db, category);
+
+		uint64_t start = now_ns();
+		enum status status = dump_database_by_group(
+			&ctx->db, dump_store_item_csv, category, ctx->null_out);
+		record_latency(lat, now_ns() - start);
+		if (status != STATUS_OK)
+			return status;
+	}
+
+	return STATUS_OK;
+}
+
+static enum status bench_dump_by_price_range(struct bench_ctx *ctx,
+											 struct latencies *lat,
+											 uint64_t *items)
+{
+	for (uint64_t i = 0; i < ctx->opts->reps; ++i) {
+		// ranges of 5.00 among the generated prices, up to 500.00
+		float min = (float)(next_random(ctx) % 49500) / 100.0f;
+		struct price_range range = { .min = min, .max = min + 5.0f };
+
+		uint64_t start = now_ns();
+		enum status status = dump_database_by_column(
+			&ctx->db, dump_store_item_csv, ITEM_COLUMN_PRICE, &range,
+			select_price_range, ctx->null_out);
+		record_latency(lat, now_ns() - start);
+		if (status != STATUS_OK)
+			return status;
+	}
+
+	*items = ctx->opts->reps * ctx->db.nr_slots;
+	return STATUS_OK;
+}
+
+static enum status bench_aggregate(struct bench_ctx *ctx, struct latencies *lat,
+								   uint64_t *items)
+{
+	for (uint64_t i = 0; i < ctx->opts->reps; ++i) {
+		struct inventory_stats stats;
+
+		uint64_t start = now_ns();
+		enum status status = aggregate_inventory(
+			&ctx->db, AGGREGATE_DEFAULT_LOW_STOCK, &stats);
+		record_latency(lat, now_ns() - start);
+		inventory_stats_free(&stats);
+		if (status != STATUS_OK)
+			return status;
+	}
+
+	*items = ctx->opts->reps * ctx->db.nr_slots;
+	return STATUS_OK;
+}
+
+static enum status bench_category_totals(struct bench_ctx *ctx,
+										 struct latencies *lat, uint64_t *items)
+{
+	*items = 0;
+	// the totals are only kept with -t
+	if (ctx->opts->db.measure_of == NULL)
+		return STATUS_OK;
+
+	for (uint64_t i = 0; i < ctx->opts->ops; ++i) {
+		struct inventory_stats stats;
+
+		uint64_t start = now_ns();
+		enum status status = inventory_totals(&ctx->db, &stats);
+		record_latency(lat, now_ns() - start);
+		*items += stats.nr_categories;
+		inventory_stats_free(&stats);
+		if (status != STATUS_OK)
+			return status;
+	}
+
+	return STATUS_OK;
+}
+
+static enum status bench_append(struct bench_ctx *ctx, struct latencies *lat,
+								uint64_t *items)
+{
+	struct store_item item;
+
+	// the appended rows follow the loaded ones, so their barcodes are new
+	for (uint64_t i = 0; i < ctx->opts->ops; ++i) {
+		datagen_item(ctx->gen, ctx->nr_rows, &item);
+
+		uint64_t start = now_ns();
+		enum status status = append_entry(&ctx->db, &item);
+		record_latency(lat, now_ns() - start);
+		if (status != STATUS_OK)
+			return status;
+		++ctx->nr_rows;
+	}
+
+	*items = ctx->opts->ops;
+	return commit_database(&ctx->db);
+}
+
+/*
+ * @brief remove the rows following a position by scanning the database
+ * @param ctx the state of the benchmarks
+ * @param lat the latencies of the removals
+ * @param items set to the number of removed entries
+ * @param first_row the position of the first removed row
+ * @return the status of the removals
+ */
+static enum status remove_rows(struct bench_ctx *ctx, struct latencies *lat,
+							   uint64_t *items, uint64_t first_row)
+{
+	for (uint64_t i = 0; i < ctx->opts->reps; ++i) {
+		int64_t barcode = datagen_barcode(first_row + i);
+
+		uint64_t start = now_ns();
+		enum status status =
+			remove_unique_entry(&ctx->db, &barcode, matches_barcode);
+		record_latency(lat, now_ns() - start);
+		if (status != STATUS_OK)
+			return status;
+	}
+
+	*items = ctx->opts->reps;
+	return commit_database(&ctx->db);
+}
+
+static enum status bench_remove_head(struct bench_ctx *ctx,
+									 struct latencies *lat, uint64_t *items)
+{
+	return remove_rows(ctx, lat, items, 0);
+}
+
+static enum status bench_remove_middle(struct bench_ctx *ctx,
+									   struct latencies *lat, uint64_t *items)
+{
+	return remove_rows(ctx, lat, items, ctx->nr_rows / 2);
+}
+
+static enum status bench_remove_tail(struct bench_ctx *ctx,
+									 struct latencies *lat, uint64_t *items)
+{
+	uint64_t reps = ctx->opts->reps;
+
+	return remove_rows(ctx, lat, items,
+					   ctx->nr_rows > reps ? ctx->nr_rows - reps : 0);
+}
+
+static enum status bench_remove_by_key(struct bench_ctx *ctx,
+									   struct latencies *lat, uint64_t *items)
+{
+	uint64_t removed = 0;
+
+	for (uint64_t i = 0; i < ctx->opts->ops; ++i) {
+		int64_t barcode = datagen_barcode(random_row(ctx));
+
+		uint64_t start = now_ns();
+		enum status status = remove_entry_by_key(&ctx->db, barcode);
+		record_latency(lat, now_ns() - start);
+		// the row may have been removed already
+		if (status == STATUS_OK)
+			++removed;
+		else if (status != STATUS_NOT_FOUND)
+			return status;
+	}
+
+	*items = removed;
+	return commit_database(&ctx->db);
+}
+
+static const struct benchmark benchmarks[] = {
+	{ "load", "macro", bench_load },
+	{ "find_by_key", "micro", bench_find_by_key },
+	{ "update_by_key", "micro", bench_update_by_key },
+	{ "update_by_key_scan", "macro", bench_update_by_key_scan },
+	{ "update_by_category", "macro", bench_update_by_category },
+	{ "update_by_category_scan", "macro", bench_update_by_category_scan },
+	{ "search_name", "micro", bench_search_name },
+	{ "search_name_prefix", "macro", bench_search_name_prefix },
+	{ "search_name_substring", "macro", bench_search_name_substring },
+	{ "dump", "macro", bench_dump },
+	{ "dump_by_category", "macro", bench_dump_by_category },
+	{ "dump_by_price_range", "macro", bench_dump_by_price_range },
+	{ "aggregate", "macro", bench_aggregate },
+	{ "category_totals", "micro", bench_category_totals },
+	{ "append", "micro", bench_append },
+	{ "remove_head", "macro", bench_remove_head },
+	{ "remove_middle", "macro", bench_remove_middle },
+	{ "remove_tail", "macro", bench_remove_tail },
+	{ "remove_by_key", "micro", bench_remove_by_key },
+};
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+// the nearest-rank percentile of sorted latencies, in microseconds
+static double percentile_us(const struct latencies *lat, double p)
+{
+	if (lat->count == 0)
+		return 0;
+
+	size_t rank = (size_t)(p * (double)lat->count + 0.999999);
+	if (rank == 0)
+		rank = 1;
+	if (rank > lat->count)
+		rank = lat->count;
+	return (double)lat->ns[rank - 1] / 1000;
+}
+
+/*
+ * @brief write the results of a benchmark as a JSON line
+ * @param bench the benchmark
+ * @param lat the latencies of its operations, sorted by the call
+ * @param items the number of processed entries
+ * @param total_ns the duration of the operations
+ */
+static void print_result(const struct benchmark *bench, struct latencies *lat,
+						 uint64_t items, uint64_t total_ns)
+{
+	double seconds = (double)total_ns / 1e9;
+
+	qsort(lat->ns, lat->count, sizeof(*lat->ns), compare_u64);
+	printf("{\"benchmark\":\"%s\",\"kind\":\"%s\",\"ops\":%zu,"
+		   "\"items\":%" PRIu64 ",\"seconds\":%.6f,\"ops_per_sec\":%.1f,"
+		   "\"items_per_sec\":%.1f,\"latency_us\":{\"p50\":%.2f,"
+		   "\"p90\":%.2f,\"p99\":%.2f,\"p999\":%.2f,\"max\":%.2f}}\n",
+		   bench->name, bench->kind, lat->count, items, seconds,
+		   seconds > 0 ? (double)lat->count / seconds : 0,
+		   seconds > 0 ? (double)items / seconds : 0, percentile_us(lat, 0.5),
+		   percentile_us(lat, 0.9), percentile_us(lat, 0.99),
+		   percentile_us(lat, 0.999), percentile_us(lat, 1));
+	(void)fflush(stdout);
+}
+
+static void print_config(const struct bench_options *opts)
+{
+	const struct db_config *db = &opts->db;
+
+	printf("{\"config\":{\"rows\":%" PRIu64 ",\"ops\":%" PRIu64
+		   ",\"reps\":%" PRIu64 ",\"seed\":%" PRIu64 ",\"categories\":%zu,"
+		   "\"names\":%zu,\"category_skew\":%.2f,\"name_skew\":%.2f,"
+		   "\"mmap\":%s,\"columnar\":%s,\"wal\":%s,\"threads\":%u,"
+		   "\"block_slots\":%zu,\"cache\":%zu,\"write_back\":%s,"
+		   "\"sorted\":%s,\"totals\":%s}}\n",
+		   opts->rows, opts->ops, opts->reps, opts->gen.seed,
+		   opts->gen.nr_categories, opts->gen.nr_names,
+		   opts->gen.category_skew, opts->gen.name_skew,
+		   db->use_mmap ? "true" : "false", db->columnar ? "true" : "false",
+		   db->use_wal ? "true" : "false", db->nr_threads, db->block_slots,
+		   db->cache_entries, db->cache_write_back ? "true" : "false",
+		   db->sorted ? "true" : "false",
+		   db->measure_of != NULL ? "true" : "false");
+}
+
+static bool is_selected(const char *only, const char *name)
+{
+	if (only == NULL)
+		return true;
+
+	size_t len = strlen(name);
+	for (const char *p = only; *p != '\0';) {
+		size_t n = strcspn(p, ",");
+		if (n == len && strncmp(p, name, len) == 0)
+			return true;
+		p += n;
+		if (*p == ',')
+			++p;
+	}
+	return false;
+}
+
+static void remove_db_files(const char *path)
+{
+	static const char *const exts[] = { "", ".idx", ".grp", ".tix",
+										".ord", ".wal", ".tmp" };
+	char file[4096];
+
+	for (size_t i = 0; i < sizeof(exts) / sizeof(exts[0]); ++i) {
+		(void)snprintf(file, sizeof(file), "%s%s", path, exts[i]);
+		(void)unlink(file);
+	}
+}
+
+static enum status run_benchmarks(const struct bench_options *opts)
+{
+	char path[4096];
+	(void)snprintf(path, sizeof(path), "%s/%s", opts->dir, BENCH_DB_NAME);
+	remove_db_files(path);
+
+	struct bench_ctx ctx = {
+		.opts = opts,
+		.gen = datagen_create(&opts->gen),
+		.rng = opts->gen.seed,
+		.null_out = fopen("/dev/null", "w"),
+	};
+	DIE(ctx.null_out == NULL, "Error opening /dev/null");
+	ctx.db = create_database(path, sizeof(struct store_item), &opts->db);
+
+	print_config(opts);
+
+	enum status status = STATUS_OK;
+	struct latencies lat = { 0 };
+	for (size_t b = 0; b < sizeof(benchmarks) / sizeof(benchmarks[0]); ++b) {
+		const struct benchmark *bench = &benchmarks[b];
+
+		// the other benchmarks work on the loaded rows
+		if (b != 0 && !is_selected(opts->only, bench->name))
+			continue;
+
+		uint64_t items = 0;
+		lat.count = 0;
+		uint64_t start = now_ns();
+		status = bench->run(&ctx, &lat, &items);
+		uint64_t total_ns = now_ns() - start;
+		if (status != STATUS_OK) {
+			fprintf(stderr, "Benchmark %s esuat\n", bench->name);
+			break;
+		}
+		print_result(bench, &lat, items, total_ns);
+	}
+
+	free(lat.ns);
+	close_database(&ctx.db);
+	remove_db_files(path);
+	(void)fclose(ctx.null_out);
+	datagen_destroy(ctx.gen);
+	return status;
+}
+
+static enum status write_csv(const struct bench_options *opts)
+{
+	FILE *out = strcmp(opts->csv_path, "-") == 0 ? stdout :
+												   fopen(opts->csv_path, "w");
+	if (out == NULL)
+		return STATUS_ERROR;
+
+	struct datagen *gen = datagen_create(&opts->gen);
+	enum status status = datagen_write_csv(gen, 0, opts->rows, out);
+	datagen_destroy(gen);
+
+	if (out != stdout && fclose(out) != 0)
+		status = STATUS_ERROR;
+	return status;
+}
+
+static void print_usage(const char *prog_name)
+{
+	fprintf(stderr,
+			"Utilizare: %s [optiuni]\n"
+			"  -n, --rows N           numarul de produse generate(implicit "
+			"100000)\n"
+			"  -o, --ops N            numarul de operatii ale unui "
+			"micro-benchmark(implicit 1000)\n"
+			"  -r, --reps N           numarul de repetari ale unui "
+			"macro-benchmark(implicit 5)\n"
+			"  -S, --seed N           samanta generatorului(implicit 1)\n"
+			"  -C, --categories N     numarul de categorii(implicit 50)\n"
+			"  -N, --names N          numarul de nume distincte(implicit "
+			"10000)\n"
+			"  -z, --category-skew S  exponentul distributiei Zipf a "
+			"categoriilor(0 pentru uniforma)\n"
+			"  -Z, --name-skew S      exponentul distributiei Zipf a "
+			"numelor(0 pentru uniforma)\n"
+			"  -d, --dir DIR          directorul bazei de date(implicit .)\n"
+			"  -B, --bench LISTA      benchmark-urile rulate, separate prin "
+			"virgula(implicit toate)\n"
+			"  -G, --generate FISIER  scrie produsele generate in format CSV"
+			"(- pentru iesirea standard), fara benchmark-uri\n"
+			"  -m, -b N, -j N, -c, -w, -g N, -k N, -W\n"
+			"                         configuratia bazei de date, ca la "
+			"store_manager\n"
+			"  -O, --sorted           baza de date sortata dupa codul de bare"
+			"(-o la store_manager)\n"
+			"  -t, --totals           actualizeaza totalurile categoriilor la "
+			"fiecare modificare\n",
+			prog_name);
+}
+
+static enum status parse_args(struct bench_options *opts, int argc,
+							  char **argv)
+{
+	static const struct option long_opts[] = {
+		{ "rows", required_argument, NULL, 'n' },
+		{ "ops", required_argument, NULL, 'o' },
+		{ "reps", required_argument, NULL, 'r' },
+		{ "seed", required_argument, NULL, 'S' },
+		{ "categories", required_argument, NULL, 'C' },
+		{ "names", required_argument, NULL, 'N' },
+		{ "category-skew", required_argument, NULL, 'z' },
+		{ "name-skew", required_argument, NULL, 'Z' },
+		{ "dir", required_argument, NULL, 'd' },
+		{ "bench", required_argument, NULL, 'B' },
+		{ "generate", required_argument, NULL, 'G' },
+		{ "mmap", no_argument, NULL, 'm' },
+		{ "block-slots", required_argument, NULL, 'b' },
+		{ "threads", required_argument, NULL, 'j' },
+		{ "columnar", no_argument, NULL, 'c' },
+		{ "wal", no_argument, NULL, 'w' },
+		{ "group-commit", required_argument, NULL, 'g' },
+		{ "cache", required_argument, NULL, 'k' },
+		{ "write-back", no_argument, NULL, 'W' },
+		{ "sorted", no_argument, NULL, 'O' },
+		{ "totals", no_argument, NULL, 't' },
+		{ NULL, 0, NULL, 0 },
+	};
+	int opt;
+
+	while ((opt = getopt_long(argc, argv,
+							  "n:o:r:S:C:N:z:Z:d:B:G:mb:j:cwg:k:WOt", long_opts,
+							  NULL)) != -1) {
+		switch (opt) {
+		case 'n':
+			opts->rows = CMD_PARSE_UINTMAX(optarg, 10);
+			break;
+		case 'o':
+			opts->ops = CMD_PARSE_UINTMAX(optarg, 10);
+			break;
+		case 'r':
+			opts->reps = CMD_PARSE_UINTMAX(optarg, 10);
+			break;
+		case 'S':
+			opts->gen.seed = CMD_PARSE_UINTMAX(optarg, 10);
+			break;
+		case 'C':
+			opts->gen.nr_categories = CMD_PARSE_UINTMAX(optarg, 10);
+			break;
+		case 'N':
+			opts->gen.nr_names = CMD_PARSE_UINTMAX(optarg, 10);
+			break;
+		case 'z':
+			opts->gen.category_skew = CMD_PARSE_DOUBLE(optarg);
+			break;
+		case 'Z':
+			opts->gen.name_skew = CMD_PARSE_DOUBLE(optarg);
+			break;
+		case 'd':
+			opts->dir = optarg;
+			break;
+		case 'B':
+			opts->only = optarg;
+			break;
+		case 'G':
+			opts->csv_path = optarg;
+			break;
+		case 'm':
+			opts->db.use_mmap = true;
+			break;
+		case 'b':
+			opts->db.block_slots = CMD_PARSE_UINTMAX(optarg, 10);
+			break;
+		case 'j':
+			opts->db.nr_threads = CMD_PARSE_UINTMAX(optarg, 10);
+			break;
+		case 'c':
+			opts->db.columnar = true;
+			break;
+		case 'w':
+			opts->db.use_wal = true;
+			break;
+		case 'g':
+			opts->db.wal_group_ops = CMD_PARSE_UINTMAX(optarg, 10);
+			break;
+		case 'k':
+			opts->db.cache_entries = CMD_PARSE_UINTMAX(optarg, 10);
+			break;
+		case 'W':
+			opts->db.cache_write_back = true;
+			break;
+		case 'O':
+			opts->db.sorted = true;
+			break;
+		case 't':
+			opts->db.measure_of = get_item_measures;
+			opts->db.nr_measures = ITEM_NR_MEASURES;
+			break;
+		default:
+			return STATUS_ERROR;
+		}
+	}
+
+	if (optind != argc || opts->rows == 0 || opts->gen.nr_categories == 0 ||
+		opts->gen.nr_names == 0 || (opts->db.sorted && opts->db.use_wal))
+		return STATUS_ERROR;
+	return STATUS_OK;
+}
+
+int main(int argc, char **argv)
+{
+	// the database is configured like the one of store_manager
+	struct bench_options opts = {
+		.rows = 100000,
+		.ops = 1000,
+		.reps = 5,
+		.dir = ".",
+		.gen = { .seed = 1, .nr_categories = 50, .nr_names = 10000 },
+		.db = { .key_of = get_barcode,
+				.group_of = get_category,
+				.text_of = get_name,
+				.order_of = get_expiry_key,
+				.compact_dead_percent = 50,
+				.columns = store_item_columns,
+				.nr_columns = ITEM_NR_COLUMNS },
+	};
+
+	if (parse_args(&opts, argc, argv) != STATUS_OK) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	enum status status = opts.csv_path != NULL ? write_csv(&opts) :
+												 run_benchmarks(&opts);
+	return status == STATUS_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,217 @@
+#include "datagen.h"
+
+#include "error.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the barcodes are 13 digit codes starting with the prefix of Romania
+#define BARCODE_BASE 5940000000000LL
+// the row positions are scrambled by a bijection of [0, 2^BARCODE_BITS)
+#define BARCODE_BITS 40
+#define BARCODE_MULT 0x9e3779b97fULL
+
+#define ARRAY_LEN(arr) (sizeof(arr) / sizeof((arr)[0]))
+
+// the independent random values drawn for each row
+enum row_field {
+	FIELD_CATEGORY,
+	FIELD_NAME,
+	FIELD_PRICE,
+	FIELD_QUANTITY,
+	FIELD_EXPIRY_DATE,
+};
+
+static const char *const category_words[] = {
+	"Lactate", "Legume", "Fructe", "Panificatie", "Carne", "Peste", "Bauturi",
+	"Dulciuri", "Conserve", "Cosmetice", "Detergenti", "Congelate", "Cafea",
+	"Condimente", "Snacks",
+};
+
+static const char *const name_nouns[] = {
+	"Lapte", "Iaurt", "Branza", "Paine", "Mere", "Rosii", "Cafea", "Suc",
+	"Apa", "Ciocolata", "Biscuiti", "Orez", "Paste", "Ulei", "Zahar", "Faina",
+	"Sapun", "Sampon", "Ton", "Salam",
+};
+
+static const char *const name_adjectives[] = {
+	"natural", "proaspat", "bio", "light", "clasic", "extra", "dulce",
+	"picant", "integral", "traditional", "premium", "simplu",
+};
+
+struct datagen {
+	uint64_t seed;
+	size_t nr_categories;
+	size_t nr_names;
+	// cumulative probabilities of the categories and of the names(NULL for
+	// the uniform distribution)
+	double *category_cdf;
+	double *name_cdf;
+};
+
+static uint64_t mix(uint64_t x)
+{
+	// splitmix64 finalizer
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+/*
+ * @brief draw a random value of a row
+ * @return a value uniformly distributed over the 64 bit integers
+ */
+static uint64_t row_random(const struct datagen *gen, uint64_t row,
+						   enum row_field field)
+{
+	return mix(gen->seed ^ mix(row * 8 + field + 0x9e3779b97f4a7c15ULL));
+}
+
+// a value uniformly distributed in [0, 1)
+static double unit_interval(uint64_t x)
+{
+	return (double)(x >> 11) * 0x1.0p-53;
+}
+
+static double *zipf_cdf(size_t count, double skew)
+{
+	if (skew <= 0)
+		return NULL;
+
+	double *cdf = malloc(count * sizeof(*cdf));
+	DIE(cdf == NULL, "Error allocating distribution");
+
+	double sum = 0;
+	for (size_t i = 0; i < count; ++i) {
+		sum += 1 / pow((double)(i + 1), skew);
+		cdf[i] = sum;
+	}
+	for (size_t i = 0; i < count; ++i)
+		cdf[i] /= sum;
+	return cdf;
+}
+
+/*
+ * @brief pick a value of a distribution
+ * @param cdf the cumulative probabilities of the values(NULL for the uniform
+ * distribution)
+ * @param count the number of values
+ * @param x a random value
+ * @return the picked value
+ */
+static size_t pick(const double *cdf, size_t count, uint64_t x)
+{
+	if (cdf == NULL)
+		return (size_t)(x % count);
+
+	double u = unit_interval(x);
+	size_t lo = 0;
+	size_t hi = count - 1;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (cdf[mid] > u)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo;
+}
+
+struct datagen *datagen_create(const struct datagen_config *config)
+{
+	struct datagen *gen = calloc(1, sizeof(*gen));
+	DIE(gen == NULL, "Error allocating generator");
+
+	gen->seed = mix(config->seed);
+	gen->nr_categories = config->nr_categories != 0 ? config->nr_categories : 1;
+	gen->nr_names = config->nr_names != 0 ? config->nr_names : 1;
+	gen->category_cdf = zipf_cdf(gen->nr_categories, config->category_skew);
+	gen->name_cdf = zipf_cdf(gen->nr_names, config->name_skew);
+	return gen;
+}
+
+void datagen_destroy(struct datagen *gen)
+{
+	if (gen == NULL)
+		return;
+
+	free(gen->category_cdf);
+	free(gen->name_cdf);
+	free(gen);
+}
+
+int64_t datagen_barcode(uint64_t row)
+{
+	uint64_t mask = (1ULL << BARCODE_BITS) - 1;
+
+	return BARCODE_BASE + (int64_t)((row * BARCODE_MULT) & mask);
+}
+
+void datagen_category_name(size_t category, char *buf)
+{
+	size_t nr_words = ARRAY_LEN(category_words);
+
+	// the words are reused with a number once they run out
+	if (category < nr_words)
+		(void)snprintf(buf, ITEM_CATEGORY_MAX_LEN, "%s",
+					   category_words[category]);
+	else
+		(void)snprintf(buf, ITEM_CATEGORY_MAX_LEN, "%s %zu",
+					   category_words[category % nr_words],
+					   category / nr_words);
+}
+
+void datagen_item_name(size_t name, char *buf)
+{
+	size_t nr_nouns = ARRAY_LEN(name_nouns);
+	size_t nr_adjectives = ARRAY_LEN(name_adjectives);
+
+	(void)snprintf(buf, ITEM_NAME_MAX_LEN, "%s %s %zu",
+				   name_nouns[name % nr_nouns],
+				   name_adjectives[(name / nr_nouns) % nr_adjectives],
+				   name / (nr_nouns * nr_adjectives));
+}
+
+void datagen_item(const struct datagen *gen, uint64_t row,
+				  struct store_item *item)
+{
+	memset(item, 0, sizeof(*item));
+	item->barcode = datagen_barcode(row);
+
+	datagen_category_name(pick(gen->category_cdf, gen->nr_categories,
+							   row_random(gen, row, FIELD_CATEGORY)),
+						  item->category);
+	datagen_item_name(pick(gen->name_cdf, gen->nr_names,
+						   row_random(gen, row, FIELD_NAME)),
+					  item->name);
+
+	// prices between 0.50 and 500.00, with two decimals
+	item->price =
+		(float)(50 + row_random(gen, row, FIELD_PRICE) % 49951) / 100;
+	item->quantity = row_random(gen, row, FIELD_QUANTITY) % 1001;
+
+	// the days stop at 28 so every date is valid
+	uint64_t date = row_random(gen, row, FIELD_EXPIRY_DATE);
+	item->expiry_date.day = (int8_t)(1 + date % 28);
+	item->expiry_date.month = (int8_t)(1 + (date >> 8) % 12);
+	item->expiry_date.year = (int32_t)(2024 + (date >> 16) % 4);
+}
+
+enum status datagen_write_csv(const struct datagen *gen, uint64_t first_row,
+							  uint64_t count, FILE *out)
+{
+	struct store_item item;
+
+	for (uint64_t row = first_row; row < first_row + count; ++row) {
+		datagen_item(gen, row, &item);
+		if (fprintf(out, "%" PRId64 ",%s,%s,%.2f,%zu,%d/%d/%d\n",
+					item.barcode, item.name, item.category, item.price,
+					item.quantity, item.expiry_date.day,
+					item.expiry_date.month, item.expiry_date.year) < 0)
+			return STATUS_ERROR;
+	}
+
+	return STATUS_OK;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "store_manager.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Deterministic generator of synthetic store items. Every row is derived from
+ * the seed and its position alone, so any row can be regenerated on its own
+ * (e.g. to look it up by barcode) and the same configuration always yields the
+ * same data.
+ */
+struct datagen;
+
+struct datagen_config {
+	uint64_t seed;
+	// number of distinct categories
+	size_t nr_categories;
+	// number of distinct names
+	size_t nr_names;
+	// exponent of the Zipf distribution of the categories and of the names
+	// over the rows(0 for a uniform distribution)
+	double category_skew;
+	double name_skew;
+};
+
+/*
+ * @brief create a generator
+ * @param config the configuration of the generated data
+ * @return the generator
+ */
+struct datagen *datagen_create(const struct datagen_config *config);
+
+/*
+ * @brief release a generator
+ * @param gen the generator
+ */
+void datagen_destroy(struct datagen *gen);
+
+/*
+ * @brief get the barcode of a row, unique among all the rows
+ * @param row the position of the row
+ * @return the barcode
+ */
+int64_t datagen_barcode(uint64_t row);
+
+/*
+ * @brief generate a row
+ * @param gen the generator
+ * @param row the position of the row
+ * @param item set to the generated item
+ */
+void datagen_item(const struct datagen *gen, uint64_t row,
+				  struct store_item *item);
+
+/*
+ * @brief get the name of a category
+ * @param category the category(0 is the most frequent one)
+ * @param buf set to the name, of at least ITEM_CATEGORY_MAX_LEN bytes
+ */
+void datagen_category_name(size_t category, char *buf);
+
+/*
+ * @brief get a name given to the items
+ * @param name the name(0 is the most frequent one)
+ * @param buf set to the name, of at least ITEM_NAME_MAX_LEN bytes
+ */
+void datagen_item_name(size_t name, char *buf);
+
+/*
+ * @brief write rows as CSV lines, in the format read by import_store_items
+ * @param gen the generator
+ * @param first_row the position of the first row
+ * @param count the number of rows
+ * @param out the output stream
+ * @return the status of the operation
+ */
+enum status datagen_write_csv(const struct datagen *gen, uint64_t first_row,
+							  uint64_t count, FILE *out);
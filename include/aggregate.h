@@ -0,0 +1,117 @@
+#pragma once
+
+#include "database.h"
+#include "error.h"
+#include "report.h"
+#include "store_manager.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Statistics of the store items grouped by category: the number of items, the
+ * items low on stock, the sum, minimum, maximum and average of the prices and
+ * of the quantities, and the value of the stock(the sum of price * quantity).
+ * The sums of the prices and the value are summed up in cents from the
+ * measures of get_item_measures, so they are equal to the running totals.
+ * They are computed in a single scan of the database, in parallel when several
+ * threads are configured, each thread aggregating its part of the database
+ * into its own table of categories. The categories are compared case
+ * insensitively, like the category index does.
+ * A database opened with get_item_measures as its measure function also keeps
+ * running totals of its categories(the number of items, the sums of the
+ * prices and of the quantities, and the value of the stock), which are read
+ * without any scan.
+ */
+
+// the quantity below which an item is low on stock, unless given otherwise
+#define AGGREGATE_DEFAULT_LOW_STOCK 10
+
+/*
+ * The statistics of a category, or of the whole store.
+ */
+struct category_stats {
+	// the category as first seen, empty for the whole store
+	char category[ITEM_CATEGORY_MAX_LEN];
+	uint64_t count;
+	// the number of items whose quantity is below the low stock threshold
+	uint64_t low_stock;
+	// in cents, each price rounded like get_item_measures does
+	int64_t price_sum;
+	float price_min;
+	float price_max;
+	uint64_t quantity_sum;
+	uint64_t quantity_min;
+	uint64_t quantity_max;
+	// in cents, each price * quantity rounded like get_item_measures does
+	int64_t value;
+};
+
+struct inventory_stats {
+	// the statistics of the categories, sorted by category
+	struct category_stats *categories;
+	size_t nr_categories;
+	struct category_stats total;
+
+	// the position of each category in categories, plus one, 0 for the free
+	// positions
+	size_t *table;
+	size_t table_capacity;
+	size_t categories_capacity;
+};
+
+/*
+ * @brief Compute the statistics of the store items of a database.
+ * @param db_mgr The database manager.
+ * @param low_stock The items with a smaller quantity are counted as low on
+ * stock.
+ * @param stats Set to the statistics, released by inventory_stats_free.
+ * @return The status of the operation.
+ */
+enum status aggregate_inventory(struct db_manager *db_mgr, uint64_t low_stock,
+								struct inventory_stats *stats);
+
+/*
+ * @brief Release the statistics computed by aggregate_inventory.
+ * @param stats The statistics.
+ */
+void inventory_stats_free(struct inventory_stats *stats);
+
+/*
+ * @brief Write the statistics of the categories, followed by those of the
+ * whole store, as a report: blocks of lines, CSV lines after a header(the
+ * whole store having an empty category) or JSON objects(the whole store having
+ * a null category).
+ * @param stats The statistics.
+ * @param format The format of the report.
+ * @param out The output stream of the report.
+ * @return The status of the operation.
+ */
+enum status write_inventory_stats(const struct inventory_stats *stats,
+								  enum report_format format, FILE *out);
+
+/*
+ * @brief Read the running totals of the categories of a database opened with
+ * get_item_measures as its measure function, in a time proportional to the
+ * number of categories. Only the count, the price sum, the quantity sum and
+ * the value of the statistics are set, and the categories are spelled as in
+ * their first item, like aggregate_inventory does.
+ * @param db_mgr The database manager.
+ * @param stats Set to the totals, released by inventory_stats_free.
+ * @return The status of the operation, STATUS_ERROR if the database keeps no
+ * totals.
+ */
+enum status inventory_totals(struct db_manager *db_mgr,
+							 struct inventory_stats *stats);
+
+/*
+ * @brief Write the totals read by inventory_totals, like
+ * write_inventory_stats does, leaving out the statistics they do not have.
+ * @param stats The totals.
+ * @param format The format of the report.
+ * @param out The output stream of the report.
+ * @return The status of the operation.
+ */
+enum status write_inventory_totals(const struct inventory_stats *stats,
+								   enum report_format format, FILE *out);
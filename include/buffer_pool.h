@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * Pool of the I/O buffers of a database(blocks of slots, single slots, column
+ * values), reused across operations instead of being allocated and freed by
+ * each of them. The buffers are grouped by size class(powers of two) and the
+ * returned buffers are kept for reuse as long as the idle ones fit in the
+ * configured budget; the others are released right away, so the memory held
+ * by the pool stays bounded however large the database grows.
+ * The budget only limits the idle buffers: the buffers in use are neither
+ * counted nor refused, their total being bounded by the operations
+ * themselves(a few blocks of slots per scan thread). A failed allocation is
+ * the only reason buffer_pool_get returns NULL.
+ * The pool is thread safe, the parallel scans taking their buffers from it.
+ */
+struct buffer_pool;
+
+/*
+ * The memory the pool takes its buffers from.
+ */
+struct buffer_allocator {
+	/*
+	 * @brief Allocate a buffer.
+	 * @param ctx The context of the allocator.
+	 * @param size The size of the buffer.
+	 * @return The buffer, aligned for any type, or NULL on failure.
+	 */
+	void *(*alloc)(void *ctx, size_t size);
+	/*
+	 * @brief Release a buffer.
+	 * @param ctx The context of the allocator.
+	 * @param buf The buffer.
+	 * @param size The size the buffer was allocated with.
+	 */
+	void (*release)(void *ctx, void *buf, size_t size);
+	void *ctx;
+};
+
+/*
+ * @brief Create an empty pool.
+ * @param allocator The allocator of the buffers(NULL for page aligned heap
+ * memory). It must outlive the pool.
+ * @param max_idle_bytes The most memory kept in buffers waiting to be reused,
+ * the buffers in use not counting towards it.
+ * @return The pool.
+ */
+struct buffer_pool *buffer_pool_create(const struct buffer_allocator *allocator,
+									   size_t max_idle_bytes);
+
+/*
+ * @brief Release a pool and all its idle buffers. The buffers in use must have
+ * been returned.
+ * @param pool The pool.
+ */
+void buffer_pool_destroy(struct buffer_pool *pool);
+
+/*
+ * @brief Get a buffer, reusing an idle one of the same size class if possible.
+ * @param pool The pool.
+ * @param size The size of the buffer.
+ * @return The buffer, whose contents are undefined, or NULL if it could not be
+ * allocated.
+ */
+void *buffer_pool_get(struct buffer_pool *pool, size_t size);
+
+/*
+ * @brief Return a buffer to the pool.
+ * @param pool The pool.
+ * @param buf The buffer(NULL is ignored).
+ * @param size The size the buffer was requested with.
+ */
+void buffer_pool_put(struct buffer_pool *pool, void *buf, size_t size);
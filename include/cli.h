@@ -5,7 +5,13 @@
 
 struct cli_program {
 	struct db_manager db_mgr;
+	// configuration used when creating or loading a database
+	struct db_config db_config;
 	char *cmd_buffer;
+	// script run instead of the interactive menu(NULL for the menu)
+	const char *script_path;
+	// file the statistics are written to on exit(NULL if they are disabled)
+	const char *stats_path;
 };
 
 /*
@@ -20,6 +26,16 @@ struct cli_program *create_cli_program(void);
  */
 void destroy_cli_program(struct cli_program *cli_prog);
 
+/*
+ * @brief Apply the command line options to the CLI program.
+ * @param cli_prog The CLI program.
+ * @param argc The number of command line arguments.
+ * @param argv The command line arguments.
+ * @return STATUS_OK if the options are valid, STATUS_ERROR otherwise.
+ */
+enum status cli_parse_args(struct cli_program *cli_prog, int argc,
+						   char **argv);
+
 /*
  * @brief Process the next operation in the CLI program.
  * @param cli_prog The CLI program.
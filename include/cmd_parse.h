@@ -0,0 +1,56 @@
+#pragma once
+
+#include "error.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+
+/*
+ * Parsing of the numbers given as command arguments, shared by the program and
+ * the benchmarks. On an invalid number, the macros return STATUS_ERROR from the
+ * function they are used in, so they should only be used for parsing command
+ * arguments.
+ */
+
+// macro for parsing a string to a uintmax_t value in a given base
+#define CMD_PARSE_UINTMAX(arg, base)              \
+	({                                            \
+		const char *_arg = arg;                   \
+		char *_endptr;                            \
+		uintmax_t _val;                           \
+		errno = 0;                                \
+		_val = strtoumax(_arg, &_endptr, base);   \
+		if (_arg == _endptr || errno == ERANGE) { \
+			return STATUS_ERROR;                  \
+		}                                         \
+		_val;                                     \
+	})
+
+// macro for parsing a string to a float value
+#define CMD_PARSE_FLOAT(arg)                      \
+	({                                            \
+		const char *_arg = arg;                   \
+		char *_endptr;                            \
+		float _val;                               \
+		errno = 0;                                \
+		_val = strtof(_arg, &_endptr);            \
+		if (_arg == _endptr || errno == ERANGE) { \
+			return STATUS_ERROR;                  \
+		}                                         \
+		_val;                                     \
+	})
+
+// macro for parsing a string to a double value
+#define CMD_PARSE_DOUBLE(arg)                     \
+	({                                            \
+		const char *_arg = arg;                   \
+		char *_endptr;                            \
+		double _val;                              \
+		errno = 0;                                \
+		_val = strtod(_arg, &_endptr);            \
+		if (_arg == _endptr || errno == ERANGE) { \
+			return STATUS_ERROR;                  \
+		}                                         \
+		_val;                                     \
+	})
@@ -1,13 +1,237 @@
 #pragma once
 
+#include "buffer_pool.h"
+#include "db_stats.h"
 #include "error.h"
+#include "record_cache.h"
+#include "text_index.h"
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
+// number of slots read at once by the scans when not configured otherwise
+#define DB_DEFAULT_BLOCK_SLOTS 8192
+// number of slots whose fields are stored together by a columnar database
+#define DB_COLUMN_GROUP_SLOTS 4096
+// number of mutations committed together to the log when not configured
+// otherwise
+#define DB_DEFAULT_WAL_GROUP_OPS 32
+// memory kept in idle I/O buffers for reuse when not configured otherwise
+#define DB_DEFAULT_POOL_BYTES (8 << 20)
+// number of slots the delta of a sorted database may hold before it is merged
+// into the sorted run when not configured otherwise
+#define DB_DEFAULT_DELTA_SLOTS 4096
+// number of measures of an entry that may be summed up per group
+#define DB_MAX_MEASURES 4
+
+struct hash_index;
+struct group_index;
+struct order_index;
+struct wal;
+struct db_snapshot;
+
+/*
+ * @brief A function that extracts the unique key of an entry(e.g. a barcode).
+ * @param entry The entry.
+ * @return The key of the entry.
+ */
+typedef int64_t (*key_func)(const void *);
+
+/*
+ * @brief A function that extracts the group of an entry(e.g. a category),
+ * shared by many entries and compared case insensitively.
+ * @param entry The entry.
+ * @return The name of the group, a string that lives as long as the entry.
+ */
+typedef const char *(*group_func)(const void *);
+
+/*
+ * @brief A function that extracts a searchable text of an entry(e.g. a name),
+ * compared case insensitively.
+ * @param entry The entry.
+ * @return The text, a string that lives as long as the entry.
+ */
+typedef const char *(*text_func)(const void *);
+
+/*
+ * @brief A function that extracts the value the entries are ordered by for
+ * range lookups(e.g. an expiry date).
+ * @param entry The entry.
+ * @return The value of the entry.
+ */
+typedef int64_t (*order_func)(const void *);
+
+/*
+ * @brief A function that extracts the measures of an entry summed up per group
+ * (e.g. the quantity and the value of a product).
+ * @param entry The entry.
+ * @param values Set to the nr_measures measures of the entry.
+ */
+typedef void (*measure_func)(const void *entry, int64_t *values);
+
+/*
+ * @brief A function that receives the running totals of a group.
+ * @param ctx The context given to visit_group_totals.
+ * @param group The name of the group, spelled as in its first entry.
+ * @param count The number of entries in the group.
+ * @param sums The sums of the measures of the entries in the group.
+ */
+typedef void (*group_totals_func)(void *ctx, const char *group, uint64_t count,
+								  const int64_t *sums);
+
+/*
+ * A field of an entry, stored on its own by a columnar database.
+ */
+struct db_column {
+	size_t offset;
+	size_t size;
+};
+
+struct db_config {
+	// when set, a hash index(key -> entry position) is kept in a
+	// "<db_name>.idx" file next to the database
+	key_func key_of;
+	// when set, a dictionary of the groups and, for each group, the list of
+	// the entry positions in it are kept in a "<db_name>.grp" file
+	group_func group_of;
+	// when set, the texts of the entries are indexed for exact, prefix and
+	// substring searches in a "<db_name>.tix" file
+	text_func text_of;
+	// when set, the entries are kept ordered by this value, for range
+	// lookups, in a "<db_name>.ord" file
+	order_func order_of;
+	// when set(together with group_of), running sums of the nr_measures
+	// measures of the entries in each group are kept in the group index,
+	// updated by every change instead of scanning the database
+	measure_func measure_of;
+	// at most DB_MAX_MEASURES
+	size_t nr_measures;
+	// the database is compacted automatically once the removed entries make
+	// up this percentage of the file(0 disables the automatic compaction)
+	unsigned compact_dead_percent;
+	// access the database file through a shared memory mapping instead of
+	// stdio, scanning and updating the entries in place
+	bool use_mmap;
+	// number of slots read and written at once by the scans(0 selects
+	// DB_DEFAULT_BLOCK_SLOTS)
+	size_t block_slots;
+	// number of threads scanning the database in update_entries and
+	// dump_database(0 or 1 scans it on the calling thread)
+	unsigned nr_threads;
+	// the fields of an entry, required by the columnar layout and by
+	// dump_database_by_column
+	const struct db_column *columns;
+	size_t nr_columns;
+	// create the database in the columnar layout, storing the values of each
+	// column contiguously for groups of DB_COLUMN_GROUP_SLOTS slots(the layout
+	// of an existing database is read from its file)
+	bool columnar;
+	// log the changes in a write-ahead log("<db_name>.wal"), only writing
+	// them to the database file once they are durable in the log; the
+	// committed changes missing from the database file after a crash are
+	// replayed from the log when the database is opened
+	bool use_wal;
+	// number of mutations committed to the log together, sharing a single
+	// write and a single fsync(0 selects DB_DEFAULT_WAL_GROUP_OPS)
+	unsigned wal_group_ops;
+	// number of entries kept in memory by the record cache, looked up by key
+	// by the key operations(0 disables the cache, which requires a key
+	// function)
+	size_t cache_entries;
+	// keep the changes of the cached entries in memory until they are evicted
+	// or flushed(write-back) instead of writing them right away
+	// (write-through)
+	bool cache_write_back;
+	// the memory of the I/O buffers(NULL for the heap)
+	const struct buffer_allocator *allocator;
+	// memory kept in the I/O buffers waiting to be reused(0 selects
+	// DB_DEFAULT_POOL_BYTES), the buffers in use not being limited by it
+	size_t pool_bytes;
+	// the statistics the operations are measured in(NULL disables the
+	// measurements); they are owned by the caller and outlive the database
+	struct db_stats *stats;
+	// whether other processes may use the database file at the same time(see
+	// open_database); incompatible with the log
+	bool shared;
+	// keep the database file sorted by key instead of keeping the hash index
+	// (requires a key function, incompatible with the log): the file holds a
+	// run of slots sorted by key followed by a delta of the entries appended
+	// since, which is merged into the run once it holds more than delta_slots
+	// slots and an eighth of the run; the key lookups binary search the run
+	// and look the delta up in memory
+	bool sorted;
+	// 0 selects DB_DEFAULT_DELTA_SLOTS
+	size_t delta_slots;
+};
+
 struct db_manager {
 	FILE *db_file;
 	size_t entry_size;
+	// size of an entry together with its slot header
+	size_t slot_size;
+	// number of slots in the file, including the removed entries
+	uint64_t nr_slots;
+	// number of removed entries not yet reclaimed by the compaction
+	uint64_t nr_dead;
+	unsigned compact_percent;
+	size_t block_slots;
+	unsigned nr_threads;
+	const struct db_column *columns;
+	size_t nr_columns;
+	bool columnar;
+	// mapping of the database file in mmap mode(NULL otherwise); it can be
+	// larger than the file
+	char *map;
+	size_t map_len;
+	key_func key_of;
+	struct hash_index *index;
+	group_func group_of;
+	struct group_index *groups;
+	measure_func measure_of;
+	size_t nr_measures;
+	text_func text_of;
+	struct text_index *texts;
+	order_func order_of;
+	struct order_index *orders;
+	// the path of the database file
+	char *path;
+	// write-ahead log(NULL when disabled)
+	struct wal *wal;
+	unsigned wal_group_ops;
+	// mutations in the log batch that was not committed yet
+	unsigned wal_pending_ops;
+	// number of slots in the database file; with the log, the slots appended
+	// past it are only in the log batch
+	uint64_t file_slots;
+	// the recently used entries with a key held by a single entry(NULL when
+	// disabled)
+	struct record_cache *cache;
+	bool cache_write_back;
+	// the I/O buffers of the operations, reused across them
+	struct buffer_pool *buffers;
+	// the statistics of the operations(NULL when not measured)
+	struct db_stats *stats;
+	// sharing of the database file with other processes: the number of
+	// changes made to the file as last seen by this process, the nesting of
+	// the running operations, whether they change the database and whether
+	// they changed it already
+	bool shared;
+	uint64_t generation;
+	unsigned shared_depth;
+	bool shared_write;
+	bool changed;
+	// the snapshot of the database(NULL if none is read) and the number of
+	// snapshots taken so far
+	struct db_snapshot *snapshot;
+	uint64_t nr_snapshots;
+	// number of slots at the start of the file sorted by key, kept by all the
+	// databases with a key function; in sorted mode, the keys of the slots
+	// after them(the delta) and the size of the delta that gets merged
+	bool sorted;
+	uint64_t nr_sorted;
+	struct order_index *delta;
+	size_t delta_slots;
 };
 
 /*
@@ -20,11 +244,23 @@ typedef bool (*match_crit_func)(const void *, const void *);
 
 /*
  * @brief A function that dumps the entry either to a file or to stdout.
- * @param entry The entry to dump.
+ * @param entry The entry to dump, or NULL once at the end of a dump that found
+ * no entry, to write whatever stands for an empty report.
  * @param out The file descriptor to dump the entry to.
  */
 typedef void (*dump_entry_func)(const void *, FILE *);
 
+/*
+ * @brief A function that selects the values of a column matching the
+ * criteria.
+ * @param values The values of the column, stored contiguously.
+ * @param count The number of values.
+ * @param criteria The criteria to match.
+ * @param selected Set to 1 for the matching values and to 0 for the others.
+ */
+typedef void (*column_filter_func)(const void *, size_t, const void *,
+								   uint8_t *);
+
 /*
  * @brief A function that updates an entry in the database.
  * It is not mandatory for the second parameter to be of the same type as the
@@ -35,27 +271,234 @@ typedef void (*dump_entry_func)(const void *, FILE *);
  */
 typedef void (*update_func)(void *, const void *);
 
+/*
+ * @brief A kernel that selects the entries of a block matching the criteria,
+ * compiled for a single predicate(see DEFINE_SELECT_KERNEL).
+ * @param entries The first entry of the block.
+ * @param count The number of entries in the block.
+ * @param stride The distance between two consecutive entries, in bytes.
+ * @param criteria The criteria to match.
+ * @param selected Set to the positions in the block of the matching entries,
+ * in increasing order.
+ * @return The number of matching entries.
+ */
+typedef size_t (*select_kernel_func)(const void *, size_t, size_t,
+									 const void *, uint32_t *);
+
+/*
+ * @brief A kernel that updates some entries of a block, compiled for a single
+ * update(see DEFINE_UPDATE_KERNEL).
+ * @param entries The first entry of the block.
+ * @param stride The distance between two consecutive entries, in bytes.
+ * @param selected The positions in the block of the entries to update.
+ * @param count The number of entries to update.
+ * @param update_val The value used to update the entries.
+ */
+typedef void (*update_kernel_func)(void *, size_t, const uint32_t *, size_t,
+								   const void *);
+
+/*
+ * A predicate and an update compiled into kernels over whole blocks, so the
+ * scans of update_entries_with make no call for each entry and the predicate
+ * is inlined into the loop over the block.
+ */
+struct scan_kernel {
+	select_kernel_func select;
+	update_kernel_func update;
+};
+
+/*
+ * Define a select kernel named name from a predicate over the entries of type
+ * type, called as match(const type *entry, criteria) and best declared static
+ * inline next to the kernel. The loop over the block does not branch on the
+ * result of the predicate.
+ */
+#define DEFINE_SELECT_KERNEL(name, type, match)                             \
+	static size_t name(const void *entries, size_t count, size_t stride,    \
+					   const void *criteria, uint32_t *selected)            \
+	{                                                                       \
+		const char *entry = entries;                                        \
+		size_t nr_selected = 0;                                             \
+                                                                            \
+		for (size_t i = 0; i < count; ++i, entry += stride) {               \
+			selected[nr_selected] = (uint32_t)i;                            \
+			nr_selected += match((const type *)(const void *)entry,         \
+								 criteria);                                 \
+		}                                                                   \
+		return nr_selected;                                                 \
+	}
+
+/*
+ * Define an update kernel named name from an update of the entries of type
+ * type, called as update(type *entry, update_val) and best declared static
+ * inline next to the kernel.
+ */
+#define DEFINE_UPDATE_KERNEL(name, type, update)                             \
+	static void name(void *entries, size_t stride, const uint32_t *selected, \
+					 size_t count, const void *update_val)                   \
+	{                                                                        \
+		for (size_t i = 0; i < count; ++i)                                   \
+			update((type *)(void *)((char *)entries + selected[i] * stride), \
+				   update_val);                                              \
+	}
+
+/*
+ * @brief A function that adds an entry to a partial result of an aggregation.
+ * @param partial The partial result.
+ * @param entry The entry.
+ * @param fold_val The value given to fold_entries.
+ */
+typedef void (*fold_func)(void *, const void *, const void *);
+
+/*
+ * @brief A function that merges a partial result of an aggregation into
+ * another one, releasing the resources held by the merged partial result.
+ * @param partial The partial result merged into.
+ * @param other The partial result merged, left empty.
+ */
+typedef void (*merge_func)(void *, void *);
+
+/*
+ * An update of the entries with a key, part of a batch of updates.
+ */
+struct key_update {
+	int64_t key;
+	update_func update;
+	const void *update_val;
+};
+
+/*
+ * An update of the entries of a group, part of a batch of updates.
+ */
+struct group_update {
+	const char *group;
+	update_func update;
+	const void *update_val;
+};
+
+/*
+ * The kinds of index lookups.
+ */
+enum db_lookup_kind {
+	// the entries with a key(requires a key function)
+	DB_LOOKUP_KEY,
+	// the entries of a group(requires a group function)
+	DB_LOOKUP_GROUP,
+	// the entries whose text matches a pattern(requires a text function)
+	DB_LOOKUP_TEXT,
+	// the entries whose order value is inside a range(requires an order
+	// function)
+	DB_LOOKUP_RANGE,
+	// the entries whose key is inside a range(requires a sorted database)
+	DB_LOOKUP_KEY_RANGE,
+};
+
+/*
+ * A lookup of the entries that may match a query in one of the indexes.
+ */
+struct db_lookup {
+	enum db_lookup_kind kind;
+	// the key of a DB_LOOKUP_KEY lookup
+	int64_t key;
+	// the name of the group or the text pattern, compared case insensitively
+	const char *pattern;
+	// how the texts are matched against the pattern
+	enum text_match mode;
+	// the bounds(included) of a DB_LOOKUP_RANGE or DB_LOOKUP_KEY_RANGE lookup
+	int64_t min;
+	int64_t max;
+};
+
+/*
+ * The positions of entries selected through the indexes, in file order. A
+ * selection stays valid until the database is compacted.
+ */
+struct db_selection {
+	int64_t *slots;
+	size_t count;
+};
+
+/*
+ * Iterator over the slots of a database, one block of consecutive slots at a
+ * time. Outside of mmap mode, each block is read with a single call and, if
+ * marked as dirty, written back with a single call when the iterator moves on.
+ * In mmap mode, the blocks point directly into the mapping.
+ * The database must not be resized while it is iterated.
+ *
+ * Usage:
+ *	struct block_iter it;
+ *	block_iter_init(&it, db_mgr);
+ *	while (block_iter_next(&it)) {
+ *		for (size_t i = 0; i < it.count; ++i) {
+ *			void *entry = block_iter_entry(&it, i);
+ *			...
+ *		}
+ *	}
+ *	status = block_iter_end(&it);
+ */
+struct block_iter {
+	struct db_manager *db_mgr;
+	// index of the first slot of the current block
+	uint64_t first_idx;
+	// number of slots in the current block
+	size_t count;
+	// the slots of the current block
+	char *slots;
+
+	uint64_t next_idx;
+	uint64_t end_idx;
+	size_t capacity;
+	char *buffer;
+	bool dirty;
+	// whether the slots are read from the snapshot being read
+	bool snapshot;
+	enum status status;
+};
+
 /*
  * @brief Create a new database.
  * @param db_name The name of the database.
  * @param entry_size The size of each entry in the database.
+ * @param config The optional configuration of the database(can be NULL).
  * @return The database manager.
  */
-struct db_manager create_database(const char *db_name, size_t entry_size);
+struct db_manager create_database(const char *db_name, size_t entry_size,
+								  const struct db_config *config);
 
 /*
  * @brief Open an existing database.
+ * If the database is configured with a key function and its index is missing
+ * or stale, the index is rebuilt. With the log, the batches committed to the
+ * log are replayed into the database file first.
+ * A shared database can be opened by several processes at once. A single
+ * process changes it at a time, while the others keep reading it; each slot is
+ * locked only while it is read or written, and the readers only wait for the
+ * compaction. Every process keeps private indexes, rebuilt whenever another
+ * process changed the database since its last operation.
  * @param db_name The name of the database.
  * @param entry_size The size of each entry in the database.
+ * @param config The optional configuration of the database(can be NULL).
  * @return The database manager.
  */
-struct db_manager open_database(const char *db_name, size_t entry_size);
+struct db_manager open_database(const char *db_name, size_t entry_size,
+								const struct db_config *config);
 
 /*
  * @brief Close the database.
+ * With the log, the pending batch is committed and the log is emptied once the
+ * database file is flushed to the disk.
+ * @param db_mgr The database manager.
+ */
+void close_database(struct db_manager *db_mgr);
+
+/*
+ * @brief Make all the mutations done so far durable.
+ * With the log, the pending batch is committed to the log and written to the
+ * database file. Otherwise, the database file is flushed to the disk.
  * @param db_mgr The database manager.
+ * @return The status of the operation.
  */
-void close_database(struct db_manager db_mgr);
+enum status commit_database(struct db_manager *db_mgr);
 
 /*
  * @brief Append an entry to the database.
@@ -63,12 +506,25 @@ void close_database(struct db_manager db_mgr);
  * @param entry The entry to append.
  * @return The status of the operation.
  */
-enum status append_entry(struct db_manager db_mgr, const void *entry);
+enum status append_entry(struct db_manager *db_mgr, const void *entry);
+
+/*
+ * @brief Append many entries to the database at once.
+ * The entries are written in large chunks and added to the indexes in a single
+ * pass at the end, which is much faster than appending them one by one.
+ * @param db_mgr The database manager.
+ * @param entries The entries to append, stored contiguously.
+ * @param count The number of entries.
+ * @return The status of the operation.
+ */
+enum status append_entries(struct db_manager *db_mgr, const void *entries,
+						   size_t count);
 
 /*
  * @brief Update all entries in the database that match the criteria.
+ * With several threads configured, disjoint ranges of the database are updated
+ * in parallel, so should_update and update must be thread safe.
  * @param db_mgr The database manager.
-void dump_database(struct db_manager db_mgr,
  * @param criteria The criteria to match.
  * @param should_update A function that determines if an entry should be updated
  * based on the criteria.
@@ -77,23 +533,90 @@ void dump_database(struct db_manager db_mgr,
  * update_val.
  * @return The status of the operation.
  */
-enum status update_entries(struct db_manager db_mgr, const void *criteria,
+enum status update_entries(struct db_manager *db_mgr, const void *criteria,
 						   match_crit_func should_update,
 						   const void *update_val, update_func update);
 
+/*
+ * @brief Update all entries in the database that match the criteria, like
+ * update_entries, through the kernels of a predicate and an update: the
+ * matching entries of each block are selected by a single call and updated by
+ * another.
+ * @param db_mgr The database manager.
+ * @param criteria The criteria to match.
+ * @param update_val The value used to update the entries.
+ * @param kernel The kernels, which must be thread safe.
+ * @return The status of the operation.
+ */
+enum status update_entries_with(struct db_manager *db_mgr,
+								const void *criteria, const void *update_val,
+								const struct scan_kernel *kernel);
+
 /*
  * @brief Remove the first entry in the database that matches the criteria.
+ * The entry is only marked as removed, its space being reclaimed by the
+ * compaction.
  * @param db_mgr The database manager.
  * @param criteria The criteria to match.
  * @param matches_crit A function that determines if an entry matches the
  * criteria.
  * @return The status of the operation.
  */
-enum status remove_unique_entry(struct db_manager db_mgr, const void *criteria,
+enum status remove_unique_entry(struct db_manager *db_mgr, const void *criteria,
 								match_crit_func matches_crit);
 
+/*
+ * @brief Reclaim the space of the removed entries.
+ * The live entries are moved towards the start of the file in a single pass,
+ * one block at a time through a buffer of the pool, and the file is truncated. With the log,
+ * the live entries are copied to a new file instead, which then replaces the
+ * database file, so the compaction is never left half done by a crash.
+ * The compaction is refused while a snapshot is read, and the automatic
+ * compaction is put off until it is closed. In a sorted database, the delta is
+ * then merged into the sorted run.
+ * @param db_mgr The database manager.
+ * @return The status of the operation.
+ */
+enum status compact_database(struct db_manager *db_mgr);
+
+/*
+ * @brief Aggregate all the entries of the database in a single scan.
+ * With several threads configured, disjoint ranges of the database are
+ * scanned in parallel, each of them into its own partial result, and the
+ * partial results are merged into the result at the end, in file order. The
+ * partial results of the other threads start zeroed, so a zeroed partial
+ * result must stand for no entries.
+ * @param db_mgr The database manager.
+ * @param result The result, holding the partial result of the first range.
+ * @param partial_size The size of a partial result.
+ * @param fold_val The value passed to fold.
+ * @param fold A function that adds an entry to a partial result.
+ * @param merge A function that merges two partial results.
+ * @return The status of the operation.
+ */
+enum status fold_entries(struct db_manager *db_mgr, void *result,
+						 size_t partial_size, const void *fold_val,
+						 fold_func fold, merge_func merge);
+
+/*
+ * @brief Visit the running totals of the groups, kept when the database is
+ * configured with a measure function. The totals are maintained by every
+ * change to the database, and only the first entry of each group is read, for
+ * its name, so this takes a time proportional to the number of groups. The
+ * groups without entries are skipped.
+ * @param db_mgr The database manager.
+ * @param visit The function called for each group, in dictionary order.
+ * @param ctx The context passed to visit.
+ * @return STATUS_OK, or STATUS_ERROR if no totals are kept.
+ */
+enum status visit_group_totals(struct db_manager *db_mgr,
+							   group_totals_func visit, void *ctx);
+
 /*
  * @brief Dump entries from the database that match some criteria.
+ * The entries are always dumped in file order. With several threads
+ * configured, dump_entry and matches_crit run in parallel on different entries
+ * and must be thread safe.
  * @param db_mgr The database manager.
  * @param dump_entry A function that dumps the entry to a file.
  * @param criteria The criteria to match.
@@ -101,6 +624,365 @@ enum status remove_unique_entry(struct db_manager db_mgr, const void *criteria,
  * criteria.
  * @param out The file descriptor to dump the entries to.
  */
-void dump_database(struct db_manager db_mgr, dump_entry_func dump_entry,
+void dump_database(struct db_manager *db_mgr, dump_entry_func dump_entry,
 				   const void *criteria, match_crit_func matches_crit,
 				   FILE *out);
+
+/*
+ * @brief Dump the entries from the database whose value in a column matches
+ * some criteria.
+ * In the columnar layout, the filter runs directly on the column read from the
+ * file and only the selected entries are assembled from the other columns. In
+ * the row layout, the values of the column are gathered from each block first.
+ * The threading rules of dump_database apply to dump_entry and filter.
+ * @param db_mgr The database manager.
+ * @param dump_entry A function that dumps the entry to a file.
+ * @param column The position of the column in the configured columns.
+ * @param criteria The criteria to match.
+ * @param filter A function that selects the matching values of the column.
+ * @param out The file descriptor to dump the entries to.
+ * @return STATUS_ERROR if the column is not configured, STATUS_OK otherwise.
+ */
+enum status dump_database_by_column(struct db_manager *db_mgr,
+									dump_entry_func dump_entry, size_t column,
+									const void *criteria,
+									column_filter_func filter, FILE *out);
+
+/*
+ * @brief Take a snapshot of the database, to be read by dump_snapshot while
+ * the database keeps changing.
+ * The snapshot is copy-on-write: before a slot is changed for the first time
+ * after the snapshot was taken, the old image of its page of slots is saved in
+ * a "<db_name>.snap" file, and reading the snapshot patches the database file
+ * with the saved pages. The writers only pay for one copy of each page they
+ * change, and are never kept waiting by the readers of the snapshot.
+ * In a shared database, all the processes save the slots they change in the
+ * snapshot, and the processes taking a snapshot before the database changes
+ * again share it. A snapshot taken after a change waits for the readers of
+ * the previous one to close it.
+ * Not available with the log.
+ * @param db_mgr The database manager.
+ * @return STATUS_ERROR if a snapshot is already read by this manager or the
+ * log is enabled, the status of the operation otherwise.
+ */
+enum status open_snapshot(struct db_manager *db_mgr);
+
+/*
+ * @brief Stop reading the snapshot, removing it once no process reads it.
+ * @param db_mgr The database manager.
+ * @return STATUS_ERROR if no snapshot is read, the status of the operation
+ * otherwise.
+ */
+enum status close_snapshot(struct db_manager *db_mgr);
+
+/*
+ * @brief Dump the entries of the snapshot that match some criteria, as they
+ * were when the snapshot was taken.
+ * The entries are dumped in file order and the threading rules of
+ * dump_database apply.
+ * @param db_mgr The database manager.
+ * @param dump_entry A function that dumps the entry to a file.
+ * @param criteria The criteria to match.
+ * @param matches_crit A function that determines if an entry matches the
+ * criteria(NULL dumps all the entries).
+ * @param out The file descriptor to dump the entries to.
+ * @return STATUS_ERROR if no snapshot is read, STATUS_OK otherwise.
+ */
+enum status dump_snapshot(struct db_manager *db_mgr,
+						  dump_entry_func dump_entry, const void *criteria,
+						  match_crit_func matches_crit, FILE *out);
+
+/*
+ * @brief Read the first entry(in file order) with the given key.
+ * Requires a database configured with a key function. With the record cache,
+ * an entry whose key is held by no other entry is cached once read.
+ * @param db_mgr The database manager.
+ * @param key The key to look up.
+ * @param entry The buffer the entry is read into(entry_size bytes).
+ * @return STATUS_OK if the entry was found, STATUS_NOT_FOUND otherwise.
+ */
+enum status find_entry_by_key(struct db_manager *db_mgr, int64_t key,
+							  void *entry);
+
+/*
+ * @brief Update all entries with the given key.
+ * Requires a database configured with a key function. Only the entries holding
+ * the key are read and written; a cached entry is updated in the cache, without
+ * reading the file.
+ * @param db_mgr The database manager.
+ * @param key The key of the entries to update.
+ * @param update_val The value used to update the entries.
+ * @param update A function that updates an entry using information from
+ * update_val.
+ * @return STATUS_OK if at least one entry was updated, STATUS_NOT_FOUND if no
+ * entry holds the key.
+ */
+enum status update_entries_by_key(struct db_manager *db_mgr, int64_t key,
+								  const void *update_val, update_func update);
+
+/*
+ * @brief Remove the first entry(in file order) with the given key.
+ * Requires a database configured with a key function.
+ * @param db_mgr The database manager.
+ * @param key The key of the entry to remove.
+ * @return STATUS_OK if the entry was removed, STATUS_NOT_FOUND if no entry
+ * holds the key.
+ */
+enum status remove_entry_by_key(struct db_manager *db_mgr, int64_t key);
+
+/*
+ * @brief Update all the entries of a group, reading and writing only the
+ * entries in the group.
+ * Requires a database configured with a group function.
+ * @param db_mgr The database manager.
+ * @param group The name of the group, compared case insensitively.
+ * @param update_val The value used to update the entries.
+ * @param update A function that updates an entry using information from
+ * update_val.
+ * @return The status of the operation.
+ */
+enum status update_entries_by_group(struct db_manager *db_mgr,
+									const char *group, const void *update_val,
+									update_func update);
+
+/*
+ * @brief Apply a batch of updates of the entries with given keys, as if they
+ * were applied one after the other by update_entries_by_key.
+ * All the matching entries are looked up first, then each of them is read
+ * once, gets all its updates in the order of the batch and is written back
+ * once, in file order. The updates must not change the keys. In a sorted
+ * database, a large batch finds its entries with a single scan of the file,
+ * looking up the key of each entry in a table of the keys of the batch,
+ * instead of a binary search per key.
+ * Requires a database configured with a key function.
+ * @param db_mgr The database manager.
+ * @param updates The updates.
+ * @param count The number of updates.
+ * @param found If not NULL, set to whether each update matched an entry.
+ * @return STATUS_OK if at least one entry was updated, STATUS_NOT_FOUND if no
+ * entry holds any of the keys.
+ */
+enum status update_entries_by_keys(struct db_manager *db_mgr,
+								   const struct key_update *updates,
+								   size_t count, bool *found);
+
+/*
+ * @brief Apply a batch of updates of the entries of given groups, as if they
+ * were applied one after the other by update_entries_by_group, reading and
+ * writing each entry of the groups once, in file order. The updates must not
+ * change the groups.
+ * Requires a database configured with a group function.
+ * @param db_mgr The database manager.
+ * @param updates The updates.
+ * @param count The number of updates.
+ * @param found If not NULL, set to whether each group holds any entry.
+ * @return The status of the operation.
+ */
+enum status update_entries_by_groups(struct db_manager *db_mgr,
+									 const struct group_update *updates,
+									 size_t count, bool *found);
+
+/*
+ * @brief Dump all the entries of a group in file order, reading only the
+ * entries in the group.
+ * Requires a database configured with a group function.
+ * @param db_mgr The database manager.
+ * @param dump_entry A function that dumps the entry to a file.
+ * @param group The name of the group, compared case insensitively.
+ * @param out The file descriptor to dump the entries to.
+ * @return The status of the operation.
+ */
+enum status dump_database_by_group(struct db_manager *db_mgr,
+								   dump_entry_func dump_entry,
+								   const char *group, FILE *out);
+
+/*
+ * @brief Dump the entries whose text matches a pattern in file order, reading
+ * only the matching entries.
+ * Requires a database configured with a text function.
+ * @param db_mgr The database manager.
+ * @param dump_entry A function that dumps the entry to a file.
+ * @param pattern The pattern, compared case insensitively.
+ * @param mode Whether the text must be equal to the pattern, start with it or
+ * contain it.
+ * @param out The file descriptor to dump the entries to.
+ * @return The status of the operation.
+ */
+enum status dump_database_by_text(struct db_manager *db_mgr,
+								  dump_entry_func dump_entry,
+								  const char *pattern, enum text_match mode,
+								  FILE *out);
+
+/*
+ * @brief Update all the entries whose order value is inside a range, reading
+ * and writing only those entries, found through the order index.
+ * Requires a database configured with an order function.
+ * @param db_mgr The database manager.
+ * @param min The smallest value in the range.
+ * @param max The largest value in the range.
+ * @param update_val The value used to update the entries.
+ * @param update A function that updates an entry using information from
+ * update_val.
+ * @return The status of the operation.
+ */
+enum status update_entries_by_range(struct db_manager *db_mgr, int64_t min,
+									int64_t max, const void *update_val,
+									update_func update);
+
+/*
+ * @brief Dump all the entries whose order value is inside a range in file
+ * order, reading only those entries.
+ * Requires a database configured with an order function.
+ * @param db_mgr The database manager.
+ * @param dump_entry A function that dumps the entry to a file.
+ * @param min The smallest value in the range.
+ * @param max The largest value in the range.
+ * @param out The file descriptor to dump the entries to.
+ * @return The status of the operation.
+ */
+enum status dump_database_by_range(struct db_manager *db_mgr,
+								   dump_entry_func dump_entry, int64_t min,
+								   int64_t max, FILE *out);
+
+/*
+ * @brief Get the counters of the record cache.
+ * @param db_mgr The database manager.
+ * @param stats Set to the counters, all 0 if the cache is disabled.
+ */
+void get_cache_stats(const struct db_manager *db_mgr,
+					 struct record_cache_stats *stats);
+
+/*
+ * @brief Count the entries of a group, using the group index.
+ * @param db_mgr The database manager.
+ * @param group The name of the group, compared case insensitively.
+ * @return The number of entries in the group, 0 without a group function.
+ */
+uint64_t count_group_entries(struct db_manager *db_mgr, const char *group);
+
+/*
+ * @brief Estimate the number of entries whose order value is inside a range,
+ * using the order index, without reading them.
+ * @param db_mgr The database manager.
+ * @param min The smallest value in the range.
+ * @param max The largest value in the range.
+ * @return The estimated number of entries, 0 without an order function.
+ */
+uint64_t count_range_entries(struct db_manager *db_mgr, int64_t min,
+							 int64_t max);
+
+/*
+ * @brief Estimate the number of entries whose key is inside a range, from the
+ * positions of its bounds in the sorted run and from the delta, without
+ * reading the entries in between.
+ * @param db_mgr The database manager.
+ * @param min The smallest key in the range.
+ * @param max The largest key in the range.
+ * @return The estimated number of entries, 0 if the database is not sorted.
+ */
+uint64_t count_key_range_entries(struct db_manager *db_mgr, int64_t min,
+								 int64_t max);
+
+/*
+ * @brief Add the entries found by an index lookup to a selection.
+ * The selection must start zeroed; selecting several lookups gives the union
+ * of their entries, each entry being selected once.
+ * @param db_mgr The database manager.
+ * @param lookup The lookup.
+ * @param selection The selection.
+ * @return STATUS_ERROR if the index of the lookup is missing, STATUS_OK
+ * otherwise.
+ */
+enum status select_entries(struct db_manager *db_mgr,
+						   const struct db_lookup *lookup,
+						   struct db_selection *selection);
+
+/*
+ * @brief Release a selection, leaving it empty.
+ * @param selection The selection.
+ */
+void free_selection(struct db_selection *selection);
+
+/*
+ * @brief Dump the selected entries that match some criteria in file order,
+ * reading only the selected entries.
+ * @param db_mgr The database manager.
+ * @param selection The selected entries.
+ * @param dump_entry A function that dumps the entry to a file.
+ * @param criteria The criteria to match.
+ * @param matches_crit A function that determines if an entry matches the
+ * criteria(NULL dumps all the selected entries).
+ * @param out The file descriptor to dump the entries to.
+ * @return The status of the operation.
+ */
+enum status dump_selection(struct db_manager *db_mgr,
+						   const struct db_selection *selection,
+						   dump_entry_func dump_entry, const void *criteria,
+						   match_crit_func matches_crit, FILE *out);
+
+/*
+ * @brief Update the selected entries that match some criteria, reading and
+ * writing only the selected entries.
+ * @param db_mgr The database manager.
+ * @param selection The selected entries.
+ * @param criteria The criteria to match.
+ * @param should_update A function that determines if an entry should be updated
+ * based on the criteria(NULL updates all the selected entries).
+ * @param update_val The value used to update the entries.
+ * @param update A function that updates an entry using information from
+ * update_val.
+ * @return The status of the operation.
+ */
+enum status update_selection(struct db_manager *db_mgr,
+							 const struct db_selection *selection,
+							 const void *criteria,
+							 match_crit_func should_update,
+							 const void *update_val, update_func update);
+
+/*
+ * @brief Start iterating over all the slots of the database.
+ * @param it The block iterator.
+ * @param db_mgr The database manager.
+ */
+void block_iter_init(struct block_iter *it, struct db_manager *db_mgr);
+
+/*
+ * @brief Start iterating over a range of slots of the database.
+ * Iterators over disjoint ranges may be used from different threads.
+ * @param it The block iterator.
+ * @param db_mgr The database manager.
+ * @param first_idx The index of the first slot.
+ * @param end_idx The index past the last slot(clamped to the database size).
+ */
+void block_iter_init_range(struct block_iter *it, struct db_manager *db_mgr,
+						   uint64_t first_idx, uint64_t end_idx);
+
+/*
+ * @brief Move to the next block, writing the current one back if it is dirty.
+ * @param it The block iterator.
+ * @return True if a new block was loaded, false at the end of the database or
+ * on error.
+ */
+bool block_iter_next(struct block_iter *it);
+
+/*
+ * @brief Get an entry of the current block.
+ * @param it The block iterator.
+ * @param i The position of the slot in the block(less than it->count).
+ * @return The entry or NULL if the entry was removed.
+ */
+void *block_iter_entry(const struct block_iter *it, size_t i);
+
+/*
+ * @brief Mark the current block as modified, so it is written back.
+ * @param it The block iterator.
+ */
+void block_iter_mark_dirty(struct block_iter *it);
+
+/*
+ * @brief Finish the iteration, writing the current block back if it is dirty
+ * and releasing the iterator buffer.
+ * @param it The block iterator.
+ * @return The status of the iteration.
+ */
+enum status block_iter_end(struct block_iter *it);
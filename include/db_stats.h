@@ -0,0 +1,175 @@
+#pragma once
+
+#include "error.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// number of buckets of the latency histograms: bucket 0 counts the latencies
+// below 1 microsecond, bucket i the ones in [2^(i - 1), 2^i) microseconds and
+// the last bucket also counts all the longer ones
+#define DB_STATS_LATENCY_BUCKETS 32
+
+/*
+ * The operations of a database measured by the statistics.
+ */
+enum db_op {
+	// the work done outside any operation(e.g. opening or closing)
+	DB_OP_OTHER,
+	DB_OP_APPEND,
+	DB_OP_APPEND_BATCH,
+	DB_OP_FIND_BY_KEY,
+	DB_OP_UPDATE,
+	DB_OP_UPDATE_BY_KEY,
+	DB_OP_UPDATE_BY_GROUP,
+	DB_OP_UPDATE_BY_RANGE,
+	DB_OP_UPDATE_SELECTION,
+	DB_OP_REMOVE,
+	DB_OP_REMOVE_BY_KEY,
+	DB_OP_DUMP,
+	DB_OP_DUMP_BY_GROUP,
+	DB_OP_DUMP_BY_TEXT,
+	DB_OP_DUMP_BY_RANGE,
+	DB_OP_DUMP_SELECTION,
+	DB_OP_DUMP_SNAPSHOT,
+	DB_OP_SELECT,
+	DB_OP_AGGREGATE,
+	DB_OP_COMPACT,
+	DB_OP_COMMIT,
+	// taking and releasing snapshots
+	DB_OP_SNAPSHOT,
+	DB_NR_OPS,
+};
+
+/*
+ * The counters of one type of operation.
+ */
+struct db_op_stats {
+	// number of operations
+	uint64_t count;
+	// entries read and checked by the operations
+	uint64_t scanned;
+	// entries found, updated, dumped or removed by the operations
+	uint64_t matched;
+	// bytes read from and written to the database and its log(in mmap mode,
+	// the bytes copied from and to the mapping)
+	uint64_t bytes_read;
+	uint64_t bytes_written;
+	// system calls issued on the database files(reads, writes, flushes,
+	// resizes)
+	uint64_t syscalls;
+	// wall-clock time of the operations, in nanoseconds
+	uint64_t total_ns;
+	uint64_t max_ns;
+	uint64_t latency[DB_STATS_LATENCY_BUCKETS];
+};
+
+/*
+ * Statistics of the operations of the databases using them, filled in only
+ * when they are given to the databases through their configuration. The
+ * counters may be updated by the threads of a parallel scan, while the
+ * operations are started and ended by a single thread.
+ */
+struct db_stats;
+
+/*
+ * @brief Create statistics with all the counters at zero.
+ * @return The statistics.
+ */
+struct db_stats *db_stats_create(void);
+
+/*
+ * @brief Release statistics.
+ * @param stats The statistics.
+ */
+void db_stats_destroy(struct db_stats *stats);
+
+/*
+ * @brief Set all the counters to zero.
+ * @param stats The statistics.
+ */
+void db_stats_reset(struct db_stats *stats);
+
+/*
+ * @brief Get the name of an operation.
+ * @param op The operation.
+ * @return The name(e.g. "update_by_group").
+ */
+const char *db_op_name(enum db_op op);
+
+/*
+ * @brief Find an operation by its name.
+ * @param name The name.
+ * @param op Set to the operation, if found.
+ * @return Whether the name is the name of an operation.
+ */
+bool db_op_parse(const char *name, enum db_op *op);
+
+/*
+ * @brief Start measuring an operation. An operation started by another one is
+ * counted as part of it.
+ * @param stats The statistics.
+ * @param op The operation.
+ */
+void db_stats_begin(struct db_stats *stats, enum db_op op);
+
+/*
+ * @brief Finish measuring the last started operation.
+ * @param stats The statistics.
+ */
+void db_stats_end(struct db_stats *stats);
+
+/*
+ * @brief Count entries processed by the current operation.
+ * @param stats The statistics.
+ * @param scanned The number of entries read and checked.
+ * @param matched The number of entries found, updated, dumped or removed.
+ */
+void db_stats_add_entries(struct db_stats *stats, uint64_t scanned,
+						  uint64_t matched);
+
+/*
+ * @brief Count I/O done by the current operation.
+ * @param stats The statistics.
+ * @param bytes_read The number of bytes read.
+ * @param bytes_written The number of bytes written.
+ * @param syscalls The number of system calls.
+ */
+void db_stats_add_io(struct db_stats *stats, uint64_t bytes_read,
+					 uint64_t bytes_written, uint64_t syscalls);
+
+/*
+ * @brief Get the counters of an operation.
+ * @param stats The statistics.
+ * @param op The operation.
+ * @param op_stats Set to the counters.
+ */
+void db_stats_get(const struct db_stats *stats, enum db_op op,
+				  struct db_op_stats *op_stats);
+
+/*
+ * @brief Estimate a percentile of the latencies of an operation from their
+ * histogram.
+ * @param op_stats The counters of the operation.
+ * @param p The percentile, between 0 and 1.
+ * @return The upper bound of the histogram bucket holding the percentile, in
+ * microseconds(0 if no operation was measured).
+ */
+double db_stats_percentile(const struct db_op_stats *op_stats, double p);
+
+/*
+ * @brief Write a table of the counters of the operations measured so far.
+ * @param stats The statistics.
+ * @param out The output stream.
+ */
+void db_stats_write_text(const struct db_stats *stats, FILE *out);
+
+/*
+ * @brief Write all the counters as a JSON object, with the operations as
+ * members.
+ * @param stats The statistics.
+ * @param out The output stream.
+ * @return The status of the write.
+ */
+enum status db_stats_write_json(const struct db_stats *stats, FILE *out);
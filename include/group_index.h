@@ -0,0 +1,138 @@
+#pragma once
+
+#include "error.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Secondary index over a string attribute shared by many entries(e.g. the
+ * category of a product). The distinct values are interned into a dictionary
+ * of names, compared case insensitively and kept as first seen, each getting
+ * a small integer id, and every id maps to the sorted list(posting list) of
+ * the slots holding that value. Optionally, each group also keeps running sums
+ * of some values of its entries, updated by the caller as the entries come and
+ * go.
+ * The index is kept in memory and written to its file when it is closed.
+ */
+struct group_index;
+
+/*
+ * @brief Load an existing index file.
+ * The index is considered stale, and NULL is returned, if it was not closed
+ * cleanly, if it keeps a different number of sums or if it does not describe
+ * the data file with the given size and modification time.
+ * @param path The path of the index file.
+ * @param nr_sums The number of running sums of each group.
+ * @param data_size The current size of the data file.
+ * @param data_mtime The current modification time of the data file(ns).
+ * @return The index or NULL if the index is missing or stale.
+ */
+struct group_index *group_index_open(const char *path, size_t nr_sums,
+									 uint64_t data_size, uint64_t data_mtime);
+
+/*
+ * @brief Create a new, empty index, replacing any existing index file.
+ * @param path The path of the index file.
+ * @param nr_sums The number of running sums of each group.
+ * @return The index.
+ */
+struct group_index *group_index_create(const char *path, size_t nr_sums);
+
+/*
+ * @brief Write the index to its file, marking it as up to date with the data
+ * file, and release it.
+ * @param gi The index.
+ * @param data_size The size of the data file at close time.
+ * @param data_mtime The modification time of the data file at close time(ns).
+ */
+void group_index_close(struct group_index *gi, uint64_t data_size,
+					   uint64_t data_mtime);
+
+/*
+ * @brief Get the id of a group name.
+ * @param gi The index.
+ * @param name The name, compared case insensitively.
+ * @return The id or -1 if the name is not in the dictionary.
+ */
+int64_t group_index_lookup(const struct group_index *gi, const char *name);
+
+/*
+ * @brief Get the id of a group name, adding the name to the dictionary if it
+ * is not there yet.
+ * @param gi The index.
+ * @param name The name, compared case insensitively.
+ * @return The id.
+ */
+uint32_t group_index_intern(struct group_index *gi, const char *name);
+
+/*
+ * @brief Add a slot to the posting list of a group.
+ * @param gi The index.
+ * @param id The id of the group.
+ * @param slot The slot of the entry.
+ */
+void group_index_insert(struct group_index *gi, uint32_t id, int64_t slot);
+
+/*
+ * @brief Remove a slot from the posting list of a group.
+ * @param gi The index.
+ * @param id The id of the group.
+ * @param slot The slot of the entry.
+ * @return STATUS_OK if the slot was removed, STATUS_NOT_FOUND otherwise.
+ */
+enum status group_index_remove(struct group_index *gi, uint32_t id,
+							   int64_t slot);
+
+/*
+ * @brief Get the posting list of a group.
+ * The list is invalidated by any change to the index.
+ * @param gi The index.
+ * @param id The id of the group.
+ * @param count Set to the number of slots in the list.
+ * @return The slots of the group, in increasing order.
+ */
+const int64_t *group_index_slots(const struct group_index *gi, uint32_t id,
+								 size_t *count);
+
+/*
+ * @brief Add values to the running sums of a group.
+ * @param gi The index.
+ * @param id The id of the group.
+ * @param values One value for each sum.
+ * @param factor The values are multiplied by it(-1 subtracts them).
+ */
+void group_index_add_sums(struct group_index *gi, uint32_t id,
+						  const int64_t *values, int64_t factor);
+
+/*
+ * @brief Get the running sums of a group.
+ * The sums are invalidated by any change to the index.
+ * @param gi The index.
+ * @param id The id of the group.
+ * @return The sums of the group.
+ */
+const int64_t *group_index_sums(const struct group_index *gi, uint32_t id);
+
+/*
+ * @brief Get the number of groups in the dictionary, the ids being
+ * 0 .. count - 1.
+ * @param gi The index.
+ * @return The number of groups.
+ */
+uint32_t group_index_nr_groups(const struct group_index *gi);
+
+/*
+ * @brief Get the name of a group.
+ * @param gi The index.
+ * @param id The id of the group.
+ * @return The name, spelled as it was first added.
+ */
+const char *group_index_name(const struct group_index *gi, uint32_t id);
+
+/*
+ * @brief Empty all the posting lists and zero the running sums, keeping the
+ * dictionary.
+ * @param gi The index.
+ */
+void group_index_clear(struct group_index *gi);
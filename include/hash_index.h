@@ -0,0 +1,91 @@
+#pragma once
+
+#include "error.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * On-disk open-addressing hash index mapping an integer key to the slots
+ * (entry positions) of the database file holding that key.
+ * The index is a multimap: the same key may be mapped to several slots.
+ */
+struct hash_index;
+
+/*
+ * @brief Open an existing index file.
+ * The index is considered stale, and NULL is returned, if it was not closed
+ * cleanly or if it does not describe the data file with the given size and
+ * modification time.
+ * @param path The path of the index file.
+ * @param data_size The current size of the data file.
+ * @param data_mtime The current modification time of the data file(ns).
+ * @return The index or NULL if the index is missing or stale.
+ */
+struct hash_index *hash_index_open(const char *path, uint64_t data_size,
+								   uint64_t data_mtime);
+
+/*
+ * @brief Create a new, empty index file, replacing any existing one.
+ * @param path The path of the index file.
+ * @param expected_keys The number of keys the index should hold without
+ * growing.
+ * @return The index.
+ */
+struct hash_index *hash_index_create(const char *path, uint64_t expected_keys);
+
+/*
+ * @brief Close the index, marking it as up to date with the data file.
+ * @param idx The index.
+ * @param data_size The size of the data file at close time.
+ * @param data_mtime The modification time of the data file at close time(ns).
+ */
+void hash_index_close(struct hash_index *idx, uint64_t data_size,
+					  uint64_t data_mtime);
+
+/*
+ * @brief Map a key to a slot.
+ * @param idx The index.
+ * @param key The key.
+ * @param slot The slot of the entry holding the key.
+ * @return The status of the operation.
+ */
+enum status hash_index_insert(struct hash_index *idx, int64_t key,
+							  int64_t slot);
+
+/*
+ * @brief Grow the index, if needed, so the given number of keys can be
+ * inserted without rehashing the table.
+ * @param idx The index.
+ * @param nr_keys The number of keys about to be inserted.
+ */
+void hash_index_reserve(struct hash_index *idx, uint64_t nr_keys);
+
+/*
+ * @brief Remove the mapping between a key and a slot.
+ * @param idx The index.
+ * @param key The key.
+ * @param slot The slot of the entry holding the key.
+ * @return STATUS_OK if the mapping was removed, STATUS_NOT_FOUND otherwise.
+ */
+enum status hash_index_remove(struct hash_index *idx, int64_t key,
+							  int64_t slot);
+
+/*
+ * @brief Get the next slot mapped to a key.
+ * The cursor must be set to 0 before the first call and must not be modified
+ * between calls. The index must not be modified during the iteration.
+ * @param idx The index.
+ * @param key The key.
+ * @param cursor The position of the iteration.
+ * @return The next slot holding the key or -1 if there are no more slots.
+ */
+int64_t hash_index_next(const struct hash_index *idx, int64_t key,
+						uint64_t *cursor);
+
+/*
+ * @brief Remove all the mappings from the index.
+ * @param idx The index.
+ */
+void hash_index_clear(struct hash_index *idx);
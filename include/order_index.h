@@ -0,0 +1,117 @@
+#pragma once
+
+#include "error.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Secondary index ordering the entries by an integer value(e.g. an expiry
+ * date), for range lookups. The (value, slot) pairs are kept in a large sorted
+ * run and a small sorted delta receiving the insertions, which is merged into
+ * the run once it grows too large. Removed pairs are only marked in the run
+ * and dropped by the next merge.
+ * The index is kept in memory and written to its file when it is closed.
+ */
+struct order_index;
+
+/*
+ * @brief Load an existing index file.
+ * The index is considered stale, and NULL is returned, if it was not closed
+ * cleanly or if it does not describe the data file with the given size and
+ * modification time.
+ * @param path The path of the index file.
+ * @param data_size The current size of the data file.
+ * @param data_mtime The current modification time of the data file(ns).
+ * @return The index or NULL if the index is missing or stale.
+ */
+struct order_index *order_index_open(const char *path, uint64_t data_size,
+									 uint64_t data_mtime);
+
+/*
+ * @brief Create a new, empty index, replacing any existing index file.
+ * @param path The path of the index file(NULL keeps the index in memory only,
+ * without writing it when it is closed).
+ * @return The index.
+ */
+struct order_index *order_index_create(const char *path);
+
+/*
+ * @brief Write the index to its file, marking it as up to date with the data
+ * file, and release it.
+ * @param oi The index.
+ * @param data_size The size of the data file at close time.
+ * @param data_mtime The modification time of the data file at close time(ns).
+ */
+void order_index_close(struct order_index *oi, uint64_t data_size,
+					   uint64_t data_mtime);
+
+/*
+ * @brief Add the value of a slot to the index.
+ * @param oi The index.
+ * @param value The value.
+ * @param slot The slot of the entry.
+ */
+void order_index_insert(struct order_index *oi, int64_t value, int64_t slot);
+
+/*
+ * @brief Add the values of many slots to the index at once, sorting them
+ * apart and merging them with the others in a single pass.
+ * @param oi The index.
+ * @param values The values.
+ * @param slots The slots of the values.
+ * @param count The number of values.
+ */
+void order_index_insert_many(struct order_index *oi, const int64_t *values,
+							 const int64_t *slots, size_t count);
+
+/*
+ * @brief Remove the value of a slot from the index.
+ * @param oi The index.
+ * @param value The value of the slot.
+ * @param slot The slot of the entry.
+ * @return STATUS_OK if the slot was removed, STATUS_NOT_FOUND otherwise.
+ */
+enum status order_index_remove(struct order_index *oi, int64_t value,
+							   int64_t slot);
+
+/*
+ * @brief Find the slots whose value is inside a range.
+ * @param oi The index.
+ * @param min The smallest value in the range.
+ * @param max The largest value in the range.
+ * @param slots Set to the matching slots, in increasing order, which must be
+ * freed by the caller.
+ * @return The number of matching slots.
+ */
+size_t order_index_find(const struct order_index *oi, int64_t min,
+						int64_t max, int64_t **slots);
+
+/*
+ * @brief Find the first slot holding a value, starting from a given slot.
+ * @param oi The index.
+ * @param value The value.
+ * @param slot The smallest slot returned.
+ * @return The smallest slot not below the given one holding the value or -1 if
+ * there is none.
+ */
+int64_t order_index_next(const struct order_index *oi, int64_t value,
+						 int64_t slot);
+
+/*
+ * @brief Estimate the number of slots whose value is inside a range, without
+ * reading them.
+ * @param oi The index.
+ * @param min The smallest value in the range.
+ * @param max The largest value in the range.
+ * @return The number of slots in the range, counting the removed slots not yet
+ * dropped by a merge.
+ */
+uint64_t order_index_count(const struct order_index *oi, int64_t min,
+						   int64_t max);
+
+/*
+ * @brief Remove all the values from the index.
+ * @param oi The index.
+ */
+void order_index_clear(struct order_index *oi);
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "error.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Sorted list of the slots(entry positions) holding some value, used by the
+ * secondary indexes of the database.
+ */
+struct posting_list {
+	int64_t *slots;
+	size_t len;
+	size_t capacity;
+};
+
+/*
+ * @brief Add a slot to the list, keeping it sorted.
+ * @param list The posting list.
+ * @param slot The slot.
+ */
+void posting_list_insert(struct posting_list *list, int64_t slot);
+
+/*
+ * @brief Remove a slot from the list.
+ * @param list The posting list.
+ * @param slot The slot.
+ * @return STATUS_OK if the slot was removed, STATUS_NOT_FOUND otherwise.
+ */
+enum status posting_list_remove(struct posting_list *list, int64_t slot);
+
+/*
+ * @brief Check if the list holds a slot.
+ * @param list The posting list.
+ * @param slot The slot.
+ * @return True if the slot is in the list.
+ */
+bool posting_list_contains(const struct posting_list *list, int64_t slot);
+
+/*
+ * @brief Release the slots of the list.
+ * @param list The posting list.
+ */
+void posting_list_free(struct posting_list *list);
+
+/*
+ * @brief Write the list to a file: the number of slots, then the slots.
+ * @param list The posting list.
+ * @param file The file.
+ * @return True on success.
+ */
+bool posting_list_write(const struct posting_list *list, FILE *file);
+
+/*
+ * @brief Read a list written by posting_list_write.
+ * @param list The posting list, which must be empty.
+ * @param file The file.
+ * @return True on success.
+ */
+bool posting_list_read(struct posting_list *list, FILE *file);
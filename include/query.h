@@ -0,0 +1,157 @@
+#pragma once
+
+#include "database.h"
+#include "error.h"
+#include "store_manager.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Queries over the store items: a disjunction of conjunctions of conditions on
+ * the fields of an item, written as
+ *
+ *   price < 10 and category = Lactate or name ~ "lapte batut"
+ *
+ * where "and" binds tighter than "or". The fields are barcode, name, category,
+ * price, quantity and expiry(or expiry_date); the operators are =, !=, <, <=,
+ * >, >= and, for name and category, ^=(starts with) and ~(contains). The texts
+ * are compared case insensitively and the dates are written as zi/luna/an. A
+ * value holding spaces is written between double quotes, with \" and \\
+ * standing for a quote and a backslash.
+ *
+ * A query is planned before it runs: the conditions of each conjunction are
+ * ordered so that the most selective ones are checked first, and if every
+ * conjunction has a condition answered by an index(barcode =, category =,
+ * name =, ^= or ~, or a range of expiry dates, the conditions on the expiry
+ * date of a conjunction being combined, or, in a sorted database, a range of
+ * barcodes, combined the same way), only the entries found in the indexes are
+ * read. Otherwise the query is checked on every entry in a single scan of
+ * the database. A dump of a single conjunction of conditions on the price, or
+ * of a single condition barcode =, expiry < or expiry <=, only reads the
+ * column of that field to select the items(see dump_database_by_column), and
+ * an update of a single condition barcode = or category = is checked by the
+ * kernels of update_items_matching.
+ */
+
+// maximum number of conditions in a query
+#define QUERY_MAX_CONDS 32
+// the indexes are only used when they select at most 1/QUERY_INDEX_MAX_SHARE
+// of the entries, a scan being cheaper beyond that
+#define QUERY_INDEX_MAX_SHARE 4
+
+enum query_field {
+	QUERY_BARCODE,
+	QUERY_NAME,
+	QUERY_CATEGORY,
+	QUERY_PRICE,
+	QUERY_QUANTITY,
+	QUERY_EXPIRY,
+};
+
+enum query_op {
+	QUERY_EQ,
+	QUERY_NE,
+	QUERY_LT,
+	QUERY_LE,
+	QUERY_GT,
+	QUERY_GE,
+	QUERY_PREFIX,
+	QUERY_CONTAINS,
+};
+
+/*
+ * A condition on a field of a store item.
+ */
+struct query_cond {
+	enum query_field field;
+	enum query_op op;
+	// the estimated share of the entries matching the condition, set by
+	// query_plan
+	double selectivity;
+	union {
+		int64_t barcode;
+		float price;
+		uint64_t quantity;
+		// the date packed by pack_date
+		int64_t date;
+		char text[ITEM_NAME_MAX_LEN];
+	} value;
+};
+
+struct query {
+	// the conditions, grouped by conjunction
+	struct query_cond conds[QUERY_MAX_CONDS];
+	size_t nr_conds;
+	// the number of conditions of each conjunction
+	size_t term_len[QUERY_MAX_CONDS];
+	size_t nr_terms;
+	// the entries selected through the indexes, used when use_index is set
+	struct db_selection selection;
+	bool use_index;
+};
+
+/*
+ * @brief parse a query
+ * @param text the text of the query
+ * @param query set to the query, which must be released with query_free
+ * @return true if the text is a valid query, false otherwise
+ */
+bool query_parse(const char *text, struct query *query);
+
+/*
+ * @brief plan a query on a database: order the conditions of each conjunction
+ * by their selectivity and select the entries to check through the indexes,
+ * when they all have a condition answered by an index and select few entries
+ * @param db_mgr the database manager
+ * @param query the query
+ * @return the status of the operation
+ */
+enum status query_plan(struct db_manager *db_mgr, struct query *query);
+
+/*
+ * @brief check if the store item matches the query, a thread safe criteria of
+ * dump_database and update_entries
+ * @param entry the entry to check
+ * @param query the query(struct query) to check against
+ * @return true if the entry matches the query, false otherwise
+ */
+bool matches_query(const void *entry, const void *query);
+
+/*
+ * @brief plan a query and dump the matching store items in file order
+ * @param db_mgr the database manager
+ * @param query the query
+ * @param dump_entry the function dumping the matching entries
+ * @param out the output stream to dump the entries to
+ * @return the status of the operation
+ */
+enum status query_dump(struct db_manager *db_mgr, struct query *query,
+					   dump_entry_func dump_entry, FILE *out);
+
+/*
+ * @brief plan a query and update the matching store items
+ * @param db_mgr the database manager
+ * @param query the query
+ * @param update_val the value used to update the entries
+ * @param update the function updating the matching entries
+ * @return the status of the operation
+ */
+enum status query_update(struct db_manager *db_mgr, struct query *query,
+						 const void *update_val, update_func update);
+
+/*
+ * @brief write the plan of a query: its conditions in the order they are
+ * checked and the way the entries are found
+ * @param query the planned query
+ * @param out the output stream
+ */
+void query_explain(const struct query *query, FILE *out);
+
+/*
+ * @brief release the entries selected by the plan of a query
+ * @param query the query
+ */
+void query_free(struct query *query);
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "error.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Bounded cache of entries, looked up by their key, each remembering the slot
+ * it was read from. Once full, the least recently used entry is evicted. The
+ * cached entries can be modified in place and marked as dirty, in which case
+ * they are only written to the database when they are evicted or flushed.
+ */
+struct record_cache;
+
+struct record_cache_stats {
+	// lookups that found the entry
+	uint64_t hits;
+	// lookups that did not
+	uint64_t misses;
+	// entries dropped to make room for others
+	uint64_t evictions;
+	// dirty entries written to the database
+	uint64_t write_backs;
+};
+
+/*
+ * @brief A function that writes a dirty cached entry to its slot.
+ * @param ctx The context given to the cache call.
+ * @param slot The slot of the entry.
+ * @param entry The entry.
+ * @return The status of the write.
+ */
+typedef enum status (*record_write_func)(void *, int64_t, const void *);
+
+/*
+ * @brief Create an empty cache.
+ * @param capacity The maximum number of cached entries.
+ * @param entry_size The size of an entry.
+ * @return The cache.
+ */
+struct record_cache *record_cache_create(size_t capacity, size_t entry_size);
+
+/*
+ * @brief Release a cache, dropping its entries, which must have been flushed.
+ * @param rc The cache.
+ */
+void record_cache_destroy(struct record_cache *rc);
+
+/*
+ * @brief Look up the entry with a key, marking it as the most recently used.
+ * The lookup is counted as a hit or a miss.
+ * @param rc The cache.
+ * @param key The key.
+ * @param slot Set to the slot of the entry, if found.
+ * @return The cached entry, which may be modified in place, or NULL if the key
+ * is not cached.
+ */
+void *record_cache_get(struct record_cache *rc, int64_t key, int64_t *slot);
+
+/*
+ * @brief Add a clean entry to the cache or replace the cached entry with the
+ * same key. If the cache is full, the least recently used entry is evicted,
+ * being written first if it is dirty.
+ * @param rc The cache.
+ * @param key The key of the entry.
+ * @param slot The slot of the entry.
+ * @param entry The entry, as it is stored in the slot.
+ * @param write The function writing a dirty evicted entry.
+ * @param ctx The context of write.
+ * @return The status of the write of the evicted entry.
+ */
+enum status record_cache_put(struct record_cache *rc, int64_t key,
+							 int64_t slot, const void *entry,
+							 record_write_func write, void *ctx);
+
+/*
+ * @brief Replace the cached entry of a slot, if its key is cached for that
+ * slot, without counting a lookup. The entry is considered clean.
+ * @param rc The cache.
+ * @param key The key of the entry.
+ * @param slot The slot of the entry.
+ * @param entry The entry, as it is stored in the slot.
+ */
+void record_cache_refresh(struct record_cache *rc, int64_t key, int64_t slot,
+						  const void *entry);
+
+/*
+ * @brief Mark the cached entry with a key as modified since it was written.
+ * @param rc The cache.
+ * @param key The key.
+ */
+void record_cache_mark_dirty(struct record_cache *rc, int64_t key);
+
+/*
+ * @brief Drop the entry with a key from the cache.
+ * @param rc The cache.
+ * @param key The key.
+ * @param write The function writing the entry if it is dirty, or NULL to
+ * discard the changes(e.g. for a removed entry).
+ * @param ctx The context of write.
+ * @return The status of the write.
+ */
+enum status record_cache_remove(struct record_cache *rc, int64_t key,
+								record_write_func write, void *ctx);
+
+/*
+ * @brief Write all the dirty entries, in increasing slot order, keeping them
+ * cached as clean entries.
+ * @param rc The cache.
+ * @param write The function writing an entry.
+ * @param ctx The context of write.
+ * @return The status of the writes.
+ */
+enum status record_cache_flush(struct record_cache *rc,
+							   record_write_func write, void *ctx);
+
+/*
+ * @brief Drop all the entries from the cache, which must have been flushed.
+ * @param rc The cache.
+ */
+void record_cache_clear(struct record_cache *rc);
+
+/*
+ * @brief Get the counters of the cache.
+ * @param rc The cache.
+ * @param stats Set to the counters.
+ */
+void record_cache_get_stats(const struct record_cache *rc,
+							struct record_cache_stats *stats);
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Helpers for writing reports quickly: the fields of an entry are formatted by
+ * hand into a buffer, without going through printf, and the buffer is written
+ * to a report file with a large stdio buffer, so that the entries reach the
+ * file in few large writes.
+ * Every helper writes at the given position of the buffer, without a null
+ * terminator, and returns the position after the written text.
+ */
+
+// size of the stdio buffer of a report file
+#define REPORT_BUFFER_SIZE (1UL << 20)
+// longest text written by report_put_uint, report_put_int or report_put_price
+#define REPORT_NUMBER_MAX_LEN 64
+
+/*
+ * The formats a report can be written in.
+ */
+enum report_format {
+	// blocks of "Camp: valoare" lines, the format of the interactive reports
+	REPORT_BLOCK,
+	// one comma separated line per entry, after a header line
+	REPORT_CSV,
+	// one JSON object per line
+	REPORT_JSON_LINES,
+};
+
+/*
+ * @brief Write a string literal.
+ */
+#define REPORT_PUT_LITERAL(dst, literal)                     \
+	((char *)memcpy((dst), (literal), sizeof(literal) - 1) + \
+	 sizeof(literal) - 1)
+
+/*
+ * @brief Open a report file for writing, with a large stdio buffer.
+ * @param path The path of the file.
+ * @return The file or NULL if it could not be opened.
+ */
+FILE *report_open(const char *path);
+
+/*
+ * @brief Choose the format of a report from the extension of its file: ".csv"
+ * for CSV, ".json" or ".jsonl" for JSON lines, blocks otherwise.
+ * @param path The path of the report.
+ * @return The format of the report.
+ */
+enum report_format report_format_of(const char *path);
+
+/*
+ * @brief Write a string, stopping at its null terminator or after max_len
+ * characters.
+ * @param dst The position in the buffer.
+ * @param str The string.
+ * @param max_len The maximum number of characters written.
+ * @return The position after the string.
+ */
+char *report_put_str(char *dst, const char *str, size_t max_len);
+
+/*
+ * @brief Write an unsigned integer in base 10(printf's %ju).
+ * @param dst The position in the buffer.
+ * @param value The value.
+ * @return The position after the value.
+ */
+char *report_put_uint(char *dst, uint64_t value);
+
+/*
+ * @brief Write a signed integer in base 10, padded with zeros to a minimum
+ * width(printf's %0*jd).
+ * @param dst The position in the buffer.
+ * @param value The value.
+ * @param width The minimum width, including the sign.
+ * @return The position after the value.
+ */
+char *report_put_int(char *dst, int64_t value, unsigned width);
+
+/*
+ * @brief Write a float with two decimals, exactly as printf's %.2f.
+ * @param dst The position in the buffer.
+ * @param value The value.
+ * @return The position after the value.
+ */
+char *report_put_price(char *dst, float value);
+
+/*
+ * @brief Write a string as a CSV field, quoted if needed.
+ * @param dst The position in the buffer, with room for 2 * max_len + 2
+ * characters.
+ * @param str The string.
+ * @param max_len The maximum length of the string.
+ * @return The position after the field.
+ */
+char *report_put_csv(char *dst, const char *str, size_t max_len);
+
+/*
+ * @brief Write a string as a quoted JSON string.
+ * @param dst The position in the buffer, with room for 6 * max_len + 2
+ * characters.
+ * @param str The string.
+ * @param max_len The maximum length of the string.
+ * @return The position after the string.
+ */
+char *report_put_json(char *dst, const char *str, size_t max_len);
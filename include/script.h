@@ -0,0 +1,73 @@
+#pragma once
+
+#include "cli.h"
+#include "error.h"
+
+#include <stdio.h>
+
+/*
+ * Non-interactive mode of the program: the operations are read from a script,
+ * one per line, and the result of each of them is written as a line of tab
+ * separated fields: the number of the line in the script, the outcome("ok",
+ * "not-found" or "error"), the command and, for some commands, details.
+ *
+ * The arguments of a command are separated by spaces; an argument holding
+ * spaces is written between double quotes, with \" and \\ standing for a quote
+ * and a backslash. Empty lines and lines starting with # are ignored.
+ *
+ *   create <db>                   open <db>                   close
+ *   add <barcode> <name> <category> <price> <quantity> <zi/luna/an>
+ *   update-price <barcode> <price>
+ *   update-quantity <barcode> <quantity>
+ *   update-expiry <barcode> <zi/luna/an>
+ *   discount <barcode> <percent>
+ *   discount-category <category> <percent>
+ *   discount-expiring <zi/luna/an> <percent>
+ *   delete <barcode>
+ *   report <file> [category]      import <file>
+ *   update-file <file>            aggregate <file> [low-stock]
+ *   totals <file>
+ *   query <file> <condition>      discount-query <condition> <percent>
+ *   compact                       commit
+ *   cache-stats                   stats [operation]
+ *
+ * Consecutive operations of the same kind are applied together: the adds are
+ * appended with a single call, the updates of products(update-*, discount)
+ * read and write each affected product once and the discounts of categories
+ * read and write each product of the categories once. The conditions of query
+ * and discount-query are written as described in query.h, between double
+ * quotes; the details of their result tell whether the products were found
+ * through the indexes("plan=index selected=<count>") or by a scan
+ * ("plan=scan"). The updates of update-file are read from a file as
+ * described by update_store_items and applied in large batches; the details of
+ * its result count them("updated=<count> not-found=<count>
+ * rejected=<count>"). The statistics of the categories computed by
+ * aggregate_inventory are written by aggregate to a report, the details of its
+ * result counting the categories and the items("categories=<count>
+ * items=<count>"). The running totals of the categories read by
+ * inventory_totals are written by totals the same way. The details of
+ * cache-stats hold the counters of the record cache("hits=<count>
+ * misses=<count> evictions=<count> write-backs=<count>").
+ * The details of stats hold the counters of an operation of the database, as
+ * named by db_op_name, or of all of them("ops=<count> scanned=<count>
+ * matched=<count> read=<bytes> written=<bytes> syscalls=<count>
+ * time_us=<microseconds>"), measured if the statistics are enabled.
+ */
+
+/*
+ * @brief Run the operations of a script on the database of the CLI program.
+ * @param cli_prog The CLI program.
+ * @param in The script.
+ * @param out The stream the results are written to.
+ * @return STATUS_OK if all the operations succeeded, STATUS_ERROR otherwise.
+ */
+enum status script_run(struct cli_program *cli_prog, FILE *in, FILE *out);
+
+/*
+ * @brief Run the operations of a script file on the database of the CLI
+ * program, writing the results to stdout.
+ * @param cli_prog The CLI program.
+ * @param path The path of the script or "-" for stdin.
+ * @return STATUS_OK if all the operations succeeded, STATUS_ERROR otherwise.
+ */
+enum status script_run_file(struct cli_program *cli_prog, const char *path);
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "error.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Copy-on-write image of the start of a file(e.g. the slots of a database) at
+ * a point in time. The file is divided into fixed-size pages and, before a page
+ * is changed for the first time after the snapshot was taken, its old image is
+ * saved in the snapshot file. The readers of the snapshot read the file itself
+ * and patch it with the saved pages.
+ * The snapshot file may be used by several processes at once: the saved pages
+ * are tracked by a map of one byte per page, mapped by all of them, and a page
+ * is only marked as saved once its image is complete.
+ */
+struct snapshot;
+
+/*
+ * @brief A function that reads the current image of a part of the file.
+ * @param ctx The context given to snapshot_preserve.
+ * @param offset The offset of the part in the file.
+ * @param buf The buffer the part is read into.
+ * @param len The size of the part.
+ * @return The status of the operation.
+ */
+typedef enum status (*snapshot_read_func)(void *, uint64_t, void *, size_t);
+
+/*
+ * @brief Create a snapshot file with no saved pages, replacing any file with
+ * the same path.
+ * @param path The path of the snapshot file.
+ * @param size The size of the start of the file held by the snapshot.
+ * @param page_size The size of a page.
+ * @param version A number describing the state of the file when the snapshot
+ * was taken(e.g. the number of changes made to it so far).
+ * @return The snapshot.
+ */
+struct snapshot *snapshot_create(const char *path, uint64_t size,
+								 size_t page_size, uint64_t version);
+
+/*
+ * @brief Open a snapshot file created by another process.
+ * @param path The path of the snapshot file.
+ * @return The snapshot or NULL if the file is missing or is not a snapshot.
+ */
+struct snapshot *snapshot_open(const char *path);
+
+/*
+ * @brief Close a snapshot file, leaving it in place.
+ * @param snap The snapshot.
+ */
+void snapshot_close(struct snapshot *snap);
+
+/*
+ * @brief Get the version given to the snapshot when it was created.
+ * @param snap The snapshot.
+ * @return The version.
+ */
+uint64_t snapshot_version(const struct snapshot *snap);
+
+/*
+ * @brief Save the old images of the pages holding a part of the file that is
+ * about to be changed, unless they were already saved. The parts past the end
+ * of the snapshot are ignored.
+ * Safe to call from several threads, also concurrently with snapshot_patch,
+ * as long as the part itself is not changed concurrently.
+ * @param snap The snapshot.
+ * @param offset The offset of the part in the file.
+ * @param len The size of the part.
+ * @param read_part A function that reads the current image of the pages.
+ * @param ctx The context passed to the function.
+ * @param nr_saved Set to the number of pages saved by this call.
+ * @return The status of the operation.
+ */
+enum status snapshot_preserve(struct snapshot *snap, uint64_t offset,
+							  size_t len, snapshot_read_func read_part,
+							  void *ctx, size_t *nr_saved);
+
+/*
+ * @brief Overwrite a part of the file read from the file itself with the old
+ * images of the pages changed since the snapshot was taken.
+ * @param snap The snapshot.
+ * @param offset The offset of the part in the file.
+ * @param buf The part, as read from the file.
+ * @param len The size of the part.
+ * @param nr_patched Set to the number of pages that were overwritten.
+ * @return The status of the operation.
+ */
+enum status snapshot_patch(struct snapshot *snap, uint64_t offset, void *buf,
+						   size_t len, size_t *nr_patched);
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "database.h"
+#include "report.h"
+
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -23,6 +26,173 @@ struct store_item {
 	char category[ITEM_CATEGORY_MAX_LEN];
 };
 
+/*
+ * The fields of a store item, in the order of store_item_columns.
+ */
+enum store_item_column {
+	ITEM_COLUMN_PRICE,
+	ITEM_COLUMN_BARCODE,
+	ITEM_COLUMN_QUANTITY,
+	ITEM_COLUMN_EXPIRY_DATE,
+	ITEM_COLUMN_NAME,
+	ITEM_COLUMN_CATEGORY,
+	ITEM_NR_COLUMNS,
+};
+
+/*
+ * The columns of a store item, used to store the items column by column.
+ */
+extern const struct db_column store_item_columns[ITEM_NR_COLUMNS];
+
+/*
+ * The measures of a store item summed up per category by the database, in the
+ * order of get_item_measures. The price and the value of an item are rounded
+ * to cents, so the sums are exact integers, the same as those of
+ * aggregate_inventory.
+ */
+enum store_item_measure {
+	ITEM_MEASURE_QUANTITY,
+	ITEM_MEASURE_PRICE,
+	// price * quantity
+	ITEM_MEASURE_VALUE,
+	ITEM_NR_MEASURES,
+};
+
+/*
+ * The outcome of the updates of store items read from a file.
+ */
+struct update_stats {
+	// the number of updates that matched an item
+	uint64_t applied;
+	// the number of updates whose barcode is not in the database
+	uint64_t not_found;
+	// the number of lines that are not valid updates
+	uint64_t rejected;
+	// the number of the first rejected line, 0 if none was rejected
+	uint64_t first_bad_line;
+};
+
+struct price_range {
+	float min;
+	float max;
+};
+
+/*
+ * The outcome of an import of store items.
+ */
+struct import_stats {
+	// the number of items added to the database
+	uint64_t imported;
+	// the number of lines that are not valid items
+	uint64_t rejected;
+	// the number of the first rejected line, 0 if none was rejected
+	uint64_t first_bad_line;
+};
+
+/*
+ * @brief check if the date is a valid expiry date
+ * @param date the date to check
+ * @return true if the date is valid, false otherwise
+ */
+bool is_valid_date(const struct date *date);
+
+/*
+ * @brief parse an expiry date written as zi/luna/an, the parts being separated
+ * by one of "/.- "
+ * @param str the text of the date
+ * @param date set to the date
+ * @return true if the text is a valid expiry date, false otherwise
+ */
+bool parse_date(const char *str, struct date *date);
+
+/*
+ * @brief parse the fields of a store item: barcode, name, category, price,
+ * quantity and expiry date, in this order
+ * @param fields the texts of the fields
+ * @param item set to the store item
+ * @return true if the fields hold a valid store item, false otherwise
+ */
+bool parse_store_item(char **fields, struct store_item *item);
+
+/*
+ * @brief import the store items from a CSV or TSV stream into the database
+ * Each line holds the barcode, name, category, price, quantity and expiry
+ * date(zi/luna/an) of an item. The fields are separated by tabs if the first
+ * line holds one, by commas otherwise, and may be quoted. A first line that
+ * does not start with a barcode is skipped as a header. The invalid lines are
+ * skipped and counted, the valid items are appended to the database in large
+ * batches.
+ * @param db_mgr the database manager
+ * @param in the input stream
+ * @param stats set to the outcome of the import
+ * @return the status of the operation
+ */
+enum status import_store_items(struct db_manager *db_mgr, FILE *in,
+							   struct import_stats *stats);
+
+/*
+ * @brief apply the updates of store items read from a CSV or TSV stream, e.g.
+ * the quantities of a delivery
+ * Each line holds the barcode of an item, the field to update(price,
+ * quantity, expiry or discount) and its new value(the discount in percents,
+ * the expiry date as zi/luna/an). The lines are read and split like those of
+ * import_store_items. The valid updates are applied in large batches by
+ * update_entries_by_keys, in the order of the stream.
+ * @param db_mgr the database manager
+ * @param in the input stream
+ * @param stats set to the outcome of the updates
+ * @return the status of the operation
+ */
+enum status update_store_items(struct db_manager *db_mgr, FILE *in,
+							   struct update_stats *stats);
+
+/*
+ * @brief get the barcode of the entry, used as the key of the database index
+ * @param entry the entry
+ * @return the barcode of the entry
+ */
+int64_t get_barcode(const void *entry);
+
+/*
+ * @brief get the category of the entry, used as the group of the database
+ * category index
+ * @param entry the entry
+ * @return the category of the entry
+ */
+const char *get_category(const void *entry);
+
+/*
+ * @brief get the name of the entry, used as the text of the database name
+ * index
+ * @param entry the entry
+ * @return the name of the entry
+ */
+const char *get_name(const void *entry);
+
+/*
+ * @brief pack a date into an integer ordered like the dates: an * 10000 +
+ * luna * 100 + zi
+ * @param date the date
+ * @return the packed date
+ */
+int64_t pack_date(const struct date *date);
+
+/*
+ * @brief get the packed expiry date of the entry, used as the value of the
+ * database expiry index
+ * @param entry the entry
+ * @return the packed expiry date of the entry
+ */
+int64_t get_expiry_key(const void *entry);
+
+/*
+ * @brief get the measures of the entry, summed up by the database in the
+ * running totals of the categories
+ * @param entry the entry
+ * @param values set to the ITEM_NR_MEASURES measures of the entry
+ */
+void get_item_measures(const void *entry, int64_t *values);
+
 /*
  * @brief check if the barcode of the entry matches the reference barcode
  * @param entry the entry to check
@@ -81,9 +251,126 @@ void update_expiry_date(void *entry, const void *expiry_date);
  */
 void discount_price(void *entry, const void *discount);
 
+/*
+ * @brief apply a discount to all the items expiring before a date, reading and
+ * writing only those items through the expiry index
+ * @param db_mgr the database manager
+ * @param date the date; the items expiring on this date are not discounted
+ * @param discount the discount value to apply, between 0 and 1
+ * @return the status of the operation
+ */
+enum status discount_expiring_before(struct db_manager *db_mgr,
+									 const struct date *date, float discount);
+
+/*
+ * @brief get the kernels compiled for a pair of a predicate and an update of
+ * store items
+ * The predicates matches_barcode and matches_category are paired with the
+ * updates update_price, update_quantity, update_expiry_date and
+ * discount_price.
+ * @param matches the predicate
+ * @param update the update
+ * @return the kernels of the pair, NULL if the pair has none
+ */
+const struct scan_kernel *find_item_kernel(match_crit_func matches,
+										   update_func update);
+
+/*
+ * @brief update all the items matching the criteria in a single scan, through
+ * the kernels of the predicate and the update if find_item_kernel has them,
+ * through update_entries otherwise
+ * @param db_mgr the database manager
+ * @param criteria the criteria to match
+ * @param matches the predicate
+ * @param update_val the value used to update the items
+ * @param update the update
+ * @return the status of the operation
+ */
+enum status update_items_matching(struct db_manager *db_mgr,
+								  const void *criteria, match_crit_func matches,
+								  const void *update_val, update_func update);
+
+/*
+ * @brief select the barcodes equal to the reference barcode
+ * @param barcodes the barcode column(int64_t values)
+ * @param count the number of values
+ * @param barcode the barcode to check against
+ * @param selected set to 1 for the matching values, 0 otherwise
+ */
+void select_barcode(const void *barcodes, size_t count, const void *barcode,
+					uint8_t *selected);
+
+/*
+ * @brief select the prices inside a price range(bounds included)
+ * @param prices the price column(float values)
+ * @param count the number of values
+ * @param range the price range to check against(struct price_range)
+ * @param selected set to 1 for the matching values, 0 otherwise
+ */
+void select_price_range(const void *prices, size_t count, const void *range,
+						uint8_t *selected);
+
+/*
+ * @brief select the expiry dates before the reference date
+ * @param dates the expiry date column(struct date values)
+ * @param count the number of values
+ * @param date the date to check against
+ * @param selected set to 1 for the matching values, 0 otherwise
+ */
+void select_expiry_before(const void *dates, size_t count, const void *date,
+						  uint8_t *selected);
+
 /*
  * @brief dump the information of the store item to the output stream
- * @param entry the entry to dump
+ * @param entry the entry to dump, NULL for the message of an empty report
  * @param out the output stream to dump the entry to
  */
 void dump_store_item_info(const void *entry, FILE *out);
+
+/*
+ * @brief dump the store item to the output stream as a CSV line, with the
+ * fields in the order read by import_store_items
+ * @param entry the entry to dump, NULL for an empty report, which only has the
+ * header line
+ * @param out the output stream to dump the entry to
+ */
+void dump_store_item_csv(const void *entry, FILE *out);
+
+/*
+ * @brief dump the store item to the output stream as a JSON object on its own
+ * line
+ * @param entry the entry to dump, NULL for an empty report, which writes
+ * nothing
+ * @param out the output stream to dump the entry to
+ */
+void dump_store_item_json(const void *entry, FILE *out);
+
+/*
+ * @brief get the function dumping store items in a report format
+ * @param format the format of the report
+ * @return the dump function
+ */
+dump_entry_func store_item_dumper(enum report_format format);
+
+/*
+ * @brief write the header line of a report of store items, if the format has
+ * one
+ * @param format the format of the report
+ * @param out the output stream of the report
+ */
+void dump_store_item_header(enum report_format format, FILE *out);
+
+/*
+ * @brief dump the store items, or those of a category, for a report; in a
+ * shared database, the items are read from a snapshot, so that the report
+ * holds the store as it was at one point in time while the other processes
+ * keep changing it
+ * @param db_mgr the database manager
+ * @param format the format of the report
+ * @param category the category of the items to dump(NULL dumps all the items)
+ * @param out the output stream of the report
+ * @return the status of the operation
+ */
+enum status dump_store_items(struct db_manager *db_mgr,
+							 enum report_format format, const char *category,
+							 FILE *out);
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "error.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Secondary index over a text attribute of the entries(e.g. the name of a
+ * product), searched case insensitively. The case folded texts are kept
+ * sorted, for exact and prefix searches, and every trigram(3 consecutive
+ * characters) of the texts maps to the slots holding it, for substring
+ * searches.
+ * The index is kept in memory and written to its file when it is closed.
+ */
+struct text_index;
+
+enum text_match {
+	TEXT_MATCH_EXACT,
+	TEXT_MATCH_PREFIX,
+	TEXT_MATCH_SUBSTRING,
+};
+
+/*
+ * @brief Load an existing index file.
+ * The index is considered stale, and NULL is returned, if it was not closed
+ * cleanly or if it does not describe the data file with the given size and
+ * modification time.
+ * @param path The path of the index file.
+ * @param data_size The current size of the data file.
+ * @param data_mtime The current modification time of the data file(ns).
+ * @return The index or NULL if the index is missing or stale.
+ */
+struct text_index *text_index_open(const char *path, uint64_t data_size,
+								   uint64_t data_mtime);
+
+/*
+ * @brief Create a new, empty index, replacing any existing index file.
+ * @param path The path of the index file.
+ * @return The index.
+ */
+struct text_index *text_index_create(const char *path);
+
+/*
+ * @brief Write the index to its file, marking it as up to date with the data
+ * file, and release it.
+ * @param ti The index.
+ * @param data_size The size of the data file at close time.
+ * @param data_mtime The modification time of the data file at close time(ns).
+ */
+void text_index_close(struct text_index *ti, uint64_t data_size,
+					  uint64_t data_mtime);
+
+/*
+ * @brief Hash a text case insensitively, to detect changes of an indexed text.
+ * @param text The text.
+ * @return The hash of the text.
+ */
+uint64_t text_index_hash(const char *text);
+
+/*
+ * @brief Index the text of a slot.
+ * @param ti The index.
+ * @param text The text.
+ * @param slot The slot of the entry, which must not be indexed already.
+ */
+void text_index_insert(struct text_index *ti, const char *text, int64_t slot);
+
+/*
+ * @brief Index the texts of consecutive slots, sorting them once and merging
+ * them into the index in a single pass.
+ * @param ti The index.
+ * @param texts The texts.
+ * @param first_slot The slot of the first text, the others following it.
+ * None of the slots may be indexed already.
+ * @param count The number of texts.
+ */
+void text_index_insert_many(struct text_index *ti, const char *const *texts,
+							int64_t first_slot, size_t count);
+
+/*
+ * @brief Remove the text of a slot from the index.
+ * @param ti The index.
+ * @param slot The slot of the entry.
+ * @return STATUS_OK if the slot was removed, STATUS_NOT_FOUND otherwise.
+ */
+enum status text_index_remove(struct text_index *ti, int64_t slot);
+
+/*
+ * @brief Remove all the texts from the index.
+ * @param ti The index.
+ */
+void text_index_clear(struct text_index *ti);
+
+/*
+ * @brief Find the slots whose text matches a pattern, case insensitively.
+ * @param ti The index.
+ * @param pattern The pattern.
+ * @param mode Whether the text must be equal to the pattern, start with it or
+ * contain it.
+ * @param slots Set to the matching slots, in increasing order, which must be
+ * freed by the caller.
+ * @return The number of matching slots.
+ */
+size_t text_index_find(const struct text_index *ti, const char *pattern,
+					   enum text_match mode, int64_t **slots);
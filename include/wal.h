@@ -0,0 +1,138 @@
+#pragma once
+
+#include "error.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Write-ahead log of fixed-size pages(e.g. the slots of a database). The
+ * writes of the pages are collected in memory as a batch, which is appended to
+ * the log file with a single write and made durable with a single fsync when
+ * it is committed. Until then, the pending images of the pages can be read
+ * back from the batch.
+ * Every batch ends with a commit record holding a checksum of the batch, so a
+ * batch torn by a crash is ignored by the recovery.
+ */
+struct wal;
+
+/*
+ * @brief A function that writes consecutive pages to their final location.
+ * @param ctx The context given to wal_apply or wal_recover.
+ * @param first The index of the first page.
+ * @param pages The images of the pages, stored contiguously.
+ * @param count The number of pages.
+ * @return The status of the operation.
+ */
+typedef enum status (*wal_pages_func)(void *, uint64_t, const void *, size_t);
+
+/*
+ * @brief A function that applies the metadata committed with a batch.
+ * @param ctx The context given to wal_apply or wal_recover.
+ * @param meta The metadata.
+ * @param len The size of the metadata.
+ * @return The status of the operation.
+ */
+typedef enum status (*wal_meta_func)(void *, const void *, size_t);
+
+/*
+ * @brief Open the log file, creating it if it is missing.
+ * A log written for another page size is discarded.
+ * @param path The path of the log file.
+ * @param page_size The size of a page.
+ * @param truncate Whether to discard the records already in the log.
+ * @return The log.
+ */
+struct wal *wal_open(const char *path, size_t page_size, bool truncate);
+
+/*
+ * @brief Close the log file, dropping the batch that was not committed.
+ * @param wal The log.
+ */
+void wal_close(struct wal *wal);
+
+/*
+ * @brief Add the images of consecutive pages to the current batch.
+ * Safe to call from several threads, also concurrently with wal_read_pages.
+ * @param wal The log.
+ * @param first The index of the first page.
+ * @param pages The images of the pages, stored contiguously.
+ * @param count The number of pages.
+ */
+void wal_write_pages(struct wal *wal, uint64_t first, const void *pages,
+					 size_t count);
+
+/*
+ * @brief Overwrite part of the pages read from their final location with the
+ * images pending in the current batch.
+ * Safe to call from several threads, also concurrently with wal_write_pages.
+ * @param wal The log.
+ * @param first The index of the first page.
+ * @param count The number of pages.
+ * @param offset The offset of the part inside a page.
+ * @param len The size of the part.
+ * @param dst The parts of the pages, one every stride bytes.
+ * @param stride The distance between the parts of consecutive pages.
+ * @return The number of pages that were overwritten.
+ */
+size_t wal_read_pages(struct wal *wal, uint64_t first, size_t count,
+					  size_t offset, size_t len, void *dst, size_t stride);
+
+/*
+ * @brief Get the size of the current batch.
+ * @param wal The log.
+ * @return The number of bytes waiting to be committed.
+ */
+size_t wal_pending_bytes(const struct wal *wal);
+
+/*
+ * @brief Get the size of the log file.
+ * @param wal The log.
+ * @return The number of bytes written to the log since it was last reset.
+ */
+uint64_t wal_log_bytes(const struct wal *wal);
+
+/*
+ * @brief Append the current batch to the log file, followed by the metadata
+ * and a commit record, and wait for it to reach the disk.
+ * @param wal The log.
+ * @param meta The metadata committed with the batch.
+ * @param len The size of the metadata.
+ * @return The status of the operation.
+ */
+enum status wal_commit(struct wal *wal, const void *meta, size_t len);
+
+/*
+ * @brief Write the committed batch to the final location of its pages, in the
+ * order of the writes, and start a new batch.
+ * @param wal The log.
+ * @param write_pages A function that writes pages to their final location.
+ * @param write_meta A function that applies the metadata of the batch.
+ * @param ctx The context passed to the functions.
+ * @return The status of the operation.
+ */
+enum status wal_apply(struct wal *wal, wal_pages_func write_pages,
+					  wal_meta_func write_meta, void *ctx);
+
+/*
+ * @brief Replay all the complete batches in the log file, stopping at the
+ * first torn or corrupted batch.
+ * @param wal The log.
+ * @param write_pages A function that writes pages to their final location.
+ * @param write_meta A function that applies the metadata of a batch.
+ * @param ctx The context passed to the functions.
+ * @param nr_batches Set to the number of batches replayed.
+ * @return The status of the operation.
+ */
+enum status wal_recover(struct wal *wal, wal_pages_func write_pages,
+						wal_meta_func write_meta, void *ctx,
+						uint64_t *nr_batches);
+
+/*
+ * @brief Empty the log file, once all its batches are durable in their final
+ * location(checkpoint).
+ * @param wal The log.
+ * @return The status of the operation.
+ */
+enum status wal_reset(struct wal *wal);
@@ -0,0 +1,392 @@
+#include "aggregate.h"
+
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// room for a category written as a quoted JSON string
+#define CATEGORY_FIELD_MAX_LEN (6 * ITEM_CATEGORY_MAX_LEN + 2)
+
+static uint64_t hash_category(const char *category)
+{
+	// FNV-1a over the case folded category
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	for (; *category != '\0'; ++category) {
+		hash ^= (uint8_t)tolower((unsigned char)*category);
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static void table_place(struct inventory_stats *stats, size_t idx)
+{
+	size_t mask = stats->table_capacity - 1;
+	size_t pos = hash_category(stats->categories[idx].category) & mask;
+
+	while (stats->table[pos] != 0)
+		pos = (pos + 1) & mask;
+	stats->table[pos] = idx + 1;
+}
+
+static void table_grow(struct inventory_stats *stats)
+{
+	free(stats->table);
+	stats->table_capacity =
+		stats->table_capacity ? stats->table_capacity * 2 : 64;
+	stats->table = calloc(stats->table_capacity, sizeof(*stats->table));
+	DIE(stats->table == NULL, "Error allocating category table");
+
+	for (size_t i = 0; i < stats->nr_categories; ++i)
+		table_place(stats, i);
+}
+
+/*
+ * @brief Find the statistics of a category, adding empty ones if the category
+ * was not seen yet.
+ */
+static struct category_stats *find_category(struct inventory_stats *stats,
+											const char *category)
+{
+	if (stats->table_capacity > 0) {
+		size_t mask = stats->table_capacity - 1;
+
+		for (size_t pos = hash_category(category) & mask;
+			 stats->table[pos] != 0; pos = (pos + 1) & mask) {
+			struct category_stats *found =
+				&stats->categories[stats->table[pos] - 1];
+			if (strcasecmp(found->category, category) == 0)
+				return found;
+		}
+	}
+
+	if (stats->nr_categories == stats->categories_capacity) {
+		stats->categories_capacity = stats->categories_capacity ?
+										 stats->categories_capacity * 2 :
+										 16;
+		stats->categories =
+			realloc(stats->categories, stats->categories_capacity *
+										   sizeof(*stats->categories));
+		DIE(stats->categories == NULL, "Error allocating category stats");
+	}
+
+	struct category_stats *added = &stats->categories[stats->nr_categories];
+	*added = (struct category_stats){ 0 };
+	strncpy(added->category, category, ITEM_CATEGORY_MAX_LEN - 1);
+	++stats->nr_categories;
+
+	// the table is kept at most half full
+	if (2 * stats->nr_categories > stats->table_capacity)
+		table_grow(stats);
+	else
+		table_place(stats, stats->nr_categories - 1);
+	return added;
+}
+
+static void add_item(struct category_stats *cat, const struct store_item *item,
+					 uint64_t low_stock)
+{
+	uint64_t quantity = item->quantity;
+	int64_t measures[ITEM_NR_MEASURES];
+
+	get_item_measures(item, measures);
+
+	if (cat->count == 0 || item->price < cat->price_min)
+		cat->price_min = item->price;
+	if (cat->count == 0 || item->price > cat->price_max)
+		cat->price_max = item->price;
+	if (cat->count == 0 || quantity < cat->quantity_min)
+		cat->quantity_min = quantity;
+	if (cat->count == 0 || quantity > cat->quantity_max)
+		cat->quantity_max = quantity;
+
+	++cat->count;
+	cat->low_stock += quantity < low_stock;
+	cat->price_sum += measures[ITEM_MEASURE_PRICE];
+	cat->quantity_sum += quantity;
+	cat->value += measures[ITEM_MEASURE_VALUE];
+}
+
+static void merge_category(struct category_stats *cat,
+						   const struct category_stats *other)
+{
+	if (other->count == 0)
+		return;
+
+	if (cat->count == 0 || other->price_min < cat->price_min)
+		cat->price_min = other->price_min;
+	if (cat->count == 0 || other->price_max > cat->price_max)
+		cat->price_max = other->price_max;
+	if (cat->count == 0 || other->quantity_min < cat->quantity_min)
+		cat->quantity_min = other->quantity_min;
+	if (cat->count == 0 || other->quantity_max > cat->quantity_max)
+		cat->quantity_max = other->quantity_max;
+
+	cat->count += other->count;
+	cat->low_stock += other->low_stock;
+	cat->price_sum += other->price_sum;
+	cat->quantity_sum += other->quantity_sum;
+	cat->value += other->value;
+}
+
+static void fold_item(void *partial, const void *entry, const void *low_stock)
+{
+	const struct store_item *item = entry;
+
+	add_item(find_category(partial, item->category), item,
+			 *(const uint64_t *)low_stock);
+}
+
+static void merge_partial(void *partial, void *other)
+{
+	struct inventory_stats *stats = other;
+
+	for (size_t i = 0; i < stats->nr_categories; ++i)
+		merge_category(find_category(partial, stats->categories[i].category),
+					   &stats->categories[i]);
+	inventory_stats_free(stats);
+}
+
+static int compare_categories(const void *a, const void *b)
+{
+	return strcasecmp(((const struct category_stats *)a)->category,
+					  ((const struct category_stats *)b)->category);
+}
+
+/*
+ * @brief Sort the categories and sum them up into the whole store.
+ */
+static void finish_stats(struct inventory_stats *stats)
+{
+	// the positions in the table are lost once the categories are sorted
+	free(stats->table);
+	stats->table = NULL;
+	stats->table_capacity = 0;
+
+	if (stats->nr_categories > 0)
+		qsort(stats->categories, stats->nr_categories,
+			  sizeof(*stats->categories), compare_categories);
+	for (size_t i = 0; i < stats->nr_categories; ++i)
+		merge_category(&stats->total, &stats->categories[i]);
+}
+
+enum status aggregate_inventory(struct db_manager *db_mgr, uint64_t low_stock,
+								struct inventory_stats *stats)
+{
+	*stats = (struct inventory_stats){ 0 };
+	enum status status = fold_entries(db_mgr, stats, sizeof(*stats),
+									  &low_stock, fold_item, merge_partial);
+
+	finish_stats(stats);
+	return status;
+}
+
+static void visit_totals(void *stats, const char *category, uint64_t count,
+						 const int64_t *sums)
+{
+	struct category_stats *cat = find_category(stats, category);
+
+	cat->count = count;
+	cat->price_sum = sums[ITEM_MEASURE_PRICE];
+	cat->quantity_sum = (uint64_t)sums[ITEM_MEASURE_QUANTITY];
+	cat->value = sums[ITEM_MEASURE_VALUE];
+}
+
+enum status inventory_totals(struct db_manager *db_mgr,
+							 struct inventory_stats *stats)
+{
+	*stats = (struct inventory_stats){ 0 };
+	enum status status = visit_group_totals(db_mgr, visit_totals, stats);
+
+	finish_stats(stats);
+	return status;
+}
+
+void inventory_stats_free(struct inventory_stats *stats)
+{
+	free(stats->categories);
+	free(stats->table);
+	*stats = (struct inventory_stats){ 0 };
+}
+
+static double average(double sum, uint64_t count)
+{
+	return count > 0 ? sum / (double)count : 0;
+}
+
+static double from_cents(int64_t cents)
+{
+	return (double)cents / 100;
+}
+
+static void write_block(const struct category_stats *cat, FILE *out)
+{
+	if (cat->category[0] != '\0')
+		fprintf(out, "-----------------\nCategorie: %s\n", cat->category);
+	else
+		fprintf(out, "-----------------\nTotal magazin\n");
+
+	fprintf(out,
+			"Produse: %" PRIu64 "\nProduse cu stoc redus: %" PRIu64
+			"\nPret minim: %.2f\nPret maxim: %.2f\nPret mediu: %.2f"
+			"\nCantitate totala: %" PRIu64 "\nCantitate minima: %" PRIu64
+			"\nCantitate maxima: %" PRIu64 "\nCantitate medie: %.2f"
+			"\nValoarea stocului: %.2f\n-----------------\n",
+			cat->count, cat->low_stock, cat->price_min, cat->price_max,
+			average(from_cents(cat->price_sum), cat->count), cat->quantity_sum,
+			cat->quantity_min, cat->quantity_max,
+			average((double)cat->quantity_sum, cat->count),
+			from_cents(cat->value));
+}
+
+static void write_csv(const struct category_stats *cat, FILE *out)
+{
+	char field[CATEGORY_FIELD_MAX_LEN];
+	char *end = report_put_csv(field, cat->category, ITEM_CATEGORY_MAX_LEN);
+
+	fprintf(out,
+			"%.*s,%" PRIu64 ",%" PRIu64 ",%.2f,%.2f,%.2f,%.2f,%" PRIu64
+			",%" PRIu64 ",%" PRIu64 ",%.2f,%.2f\n",
+			(int)(end - field), field, cat->count, cat->low_stock,
+			from_cents(cat->price_sum), cat->price_min, cat->price_max,
+			average(from_cents(cat->price_sum), cat->count), cat->quantity_sum,
+			cat->quantity_min, cat->quantity_max,
+			average((double)cat->quantity_sum, cat->count),
+			from_cents(cat->value));
+}
+
+static void write_json(const struct category_stats *cat, FILE *out)
+{
+	char field[CATEGORY_FIELD_MAX_LEN] = "null";
+	char *end = field + strlen(field);
+
+	if (cat->category[0] != '\0')
+		end = report_put_json(field, cat->category, ITEM_CATEGORY_MAX_LEN);
+
+	fprintf(out,
+			"{\"category\":%.*s,\"count\":%" PRIu64 ",\"low_stock\":%" PRIu64
+			",\"price_sum\":%.2f,\"price_min\":%.2f,\"price_max\":%.2f"
+			",\"price_avg\":%.2f,\"quantity_sum\":%" PRIu64
+			",\"quantity_min\":%" PRIu64 ",\"quantity_max\":%" PRIu64
+			",\"quantity_avg\":%.2f,\"value\":%.2f}\n",
+			(int)(end - field), field, cat->count, cat->low_stock,
+			from_cents(cat->price_sum), cat->price_min, cat->price_max,
+			average(from_cents(cat->price_sum), cat->count), cat->quantity_sum,
+			cat->quantity_min, cat->quantity_max,
+			average((double)cat->quantity_sum, cat->count),
+			from_cents(cat->value));
+}
+
+static void write_totals_block(const struct category_stats *cat, FILE *out)
+{
+	if (cat->category[0] != '\0')
+		fprintf(out, "-----------------\nCategorie: %s\n", cat->category);
+	else
+		fprintf(out, "-----------------\nTotal magazin\n");
+
+	fprintf(out,
+			"Produse: %" PRIu64 "\nPret mediu: %.2f\nCantitate totala: %" PRIu64
+			"\nCantitate medie: %.2f\nValoarea stocului: %.2f"
+			"\n-----------------\n",
+			cat->count, average(from_cents(cat->price_sum), cat->count),
+			cat->quantity_sum, average((double)cat->quantity_sum, cat->count),
+			from_cents(cat->value));
+}
+
+static void write_totals_csv(const struct category_stats *cat, FILE *out)
+{
+	char field[CATEGORY_FIELD_MAX_LEN];
+	char *end = report_put_csv(field, cat->category, ITEM_CATEGORY_MAX_LEN);
+
+	fprintf(out, "%.*s,%" PRIu64 ",%.2f,%.2f,%" PRIu64 ",%.2f,%.2f\n",
+			(int)(end - field), field, cat->count, from_cents(cat->price_sum),
+			average(from_cents(cat->price_sum), cat->count), cat->quantity_sum,
+			average((double)cat->quantity_sum, cat->count),
+			from_cents(cat->value));
+}
+
+static void write_totals_json(const struct category_stats *cat, FILE *out)
+{
+	char field[CATEGORY_FIELD_MAX_LEN] = "null";
+	char *end = field + strlen(field);
+
+	if (cat->category[0] != '\0')
+		end = report_put_json(field, cat->category, ITEM_CATEGORY_MAX_LEN);
+
+	fprintf(out,
+			"{\"category\":%.*s,\"count\":%" PRIu64
+			",\"price_sum\":%.2f,\"price_avg\":%.2f,\"quantity_sum\":%" PRIu64
+			",\"quantity_avg\":%.2f,\"value\":%.2f}\n",
+			(int)(end - field), field, cat->count, from_cents(cat->price_sum),
+			average(from_cents(cat->price_sum), cat->count), cat->quantity_sum,
+			average((double)cat->quantity_sum, cat->count),
+			from_cents(cat->value));
+}
+
+/*
+ * The ways of writing the statistics of a category, one for each format.
+ */
+struct stats_writer {
+	// the first line of a CSV report
+	const char *csv_header;
+	void (*block)(const struct category_stats *, FILE *);
+	void (*csv)(const struct category_stats *, FILE *);
+	void (*json)(const struct category_stats *, FILE *);
+};
+
+static enum status write_report(const struct inventory_stats *stats,
+								const struct stats_writer *writer,
+								enum report_format format, FILE *out)
+{
+	void (*write_category)(const struct category_stats *, FILE *);
+
+	switch (format) {
+	case REPORT_CSV:
+		write_category = writer->csv;
+		(void)fputs(writer->csv_header, out);
+		break;
+	case REPORT_JSON_LINES:
+		write_category = writer->json;
+		break;
+	default:
+		write_category = writer->block;
+		break;
+	}
+
+	for (size_t i = 0; i < stats->nr_categories; ++i)
+		write_category(&stats->categories[i], out);
+	write_category(&stats->total, out);
+
+	return ferror(out) ? STATUS_ERROR : STATUS_OK;
+}
+
+enum status write_inventory_stats(const struct inventory_stats *stats,
+								  enum report_format format, FILE *out)
+{
+	static const struct stats_writer writer = {
+		.csv_header = "category,count,low_stock,price_sum,price_min,price_max,"
+					  "price_avg,quantity_sum,quantity_min,quantity_max,"
+					  "quantity_avg,value\n",
+		.block = write_block,
+		.csv = write_csv,
+		.json = write_json,
+	};
+
+	return write_report(stats, &writer, format, out);
+}
+
+enum status write_inventory_totals(const struct inventory_stats *stats,
+								   enum report_format format, FILE *out)
+{
+	static const struct stats_writer writer = {
+		.csv_header = "category,count,price_sum,price_avg,quantity_sum,"
+					  "quantity_avg,value\n",
+		.block = write_totals_block,
+		.csv = write_totals_csv,
+		.json = write_totals_json,
+	};
+
+	return write_report(stats, &writer, format, out);
+}
@@ -0,0 +1,141 @@
+#include "buffer_pool.h"
+
+#include "error.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define BUFFER_ALIGN 4096
+// the smallest size class is 1 << MIN_CLASS_SHIFT bytes
+#define MIN_CLASS_SHIFT 6
+#define NR_CLASSES (sizeof(size_t) * 8)
+
+/*
+ * An idle buffer, reused as the link of its free list.
+ */
+struct idle_buffer {
+	struct idle_buffer *next;
+};
+
+struct buffer_pool {
+	struct buffer_allocator allocator;
+	size_t max_idle_bytes;
+	size_t idle_bytes;
+	// idle buffers of each size class
+	struct idle_buffer *free_lists[NR_CLASSES];
+	pthread_mutex_t lock;
+};
+
+static void *heap_alloc(void *ctx, size_t size)
+{
+	(void)ctx;
+	void *buf;
+
+	if (posix_memalign(&buf, BUFFER_ALIGN, size) != 0)
+		return NULL;
+	return buf;
+}
+
+static void heap_release(void *ctx, void *buf, size_t size)
+{
+	(void)ctx;
+	(void)size;
+	free(buf);
+}
+
+static const struct buffer_allocator heap_allocator = {
+	.alloc = heap_alloc,
+	.release = heap_release,
+	.ctx = NULL,
+};
+
+/*
+ * @brief Get the size class of a buffer size.
+ * @return The class, whose buffers have 1 << class bytes.
+ */
+static unsigned size_class(size_t size)
+{
+	unsigned class = MIN_CLASS_SHIFT;
+
+	while (((size_t)1 << class) < size)
+		++class;
+	return class;
+}
+
+struct buffer_pool *buffer_pool_create(const struct buffer_allocator *allocator,
+									   size_t max_idle_bytes)
+{
+	struct buffer_pool *pool = calloc(1, sizeof(*pool));
+	DIE(pool == NULL, "Error allocating buffer pool");
+
+	pool->allocator = allocator != NULL ? *allocator : heap_allocator;
+	pool->max_idle_bytes = max_idle_bytes;
+	pthread_mutex_init(&pool->lock, NULL);
+	return pool;
+}
+
+void buffer_pool_destroy(struct buffer_pool *pool)
+{
+	if (pool == NULL)
+		return;
+
+	for (unsigned class = 0; class < NR_CLASSES; ++class) {
+		struct idle_buffer *buf = pool->free_lists[class];
+
+		while (buf != NULL) {
+			struct idle_buffer *next = buf->next;
+
+			pool->allocator.release(pool->allocator.ctx, buf,
+									(size_t)1 << class);
+			buf = next;
+		}
+	}
+
+	pthread_mutex_destroy(&pool->lock);
+	free(pool);
+}
+
+void *buffer_pool_get(struct buffer_pool *pool, size_t size)
+{
+	if (size > SIZE_MAX / 2)
+		return NULL;
+
+	unsigned class = size_class(size);
+
+	pthread_mutex_lock(&pool->lock);
+	struct idle_buffer *buf = pool->free_lists[class];
+	if (buf != NULL) {
+		pool->free_lists[class] = buf->next;
+		pool->idle_bytes -= (size_t)1 << class;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	if (buf != NULL)
+		return buf;
+	return pool->allocator.alloc(pool->allocator.ctx, (size_t)1 << class);
+}
+
+void buffer_pool_put(struct buffer_pool *pool, void *buf, size_t size)
+{
+	if (buf == NULL)
+		return;
+
+	unsigned class = size_class(size);
+	size_t class_size = (size_t)1 << class;
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->idle_bytes + class_size <= pool->max_idle_bytes) {
+		struct idle_buffer *idle = buf;
+
+		idle->next = pool->free_lists[class];
+		pool->free_lists[class] = idle;
+		pool->idle_bytes += class_size;
+		buf = NULL;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	// the buffers over the budget are not kept
+	if (buf != NULL)
+		pool->allocator.release(pool->allocator.ctx, buf, class_size);
+}
@@ -1,43 +1,19 @@
 #include "cli.h"
 
+#include "aggregate.h"
+#include "cmd_parse.h"
 #include "database.h"
 #include "error.h"
+#include "query.h"
 #include "store_manager.h"
 
 #include <ctype.h>
+#include <getopt.h>
 #include <inttypes.h>
 #include <string.h>
 
 #define CLI_MAX_CMD_LEN 128
 
-// macro for parsing a string to a uintmax_t value in a given base
-// should be only used fo parsing command arguments
-#define CMD_PARSE_UINTMAX(arg, base)              \
-	({                                            \
-		const char *_arg = arg;                   \
-		char *_endptr;                            \
-		uintmax_t _val;                           \
-		_val = strtoumax(_arg, &_endptr, base);   \
-		if (_arg == _endptr || errno == ERANGE) { \
-			return STATUS_ERROR;                  \
-		}                                         \
-		_val;                                     \
-	})
-
-// macro for parsing a string to a float value in a given base
-// should be only used fo parsing command arguments
-#define CMD_PARSE_FLOAT(arg)                      \
-	({                                            \
-		const char *_arg = arg;                   \
-		char *_endptr;                            \
-		float _val;                               \
-		_val = strtof(_arg, &_endptr);            \
-		if (_arg == _endptr || errno == ERANGE) { \
-			return STATUS_ERROR;                  \
-		}                                         \
-		_val;                                     \
-	})
-
 #define GET_LINE(buffer)                                   \
 	({                                                     \
 		if (fgets(buffer, CLI_MAX_CMD_LEN, stdin) == NULL) \
@@ -55,14 +31,152 @@ struct cli_program *create_cli_program(void)
 	DIE(cli_prog->cmd_buffer == NULL,
 		"Failed to allocate memory for cmd_buffer");
 
+	cli_prog->db_config = (struct db_config){ .key_of = get_barcode,
+											  .group_of = get_category,
+											  .text_of = get_name,
+											  .order_of = get_expiry_key,
+											  .compact_dead_percent = 50,
+											  .columns = store_item_columns,
+											  .nr_columns = ITEM_NR_COLUMNS };
+
 	return cli_prog;
 }
 
+static void cli_print_usage(const char *prog_name)
+{
+	fprintf(stderr,
+			"Utilizare: %s [optiuni]\n"
+			"  -m, --mmap            acceseaza baza de date printr-o mapare in "
+			"memorie\n"
+			"  -b, --block-slots N   numarul de intrari citite odata la "
+			"parcurgerea bazei de date\n"
+			"  -j, --threads N       numarul de fire de executie folosite la "
+			"parcurgerea bazei de date\n"
+			"  -c, --columnar        creeaza bazele de date noi cu fiecare "
+			"camp stocat separat(pe coloane)\n"
+			"  -w, --wal             inregistreaza modificarile intr-un jurnal "
+			"(write-ahead log) inainte de a le scrie in baza de date\n"
+			"  -g, --group-commit N  numarul de modificari salvate impreuna in "
+			"jurnal\n"
+			"  -k, --cache N         numarul de produse folosite recent "
+			"pastrate in memorie\n"
+			"  -W, --write-back      scrie modificarile produselor din memorie "
+			"doar cand sunt eliminate din ea\n"
+			"  -s, --script FISIER   executa operatiile din fisier(- pentru "
+			"intrarea standard), fara meniu\n"
+			"  -S, --stats FISIER    masoara operatiile bazei de date si scrie "
+			"statisticile in fisier(JSON) la iesire\n"
+			"  -x, --shared          permite folosirea bazei de date de catre "
+			"mai multe procese deodata(fara -w)\n"
+			"  -o, --sorted          pastreaza baza de date sortata dupa "
+			"codul de bare, fara indexul de chei(fara -w)\n"
+			"  -t, --totals          actualizeaza totalurile categoriilor la "
+			"fiecare modificare, pentru citirea lor fara parcurgere\n",
+			prog_name);
+}
+
+enum status cli_parse_args(struct cli_program *cli_prog, int argc,
+						   char **argv)
+{
+	static const struct option long_opts[] = {
+		{ "mmap", no_argument, NULL, 'm' },
+		{ "block-slots", required_argument, NULL, 'b' },
+		{ "threads", required_argument, NULL, 'j' },
+		{ "columnar", no_argument, NULL, 'c' },
+		{ "wal", no_argument, NULL, 'w' },
+		{ "group-commit", required_argument, NULL, 'g' },
+		{ "cache", required_argument, NULL, 'k' },
+		{ "write-back", no_argument, NULL, 'W' },
+		{ "script", required_argument, NULL, 's' },
+		{ "stats", required_argument, NULL, 'S' },
+		{ "shared", no_argument, NULL, 'x' },
+		{ "sorted", no_argument, NULL, 'o' },
+		{ "totals", no_argument, NULL, 't' },
+		{ NULL, 0, NULL, 0 },
+	};
+	int opt;
+
+	while ((opt = getopt_long(argc, argv, "mb:j:cwg:k:Ws:S:xot", long_opts,
+							  NULL)) != -1) {
+		switch (opt) {
+		case 'm':
+			cli_prog->db_config.use_mmap = true;
+			break;
+		case 'b':
+			cli_prog->db_config.block_slots = CMD_PARSE_UINTMAX(optarg, 10);
+			break;
+		case 'j':
+			cli_prog->db_config.nr_threads = CMD_PARSE_UINTMAX(optarg, 10);
+			break;
+		case 'c':
+			cli_prog->db_config.columnar = true;
+			break;
+		case 'w':
+			cli_prog->db_config.use_wal = true;
+			break;
+		case 'g':
+			cli_prog->db_config.wal_group_ops = CMD_PARSE_UINTMAX(optarg, 10);
+			break;
+		case 'k':
+			cli_prog->db_config.cache_entries = CMD_PARSE_UINTMAX(optarg, 10);
+			break;
+		case 'W':
+			cli_prog->db_config.cache_write_back = true;
+			break;
+		case 's':
+			cli_prog->script_path = optarg;
+			break;
+		case 'S':
+			cli_prog->stats_path = optarg;
+			if (cli_prog->db_config.stats == NULL)
+				cli_prog->db_config.stats = db_stats_create();
+			break;
+		case 'x':
+			cli_prog->db_config.shared = true;
+			break;
+		case 'o':
+			cli_prog->db_config.sorted = true;
+			break;
+		case 't':
+			cli_prog->db_config.measure_of = get_item_measures;
+			cli_prog->db_config.nr_measures = ITEM_NR_MEASURES;
+			break;
+		default:
+			cli_print_usage(argv[0]);
+			return STATUS_ERROR;
+		}
+	}
+
+	// the log of a database is private to the process writing it, and the
+	// sorted run is rewritten in place by the merges
+	if (optind != argc ||
+		((cli_prog->db_config.shared || cli_prog->db_config.sorted) &&
+		 cli_prog->db_config.use_wal)) {
+		cli_print_usage(argv[0]);
+		return STATUS_ERROR;
+	}
+
+	return STATUS_OK;
+}
+
 void destroy_cli_program(struct cli_program *cli_prog)
 {
 	if (cli_prog == NULL)
 		return;
-	close_database(cli_prog->db_mgr);
+	close_database(&cli_prog->db_mgr);
+
+	// the statistics include the work done by closing the database
+	if (cli_prog->db_config.stats != NULL) {
+		FILE *out = fopen(cli_prog->stats_path, "w");
+		if (out == NULL ||
+			db_stats_write_json(cli_prog->db_config.stats, out) !=
+				STATUS_OK)
+			fprintf(stderr, "Eroare la scrierea statisticilor\n");
+		if (out != NULL)
+			(void)fclose(out);
+		db_stats_destroy(cli_prog->db_config.stats);
+	}
+
 	free(cli_prog->cmd_buffer);
 	free(cli_prog);
 }
@@ -100,7 +214,8 @@ static enum status cli_create_db(struct cli_program *cli_prog)
 		return STATUS_ERROR;
 	}
 
-	cli_prog->db_mgr = create_database(filename, sizeof(struct store_item));
+	cli_prog->db_mgr = create_database(filename, sizeof(struct store_item),
+									   &cli_prog->db_config);
 
 	return STATUS_OK;
 }
@@ -117,17 +232,12 @@ static enum status cli_load_db(struct cli_program *cli_prog)
 		return STATUS_ERROR;
 	}
 
-	cli_prog->db_mgr = open_database(filename, sizeof(struct store_item));
+	cli_prog->db_mgr = open_database(filename, sizeof(struct store_item),
+									 &cli_prog->db_config);
 
 	return STATUS_OK;
 }
 
-static bool is_valid_date(const struct date *date)
-{
-	return date->day > 0 && date->day <= 31 && date->month > 0 &&
-		   date->month <= 12 && date->year > 0;
-}
-
 static enum status cli_add_prod(struct cli_program *cli_prog)
 {
 	struct store_item item = { 0 };
@@ -168,7 +278,7 @@ static enum status cli_add_prod(struct cli_program *cli_prog)
 		return STATUS_ERROR;
 	}
 
-	return append_entry(cli_prog->db_mgr, &item);
+	return append_entry(&cli_prog->db_mgr, &item);
 }
 
 static inline bool is_valid_percentage(float discount)
@@ -201,8 +311,8 @@ static enum status cli_update_prod(struct cli_program *cli_prog)
 
 		float price = CMD_PARSE_FLOAT(cli_prog->cmd_buffer);
 
-		return update_entries(cli_prog->db_mgr, &barcode, matches_barcode,
-							  &price, update_price);
+		return update_entries_by_key(&cli_prog->db_mgr, (int64_t)barcode,
+									 &price, update_price);
 	}
 	case 2: {
 		printf("Introduceti noua cantitate: ");
@@ -210,8 +320,8 @@ static enum status cli_update_prod(struct cli_program *cli_prog)
 
 		uintmax_t quantity = CMD_PARSE_UINTMAX(cli_prog->cmd_buffer, 10);
 
-		return update_entries(cli_prog->db_mgr, &barcode, matches_barcode,
-							  &quantity, update_quantity);
+		return update_entries_by_key(&cli_prog->db_mgr, (int64_t)barcode,
+									 &quantity, update_quantity);
 	}
 	case 3: {
 		printf("Introduceti noua data de expirare(zi luna an): ");
@@ -232,8 +342,8 @@ static enum status cli_update_prod(struct cli_program *cli_prog)
 			return STATUS_ERROR;
 		}
 
-		return update_entries(cli_prog->db_mgr, &barcode, matches_barcode,
-							  &expiry_date, update_expiry_date);
+		return update_entries_by_key(&cli_prog->db_mgr, (int64_t)barcode,
+									 &expiry_date, update_expiry_date);
 	}
 
 	case 4: {
@@ -248,8 +358,8 @@ static enum status cli_update_prod(struct cli_program *cli_prog)
 
 		discount /= 100;
 
-		return update_entries(cli_prog->db_mgr, &barcode, matches_barcode,
-							  &discount, discount_price);
+		return update_entries_by_key(&cli_prog->db_mgr, (int64_t)barcode,
+									 &discount, discount_price);
 	}
 	default:
 		printf("Comanda invalida\n");
@@ -278,8 +388,8 @@ static enum status cli_update_cat(struct cli_program *cli_prog)
 
 	discount /= 100;
 
-	return update_entries(cli_prog->db_mgr, category, matches_category,
-						  &discount, discount_price);
+	return update_entries_by_group(&cli_prog->db_mgr, category, &discount,
+								   discount_price);
 }
 
 static enum status cli_delete_prod(struct cli_program *cli_prog)
@@ -290,49 +400,296 @@ static enum status cli_delete_prod(struct cli_program *cli_prog)
 	uintmax_t barcode = CMD_PARSE_UINTMAX(cli_prog->cmd_buffer, 10);
 
 	enum status status =
-		remove_unique_entry(cli_prog->db_mgr, &barcode, matches_barcode);
-	if (status == STATUS_ERROR)
+		remove_entry_by_key(&cli_prog->db_mgr, (int64_t)barcode);
+	if (status == STATUS_NOT_FOUND)
 		printf("Produsul nu a fost gasit\n");
 	return status;
 }
 
-static enum status cli_gen_total_report(struct cli_program *cli_prog)
+/*
+ * @brief Open a report file, in the format given by its extension, and write
+ * the header of the format.
+ */
+static FILE *open_report(const char *filename, enum report_format *format)
 {
-	char *filename = get_filename(cli_prog);
-	FILE *out = fopen(filename, "w");
+	if (filename == NULL) {
+		fprintf(stderr, "Fisier invalid\n");
+		return NULL;
+	}
+
+	FILE *out = report_open(filename);
 	if (out == NULL) {
 		fprintf(stderr, "Eroare la deschiderea fisierului\n");
+		return NULL;
+	}
+
+	*format = report_format_of(filename);
+	dump_store_item_header(*format, out);
+	return out;
+}
+
+static enum status close_report(FILE *out, enum status status)
+{
+	if (fclose(out) != 0) {
+		fprintf(stderr, "Eroare la scrierea raportului\n");
 		return STATUS_ERROR;
 	}
+	return status;
+}
 
-	dump_database(cli_prog->db_mgr, dump_store_item_info, NULL, NULL, out);
-	return STATUS_OK;
+static enum status cli_gen_total_report(struct cli_program *cli_prog)
+{
+	enum report_format format;
+	FILE *out = open_report(get_filename(cli_prog), &format);
+	if (out == NULL)
+		return STATUS_ERROR;
+
+	return close_report(out, dump_store_items(&cli_prog->db_mgr, format, NULL,
+											  out));
 }
 
-static enum status cli_gen_category_report(struct cli_program *cli_prog)
+static enum status cli_gen_stats_report(struct cli_program *cli_prog)
 {
-	char *filename = get_filename(cli_prog);
-	FILE *out = fopen(filename, "w");
+	printf("Introduceti cantitatea sub care stocul este redus(implicit %d): ",
+		   AGGREGATE_DEFAULT_LOW_STOCK);
+	GET_LINE(cli_prog->cmd_buffer);
+
+	uintmax_t low_stock = AGGREGATE_DEFAULT_LOW_STOCK;
+	if (*strip(cli_prog->cmd_buffer) != '\0')
+		low_stock = CMD_PARSE_UINTMAX(cli_prog->cmd_buffer, 10);
+
+	const char *filename = get_filename(cli_prog);
+	if (filename == NULL) {
+		fprintf(stderr, "Fisier invalid\n");
+		return STATUS_ERROR;
+	}
+
+	FILE *out = report_open(filename);
 	if (out == NULL) {
 		fprintf(stderr, "Eroare la deschiderea fisierului\n");
 		return STATUS_ERROR;
 	}
 
+	struct inventory_stats stats;
+	enum status status =
+		aggregate_inventory(&cli_prog->db_mgr, (uint64_t)low_stock, &stats);
+	if (status == STATUS_OK)
+		status = write_inventory_stats(&stats, report_format_of(filename),
+									   out);
+	inventory_stats_free(&stats);
+	return close_report(out, status);
+}
+
+static enum status cli_show_category_totals(struct cli_program *cli_prog)
+{
+	if (cli_prog->db_config.measure_of == NULL) {
+		fprintf(stderr, "Totalurile categoriilor nu sunt pastrate(optiunea "
+						"-t)\n");
+		return STATUS_ERROR;
+	}
+
+	struct inventory_stats stats;
+	enum status status = inventory_totals(&cli_prog->db_mgr, &stats);
+	if (status == STATUS_OK)
+		status = write_inventory_totals(&stats, REPORT_BLOCK, stdout);
+	inventory_stats_free(&stats);
+	return status;
+}
+
+static enum status cli_gen_category_report(struct cli_program *cli_prog)
+{
+	enum report_format format;
+	FILE *out = open_report(get_filename(cli_prog), &format);
+	if (out == NULL)
+		return STATUS_ERROR;
+
 	printf("Introduceti categoria: ");
-	GET_LINE(cli_prog->cmd_buffer);
+	if (fgets(cli_prog->cmd_buffer, CLI_MAX_CMD_LEN, stdin) == NULL)
+		return close_report(out, STATUS_ERROR);
+
 	char *category = strip(cli_prog->cmd_buffer);
-	dump_database(cli_prog->db_mgr, dump_store_item_info, (void *)category,
-				  matches_category, out);
-	return STATUS_OK;
+	return close_report(out, dump_store_items(&cli_prog->db_mgr, format,
+											  category, out));
+}
+
+static enum status cli_find_prod_by(struct cli_program *cli_prog,
+									enum text_match mode)
+{
+	GET_LINE(cli_prog->cmd_buffer);
+	char *name = strip(cli_prog->cmd_buffer);
+	return dump_database_by_text(&cli_prog->db_mgr, dump_store_item_info, name,
+								 mode, stdout);
 }
 
 static enum status cli_find_prod(struct cli_program *cli_prog)
 {
 	printf("Introduceti numele produsului: ");
+	return cli_find_prod_by(cli_prog, TEXT_MATCH_EXACT);
+}
+
+static enum status cli_find_prod_prefix(struct cli_program *cli_prog)
+{
+	printf("Introduceti inceputul numelui: ");
+	return cli_find_prod_by(cli_prog, TEXT_MATCH_PREFIX);
+}
+
+static enum status cli_find_prod_substring(struct cli_program *cli_prog)
+{
+	printf("Introduceti o parte din nume: ");
+	return cli_find_prod_by(cli_prog, TEXT_MATCH_SUBSTRING);
+}
+
+static enum status cli_compact_db(struct cli_program *cli_prog)
+{
+	enum status status = compact_database(&cli_prog->db_mgr);
+	if (status != STATUS_OK)
+		fprintf(stderr, "Eroare la compactarea bazei de date\n");
+	return status;
+}
+
+static enum status cli_import_prods(struct cli_program *cli_prog)
+{
+	printf("Introduceti numele fisierului CSV/TSV(- pentru intrarea "
+		   "standard): ");
 	GET_LINE(cli_prog->cmd_buffer);
-	char *name = strip(cli_prog->cmd_buffer);
-	dump_database(cli_prog->db_mgr, dump_store_item_info, (void *)name,
-				  matches_name, stdout);
+	char *filename = strip(cli_prog->cmd_buffer);
+
+	bool use_stdin = strcmp(filename, "-") == 0;
+	FILE *in = use_stdin ? stdin : fopen(filename, "r");
+	if (in == NULL) {
+		fprintf(stderr, "Eroare la deschiderea fisierului\n");
+		return STATUS_ERROR;
+	}
+
+	struct import_stats stats;
+	enum status status = import_store_items(&cli_prog->db_mgr, in, &stats);
+	if (!use_stdin)
+		(void)fclose(in);
+
+	printf("Produse importate: %" PRIu64 "\n", stats.imported);
+	if (stats.rejected != 0)
+		printf("Linii invalide: %" PRIu64 "(prima: linia %" PRIu64 ")\n",
+			   stats.rejected, stats.first_bad_line);
+	if (status != STATUS_OK)
+		fprintf(stderr, "Eroare la importul produselor\n");
+	return status;
+}
+
+static enum status cli_update_from_file(struct cli_program *cli_prog)
+{
+	printf("Introduceti numele fisierului CSV/TSV cu actualizari(- pentru "
+		   "intrarea standard): ");
+	GET_LINE(cli_prog->cmd_buffer);
+	char *filename = strip(cli_prog->cmd_buffer);
+
+	bool use_stdin = strcmp(filename, "-") == 0;
+	FILE *in = use_stdin ? stdin : fopen(filename, "r");
+	if (in == NULL) {
+		fprintf(stderr, "Eroare la deschiderea fisierului\n");
+		return STATUS_ERROR;
+	}
+
+	struct update_stats stats;
+	enum status status = update_store_items(&cli_prog->db_mgr, in, &stats);
+	if (!use_stdin)
+		(void)fclose(in);
+
+	printf("Produse actualizate: %" PRIu64 "\n", stats.applied);
+	if (stats.not_found != 0)
+		printf("Coduri de bare negasite: %" PRIu64 "\n", stats.not_found);
+	if (stats.rejected != 0)
+		printf("Linii invalide: %" PRIu64 "(prima: linia %" PRIu64 ")\n",
+			   stats.rejected, stats.first_bad_line);
+	if (status != STATUS_OK)
+		fprintf(stderr, "Eroare la actualizarea produselor\n");
+	return status;
+}
+
+/*
+ * @brief Read a query from the user.
+ * @return True if the query is valid.
+ */
+static bool cli_read_query(struct cli_program *cli_prog, struct query *query)
+{
+	printf("Introduceti conditia(ex. category = Lactate and price < 10): ");
+	if (fgets(cli_prog->cmd_buffer, CLI_MAX_CMD_LEN, stdin) == NULL)
+		return false;
+
+	if (!query_parse(strip(cli_prog->cmd_buffer), query)) {
+		fprintf(stderr, "Conditie invalida\n");
+		return false;
+	}
+	return true;
+}
+
+static enum status cli_query_prods(struct cli_program *cli_prog)
+{
+	struct query query;
+	if (!cli_read_query(cli_prog, &query))
+		return STATUS_ERROR;
+
+	enum status status =
+		query_dump(&cli_prog->db_mgr, &query, dump_store_item_info, stdout);
+	if (status == STATUS_OK)
+		query_explain(&query, stdout);
+	query_free(&query);
+	return status;
+}
+
+static enum status cli_discount_query(struct cli_program *cli_prog)
+{
+	struct query query;
+	if (!cli_read_query(cli_prog, &query))
+		return STATUS_ERROR;
+
+	printf("Introduceti discount-ul(%%): ");
+	GET_LINE(cli_prog->cmd_buffer);
+	float discount = CMD_PARSE_FLOAT(cli_prog->cmd_buffer);
+
+	if (!is_valid_percentage(discount)) {
+		printf("Discount invalid\n");
+		return STATUS_ERROR;
+	}
+
+	discount /= 100;
+
+	enum status status = query_update(&cli_prog->db_mgr, &query, &discount,
+									  discount_price);
+	query_free(&query);
+	return status;
+}
+
+static enum status cli_discount_expiring(struct cli_program *cli_prog)
+{
+	struct date date;
+
+	printf("Introduceti data(zi luna an): ");
+	GET_LINE(cli_prog->cmd_buffer);
+	if (!parse_date(strip(cli_prog->cmd_buffer), &date)) {
+		fprintf(stderr, "Data invalida\n");
+		return STATUS_ERROR;
+	}
+
+	printf("Introduceti discount-ul(%%): ");
+	GET_LINE(cli_prog->cmd_buffer);
+	float discount = CMD_PARSE_FLOAT(cli_prog->cmd_buffer);
+
+	if (!is_valid_percentage(discount)) {
+		printf("Discount invalid\n");
+		return STATUS_ERROR;
+	}
+
+	return discount_expiring_before(&cli_prog->db_mgr, &date, discount / 100);
+}
+
+static enum status cli_show_stats(struct cli_program *cli_prog)
+{
+	if (cli_prog->db_config.stats == NULL) {
+		fprintf(stderr, "Statisticile nu sunt activate(optiunea -S)\n");
+		return STATUS_ERROR;
+	}
+
+	db_stats_write_text(cli_prog->db_config.stats, stdout);
 	return STATUS_OK;
 }
 
@@ -353,6 +710,17 @@ enum cli_ops {
 	CLI_GEN_CATEGORY_REPORT,
 	CLI_FIND_PRODUCT,
 	CLI_EXIT,
+	CLI_COMPACT_DB,
+	CLI_FIND_PRODUCT_PREFIX,
+	CLI_FIND_PRODUCT_SUBSTRING,
+	CLI_IMPORT_PRODUCTS,
+	CLI_QUERY_PRODUCTS,
+	CLI_DISCOUNT_QUERY,
+	CLI_DISCOUNT_EXPIRING,
+	CLI_SHOW_STATS,
+	CLI_UPDATE_FROM_FILE,
+	CLI_GEN_STATS_REPORT,
+	CLI_SHOW_CATEGORY_TOTALS,
 	CLI_MAX_OPS
 };
 
@@ -378,7 +746,38 @@ static const cli_op_t cli_ops[] = {
 								  cli_gen_category_report },
 	[CLI_FIND_PRODUCT] = { "Gaseste un produs dupa nume(afisare pe ecran)",
 						   cli_find_prod },
-	[CLI_EXIT] = { "Iesire", cli_exit }
+	[CLI_EXIT] = { "Iesire", cli_exit },
+	[CLI_COMPACT_DB] = { "Compacteaza baza de date(elibereaza spatiul "
+						 "produselor sterse)",
+						 cli_compact_db },
+	[CLI_FIND_PRODUCT_PREFIX] = { "Gaseste produsele al caror nume incepe cu "
+								  "un text(afisare pe ecran)",
+								  cli_find_prod_prefix },
+	[CLI_FIND_PRODUCT_SUBSTRING] = { "Gaseste produsele al caror nume contine "
+									 "un text(afisare pe ecran)",
+									 cli_find_prod_substring },
+	[CLI_IMPORT_PRODUCTS] = { "Importa produse dintr-un fisier CSV/TSV",
+							  cli_import_prods },
+	[CLI_QUERY_PRODUCTS] = { "Gaseste produsele care indeplinesc o conditie"
+							 "(afisare pe ecran)",
+							 cli_query_prods },
+	[CLI_DISCOUNT_QUERY] = { "Aplicati discount produselor care indeplinesc "
+							 "o conditie",
+							 cli_discount_query },
+	[CLI_DISCOUNT_EXPIRING] = { "Aplicati discount produselor care expira "
+								"inainte de o data",
+								cli_discount_expiring },
+	[CLI_SHOW_STATS] = { "Afiseaza statisticile operatiilor bazei de date",
+						 cli_show_stats },
+	[CLI_UPDATE_FROM_FILE] = { "Actualizeaza produsele dintr-un fisier CSV/TSV"
+							   "(ex. cantitatile unei livrari)",
+							   cli_update_from_file },
+	[CLI_GEN_STATS_REPORT] = { "Genereaza un raport cu statisticile "
+							   "categoriilor(valoarea stocului, stoc redus)",
+							   cli_gen_stats_report },
+	[CLI_SHOW_CATEGORY_TOTALS] = { "Afiseaza totalurile curente ale "
+								   "categoriilor(afisare pe ecran)",
+								   cli_show_category_totals }
 };
 
 // static void clrscr(void)
@@ -1,10 +1,25 @@
+#define _GNU_SOURCE
+
 #include "database.h"
 
 #include "error.h"
+#include "group_index.h"
+#include "hash_index.h"
+#include "order_index.h"
+#include "record_cache.h"
+#include "snapshot.h"
+#include "text_index.h"
+#include "wal.h"
 
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 
 #ifdef _WIN32
 #include <io.h>
@@ -14,175 +29,4956 @@
 #include <unistd.h>
 #endif
 
-struct db_manager create_database(const char *db_name, size_t entry_size)
+#define INDEX_FILE_EXT ".idx"
+#define GROUP_INDEX_FILE_EXT ".grp"
+#define TEXT_INDEX_FILE_EXT ".tix"
+#define ORDER_INDEX_FILE_EXT ".ord"
+#define WAL_FILE_EXT ".wal"
+#define SNAPSHOT_FILE_EXT ".snap"
+#define TMP_FILE_EXT ".tmp"
+
+#define DB_FILE_MAGIC "SEQDB002"
+// automatic compaction is not worth it for a handful of deleted slots
+#define COMPACT_MIN_DEAD_SLOTS 64
+
+// smallest mapping created for a database opened in mmap mode
+#define MMAP_MIN_LEN (1UL << 20)
+
+// a log batch is committed early once it holds this many bytes
+#define WAL_MAX_BATCH_BYTES (8UL << 20)
+// the log is checkpointed(emptied) once it grows past this size
+#define WAL_CHECKPOINT_BYTES (16UL << 20)
+
+// size of the chunks of slots written at once by a bulk append
+#define APPEND_CHUNK_BYTES (1UL << 20)
+
+// number of slots saved together in a snapshot by the row layout(the columnar
+// layout saves whole groups)
+#define SNAPSHOT_PAGE_SLOTS 64
+
+// the binary search of the sorted run reads single slots until the slots left
+// fit in a single read of this many slots
+#define SORTED_WINDOW_SLOTS 64
+// memory holding the part of the delta merged into the sorted run at once
+#define MERGE_CHUNK_BYTES (64UL << 20)
+// a batch of key updates of a sorted database finds its entries with a scan
+// of the file, instead of a binary search per key, once it holds a key for
+// every this many slots
+#define KEY_SCAN_SLOTS_PER_KEY 256
+
+#define SLOT_DELETED 0x1
+
+/*
+ * The database file starts with a header, followed by the slots. Each slot
+ * holds a slot header and an entry. Removed entries are only marked as deleted
+ * in the slot header(tombstones) and are reclaimed by the compaction.
+ */
+struct db_file_header {
+	char magic[8];
+	uint64_t entry_size;
+	uint64_t nr_dead;
+	uint32_t layout;
+	uint32_t nr_columns;
+	// number of slots in the file; the row layout only reads it in a shared
+	// database, whose file may be grown before the slots are written, while
+	// the file of the columnar layout is allocated one group at a time
+	uint64_t nr_slots;
+	// number of times the shared databases changed the file, which tells the
+	// other processes sharing it to reload their state
+	uint64_t generation;
+	// number of snapshots taken so far and whether the last one is still read
+	// (see open_snapshot)
+	uint32_t nr_snapshots;
+	uint32_t snapshot_open;
+	// number of slots at the start of the file sorted by key(see
+	// db_config.sorted)
+	uint64_t nr_sorted;
+};
+
+enum db_layout {
+	DB_LAYOUT_ROWS,
+	DB_LAYOUT_COLUMNS,
+};
+
+// the state of the file header committed with every log batch
+struct wal_db_meta {
+	uint64_t nr_slots;
+	uint64_t nr_dead;
+};
+
+struct db_slot_header {
+	uint32_t flags;
+	uint32_t reserved;
+};
+
+/*
+ * A snapshot of the slots of a database. The old images of the slots changed
+ * after it was taken are saved in a "<db_name>.snap" file, starting with the
+ * first slot at offset 0. In a shared database, the processes not reading the
+ * snapshot also keep it, to save the slots they change.
+ */
+struct db_snapshot {
+	struct snapshot *file;
+	// the number of the snapshot, counting the snapshots of the database
+	uint64_t id;
+	// number of slots of the database when the snapshot was taken
+	uint64_t nr_slots;
+	// whether this process reads it(see open_snapshot)
+	bool reading;
+};
+
+static inline int db_fd(const struct db_manager *db_mgr)
 {
-	FILE *db = fopen(db_name, "w+b");
-	DIE(db == NULL, "Error opening database");
+	return fileno(db_mgr->db_file);
+}
 
-	return (struct db_manager){ .db_file = db, .entry_size = entry_size };
+static inline off_t slot_offset(const struct db_manager *db_mgr, int64_t idx)
+{
+	return (off_t)sizeof(struct db_file_header) +
+		   idx * (off_t)db_mgr->slot_size;
 }
 
-struct db_manager open_database(const char *db_name, size_t entry_size)
+static inline char *mapped_slot(const struct db_manager *db_mgr, int64_t idx)
 {
-	FILE *db = fopen(db_name, "r+b");
-	DIE(db == NULL, "Error opening database");
+	return db_mgr->map + slot_offset(db_mgr, idx);
+}
+
+/*
+ * @brief Get the size of the database file holding the given number of slots.
+ * A columnar database is always allocated in whole groups.
+ */
+static inline off_t file_size_for(const struct db_manager *db_mgr,
+								  uint64_t nr_slots)
+{
+	if (db_mgr->columnar)
+		nr_slots = (nr_slots + DB_COLUMN_GROUP_SLOTS - 1) /
+				   DB_COLUMN_GROUP_SLOTS * DB_COLUMN_GROUP_SLOTS;
+
+	return slot_offset(db_mgr, (int64_t)nr_slots);
+}
+
+/*
+ * @brief Get the size of the pages of the snapshots. The slots of a columnar
+ * database are saved a group at a time, as they are locked.
+ */
+static inline size_t snapshot_page_bytes(const struct db_manager *db_mgr)
+{
+	return (db_mgr->columnar ? DB_COLUMN_GROUP_SLOTS : SNAPSHOT_PAGE_SLOTS) *
+		   db_mgr->slot_size;
+}
 
-	return (struct db_manager){ .db_file = db, .entry_size = entry_size };
+/*
+ * @brief Check if the slots can be accessed in place in the mapping.
+ * The slots of a columnar database are scattered across its columns, so they
+ * are always copied in and out of the file. With the log, the slots are
+ * copied as well, since they are written through the log.
+ */
+static inline bool slots_in_place(const struct db_manager *db_mgr)
+{
+	// the slots of a shared database are copied while they are locked, and
+	// the old images of the slots are saved before a change while a snapshot
+	// is read
+	return db_mgr->map != NULL && !db_mgr->columnar && db_mgr->wal == NULL &&
+		   !db_mgr->shared && db_mgr->snapshot == NULL;
 }
 
-void close_database(struct db_manager db_mgr)
+/*
+ * @brief Get the number of consecutive slots, starting from the given one, that
+ * are stored in the database file. With the log, the slots past the end of the
+ * file are only in the log batch.
+ */
+static inline size_t stored_slots(const struct db_manager *db_mgr,
+								  uint64_t idx, size_t count)
 {
-	if (db_mgr.db_file != NULL)
-		(void)fclose(db_mgr.db_file);
+	if (db_mgr->wal == NULL)
+		return count;
+	if (idx >= db_mgr->file_slots)
+		return 0;
+	return db_mgr->file_slots - idx < count ?
+			   (size_t)(db_mgr->file_slots - idx) :
+			   count;
 }
 
-static enum status write_entry(struct db_manager db_mgr, const void *entry)
+static inline void *slot_entry(void *slot)
 {
-	size_t written = fwrite(entry, db_mgr.entry_size, 1, db_mgr.db_file);
+	return (char *)slot + sizeof(struct db_slot_header);
+}
 
-	return written == 1 ? STATUS_OK : STATUS_ERROR;
+static inline bool slot_is_live(const void *slot)
+{
+	return !(((const struct db_slot_header *)slot)->flags & SLOT_DELETED);
 }
 
 /*
- * @brief Find the index of the entry in the database
- * @param db_mgr - the database manager
- * @param criteria - the criteria to match
- * @param matches_crit - the function to match the criteria
- * @return the index of the entry in the database or -1 if the entry is not
- * found
+ * @brief Build the live slot of an entry in a buffer of the pool.
+ * @param db_mgr The database manager.
+ * @param entry The entry.
+ * @return The slot, to be returned to the pool, or NULL if no buffer could be
+ * allocated.
  */
-static int64_t find_entry_idx(struct db_manager db_mgr, const void *criteria,
-							  match_crit_func matches_crit)
+static char *live_slot(struct db_manager *db_mgr, const void *entry)
 {
-	FILE *db = db_mgr.db_file;
-	size_t entry_size = db_mgr.entry_size;
+	char *slot = buffer_pool_get(db_mgr->buffers, db_mgr->slot_size);
 
-	int64_t idx = 0;
+	if (slot != NULL) {
+		memset(slot, 0, sizeof(struct db_slot_header));
+		memcpy(slot_entry(slot), entry, db_mgr->entry_size);
+	}
+	return slot;
+}
 
-	char *buffer = malloc(entry_size);
-	DIE(buffer == NULL, "Error allocating buffer");
+static char *sibling_path(const char *db_name, const char *ext)
+{
+	size_t len = strlen(db_name) + strlen(ext) + 1;
+	char *path = malloc(len);
+	DIE(path == NULL, "Error allocating path");
 
-	while (fread(buffer, entry_size, 1, db) == 1) {
-		if (matches_crit(buffer, criteria)) {
-			free(buffer);
-			return idx;
-		}
-		++idx;
+	(void)snprintf(path, len, "%s%s", db_name, ext);
+	return path;
+}
+
+static void db_file_stat(FILE *db, uint64_t *size, uint64_t *mtime)
+{
+	struct stat st;
+	DIE(fstat(fileno(db), &st) != 0, "Error reading database attributes");
+
+	*size = (uint64_t)st.st_size;
+	*mtime = (uint64_t)st.st_mtim.tv_sec * 1000000000ULL +
+			 (uint64_t)st.st_mtim.tv_nsec;
+}
+
+static inline void count_entries(const struct db_manager *db_mgr,
+								 uint64_t scanned, uint64_t matched)
+{
+	if (db_mgr->stats != NULL)
+		db_stats_add_entries(db_mgr->stats, scanned, matched);
+}
+
+static inline void count_io(struct db_stats *stats, uint64_t bytes_read,
+							uint64_t bytes_written, uint64_t syscalls)
+{
+	if (stats != NULL)
+		db_stats_add_io(stats, bytes_read, bytes_written, syscalls);
+}
+
+/*
+ * The processes sharing a database coordinate through locks on byte ranges of
+ * its file: the slots are locked while they are read or written, and the locks
+ * of the writer and of the layout are taken on bytes past the end of any
+ * database file. Open file description locks are not released when another
+ * descriptor of the file is closed, and they are shared by the threads of a
+ * scan.
+ */
+#ifdef F_OFD_SETLKW
+#define DB_SETLKW F_OFD_SETLKW
+#define DB_GETLK F_OFD_GETLK
+#else
+#define DB_SETLKW F_SETLKW
+#define DB_GETLK F_GETLK
+#endif
+
+// held by the process changing the database, for the whole operation
+#define DB_LOCK_WRITER ((off_t)1 << 62)
+// shared by the operations reading the database and held alone while the
+// compaction moves the slots
+#define DB_LOCK_LAYOUT (DB_LOCK_WRITER + 1)
+// shared by the processes reading the snapshot of the database
+#define DB_LOCK_SNAPSHOT (DB_LOCK_WRITER + 2)
+
+static void lock_range(struct db_manager *db_mgr, short type, off_t start,
+					   off_t len)
+{
+	if (!db_mgr->shared)
+		return;
+
+	struct flock lock = {
+		.l_type = type, .l_whence = SEEK_SET, .l_start = start, .l_len = len
+	};
+	int ret;
+
+	do {
+		ret = fcntl(db_fd(db_mgr), DB_SETLKW, &lock);
+	} while (ret != 0 && errno == EINTR);
+	count_io(db_mgr->stats, 0, 0, 1);
+	DIE(ret != 0, "Error locking database");
+}
+
+/*
+ * @brief Lock consecutive slots of a shared database. The slots of a columnar
+ * database are spread over their whole groups, which are locked instead.
+ */
+static void lock_slots(struct db_manager *db_mgr, short type, int64_t idx,
+					   size_t count)
+{
+	int64_t end = idx + (int64_t)count;
+
+	if (!db_mgr->shared || count == 0)
+		return;
+
+	if (db_mgr->columnar) {
+		idx -= idx % DB_COLUMN_GROUP_SLOTS;
+		end += (DB_COLUMN_GROUP_SLOTS - end % DB_COLUMN_GROUP_SLOTS) %
+			   DB_COLUMN_GROUP_SLOTS;
 	}
+	lock_range(db_mgr, type, slot_offset(db_mgr, idx),
+			   slot_offset(db_mgr, end) - slot_offset(db_mgr, idx));
+}
 
-	free(buffer);
-	return -1;
+/*
+ * @brief Check if other processes read the snapshot of a shared database.
+ */
+static bool snapshot_readers(struct db_manager *db_mgr)
+{
+	if (!db_mgr->shared)
+		return false;
+
+	struct flock lock = { .l_type = F_WRLCK,
+						  .l_whence = SEEK_SET,
+						  .l_start = DB_LOCK_SNAPSHOT,
+						  .l_len = 1 };
+
+	count_io(db_mgr->stats, 0, 0, 1);
+	DIE(fcntl(db_fd(db_mgr), DB_GETLK, &lock) != 0, "Error locking database");
+	return lock.l_type != F_UNLCK;
 }
 
-enum status append_entry(struct db_manager db_mgr, const void *entry)
+static enum status pread_full(struct db_stats *stats, int fd, void *buf,
+							  size_t len, off_t offset)
 {
-	// set the file pointer to the end of the file
-	fseek(db_mgr.db_file, 0, SEEK_END);
-	return write_entry(db_mgr, entry);
+	while (len > 0) {
+		ssize_t ret = pread(fd, buf, len, offset);
+		count_io(stats, ret > 0 ? (uint64_t)ret : 0, 0, 1);
+		if (ret <= 0)
+			return STATUS_ERROR;
+		buf = (char *)buf + ret;
+		len -= ret;
+		offset += ret;
+	}
+
+	return STATUS_OK;
 }
 
-enum status update_entries(struct db_manager db_mgr, const void *criteria,
-						   match_crit_func should_update,
-						   const void *update_val, update_func update)
+static enum status pwrite_full(struct db_stats *stats, int fd,
+							   const void *buf, size_t len, off_t offset)
 {
-	FILE *db = db_mgr.db_file;
-	size_t entry_size = db_mgr.entry_size;
-	(void)fseek(db, 0, SEEK_SET);
+	while (len > 0) {
+		ssize_t ret = pwrite(fd, buf, len, offset);
+		count_io(stats, 0, ret > 0 ? (uint64_t)ret : 0, 1);
+		if (ret <= 0)
+			return STATUS_ERROR;
+		buf = (const char *)buf + ret;
+		len -= ret;
+		offset += ret;
+	}
 
-	char *buffer = malloc(entry_size);
-	DIE(buffer == NULL, "Error allocating buffer");
+	return STATUS_OK;
+}
 
-	while (fread(buffer, entry_size, 1, db) == 1) {
-		if (should_update(buffer, criteria)) {
-			update(buffer, update_val);
+/*
+ * In the columnar layout, the slots are stored in groups of
+ * DB_COLUMN_GROUP_SLOTS. A group holds the slot headers of all its slots,
+ * followed by the values of the first column for all its slots, and so on.
+ * The parts of a slot are numbered with the slot header as part 0 and the
+ * columns starting from 1.
+ */
+static size_t part_size(const struct db_manager *db_mgr, size_t part)
+{
+	return part == 0 ? sizeof(struct db_slot_header) :
+					   db_mgr->columns[part - 1].size;
+}
+
+// offset of a part inside a slot
+static size_t part_slot_offset(const struct db_manager *db_mgr, size_t part)
+{
+	return part == 0 ? 0 :
+					   sizeof(struct db_slot_header) +
+						   db_mgr->columns[part - 1].offset;
+}
+
+// offset of the values of a part inside a group
+static off_t part_group_offset(const struct db_manager *db_mgr, size_t part)
+{
+	off_t offset = 0;
+
+	for (size_t i = 0; i < part; ++i)
+		offset += (off_t)part_size(db_mgr, i) * DB_COLUMN_GROUP_SLOTS;
+
+	return offset;
+}
+
+/*
+ * @brief Read or write the values of one part for consecutive slots of a
+ * columnar database.
+ * @param db_mgr The database manager.
+ * @param part The part.
+ * @param idx The index of the first slot.
+ * @param values The values, stored contiguously.
+ * @param count The number of slots.
+ * @param write Whether the values are written instead of read.
+ * @return The status of the operation.
+ */
+static enum status transfer_part(struct db_manager *db_mgr, size_t part,
+								 uint64_t idx, void *values, size_t count,
+								 bool write)
+{
+	size_t size = part_size(db_mgr, part);
+	off_t part_offset = part_group_offset(db_mgr, part);
+	uint64_t first_idx = idx;
+	size_t total = count;
+	char *pos = values;
 
-			fseek(db, -entry_size, SEEK_CUR);
-			write_entry(db_mgr, buffer);
+	if (!write)
+		count = stored_slots(db_mgr, idx, count);
+
+	while (count > 0) {
+		uint64_t group = idx / DB_COLUMN_GROUP_SLOTS;
+		size_t row = idx % DB_COLUMN_GROUP_SLOTS;
+		size_t run = DB_COLUMN_GROUP_SLOTS - row;
+		if (run > count)
+			run = count;
+
+		off_t offset = slot_offset(db_mgr, (int64_t)(group *
+													 DB_COLUMN_GROUP_SLOTS)) +
+					   part_offset + (off_t)(row * size);
+		size_t len = run * size;
+		enum status status = STATUS_OK;
+
+		if (db_mgr->map != NULL) {
+			if (write)
+				memcpy(db_mgr->map + offset, pos, len);
+			else
+				memcpy(pos, db_mgr->map + offset, len);
+			count_io(db_mgr->stats, write ? 0 : len, write ? len : 0, 0);
+		} else if (write) {
+			status = pwrite_full(db_mgr->stats, db_fd(db_mgr), pos, len,
+								 offset);
+		} else {
+			status = pread_full(db_mgr->stats, db_fd(db_mgr), pos, len,
+								offset);
 		}
+		if (status != STATUS_OK)
+			return status;
+
+		pos += len;
+		idx += run;
+		count -= run;
 	}
 
-	free(buffer);
+	// the slots written since the last commit are read from the log batch
+	if (!write && db_mgr->wal != NULL)
+		(void)wal_read_pages(db_mgr->wal, first_idx, total,
+							 part_slot_offset(db_mgr, part), size, values,
+							 size);
+
 	return STATUS_OK;
 }
 
-enum status remove_unique_entry(struct db_manager db_mgr, const void *criteria,
-								match_crit_func matches_crit)
+/*
+ * @brief Read or write consecutive slots of a columnar database, converting
+ * them from or to the row layout of the slots buffer.
+ * The bytes of an entry not covered by any column are read as zeros.
+ * @return The status of the operation.
+ */
+static enum status transfer_slot_columns(struct db_manager *db_mgr,
+										 uint64_t idx, char *slots,
+										 size_t count, bool write)
 {
-	FILE *db = db_mgr.db_file;
-	size_t entry_size = db_mgr.entry_size;
-	(void)fseek(db, 0, SEEK_SET);
+	size_t slot_size = db_mgr->slot_size;
+	size_t max_size = sizeof(struct db_slot_header);
+	enum status status = STATUS_OK;
 
-	int64_t idx = find_entry_idx(db_mgr, criteria, matches_crit);
+	for (size_t c = 0; c < db_mgr->nr_columns; ++c)
+		if (db_mgr->columns[c].size > max_size)
+			max_size = db_mgr->columns[c].size;
 
-	if (idx == -1) {
+	char *values = buffer_pool_get(db_mgr->buffers, count * max_size);
+	if (values == NULL)
 		return STATUS_ERROR;
+
+	if (!write)
+		memset(slots, 0, count * slot_size);
+
+	for (size_t part = 0; part <= db_mgr->nr_columns; ++part) {
+		size_t size = part_size(db_mgr, part);
+		char *field = slots + part_slot_offset(db_mgr, part);
+
+		if (write)
+			for (size_t i = 0; i < count; ++i)
+				memcpy(values + i * size, field + i * slot_size, size);
+
+		status = transfer_part(db_mgr, part, idx, values, count, write);
+		if (status != STATUS_OK)
+			break;
+
+		if (!write)
+			for (size_t i = 0; i < count; ++i)
+				memcpy(field + i * slot_size, values + i * size, size);
 	}
 
-	// calculate the size of the remaining entries
-	fseek(db, 0, SEEK_END);
-	long int db_size = ftell(db);
+	buffer_pool_put(db_mgr->buffers, values, count * max_size);
+	return status;
+}
+
+/*
+ * @brief Read consecutive slots from the database file, without locking them.
+ * @return The status of the operation.
+ */
+static enum status load_slots(struct db_manager *db_mgr, int64_t idx,
+							  void *slots, size_t count)
+{
+	size_t len = stored_slots(db_mgr, (uint64_t)idx, count) *
+				 db_mgr->slot_size;
 
-	(void)fseek(db, idx * (long)entry_size, SEEK_SET);
-	long int remaining_size = db_size - (idx + 1) * (long int)entry_size;
+	if (db_mgr->columnar)
+		return transfer_slot_columns(db_mgr, (uint64_t)idx, slots, count,
+									 false);
 
-	if (remaining_size <= 0) {
-		int ret_val = ftruncate(fileno(db), db_size - (long)entry_size);
-		fflush(db);
-		return ret_val == 0 ? STATUS_OK : STATUS_ERROR;
+	if (db_mgr->map != NULL) {
+		memcpy(slots, mapped_slot(db_mgr, idx), len);
+		count_io(db_mgr->stats, len, 0, 0);
+		return STATUS_OK;
 	}
 
-	// read the remaining entries
-	(void)fseek(db, (idx + 1) * (long)entry_size, SEEK_SET);
+	return pread_full(db_mgr->stats, db_fd(db_mgr), slots, len,
+					  slot_offset(db_mgr, idx));
+}
+
+/*
+ * @brief Read consecutive slots from the database.
+ * @param db_mgr The database manager.
+ * @param idx The index of the first slot.
+ * @param slots The buffer the slots are read into.
+ * @param count The number of slots.
+ * @return The status of the operation.
+ */
+static enum status read_slots(struct db_manager *db_mgr, int64_t idx,
+							  void *slots, size_t count)
+{
+	lock_slots(db_mgr, F_RDLCK, idx, count);
+	enum status status = load_slots(db_mgr, idx, slots, count);
+	lock_slots(db_mgr, F_UNLCK, idx, count);
+
+	// the slots written since the last commit are read from the log batch(the
+	// columns are patched as they are read)
+	if (status == STATUS_OK && db_mgr->wal != NULL && !db_mgr->columnar)
+		(void)wal_read_pages(db_mgr->wal, (uint64_t)idx, count, 0,
+							 db_mgr->slot_size, slots, db_mgr->slot_size);
+
+	return status;
+}
+
+/*
+ * @brief Read consecutive slots of the snapshot being read, as they were when
+ * it was taken.
+ * @return The status of the operation.
+ */
+static enum status read_snapshot_slots(struct db_manager *db_mgr, int64_t idx,
+									   void *slots, size_t count)
+{
+	size_t slot_size = db_mgr->slot_size;
+	size_t nr_patched = 0;
+
+	lock_slots(db_mgr, F_RDLCK, idx, count);
+	enum status status = load_slots(db_mgr, idx, slots, count);
+	if (status == STATUS_OK)
+		status = snapshot_patch(db_mgr->snapshot->file,
+								(uint64_t)idx * slot_size, slots,
+								count * slot_size, &nr_patched);
+	lock_slots(db_mgr, F_UNLCK, idx, count);
+
+	count_io(db_mgr->stats, nr_patched * snapshot_page_bytes(db_mgr), 0,
+			 nr_patched);
+	return status;
+}
+
+/*
+ * @brief Read the current image of a part of the snapshot, a
+ * snapshot_read_func. The slots are locked by the writer.
+ */
+static enum status read_snapshot_part(void *ctx, uint64_t offset, void *buf,
+									  size_t len)
+{
+	struct db_manager *db_mgr = ctx;
+
+	return load_slots(db_mgr, (int64_t)(offset / db_mgr->slot_size), buf,
+					  len / db_mgr->slot_size);
+}
+
+/*
+ * @brief Save the old images of consecutive slots in the snapshot, before they
+ * are changed for the first time since it was taken.
+ * @return The status of the operation.
+ */
+static enum status preserve_slots(struct db_manager *db_mgr, int64_t idx,
+								  size_t count)
+{
+	size_t nr_saved;
+	enum status status = snapshot_preserve(
+		db_mgr->snapshot->file, (uint64_t)idx * db_mgr->slot_size,
+		count * db_mgr->slot_size, read_snapshot_part, db_mgr, &nr_saved);
+
+	count_io(db_mgr->stats, 0, nr_saved * snapshot_page_bytes(db_mgr),
+			 nr_saved);
+	return status;
+}
 
-	char *remaining_data = malloc(remaining_size);
-	DIE(remaining_data == NULL, "Error allocating buffer");
+/*
+ * @brief Write consecutive slots to the database file.
+ * In mmap mode the slots may overlap their destination in the mapping.
+ * @param db_mgr The database manager.
+ * @param idx The index of the first slot.
+ * @param slots The slots to write.
+ * @param count The number of slots.
+ * @return The status of the operation.
+ */
+static enum status store_slots(struct db_manager *db_mgr, int64_t idx,
+							   const void *slots, size_t count)
+{
+	size_t len = count * db_mgr->slot_size;
+	enum status status = STATUS_OK;
 
-	if (fread(remaining_data, 1, remaining_size, db) != remaining_size) {
-		free(remaining_data);
+	lock_slots(db_mgr, F_WRLCK, idx, count);
+	// the snapshot keeps the old images of the slots
+	if (db_mgr->snapshot != NULL &&
+		preserve_slots(db_mgr, idx, count) != STATUS_OK) {
+		lock_slots(db_mgr, F_UNLCK, idx, count);
 		return STATUS_ERROR;
 	}
 
-	// write the remaining entries one position back
+	if (db_mgr->columnar) {
+		status = transfer_slot_columns(db_mgr, (uint64_t)idx, (char *)slots,
+									   count, true);
+	} else if (db_mgr->map != NULL) {
+		memmove(mapped_slot(db_mgr, idx), slots, len);
+		count_io(db_mgr->stats, 0, len, 0);
+	} else {
+		status = pwrite_full(db_mgr->stats, db_fd(db_mgr), slots, len,
+							 slot_offset(db_mgr, idx));
+	}
+	lock_slots(db_mgr, F_UNLCK, idx, count);
 
-	(void)fseek(db, idx * (long)entry_size, SEEK_SET);
-	if (fwrite(remaining_data, 1, remaining_size, db) != remaining_size) {
-		free(remaining_data);
-		return STATUS_ERROR;
+	// the slots may be written by the threads of a scan
+	if (db_mgr->shared)
+		__atomic_store_n(&db_mgr->changed, true, __ATOMIC_RELAXED);
+	return status;
+}
+
+/*
+ * @brief Write consecutive slots to the database.
+ * With the log, the slots are only added to the log batch, and they are
+ * written to the database file once the batch is committed.
+ * @param db_mgr The database manager.
+ * @param idx The index of the first slot.
+ * @param slots The slots to write.
+ * @param count The number of slots.
+ * @return The status of the operation.
+ */
+static enum status write_slots(struct db_manager *db_mgr, int64_t idx,
+							   const void *slots, size_t count)
+{
+	if (db_mgr->wal != NULL) {
+		wal_write_pages(db_mgr->wal, (uint64_t)idx, slots, count);
+		return STATUS_OK;
 	}
 
-	// truncate the file to the new size
-	if (ftruncate(fileno(db), db_size - (long)entry_size) != 0) {
-		free(remaining_data);
-		return STATUS_ERROR;
+	return store_slots(db_mgr, idx, slots, count);
+}
+
+static enum status write_file_header(struct db_manager *db_mgr)
+{
+	struct db_file_header hdr = { .entry_size = db_mgr->entry_size,
+								  .nr_dead = db_mgr->nr_dead,
+								  .nr_slots = db_mgr->nr_slots,
+								  .generation = db_mgr->generation,
+								  .nr_snapshots = db_mgr->nr_snapshots,
+								  .snapshot_open = db_mgr->snapshot != NULL,
+								  .nr_sorted = db_mgr->nr_sorted };
+	enum status status = STATUS_OK;
+
+	if (db_mgr->columnar) {
+		hdr.layout = DB_LAYOUT_COLUMNS;
+		hdr.nr_columns = (uint32_t)db_mgr->nr_columns;
 	}
+	memcpy(hdr.magic, DB_FILE_MAGIC, sizeof(hdr.magic));
 
-	fflush(db);
-	free(remaining_data);
-	return STATUS_OK;
+	lock_range(db_mgr, F_WRLCK, 0, sizeof(hdr));
+	if (db_mgr->map != NULL)
+		memcpy(db_mgr->map, &hdr, sizeof(hdr));
+	else
+		status = pwrite_full(db_mgr->stats, db_fd(db_mgr), &hdr, sizeof(hdr),
+							 0);
+	lock_range(db_mgr, F_UNLCK, 0, sizeof(hdr));
+
+	return status;
 }
 
-void dump_database(struct db_manager db_mgr, dump_entry_func dump_entry,
-				   const void *criteria, match_crit_func matches_crit,
-				   FILE *out)
+/*
+ * @brief Convert a database written as a plain sequence of entries(without a
+ * file header and slot headers) to the current format.
+ * The conversion is done in a temporary file which then replaces the
+ * database.
+ * @param db_name The name of the database.
+ * @param db The open database file, closed by the conversion.
+ * @param entry_size The size of each entry in the database.
+ * @return The reopened database file.
+ */
+static FILE *upgrade_legacy_database(const char *db_name, FILE *db,
+									 size_t entry_size)
 {
-	FILE *db = db_mgr.db_file;
-	size_t entry_size = db_mgr.entry_size;
-	(void)fseek(db, 0, SEEK_SET);
+	char *tmp_path = sibling_path(db_name, TMP_FILE_EXT);
+	FILE *tmp = fopen(tmp_path, "wb");
+	DIE(tmp == NULL, "Error creating temporary database");
+
+	struct db_file_header hdr = { .entry_size = entry_size };
+	memcpy(hdr.magic, DB_FILE_MAGIC, sizeof(hdr.magic));
+	DIE(fwrite(&hdr, sizeof(hdr), 1, tmp) != 1, "Error upgrading database");
 
 	char *buffer = malloc(entry_size);
 	DIE(buffer == NULL, "Error allocating buffer");
 
-	int64_t cnt = 0;
+	struct db_slot_header slot_hdr = { 0 };
+	(void)fseek(db, 0, SEEK_SET);
 	while (fread(buffer, entry_size, 1, db) == 1) {
-		if (matches_crit == NULL || matches_crit(buffer, criteria)) {
-			dump_entry(buffer, out);
-			++cnt;
-		}
+		DIE(fwrite(&slot_hdr, sizeof(slot_hdr), 1, tmp) != 1 ||
+				fwrite(buffer, entry_size, 1, tmp) != 1,
+			"Error upgrading database");
 	}
 
-	if (cnt == 0) {
-		(void)fprintf(out, "Nicio intrare gasita\n");
+	free(buffer);
+	DIE(fclose(tmp) != 0, "Error upgrading database");
+	(void)fclose(db);
+	DIE(rename(tmp_path, db_name) != 0, "Error upgrading database");
+	free(tmp_path);
+
+	db = fopen(db_name, "r+b");
+	DIE(db == NULL, "Error opening database");
+	return db;
+}
+
+/*
+ * @brief Map the database file in memory.
+ * The mapping is larger than the file, leaving room for the file to grow
+ * without remapping it on every append.
+ * @param db_mgr The database manager.
+ */
+static void map_database(struct db_manager *db_mgr)
+{
+	size_t size = file_size_for(db_mgr, db_mgr->nr_slots);
+	size_t map_len = size > MMAP_MIN_LEN ? size : MMAP_MIN_LEN;
+
+	void *map = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+					 db_fd(db_mgr), 0);
+	DIE(map == MAP_FAILED, "Error mapping database");
+
+	db_mgr->map = map;
+	db_mgr->map_len = map_len;
+}
+
+static int truncate_file(struct db_manager *db_mgr, off_t size)
+{
+	count_io(db_mgr->stats, 0, 0, 1);
+	return ftruncate(db_fd(db_mgr), size);
+}
+
+/*
+ * @brief Resize the file of a database opened in mmap mode, growing the
+ * mapping if the file no longer fits in it.
+ * @param db_mgr The database manager.
+ * @param size The new size of the file.
+ * @return The status of the operation.
+ */
+static enum status resize_mapped_file(struct db_manager *db_mgr, size_t size)
+{
+	if (truncate_file(db_mgr, (off_t)size) != 0)
+		return STATUS_ERROR;
+
+	if (size <= db_mgr->map_len)
+		return STATUS_OK;
+
+	size_t map_len = db_mgr->map_len * 2;
+	if (map_len < size)
+		map_len = size;
+
+	void *map = mremap(db_mgr->map, db_mgr->map_len, map_len, MREMAP_MAYMOVE);
+	count_io(db_mgr->stats, 0, 0, 1);
+	if (map == MAP_FAILED)
+		return STATUS_ERROR;
+
+	db_mgr->map = map;
+	db_mgr->map_len = map_len;
+	return STATUS_OK;
+}
+
+/*
+ * @brief Write slots committed to the log to the database file, growing the
+ * file for the appended slots.
+ * @param ctx The database manager.
+ * @return The status of the operation.
+ */
+static enum status apply_logged_slots(void *ctx, uint64_t idx,
+									  const void *slots, size_t count)
+{
+	struct db_manager *db_mgr = ctx;
+
+	if (idx + count > db_mgr->file_slots) {
+		off_t size = file_size_for(db_mgr, idx + count);
+		enum status status = STATUS_OK;
+
+		if (db_mgr->map != NULL)
+			status = resize_mapped_file(db_mgr, size);
+		else if (truncate_file(db_mgr, size) != 0)
+			status = STATUS_ERROR;
+		if (status != STATUS_OK)
+			return status;
+		db_mgr->file_slots = idx + count;
 	}
 
-	free(buffer);
+	return store_slots(db_mgr, (int64_t)idx, slots, count);
+}
+
+/*
+ * @brief Write the file header committed with a log batch.
+ * @param ctx The database manager.
+ * @return The status of the operation.
+ */
+static enum status apply_logged_meta(void *ctx, const void *meta, size_t len)
+{
+	struct db_manager *db_mgr = ctx;
+	struct wal_db_meta state;
+
+	if (len != sizeof(state))
+		return STATUS_ERROR;
+
+	memcpy(&state, meta, sizeof(state));
+	db_mgr->nr_slots = state.nr_slots;
+	db_mgr->nr_dead = state.nr_dead;
+	return write_file_header(db_mgr);
+}
+
+/*
+ * @brief Write an entry of the record cache to its slot, a record_write_func.
+ */
+static enum status write_cached_entry(void *ctx, int64_t idx, const void *entry)
+{
+	struct db_manager *db_mgr = ctx;
+	// the cached entries are live
+	char *slot = live_slot(db_mgr, entry);
+	if (slot == NULL)
+		return STATUS_ERROR;
+
+	enum status status = write_slots(db_mgr, idx, slot, 1);
+	buffer_pool_put(db_mgr->buffers, slot, db_mgr->slot_size);
+	return status;
+}
+
+/*
+ * @brief Write the dirty entries of the record cache, before the database file
+ * is read by an operation that does not go through the cache.
+ * @param db_mgr The database manager.
+ * @return The status of the writes.
+ */
+static enum status sync_cache(struct db_manager *db_mgr)
+{
+	if (db_mgr->cache == NULL)
+		return STATUS_OK;
+
+	return record_cache_flush(db_mgr->cache, write_cached_entry, db_mgr);
+}
+
+/*
+ * @brief Write the dirty entries of the record cache and empty it, before an
+ * operation that may change any entry in place or move the entries.
+ * @param db_mgr The database manager.
+ * @return The status of the writes.
+ */
+static enum status drop_cache(struct db_manager *db_mgr)
+{
+	enum status status = sync_cache(db_mgr);
+
+	if (db_mgr->cache != NULL)
+		record_cache_clear(db_mgr->cache);
+	return status;
+}
+
+/*
+ * @brief Drop a key from the record cache, which only holds the keys of a
+ * single entry, once another entry gets the key or the entry loses it. The
+ * entry is written first if it is dirty.
+ * @param db_mgr The database manager.
+ * @param key The key.
+ * @return The status of the write.
+ */
+static enum status uncache_key(struct db_manager *db_mgr, int64_t key)
+{
+	if (db_mgr->cache == NULL)
+		return STATUS_OK;
+
+	return record_cache_remove(db_mgr->cache, key, write_cached_entry,
+							   db_mgr);
+}
+
+/*
+ * @brief Keep the record cache in sync with an entry just written by an
+ * operation that does not go through the cache.
+ * @param db_mgr The database manager.
+ * @param idx The slot of the entry.
+ * @param entry The entry.
+ * @param insert Whether to also cache the entry if it is not cached yet, which
+ * requires its key to be held by this entry only.
+ * @return The status of the write of an evicted dirty entry.
+ */
+static enum status cache_written(struct db_manager *db_mgr, int64_t idx,
+								 const void *entry, bool insert)
+{
+	if (db_mgr->cache == NULL)
+		return STATUS_OK;
+
+	int64_t key = db_mgr->key_of(entry);
+	if (!insert) {
+		record_cache_refresh(db_mgr->cache, key, idx, entry);
+		return STATUS_OK;
+	}
+
+	return record_cache_put(db_mgr->cache, key, idx, entry, write_cached_entry,
+							db_mgr);
+}
+
+static enum status sync_database_file(struct db_manager *db_mgr)
+{
+	count_io(db_mgr->stats, 0, 0, db_mgr->map != NULL ? 2 : 1);
+	if (db_mgr->map != NULL &&
+		msync(db_mgr->map, file_size_for(db_mgr, db_mgr->nr_slots),
+			  MS_SYNC) != 0)
+		return STATUS_ERROR;
+
+	return fdatasync(db_fd(db_mgr)) == 0 ? STATUS_OK : STATUS_ERROR;
+}
+
+/*
+ * @brief Empty the log once the database file holding all its batches is on
+ * the disk.
+ * @param db_mgr The database manager.
+ * @return The status of the operation.
+ */
+static enum status checkpoint_log(struct db_manager *db_mgr)
+{
+	if (sync_database_file(db_mgr) != STATUS_OK)
+		return STATUS_ERROR;
+
+	// truncating, rewriting the header and flushing the log
+	count_io(db_mgr->stats, 0, 0, 3);
+	return wal_reset(db_mgr->wal);
+}
+
+/*
+ * @brief Commit the log batch, then write it to the database file. The
+ * database file is only flushed by the checkpoints, once the log grows large
+ * enough.
+ * @param db_mgr The database manager.
+ * @return The status of the operation.
+ */
+static enum status commit_log(struct db_manager *db_mgr)
+{
+	// the dirty cached entries are committed along with the other changes
+	if (sync_cache(db_mgr) != STATUS_OK)
+		return STATUS_ERROR;
+
+	struct wal_db_meta state = { .nr_slots = db_mgr->nr_slots,
+								 .nr_dead = db_mgr->nr_dead };
+
+	db_mgr->wal_pending_ops = 0;
+	if (wal_pending_bytes(db_mgr->wal) == 0)
+		return STATUS_OK;
+
+	// the batch is written and flushed to the log by two system calls
+	uint64_t log_bytes = wal_log_bytes(db_mgr->wal);
+	if (wal_commit(db_mgr->wal, &state, sizeof(state)) != STATUS_OK)
+		return STATUS_ERROR;
+	count_io(db_mgr->stats, 0, wal_log_bytes(db_mgr->wal) - log_bytes, 2);
+
+	if (wal_apply(db_mgr->wal, apply_logged_slots, apply_logged_meta,
+				  db_mgr) != STATUS_OK)
+		return STATUS_ERROR;
+
+	if (wal_log_bytes(db_mgr->wal) >= WAL_CHECKPOINT_BYTES)
+		return checkpoint_log(db_mgr);
+
+	return STATUS_OK;
+}
+
+/*
+ * @brief Finish a mutation of the database. With the log, the batch is
+ * committed once it holds the configured number of mutations or grows too
+ * large, so the mutations in between share one log write and one fsync.
+ * @param db_mgr The database manager.
+ * @param status The status of the mutation.
+ * @return The status of the mutation and of the commit.
+ */
+static enum status end_mutation(struct db_manager *db_mgr, enum status status)
+{
+	if (db_mgr->wal == NULL)
+		return status;
+
+	if (++db_mgr->wal_pending_ops >= db_mgr->wal_group_ops ||
+		wal_pending_bytes(db_mgr->wal) >= WAL_MAX_BATCH_BYTES) {
+		enum status commit_status = commit_log(db_mgr);
+		if (status == STATUS_OK)
+			status = commit_status;
+	}
+
+	return status;
+}
+
+/*
+ * @brief Open the log of the database. When opening an existing database, the
+ * batches committed before a crash are replayed into the database file.
+ * @param db_mgr The database manager.
+ * @param db_name The name of the database.
+ * @param create Whether the database was just created.
+ */
+static void open_log(struct db_manager *db_mgr, const char *db_name,
+					 bool create)
+{
+	char *path = sibling_path(db_name, WAL_FILE_EXT);
+	db_mgr->wal = wal_open(path, db_mgr->slot_size, create);
+	free(path);
+
+	// a log closed cleanly is empty
+	if (create || wal_log_bytes(db_mgr->wal) == 0)
+		return;
+
+	uint64_t nr_batches;
+	DIE(wal_recover(db_mgr->wal, apply_logged_slots, apply_logged_meta, db_mgr,
+					&nr_batches) != STATUS_OK ||
+			checkpoint_log(db_mgr) != STATUS_OK,
+		"Error recovering database");
+}
+
+// whether the blocks of an iterator point directly into the mapping
+static inline bool block_in_place(const struct block_iter *it)
+{
+	return slots_in_place(it->db_mgr) && !it->snapshot;
+}
+
+/*
+ * @brief Start iterating over a range of slots of the database or of the
+ * snapshot being read.
+ */
+static void iter_init(struct block_iter *it, struct db_manager *db_mgr,
+					  uint64_t first_idx, uint64_t end_idx, bool snapshot)
+{
+	*it = (struct block_iter){
+		.db_mgr = db_mgr,
+		.next_idx = first_idx,
+		.end_idx = end_idx < db_mgr->nr_slots ? end_idx : db_mgr->nr_slots,
+		.capacity = db_mgr->block_slots,
+		.snapshot = snapshot,
+		.status = STATUS_OK,
+	};
+
+	if (!block_in_place(it)) {
+		it->buffer = buffer_pool_get(db_mgr->buffers,
+									 it->capacity * db_mgr->slot_size);
+		if (it->buffer == NULL)
+			it->status = STATUS_ERROR;
+	}
+}
+
+void block_iter_init(struct block_iter *it, struct db_manager *db_mgr)
+{
+	iter_init(it, db_mgr, 0, db_mgr->nr_slots, false);
+}
+
+void block_iter_init_range(struct block_iter *it, struct db_manager *db_mgr,
+						   uint64_t first_idx, uint64_t end_idx)
+{
+	iter_init(it, db_mgr, first_idx, end_idx, false);
+}
+
+/*
+ * @brief Write the current block back to the database if it was modified.
+ * @param it The block iterator.
+ */
+static void block_iter_flush(struct block_iter *it)
+{
+	if (!it->dirty)
+		return;
+
+	it->dirty = false;
+	// in mmap mode the entries were modified in place
+	if (!block_in_place(it) &&
+		write_slots(it->db_mgr, (int64_t)it->first_idx, it->slots,
+					it->count) != STATUS_OK)
+		it->status = STATUS_ERROR;
+}
+
+bool block_iter_next(struct block_iter *it)
+{
+	block_iter_flush(it);
+
+	if (it->status != STATUS_OK || it->next_idx >= it->end_idx)
+		return false;
+
+	size_t count = it->end_idx - it->next_idx;
+	if (count > it->capacity)
+		count = it->capacity;
+
+	if (block_in_place(it)) {
+		it->slots = mapped_slot(it->db_mgr, (int64_t)it->next_idx);
+	} else {
+		enum status (*read_block)(struct db_manager *, int64_t, void *,
+								  size_t) =
+			it->snapshot ? read_snapshot_slots : read_slots;
+
+		it->slots = it->buffer;
+		if (read_block(it->db_mgr, (int64_t)it->next_idx, it->slots, count) !=
+			STATUS_OK) {
+			it->status = STATUS_ERROR;
+			return false;
+		}
+	}
+
+	it->first_idx = it->next_idx;
+	it->count = count;
+	it->next_idx += count;
+	count_entries(it->db_mgr, count, 0);
+	return true;
+}
+
+void *block_iter_entry(const struct block_iter *it, size_t i)
+{
+	char *slot = it->slots + i * it->db_mgr->slot_size;
+
+	return slot_is_live(slot) ? slot_entry(slot) : NULL;
+}
+
+void block_iter_mark_dirty(struct block_iter *it)
+{
+	it->dirty = true;
+}
+
+enum status block_iter_end(struct block_iter *it)
+{
+	block_iter_flush(it);
+	buffer_pool_put(it->db_mgr->buffers, it->buffer,
+					it->capacity * it->db_mgr->slot_size);
+	it->buffer = NULL;
+	it->slots = NULL;
+
+	return it->status;
+}
+
+/*
+ * @brief Create a fresh index and fill it with the keys of all the live
+ * entries in the database.
+ * @param db_mgr The database manager.
+ * @param path The path of the index file.
+ */
+static void rebuild_index(struct db_manager *db_mgr, const char *path)
+{
+	db_mgr->index =
+		hash_index_create(path, db_mgr->nr_slots - db_mgr->nr_dead);
+
+	struct block_iter it;
+	block_iter_init(&it, db_mgr);
+	while (block_iter_next(&it)) {
+		for (size_t i = 0; i < it.count; ++i) {
+			void *entry = block_iter_entry(&it, i);
+			if (entry != NULL)
+				DIE(hash_index_insert(db_mgr->index, db_mgr->key_of(entry),
+									  (int64_t)(it.first_idx + i)) !=
+						STATUS_OK,
+					"Error building index");
+		}
+	}
+	DIE(block_iter_end(&it) != STATUS_OK, "Error reading database");
+}
+
+static void index_group(struct db_manager *db_mgr, const void *entry,
+						int64_t idx)
+{
+	uint32_t id = group_index_intern(db_mgr->groups, db_mgr->group_of(entry));
+
+	group_index_insert(db_mgr->groups, id, idx);
+	if (db_mgr->measure_of != NULL) {
+		int64_t values[DB_MAX_MEASURES];
+
+		db_mgr->measure_of(entry, values);
+		group_index_add_sums(db_mgr->groups, id, values, 1);
+	}
+}
+
+/*
+ * The values of many entries, added to the order index at once after a pass
+ * over the database.
+ */
+struct order_batch {
+	int64_t *values;
+	int64_t *slots;
+	size_t len;
+	size_t capacity;
+};
+
+static void order_batch_add(struct order_batch *batch, int64_t value,
+							int64_t slot)
+{
+	if (batch->len == batch->capacity) {
+		batch->capacity = batch->capacity ? batch->capacity * 2 : 1024;
+		batch->values =
+			realloc(batch->values, batch->capacity * sizeof(*batch->values));
+		batch->slots =
+			realloc(batch->slots, batch->capacity * sizeof(*batch->slots));
+		DIE(batch->values == NULL || batch->slots == NULL,
+			"Error allocating buffer");
+	}
+	batch->values[batch->len] = value;
+	batch->slots[batch->len++] = slot;
+}
+
+static void order_batch_flush(struct order_index *oi,
+							  struct order_batch *batch)
+{
+	order_index_insert_many(oi, batch->values, batch->slots, batch->len);
+	free(batch->values);
+	free(batch->slots);
+	*batch = (struct order_batch){ 0 };
+}
+
+/*
+ * @brief Add the key of a slot to the hash index or, in a sorted database, to
+ * the delta if the slot is past the sorted run.
+ * @param db_mgr The database manager.
+ * @param key The key.
+ * @param idx The slot.
+ * @return The status of the operation.
+ */
+static enum status index_key(struct db_manager *db_mgr, int64_t key,
+							 int64_t idx)
+{
+	if (db_mgr->index != NULL)
+		return hash_index_insert(db_mgr->index, key, idx);
+	if (db_mgr->delta != NULL && idx >= (int64_t)db_mgr->nr_sorted)
+		order_index_insert(db_mgr->delta, key, idx);
+	return STATUS_OK;
+}
+
+/*
+ * @brief Remove the key of a slot from the index it was added to by
+ * index_key.
+ * @param db_mgr The database manager.
+ * @param key The key.
+ * @param idx The slot.
+ */
+static void unindex_key(struct db_manager *db_mgr, int64_t key, int64_t idx)
+{
+	if (db_mgr->index != NULL)
+		(void)hash_index_remove(db_mgr->index, key, idx);
+	else if (db_mgr->delta != NULL && idx >= (int64_t)db_mgr->nr_sorted)
+		(void)order_index_remove(db_mgr->delta, key, idx);
+}
+
+/*
+ * @brief Add the keys of the live slots in a range past the sorted run to the
+ * delta of a sorted database.
+ * @param db_mgr The database manager.
+ * @param first_idx The first slot of the range.
+ * @param end_idx The slot past the range.
+ */
+static void index_delta_range(struct db_manager *db_mgr, uint64_t first_idx,
+							  uint64_t end_idx)
+{
+	struct order_batch batch = { 0 };
+	struct block_iter it;
+
+	block_iter_init_range(&it, db_mgr, first_idx, end_idx);
+	while (block_iter_next(&it)) {
+		for (size_t i = 0; i < it.count; ++i) {
+			void *entry = block_iter_entry(&it, i);
+			if (entry != NULL)
+				order_batch_add(&batch, db_mgr->key_of(entry),
+								(int64_t)(it.first_idx + i));
+		}
+	}
+	DIE(block_iter_end(&it) != STATUS_OK, "Error reading database");
+
+	order_batch_flush(db_mgr->delta, &batch);
+}
+
+/*
+ * @brief Add an entry to the secondary(group, text and order) indexes.
+ * @param db_mgr The database manager.
+ * @param entry The entry.
+ * @param idx The index of the entry in the database.
+ * @param orders If not NULL, the value of the entry is added to this batch
+ * instead of the order index.
+ */
+static void index_secondary(struct db_manager *db_mgr, const void *entry,
+							int64_t idx, struct order_batch *orders)
+{
+	if (db_mgr->groups != NULL)
+		index_group(db_mgr, entry, idx);
+	if (db_mgr->texts != NULL)
+		text_index_insert(db_mgr->texts, db_mgr->text_of(entry), idx);
+	if (db_mgr->orders == NULL)
+		return;
+	if (orders != NULL)
+		order_batch_add(orders, db_mgr->order_of(entry), idx);
+	else
+		order_index_insert(db_mgr->orders, db_mgr->order_of(entry), idx);
+}
+
+/*
+ * @brief Fill the freshly created secondary indexes with all the live entries
+ * in the database.
+ * @param db_mgr The database manager.
+ * @param groups Whether the group index was created.
+ * @param texts Whether the text index was created.
+ * @param orders Whether the order index was created.
+ */
+static void rebuild_secondary(struct db_manager *db_mgr, bool groups,
+							  bool texts, bool orders)
+{
+	struct order_batch batch = { 0 };
+	struct block_iter it;
+
+	block_iter_init(&it, db_mgr);
+	while (block_iter_next(&it)) {
+		for (size_t i = 0; i < it.count; ++i) {
+			void *entry = block_iter_entry(&it, i);
+			if (entry == NULL)
+				continue;
+
+			int64_t idx = (int64_t)(it.first_idx + i);
+			if (groups)
+				index_group(db_mgr, entry, idx);
+			if (texts)
+				text_index_insert(db_mgr->texts, db_mgr->text_of(entry), idx);
+			if (orders)
+				order_batch_add(&batch, db_mgr->order_of(entry), idx);
+		}
+	}
+	DIE(block_iter_end(&it) != STATUS_OK, "Error reading database");
+
+	if (orders)
+		order_batch_flush(db_mgr->orders, &batch);
+}
+
+/*
+ * @brief Empty all the indexes, then fill them again with the live entries in
+ * the database, in a single pass over it.
+ * @param db_mgr The database manager.
+ */
+static void refill_indexes(struct db_manager *db_mgr)
+{
+	if (db_mgr->index != NULL) {
+		hash_index_clear(db_mgr->index);
+		hash_index_reserve(db_mgr->index, db_mgr->nr_slots - db_mgr->nr_dead);
+	}
+	if (db_mgr->groups != NULL)
+		group_index_clear(db_mgr->groups);
+	if (db_mgr->texts != NULL)
+		text_index_clear(db_mgr->texts);
+	if (db_mgr->orders != NULL)
+		order_index_clear(db_mgr->orders);
+	if (db_mgr->delta != NULL)
+		order_index_clear(db_mgr->delta);
+
+	struct order_batch batch = { 0 };
+	struct order_batch keys = { 0 };
+	struct block_iter it;
+
+	block_iter_init(&it, db_mgr);
+	while (block_iter_next(&it)) {
+		for (size_t i = 0; i < it.count; ++i) {
+			void *entry = block_iter_entry(&it, i);
+			if (entry == NULL)
+				continue;
+
+			int64_t idx = (int64_t)(it.first_idx + i);
+			if (db_mgr->index != NULL)
+				DIE(hash_index_insert(db_mgr->index, db_mgr->key_of(entry),
+									  idx) != STATUS_OK,
+					"Error building index");
+			else if (db_mgr->delta != NULL &&
+					 idx >= (int64_t)db_mgr->nr_sorted)
+				order_batch_add(&keys, db_mgr->key_of(entry), idx);
+			index_secondary(db_mgr, entry, idx, &batch);
+		}
+	}
+	DIE(block_iter_end(&it) != STATUS_OK, "Error reading database");
+
+	if (db_mgr->orders != NULL)
+		order_batch_flush(db_mgr->orders, &batch);
+	if (db_mgr->delta != NULL)
+		order_batch_flush(db_mgr->delta, &keys);
+}
+
+/*
+ * @brief Get the path of an index of the database. Each process sharing a
+ * database keeps indexes of its own, rebuilt from the entries, in files named
+ * after the process.
+ */
+static char *index_path(const struct db_manager *db_mgr, const char *db_name,
+						const char *ext)
+{
+	if (!db_mgr->shared)
+		return sibling_path(db_name, ext);
+
+	char *path;
+	DIE(asprintf(&path, "%s%s.%ld", db_name, ext, (long)getpid()) < 0,
+		"Error allocating path");
+	return path;
+}
+
+/*
+ * @brief Create empty indexes for the database.
+ * @param db_mgr The database manager.
+ * @param db_name The path of the database file.
+ */
+static void create_indexes(struct db_manager *db_mgr, const char *db_name)
+{
+	// the delta of a sorted database is rebuilt from the file when opened
+	if (db_mgr->sorted) {
+		db_mgr->delta = order_index_create(NULL);
+	} else if (db_mgr->key_of != NULL) {
+		char *path = index_path(db_mgr, db_name, INDEX_FILE_EXT);
+		db_mgr->index = hash_index_create(path, 0);
+		// the private index is only used through its mapping
+		if (db_mgr->shared)
+			(void)unlink(path);
+		free(path);
+	}
+
+	if (db_mgr->group_of != NULL) {
+		char *path = index_path(db_mgr, db_name, GROUP_INDEX_FILE_EXT);
+		db_mgr->groups = group_index_create(path, db_mgr->nr_measures);
+		free(path);
+	}
+
+	if (db_mgr->text_of != NULL) {
+		char *path = index_path(db_mgr, db_name, TEXT_INDEX_FILE_EXT);
+		db_mgr->texts = text_index_create(path);
+		free(path);
+	}
+
+	if (db_mgr->order_of != NULL) {
+		char *path = index_path(db_mgr, db_name, ORDER_INDEX_FILE_EXT);
+		db_mgr->orders = order_index_create(path);
+		free(path);
+	}
+}
+
+/*
+ * @brief Make the changes of the writer of a shared database visible to the
+ * other processes, which reload their state once they see the new generation
+ * in the header.
+ * @param db_mgr The database manager.
+ * @return The status of the operation.
+ */
+static enum status publish_changes(struct db_manager *db_mgr)
+{
+	db_mgr->changed = false;
+	++db_mgr->generation;
+	return write_file_header(db_mgr);
+}
+
+/*
+ * @brief Find the first slot of the sorted run whose key is not smaller than
+ * the given one, removed slots included, since they keep their keys. The
+ * slots are read one at a time until the slots left fit in a single read.
+ * @param db_mgr The database manager.
+ * @param key The key.
+ * @return The slot or nr_sorted if all the keys of the run are smaller.
+ */
+static uint64_t sorted_lower_bound(struct db_manager *db_mgr, int64_t key)
+{
+	uint64_t lo = 0;
+	uint64_t hi = db_mgr->nr_sorted;
+	size_t len = SORTED_WINDOW_SLOTS * db_mgr->slot_size;
+	char *slots = buffer_pool_get(db_mgr->buffers, len);
+	DIE(slots == NULL, "Error allocating buffer");
+
+	while (hi - lo > SORTED_WINDOW_SLOTS) {
+		uint64_t mid = lo + (hi - lo) / 2;
+
+		DIE(read_slots(db_mgr, (int64_t)mid, slots, 1) != STATUS_OK,
+			"Error reading database");
+		if (db_mgr->key_of(slot_entry(slots)) < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (hi > lo) {
+		uint64_t first = lo;
+
+		DIE(read_slots(db_mgr, (int64_t)first, slots, hi - lo) != STATUS_OK,
+			"Error reading database");
+		while (lo < hi && db_mgr->key_of(slot_entry(
+							  slots + (lo - first) * db_mgr->slot_size)) < key)
+			++lo;
+	}
+
+	buffer_pool_put(db_mgr->buffers, slots, len);
+	return lo;
+}
+
+/*
+ * @brief Iterate over the slots holding a key, using the hash index or, in a
+ * sorted database, a binary search of the sorted run followed by the delta.
+ * @param db_mgr The database manager.
+ * @param key The key.
+ * @param cursor The position of the iteration, 0 for the first call.
+ * @return The next slot holding the key or -1 if there are no more slots. The
+ * slots of a sorted database are returned in increasing order.
+ */
+static int64_t next_key_slot(struct db_manager *db_mgr, int64_t key,
+							 uint64_t *cursor)
+{
+	if (!db_mgr->sorted)
+		return hash_index_next(db_mgr->index, key, cursor);
+
+	// the cursor holds the next slot to look at, plus one
+	uint64_t pos = *cursor == 0 ? sorted_lower_bound(db_mgr, key) :
+								  *cursor - 1;
+
+	if (pos < db_mgr->nr_sorted) {
+		char *slot = buffer_pool_get(db_mgr->buffers, db_mgr->slot_size);
+		DIE(slot == NULL, "Error allocating buffer");
+
+		for (; pos < db_mgr->nr_sorted; ++pos) {
+			DIE(read_slots(db_mgr, (int64_t)pos, slot, 1) != STATUS_OK,
+				"Error reading database");
+			if (db_mgr->key_of(slot_entry(slot)) != key) {
+				pos = db_mgr->nr_sorted;
+				break;
+			}
+			if (slot_is_live(slot))
+				break;
+		}
+		buffer_pool_put(db_mgr->buffers, slot, db_mgr->slot_size);
+
+		if (pos < db_mgr->nr_sorted) {
+			*cursor = pos + 2;
+			return (int64_t)pos;
+		}
+	}
+
+	int64_t idx = order_index_next(db_mgr->delta, key, (int64_t)pos);
+	*cursor = idx == -1 ? pos + 1 : (uint64_t)idx + 2;
+	return idx;
+}
+
+/*
+ * @brief Shorten the sorted run of a database before the key of one of its
+ * slots is changed. The slots left out of the run are added to the delta of a
+ * sorted database, which gets merged back in later.
+ * @param db_mgr The database manager.
+ * @param idx The slot whose key changes.
+ */
+static void cut_sorted_run(struct db_manager *db_mgr, int64_t idx)
+{
+	uint64_t end = db_mgr->nr_sorted;
+
+	if ((uint64_t)idx >= end)
+		return;
+
+	// a run longer than the sorted slots must never be found in the file
+	db_mgr->nr_sorted = (uint64_t)idx;
+	DIE(write_file_header(db_mgr) != STATUS_OK, "Error writing database");
+	if (db_mgr->delta != NULL)
+		index_delta_range(db_mgr, (uint64_t)idx + 1, end);
+}
+
+/*
+ * The key of a slot of the merged chunk and its position in the chunk.
+ */
+struct merge_key {
+	int64_t key;
+	size_t pos;
+};
+
+static int compare_merge_keys(const void *a, const void *b)
+{
+	const struct merge_key *x = a;
+	const struct merge_key *y = b;
+
+	if (x->key != y->key)
+		return (x->key > y->key) - (x->key < y->key);
+	return (x->pos > y->pos) - (x->pos < y->pos);
+}
+
+/*
+ * @brief Merge the slots right after the sorted run into the run. The slots
+ * are sorted in memory, then merged with the run starting from the end, so
+ * each slot is written at or after the position it was read from and the
+ * slots of the run not read yet are never overwritten. The merge stops once
+ * the sorted slots are used up, the rest of the run being already in place.
+ * @param db_mgr The database manager.
+ * @param count The number of slots merged.
+ * @return The status of the operation.
+ */
+static enum status merge_chunk(struct db_manager *db_mgr, size_t count)
+{
+	size_t slot_size = db_mgr->slot_size;
+	size_t block = db_mgr->block_slots;
+	char *chunk = buffer_pool_get(db_mgr->buffers, count * slot_size);
+	char *in = buffer_pool_get(db_mgr->buffers, block * slot_size);
+	char *out = buffer_pool_get(db_mgr->buffers, block * slot_size);
+	struct merge_key *keys = malloc(count * sizeof(*keys));
+	DIE(keys == NULL, "Error allocating buffer");
+
+	enum status status = chunk != NULL && in != NULL && out != NULL ?
+							 STATUS_OK :
+							 STATUS_ERROR;
+	if (status == STATUS_OK)
+		status = read_slots(db_mgr, (int64_t)db_mgr->nr_sorted, chunk, count);
+
+	// the removed slots are merged too, keeping the size of the file
+	for (size_t i = 0; i < count && status == STATUS_OK; ++i)
+		keys[i] = (struct merge_key){
+			.key = db_mgr->key_of(slot_entry(chunk + i * slot_size)),
+			.pos = i
+		};
+	if (status == STATUS_OK)
+		qsort(keys, count, sizeof(*keys), compare_merge_keys);
+
+	// the slots of the run left to merge, [0, run), of which [in_first, run)
+	// are held by the input buffer, and the chunk slots left, keys[0, left)
+	uint64_t run = db_mgr->nr_sorted;
+	uint64_t in_first = run;
+	size_t left = count;
+	size_t out_len = 0;
+
+	while (left > 0 && status == STATUS_OK) {
+		if (run > 0 && in_first == run) {
+			size_t n = run < block ? (size_t)run : block;
+
+			in_first = run - n;
+			status = read_slots(db_mgr, (int64_t)in_first, in, n);
+			if (status != STATUS_OK)
+				break;
+		}
+
+		// the run goes first among equal keys
+		char *src = run > 0 ? in + (run - 1 - in_first) * slot_size : NULL;
+		if (src != NULL &&
+			db_mgr->key_of(slot_entry(src)) > keys[left - 1].key)
+			--run;
+		else
+			src = chunk + keys[--left].pos * slot_size;
+
+		// the output buffer is filled from its end
+		memcpy(out + (block - ++out_len) * slot_size, src, slot_size);
+		if (out_len == block || left == 0) {
+			status = write_slots(db_mgr, (int64_t)(run + left),
+								 out + (block - out_len) * slot_size, out_len);
+			out_len = 0;
+		}
+	}
+
+	free(keys);
+	buffer_pool_put(db_mgr->buffers, out, block * slot_size);
+	buffer_pool_put(db_mgr->buffers, in, block * slot_size);
+	buffer_pool_put(db_mgr->buffers, chunk, count * slot_size);
+	return status;
+}
+
+/*
+ * @brief Merge the delta of a sorted database into the sorted run, in chunks
+ * of at most MERGE_CHUNK_BYTES, then refill the indexes with the new positions
+ * of the slots.
+ * @param db_mgr The database manager.
+ * @return The status of the operation.
+ */
+static enum status merge_delta(struct db_manager *db_mgr)
+{
+	size_t chunk_slots = MERGE_CHUNK_BYTES / db_mgr->slot_size;
+	if (chunk_slots == 0)
+		chunk_slots = 1;
+
+	// the entries are moved to other slots
+	if (drop_cache(db_mgr) != STATUS_OK)
+		return STATUS_ERROR;
+
+	enum status status = STATUS_OK;
+	while (status == STATUS_OK && db_mgr->nr_sorted < db_mgr->nr_slots) {
+		uint64_t left = db_mgr->nr_slots - db_mgr->nr_sorted;
+		size_t count = left < chunk_slots ? (size_t)left : chunk_slots;
+
+		status = merge_chunk(db_mgr, count);
+		if (status == STATUS_OK)
+			db_mgr->nr_sorted += count;
+	}
+
+	refill_indexes(db_mgr);
+	if (write_file_header(db_mgr) != STATUS_OK)
+		status = STATUS_ERROR;
+	return status;
+}
+
+/*
+ * @brief Check if the delta of a sorted database grew large enough to be
+ * merged. The merges are put off while a snapshot is read, since they move
+ * the slots.
+ */
+static bool merge_due(const struct db_manager *db_mgr)
+{
+	uint64_t max_delta = db_mgr->nr_sorted / 8;
+
+	if (max_delta < db_mgr->delta_slots)
+		max_delta = db_mgr->delta_slots;
+	return db_mgr->sorted && db_mgr->snapshot == NULL &&
+		   db_mgr->nr_slots - db_mgr->nr_sorted > max_delta;
+}
+
+/*
+ * @brief Merge the delta of a sorted database into the sorted run once it
+ * grew large enough.
+ * @param db_mgr The database manager.
+ * @return The status of the operation.
+ */
+static enum status merge_if_due(struct db_manager *db_mgr)
+{
+	if (!merge_due(db_mgr))
+		return STATUS_OK;
+
+	// the slots are moved like by the compaction
+	lock_range(db_mgr, F_WRLCK, DB_LOCK_LAYOUT, 1);
+	enum status status = merge_delta(db_mgr);
+	if (status == STATUS_OK && db_mgr->shared)
+		status = publish_changes(db_mgr);
+	lock_range(db_mgr, F_UNLCK, DB_LOCK_LAYOUT, 1);
+
+	return status;
+}
+
+/*
+ * @brief Prepare a database for being shared with other processes once its
+ * layout is known.
+ * @param db_mgr The database manager.
+ */
+static void share_database(struct db_manager *db_mgr)
+{
+	// a group of a columnar database is locked as a whole, so the threads of
+	// a scan must not split one
+	if (db_mgr->columnar)
+		db_mgr->block_slots = (db_mgr->block_slots + DB_COLUMN_GROUP_SLOTS -
+							   1) /
+							  DB_COLUMN_GROUP_SLOTS * DB_COLUMN_GROUP_SLOTS;
+}
+
+static struct db_manager init_db_manager(FILE *db, size_t entry_size,
+										 const struct db_config *config)
+{
+	struct db_manager db_mgr = {
+		.db_file = db,
+		.entry_size = entry_size,
+		.slot_size = sizeof(struct db_slot_header) + entry_size,
+		.block_slots = DB_DEFAULT_BLOCK_SLOTS,
+		.nr_threads = 1,
+		.wal_group_ops = DB_DEFAULT_WAL_GROUP_OPS,
+		.delta_slots = DB_DEFAULT_DELTA_SLOTS,
+	};
+	const struct buffer_allocator *allocator = NULL;
+	size_t pool_bytes = DB_DEFAULT_POOL_BYTES;
+
+	if (config != NULL) {
+		db_mgr.key_of = config->key_of;
+		db_mgr.group_of = config->group_of;
+		db_mgr.text_of = config->text_of;
+		db_mgr.order_of = config->order_of;
+		db_mgr.measure_of = config->measure_of;
+		db_mgr.nr_measures = config->measure_of ? config->nr_measures : 0;
+		db_mgr.compact_percent = config->compact_dead_percent;
+		if (config->block_slots != 0)
+			db_mgr.block_slots = config->block_slots;
+		if (config->nr_threads != 0)
+			db_mgr.nr_threads = config->nr_threads;
+		db_mgr.columns = config->columns;
+		db_mgr.nr_columns = config->nr_columns;
+		if (config->wal_group_ops != 0)
+			db_mgr.wal_group_ops = config->wal_group_ops;
+		// the cache looks the entries up by key
+		if (config->cache_entries != 0 && config->key_of != NULL)
+			db_mgr.cache =
+				record_cache_create(config->cache_entries, entry_size);
+		// the other processes only see the entries written to the file
+		db_mgr.shared = config->shared;
+		db_mgr.cache_write_back = config->cache_write_back && !config->shared;
+		allocator = config->allocator;
+		db_mgr.stats = config->stats;
+		if (config->pool_bytes != 0)
+			pool_bytes = config->pool_bytes;
+		db_mgr.sorted = config->sorted;
+		if (config->delta_slots != 0)
+			db_mgr.delta_slots = config->delta_slots;
+	}
+	db_mgr.buffers = buffer_pool_create(allocator, pool_bytes);
+
+	if (db_mgr.shared && config->use_wal) {
+		errno = EINVAL;
+		DIE(true, "Shared database with a log");
+	}
+
+	// the merges rewrite the sorted run in place
+	if (db_mgr.sorted && (db_mgr.key_of == NULL || config->use_wal)) {
+		errno = EINVAL;
+		DIE(true, "Sorted database without a key function or with a log");
+	}
+
+	// the sums are kept in the group index
+	if (db_mgr.measure_of != NULL &&
+		(db_mgr.group_of == NULL || db_mgr.nr_measures == 0 ||
+		 db_mgr.nr_measures > DB_MAX_MEASURES)) {
+		errno = EINVAL;
+		DIE(true, "Measures without a group function or too many measures");
+	}
+
+	for (size_t c = 0; c < db_mgr.nr_columns; ++c) {
+		if (db_mgr.columns[c].offset + db_mgr.columns[c].size > entry_size) {
+			errno = EINVAL;
+			DIE(true, "Database column outside of the entry");
+		}
+	}
+
+	return db_mgr;
+}
+
+struct db_manager create_database(const char *db_name, size_t entry_size,
+								  const struct db_config *config)
+{
+	FILE *db = fopen(db_name, "w+b");
+	DIE(db == NULL, "Error opening database");
+
+	struct db_manager db_mgr = init_db_manager(db, entry_size, config);
+	db_mgr.path = strdup(db_name);
+	DIE(db_mgr.path == NULL, "Error allocating path");
+
+	if (config != NULL && config->columnar) {
+		if (db_mgr.nr_columns == 0) {
+			errno = EINVAL;
+			DIE(true, "Columnar database without columns");
+		}
+		db_mgr.columnar = true;
+	}
+	DIE(write_file_header(&db_mgr) != STATUS_OK, "Error writing database");
+
+	if (config != NULL && config->use_wal)
+		open_log(&db_mgr, db_name, true);
+
+	if (config != NULL && config->use_mmap)
+		map_database(&db_mgr);
+
+	if (db_mgr.shared)
+		share_database(&db_mgr);
+	create_indexes(&db_mgr, db_name);
+
+	return db_mgr;
+}
+
+struct db_manager open_database(const char *db_name, size_t entry_size,
+								const struct db_config *config)
+{
+	FILE *db = fopen(db_name, "r+b");
+	DIE(db == NULL, "Error opening database");
+
+	struct db_file_header hdr;
+	if (pread_full(NULL, fileno(db), &hdr, sizeof(hdr), 0) != STATUS_OK ||
+		memcmp(hdr.magic, DB_FILE_MAGIC, sizeof(hdr.magic)) != 0) {
+		db = upgrade_legacy_database(db_name, db, entry_size);
+		DIE(pread_full(NULL, fileno(db), &hdr, sizeof(hdr), 0) != STATUS_OK,
+			"Error reading database");
+	}
+
+	if (hdr.entry_size != entry_size) {
+		errno = EINVAL;
+		DIE(true, "Database entry size mismatch");
+	}
+
+	struct db_manager db_mgr = init_db_manager(db, entry_size, config);
+	db_mgr.path = strdup(db_name);
+	DIE(db_mgr.path == NULL, "Error allocating path");
+	uint64_t size;
+	uint64_t mtime;
+
+	// a shared database is loaded while no other process changes it
+	if (db_mgr.shared) {
+		lock_range(&db_mgr, F_WRLCK, DB_LOCK_WRITER, 1);
+		DIE(pread_full(NULL, fileno(db), &hdr, sizeof(hdr), 0) != STATUS_OK,
+			"Error reading database");
+	}
+
+	db_file_stat(db, &size, &mtime);
+	db_mgr.nr_slots = (size - sizeof(hdr)) / db_mgr.slot_size;
+	db_mgr.nr_dead = hdr.nr_dead;
+	db_mgr.generation = hdr.generation;
+	db_mgr.nr_snapshots = hdr.nr_snapshots;
+	// the changes of the keys are only tracked with a key function, and the
+	// header is not part of the log batches
+	if (db_mgr.key_of != NULL && (config == NULL || !config->use_wal))
+		db_mgr.nr_sorted = hdr.nr_sorted;
+
+	if (hdr.layout == DB_LAYOUT_COLUMNS) {
+		if (hdr.nr_columns != db_mgr.nr_columns) {
+			errno = EINVAL;
+			DIE(true, "Database columns mismatch");
+		}
+		db_mgr.columnar = true;
+		db_mgr.nr_slots = hdr.nr_slots;
+	}
+	db_mgr.file_slots = db_mgr.nr_slots;
+	if (db_mgr.nr_sorted > db_mgr.nr_slots)
+		db_mgr.nr_sorted = db_mgr.nr_slots;
+
+	if (config != NULL && config->use_wal) {
+		open_log(&db_mgr, db_name, false);
+		// the replayed batches change the database file
+		db_file_stat(db, &size, &mtime);
+	}
+
+	if (config != NULL && config->use_mmap)
+		map_database(&db_mgr);
+
+	// the indexes of the other processes may change at any time
+	if (db_mgr.shared) {
+		share_database(&db_mgr);
+		create_indexes(&db_mgr, db_name);
+		refill_indexes(&db_mgr);
+		lock_range(&db_mgr, F_UNLCK, DB_LOCK_WRITER, 1);
+		return db_mgr;
+	}
+
+	if (db_mgr.sorted) {
+		db_mgr.delta = order_index_create(NULL);
+		index_delta_range(&db_mgr, db_mgr.nr_sorted, db_mgr.nr_slots);
+	} else if (db_mgr.key_of != NULL) {
+		char *path = sibling_path(db_name, INDEX_FILE_EXT);
+		db_mgr.index = hash_index_open(path, size, mtime);
+		if (db_mgr.index == NULL)
+			rebuild_index(&db_mgr, path);
+		free(path);
+	}
+
+	bool stale_groups = false;
+	bool stale_texts = false;
+
+	if (db_mgr.group_of != NULL) {
+		char *path = sibling_path(db_name, GROUP_INDEX_FILE_EXT);
+		db_mgr.groups = group_index_open(path, db_mgr.nr_measures, size, mtime);
+		if (db_mgr.groups == NULL) {
+			db_mgr.groups = group_index_create(path, db_mgr.nr_measures);
+			stale_groups = true;
+		}
+		free(path);
+	}
+
+	if (db_mgr.text_of != NULL) {
+		char *path = sibling_path(db_name, TEXT_INDEX_FILE_EXT);
+		db_mgr.texts = text_index_open(path, size, mtime);
+		if (db_mgr.texts == NULL) {
+			db_mgr.texts = text_index_create(path);
+			stale_texts = true;
+		}
+		free(path);
+	}
+
+	bool stale_orders = false;
+
+	if (db_mgr.order_of != NULL) {
+		char *path = sibling_path(db_name, ORDER_INDEX_FILE_EXT);
+		db_mgr.orders = order_index_open(path, size, mtime);
+		if (db_mgr.orders == NULL) {
+			db_mgr.orders = order_index_create(path);
+			stale_orders = true;
+		}
+		free(path);
+	}
+
+	if (stale_groups || stale_texts || stale_orders)
+		rebuild_secondary(&db_mgr, stale_groups, stale_texts, stale_orders);
+
+	DIE(merge_if_due(&db_mgr) != STATUS_OK, "Error writing database");
+	return db_mgr;
+}
+
+static void forget_snapshot(struct db_manager *db_mgr)
+{
+	if (db_mgr->snapshot == NULL)
+		return;
+
+	snapshot_close(db_mgr->snapshot->file);
+	free(db_mgr->snapshot);
+	db_mgr->snapshot = NULL;
+}
+
+/*
+ * @brief Remove the snapshot of the database once no process reads it.
+ * @param db_mgr The database manager.
+ * @return The status of the operation.
+ */
+static enum status remove_snapshot(struct db_manager *db_mgr)
+{
+	char *path = sibling_path(db_mgr->path, SNAPSHOT_FILE_EXT);
+
+	forget_snapshot(db_mgr);
+	(void)unlink(path);
+	free(path);
+
+	// the other processes stop saving the slots they change
+	return db_mgr->shared ? write_file_header(db_mgr) : STATUS_OK;
+}
+
+void close_database(struct db_manager *db_mgr)
+{
+	if (db_mgr->db_file == NULL)
+		return;
+
+	if (db_mgr->snapshot != NULL && db_mgr->snapshot->reading)
+		DIE(close_snapshot(db_mgr) != STATUS_OK, "Error writing database");
+	forget_snapshot(db_mgr);
+
+	DIE(sync_cache(db_mgr) != STATUS_OK, "Error writing database");
+	record_cache_destroy(db_mgr->cache);
+	db_mgr->cache = NULL;
+
+	if (db_mgr->wal != NULL) {
+		DIE(commit_log(db_mgr) != STATUS_OK ||
+				checkpoint_log(db_mgr) != STATUS_OK,
+			"Error writing database log");
+		wal_close(db_mgr->wal);
+	}
+
+	// the header of a shared database is written by each change
+	if (!db_mgr->shared)
+		(void)write_file_header(db_mgr);
+
+	if (db_mgr->map != NULL)
+		(void)munmap(db_mgr->map, db_mgr->map_len);
+
+	if (db_mgr->index != NULL || db_mgr->groups != NULL ||
+		db_mgr->texts != NULL || db_mgr->orders != NULL) {
+		uint64_t size;
+		uint64_t mtime;
+
+		// the indexes record the state of the data file after the last write
+		db_file_stat(db_mgr->db_file, &size, &mtime);
+		hash_index_close(db_mgr->index, size, mtime);
+		group_index_close(db_mgr->groups, size, mtime);
+		text_index_close(db_mgr->texts, size, mtime);
+		order_index_close(db_mgr->orders, size, mtime);
+	}
+	order_index_close(db_mgr->delta, 0, 0);
+
+	if (db_mgr->shared) {
+		const char *exts[] = { GROUP_INDEX_FILE_EXT, TEXT_INDEX_FILE_EXT,
+							   ORDER_INDEX_FILE_EXT };
+
+		for (size_t i = 0; i < sizeof(exts) / sizeof(*exts); ++i) {
+			char *path = index_path(db_mgr, db_mgr->path, exts[i]);
+			(void)unlink(path);
+			free(path);
+		}
+	}
+	free(db_mgr->path);
+
+	buffer_pool_destroy(db_mgr->buffers);
+	(void)fclose(db_mgr->db_file);
+	*db_mgr = (struct db_manager){ 0 };
+}
+
+/*
+ * @brief Keep the snapshot of a shared database read by other processes, so
+ * the slots changed by this one are saved in it. A snapshot left behind by
+ * processes that ended without closing it is removed.
+ * @param db_mgr The database manager.
+ * @param hdr The file header.
+ */
+static void follow_snapshot(struct db_manager *db_mgr,
+							const struct db_file_header *hdr)
+{
+	struct db_snapshot *snap = db_mgr->snapshot;
+
+	db_mgr->nr_snapshots = hdr->nr_snapshots;
+	if (snap != NULL && snap->reading)
+		return;
+
+	if (!hdr->snapshot_open) {
+		forget_snapshot(db_mgr);
+		return;
+	}
+	if (!snapshot_readers(db_mgr)) {
+		DIE(remove_snapshot(db_mgr) != STATUS_OK, "Error writing database");
+		return;
+	}
+	if (snap != NULL && snap->id == hdr->nr_snapshots)
+		return;
+
+	forget_snapshot(db_mgr);
+	char *path = sibling_path(db_mgr->path, SNAPSHOT_FILE_EXT);
+	struct snapshot *file = snapshot_open(path);
+	free(path);
+	DIE(file == NULL, "Error opening snapshot");
+
+	snap = calloc(1, sizeof(*snap));
+	DIE(snap == NULL, "Error allocating snapshot");
+	*snap = (struct db_snapshot){ .file = file, .id = hdr->nr_snapshots };
+	db_mgr->snapshot = snap;
+}
+
+/*
+ * @brief Reload the state of a shared database changed by another process.
+ * The cached entries are dropped and the indexes are rebuilt from the entries.
+ * @param db_mgr The database manager.
+ * @param hdr The file header.
+ */
+static void reload_shared(struct db_manager *db_mgr,
+						  const struct db_file_header *hdr)
+{
+	DIE(drop_cache(db_mgr) != STATUS_OK, "Error writing database");
+	db_mgr->nr_slots = hdr->nr_slots;
+	db_mgr->file_slots = hdr->nr_slots;
+	db_mgr->nr_dead = hdr->nr_dead;
+	db_mgr->generation = hdr->generation;
+	if (db_mgr->key_of != NULL)
+		db_mgr->nr_sorted = hdr->nr_sorted;
+
+	// the file may have been grown past the mapping
+	size_t size = file_size_for(db_mgr, db_mgr->nr_slots);
+	if (db_mgr->map != NULL && size > db_mgr->map_len) {
+		void *map =
+			mremap(db_mgr->map, db_mgr->map_len, size, MREMAP_MAYMOVE);
+		count_io(db_mgr->stats, 0, 0, 1);
+		DIE(map == MAP_FAILED, "Error mapping database");
+		db_mgr->map = map;
+		db_mgr->map_len = size;
+	}
+
+	refill_indexes(db_mgr);
+}
+
+/*
+ * @brief Bring the state of a shared database up to date at the start of an
+ * operation.
+ * @param db_mgr The database manager.
+ */
+static void refresh_shared(struct db_manager *db_mgr)
+{
+	struct db_file_header hdr;
+
+	lock_range(db_mgr, F_RDLCK, 0, sizeof(hdr));
+	enum status status =
+		pread_full(db_mgr->stats, db_fd(db_mgr), &hdr, sizeof(hdr), 0);
+	lock_range(db_mgr, F_UNLCK, 0, sizeof(hdr));
+	DIE(status != STATUS_OK, "Error reading database");
+
+	if (hdr.generation != db_mgr->generation)
+		reload_shared(db_mgr, &hdr);
+	// the snapshots are only taken and removed by the writer
+	if (db_mgr->shared_write)
+		follow_snapshot(db_mgr, &hdr);
+}
+
+/*
+ * @brief Start an operation on a shared database. The changes are made by a
+ * single process at a time, while the readers only keep the compaction from
+ * moving the slots under them.
+ * @param db_mgr The database manager.
+ * @param write Whether the operation changes the database.
+ */
+static void begin_shared(struct db_manager *db_mgr, bool write)
+{
+	if (db_mgr->shared_depth++ > 0)
+		return;
+
+	db_mgr->shared_write = write;
+	lock_range(db_mgr, write ? F_WRLCK : F_RDLCK,
+			   write ? DB_LOCK_WRITER : DB_LOCK_LAYOUT, 1);
+	refresh_shared(db_mgr);
+}
+
+static void end_shared(struct db_manager *db_mgr)
+{
+	if (--db_mgr->shared_depth > 0)
+		return;
+
+	if (!db_mgr->shared_write) {
+		lock_range(db_mgr, F_UNLCK, DB_LOCK_LAYOUT, 1);
+		return;
+	}
+
+	if (db_mgr->changed)
+		DIE(publish_changes(db_mgr) != STATUS_OK, "Error writing database");
+	lock_range(db_mgr, F_UNLCK, DB_LOCK_WRITER, 1);
+}
+
+static bool op_writes(enum db_op op)
+{
+	switch (op) {
+	case DB_OP_FIND_BY_KEY:
+	case DB_OP_DUMP:
+	case DB_OP_DUMP_BY_GROUP:
+	case DB_OP_DUMP_BY_TEXT:
+	case DB_OP_DUMP_BY_RANGE:
+	case DB_OP_DUMP_SELECTION:
+	case DB_OP_DUMP_SNAPSHOT:
+	case DB_OP_SELECT:
+	case DB_OP_AGGREGATE:
+		return false;
+	default:
+		return true;
+	}
+}
+
+/*
+ * An operation of the database, ended when the variable declared by OP_SCOPE
+ * goes out of scope, whatever the path the function returns through. The
+ * operation is measured by the statistics and, on a shared database, holds
+ * the locks of its kind. Without statistics and sharing, it costs two
+ * branches.
+ */
+struct op_scope {
+	struct db_manager *db_mgr;
+};
+
+static inline struct op_scope begin_op(struct db_manager *db_mgr,
+									   enum db_op op)
+{
+	if (db_mgr->stats != NULL)
+		db_stats_begin(db_mgr->stats, op);
+	if (db_mgr->shared)
+		begin_shared(db_mgr, op_writes(op));
+	return (struct op_scope){ .db_mgr = db_mgr };
+}
+
+static inline void end_op(struct op_scope *scope)
+{
+	if (scope->db_mgr->shared)
+		end_shared(scope->db_mgr);
+	if (scope->db_mgr->stats != NULL)
+		db_stats_end(scope->db_mgr->stats);
+}
+
+#define OP_SCOPE(db_mgr, op)                                      \
+	struct op_scope _op_scope __attribute__((cleanup(end_op))) = \
+		begin_op(db_mgr, op)
+
+/*
+ * The values of an entry tracked by the indexes, saved before an update.
+ */
+struct entry_refs {
+	int64_t key;
+	int64_t group;
+	uint64_t text;
+	int64_t order;
+	// only saved when the group totals are kept
+	int64_t measures[DB_MAX_MEASURES];
+};
+
+static void save_entry_refs(const struct db_manager *db_mgr, const void *entry,
+							struct entry_refs *refs)
+{
+	refs->key = db_mgr->key_of != NULL ? db_mgr->key_of(entry) : 0;
+	refs->group = db_mgr->groups != NULL ?
+					  group_index_lookup(db_mgr->groups,
+										 db_mgr->group_of(entry)) :
+					  -1;
+	refs->text = db_mgr->texts != NULL ?
+					 text_index_hash(db_mgr->text_of(entry)) :
+					 0;
+	refs->order = db_mgr->orders != NULL ? db_mgr->order_of(entry) : 0;
+	if (db_mgr->groups != NULL && db_mgr->measure_of != NULL)
+		db_mgr->measure_of(entry, refs->measures);
+}
+
+/*
+ * @brief Check if an update changed any value of an entry tracked by the
+ * indexes. The indexes are only read, so updates of different entries may be
+ * checked in parallel.
+ * @param db_mgr The database manager.
+ * @param refs The values saved before the update.
+ * @param entry The updated entry.
+ * @return True if the entry has to be reindexed.
+ */
+static bool entry_refs_changed(const struct db_manager *db_mgr,
+							   const struct entry_refs *refs,
+							   const void *entry)
+{
+	struct entry_refs new_refs;
+
+	save_entry_refs(db_mgr, entry, &new_refs);
+	return new_refs.key != refs->key || new_refs.group != refs->group ||
+		   new_refs.text != refs->text || new_refs.order != refs->order;
+}
+
+/*
+ * @brief Move the index mappings of an entry whose key, group, text or order
+ * value was changed by an update, and move its measures between the group
+ * totals.
+ * @param db_mgr The database manager.
+ * @param idx The index of the entry in the database.
+ * @param refs The values of the entry saved before the update.
+ * @param entry The updated entry.
+ */
+static void reindex_entry(struct db_manager *db_mgr, int64_t idx,
+						  const struct entry_refs *refs, const void *entry)
+{
+	if (db_mgr->key_of != NULL) {
+		int64_t new_key = db_mgr->key_of(entry);
+
+		if (new_key != refs->key) {
+			cut_sorted_run(db_mgr, idx);
+			// the slots cut from the run may already be in the delta with
+			// their new key
+			unindex_key(db_mgr, refs->key, idx);
+			unindex_key(db_mgr, new_key, idx);
+			DIE(index_key(db_mgr, new_key, idx) != STATUS_OK,
+				"Error updating index");
+			DIE(uncache_key(db_mgr, refs->key) != STATUS_OK ||
+					uncache_key(db_mgr, new_key) != STATUS_OK,
+				"Error writing database");
+		}
+	}
+
+	if (db_mgr->groups != NULL) {
+		uint32_t new_group =
+			group_index_intern(db_mgr->groups, db_mgr->group_of(entry));
+
+		if (new_group != refs->group) {
+			(void)group_index_remove(db_mgr->groups, (uint32_t)refs->group,
+									 idx);
+			group_index_insert(db_mgr->groups, new_group, idx);
+		}
+		if (db_mgr->measure_of != NULL) {
+			int64_t values[DB_MAX_MEASURES];
+
+			db_mgr->measure_of(entry, values);
+			group_index_add_sums(db_mgr->groups, (uint32_t)refs->group,
+								 refs->measures, -1);
+			group_index_add_sums(db_mgr->groups, new_group, values, 1);
+		}
+	}
+
+	if (db_mgr->texts != NULL &&
+		text_index_hash(db_mgr->text_of(entry)) != refs->text) {
+		(void)text_index_remove(db_mgr->texts, idx);
+		text_index_insert(db_mgr->texts, db_mgr->text_of(entry), idx);
+	}
+
+	if (db_mgr->orders != NULL && db_mgr->order_of(entry) != refs->order) {
+		(void)order_index_remove(db_mgr->orders, refs->order, idx);
+		order_index_insert(db_mgr->orders, db_mgr->order_of(entry), idx);
+	}
+}
+
+/*
+ * @brief Add consecutive appended entries to all the indexes at once.
+ * @param db_mgr The database manager.
+ * @param entries The entries.
+ * @param first_idx The index of the first entry in the database.
+ * @param count The number of entries.
+ * @return The status of the operation.
+ */
+static enum status index_appended(struct db_manager *db_mgr,
+								  const char *entries, int64_t first_idx,
+								  size_t count)
+{
+	enum status status = STATUS_OK;
+
+	if (db_mgr->index != NULL) {
+		hash_index_reserve(db_mgr->index, count);
+		for (size_t i = 0; i < count; ++i) {
+			const void *entry = entries + i * db_mgr->entry_size;
+			if (hash_index_insert(db_mgr->index, db_mgr->key_of(entry),
+								  first_idx + (int64_t)i) != STATUS_OK ||
+				uncache_key(db_mgr, db_mgr->key_of(entry)) != STATUS_OK)
+				status = STATUS_ERROR;
+		}
+	}
+
+	// the appended slots are past the sorted run
+	if (db_mgr->delta != NULL) {
+		int64_t *keys = malloc(count * sizeof(*keys));
+		int64_t *slots = malloc(count * sizeof(*slots));
+		DIE(keys == NULL || slots == NULL, "Error allocating buffer");
+
+		for (size_t i = 0; i < count; ++i) {
+			keys[i] = db_mgr->key_of(entries + i * db_mgr->entry_size);
+			slots[i] = first_idx + (int64_t)i;
+			if (uncache_key(db_mgr, keys[i]) != STATUS_OK)
+				status = STATUS_ERROR;
+		}
+		order_index_insert_many(db_mgr->delta, keys, slots, count);
+		free(slots);
+		free(keys);
+	}
+
+	if (db_mgr->groups != NULL) {
+		for (size_t i = 0; i < count; ++i)
+			index_group(db_mgr, entries + i * db_mgr->entry_size,
+						first_idx + (int64_t)i);
+	}
+
+	if (db_mgr->texts != NULL) {
+		const char **texts = malloc(count * sizeof(*texts));
+		DIE(texts == NULL, "Error allocating buffer");
+
+		for (size_t i = 0; i < count; ++i)
+			texts[i] = db_mgr->text_of(entries + i * db_mgr->entry_size);
+		text_index_insert_many(db_mgr->texts, texts, first_idx, count);
+		free(texts);
+	}
+
+	if (db_mgr->orders != NULL) {
+		int64_t *values = malloc(count * sizeof(*values));
+		int64_t *slots = malloc(count * sizeof(*slots));
+		DIE(values == NULL || slots == NULL, "Error allocating buffer");
+
+		for (size_t i = 0; i < count; ++i) {
+			values[i] = db_mgr->order_of(entries + i * db_mgr->entry_size);
+			slots[i] = first_idx + (int64_t)i;
+		}
+		order_index_insert_many(db_mgr->orders, values, slots, count);
+		free(slots);
+		free(values);
+	}
+
+	return status;
+}
+
+/*
+ * @brief Find the index of the entry in the database
+ * @param db_mgr - the database manager
+ * @param criteria - the criteria to match
+ * @param matches_crit - the function to match the criteria
+ * @return the index of the entry in the database or -1 if the entry is not
+ * found
+ */
+static int64_t find_entry_idx(struct db_manager *db_mgr, const void *criteria,
+							  match_crit_func matches_crit)
+{
+	struct block_iter it;
+	int64_t found = -1;
+
+	block_iter_init(&it, db_mgr);
+	while (found == -1 && block_iter_next(&it)) {
+		for (size_t i = 0; i < it.count; ++i) {
+			void *entry = block_iter_entry(&it, i);
+			if (entry != NULL && matches_crit(entry, criteria)) {
+				found = (int64_t)(it.first_idx + i);
+				break;
+			}
+		}
+	}
+
+	if (block_iter_end(&it) != STATUS_OK)
+		return -1;
+
+	if (found != -1)
+		count_entries(db_mgr, 0, 1);
+	return found;
+}
+
+/*
+ * @brief Find the lowest index of an entry holding the key using the hash
+ * index or the sorted run.
+ * @param db_mgr - the database manager
+ * @param key - the key to look up
+ * @param count - set to the number of entries holding the key
+ * @return the index of the entry in the database or -1 if the entry is not
+ * found
+ */
+static int64_t find_key_idx(struct db_manager *db_mgr, int64_t key,
+							size_t *count)
+{
+	uint64_t cursor = 0;
+	int64_t first = -1;
+	int64_t idx;
+
+	*count = 0;
+	while ((idx = next_key_slot(db_mgr, key, &cursor)) != -1) {
+		if (first == -1 || idx < first)
+			first = idx;
+		++*count;
+	}
+
+	return first;
+}
+
+/*
+ * @brief Write a new slot at the end of a columnar database, allocating a new
+ * group if the last one is full.
+ * @param db_mgr The database manager.
+ * @param entry The entry of the slot.
+ * @return The status of the operation.
+ */
+static enum status append_slot_columns(struct db_manager *db_mgr,
+									   const void *entry)
+{
+	uint64_t idx = db_mgr->nr_slots;
+	enum status status = STATUS_OK;
+
+	if (idx % DB_COLUMN_GROUP_SLOTS == 0) {
+		off_t size = file_size_for(db_mgr, idx + 1);
+		if (db_mgr->map != NULL)
+			status = resize_mapped_file(db_mgr, size);
+		else if (truncate_file(db_mgr, size) != 0)
+			status = STATUS_ERROR;
+		if (status != STATUS_OK)
+			return status;
+	}
+
+	char *slot = live_slot(db_mgr, entry);
+	if (slot == NULL)
+		return STATUS_ERROR;
+
+	status = write_slots(db_mgr, (int64_t)idx, slot, 1);
+	buffer_pool_put(db_mgr->buffers, slot, db_mgr->slot_size);
+	if (status != STATUS_OK)
+		return status;
+
+	// the number of slots is only known from the header
+	++db_mgr->nr_slots;
+	status = write_file_header(db_mgr);
+	--db_mgr->nr_slots;
+
+	return status;
+}
+
+enum status commit_database(struct db_manager *db_mgr)
+{
+	OP_SCOPE(db_mgr, DB_OP_COMMIT);
+
+	if (db_mgr->wal != NULL)
+		return commit_log(db_mgr);
+
+	if (sync_cache(db_mgr) != STATUS_OK)
+		return STATUS_ERROR;
+	return sync_database_file(db_mgr);
+}
+
+enum status append_entry(struct db_manager *db_mgr, const void *entry)
+{
+	OP_SCOPE(db_mgr, DB_OP_APPEND);
+	struct db_slot_header slot_hdr = { 0 };
+	int64_t idx = (int64_t)db_mgr->nr_slots;
+
+	if (db_mgr->wal != NULL) {
+		char *slot = live_slot(db_mgr, entry);
+		if (slot == NULL)
+			return STATUS_ERROR;
+
+		(void)write_slots(db_mgr, idx, slot, 1);
+		buffer_pool_put(db_mgr->buffers, slot, db_mgr->slot_size);
+	} else if (db_mgr->columnar) {
+		enum status status = append_slot_columns(db_mgr, entry);
+		if (status != STATUS_OK)
+			return status;
+	} else if (db_mgr->map != NULL) {
+		if (resize_mapped_file(db_mgr, slot_offset(db_mgr, idx + 1)) !=
+			STATUS_OK)
+			return STATUS_ERROR;
+
+		char *slot = mapped_slot(db_mgr, idx);
+		memcpy(slot, &slot_hdr, sizeof(slot_hdr));
+		memcpy(slot_entry(slot), entry, db_mgr->entry_size);
+		count_io(db_mgr->stats, 0, db_mgr->slot_size, 0);
+		db_mgr->changed = true;
+	} else {
+		struct iovec iov[] = {
+			{ .iov_base = &slot_hdr, .iov_len = sizeof(slot_hdr) },
+			{ .iov_base = (void *)entry, .iov_len = db_mgr->entry_size },
+		};
+
+		count_io(db_mgr->stats, 0, db_mgr->slot_size, 1);
+		if (pwritev(db_fd(db_mgr), iov, 2, slot_offset(db_mgr, idx)) !=
+			(ssize_t)db_mgr->slot_size)
+			return STATUS_ERROR;
+		db_mgr->changed = true;
+	}
+
+	++db_mgr->nr_slots;
+
+	index_secondary(db_mgr, entry, idx, NULL);
+
+	enum status status = STATUS_OK;
+	if (db_mgr->key_of != NULL) {
+		status = index_key(db_mgr, db_mgr->key_of(entry), idx);
+		if (status == STATUS_OK)
+			status = uncache_key(db_mgr, db_mgr->key_of(entry));
+	}
+
+	status = end_mutation(db_mgr, status);
+	// the delta is merged into the sorted run once it grows too large
+	if (status == STATUS_OK)
+		status = merge_if_due(db_mgr);
+	return status;
+}
+
+enum status append_entries(struct db_manager *db_mgr, const void *entries,
+						   size_t count)
+{
+	OP_SCOPE(db_mgr, DB_OP_APPEND_BATCH);
+	int64_t first_idx = (int64_t)db_mgr->nr_slots;
+	enum status status = STATUS_OK;
+
+	if (count == 0)
+		return STATUS_OK;
+
+	// without the log, the file is grown once for all the entries; the log
+	// grows it as its batches are applied
+	if (db_mgr->wal == NULL && (db_mgr->map != NULL || db_mgr->columnar)) {
+		off_t size = file_size_for(db_mgr, db_mgr->nr_slots + count);
+		if (db_mgr->map != NULL)
+			status = resize_mapped_file(db_mgr, size);
+		else if (truncate_file(db_mgr, size) != 0)
+			status = STATUS_ERROR;
+		if (status != STATUS_OK)
+			return status;
+	}
+
+	size_t chunk_slots = APPEND_CHUNK_BYTES / db_mgr->slot_size;
+	if (chunk_slots == 0)
+		chunk_slots = 1;
+	if (chunk_slots > count)
+		chunk_slots = count;
+
+	char *slots = buffer_pool_get(db_mgr->buffers,
+								  chunk_slots * db_mgr->slot_size);
+	if (slots == NULL)
+		return STATUS_ERROR;
+	memset(slots, 0, chunk_slots * db_mgr->slot_size);
+
+	const char *entry = entries;
+	for (size_t done = 0; done < count && status == STATUS_OK;) {
+		size_t n = count - done < chunk_slots ? count - done : chunk_slots;
+
+		// the slot headers stay zeroed(live) from the initialization
+		for (size_t i = 0; i < n; ++i, entry += db_mgr->entry_size)
+			memcpy(slot_entry(slots + i * db_mgr->slot_size), entry,
+				   db_mgr->entry_size);
+
+		status = write_slots(db_mgr, (int64_t)db_mgr->nr_slots, slots, n);
+		if (status != STATUS_OK)
+			break;
+		db_mgr->nr_slots += n;
+		done += n;
+
+		// a large import is split into several log batches
+		if (db_mgr->wal != NULL &&
+			wal_pending_bytes(db_mgr->wal) >= WAL_MAX_BATCH_BYTES)
+			status = commit_log(db_mgr);
+	}
+	buffer_pool_put(db_mgr->buffers, slots, chunk_slots * db_mgr->slot_size);
+
+	// the number of slots of a columnar database is only known from the
+	// header, which is written by the log commits otherwise
+	if (db_mgr->columnar && db_mgr->wal == NULL) {
+		enum status hdr_status = write_file_header(db_mgr);
+		if (status == STATUS_OK)
+			status = hdr_status;
+	}
+
+	// index whatever was written, even if the append stopped early
+	enum status index_status =
+		index_appended(db_mgr, entries, first_idx,
+					   (size_t)((int64_t)db_mgr->nr_slots - first_idx));
+	if (status == STATUS_OK)
+		status = index_status;
+
+	status = end_mutation(db_mgr, status);
+	if (status == STATUS_OK)
+		status = merge_if_due(db_mgr);
+	return status;
+}
+
+/*
+ * @brief Get the number of threads a scan over the whole database should use.
+ * Small databases are scanned by a single thread, since every thread should
+ * get at least a full block.
+ * @param db_mgr The database manager.
+ * @return The number of threads.
+ */
+static unsigned scan_threads(const struct db_manager *db_mgr)
+{
+	uint64_t nr_blocks =
+		(db_mgr->nr_slots + db_mgr->block_slots - 1) / db_mgr->block_slots;
+
+	if (nr_blocks == 0)
+		return 1;
+	return nr_blocks < db_mgr->nr_threads ? (unsigned)nr_blocks :
+											db_mgr->nr_threads;
+}
+
+struct entry_change {
+	int64_t idx;
+	struct entry_refs refs;
+};
+
+/*
+ * A range of slots updated by update_entries. The indexes are not thread safe,
+ * so the entries whose indexed values were changed by the update are collected
+ * and reindexed after all the ranges are done. The changes of the measures of
+ * the other entries are summed up per group, in the range's own totals, and
+ * added to the group totals at the end.
+ */
+struct update_task {
+	struct db_manager *db_mgr;
+	uint64_t first_idx;
+	uint64_t end_idx;
+	const void *criteria;
+	match_crit_func should_update;
+	const void *update_val;
+	update_func update;
+	// replaces should_update and update when set
+	const struct scan_kernel *kernel;
+
+	struct entry_change *changes;
+	size_t nr_changes;
+	size_t changes_cap;
+	// nr_measures changes for each of the nr_groups groups in the index at
+	// the start
+	int64_t *deltas;
+	uint32_t nr_groups;
+	uint64_t nr_updated;
+	enum status status;
+};
+
+/*
+ * @brief Record an entry updated by an update task: its measures are added to
+ * the totals of the task or, if its indexed values changed, it is collected
+ * for reindexing.
+ * @param task The update task.
+ * @param idx The index of the entry in the database.
+ * @param refs The values of the entry saved before the update.
+ * @param entry The updated entry.
+ */
+static void track_update(struct update_task *task, int64_t idx,
+						 const struct entry_refs *refs, const void *entry)
+{
+	struct db_manager *db_mgr = task->db_mgr;
+
+	++task->nr_updated;
+	if (!entry_refs_changed(db_mgr, refs, entry)) {
+		if (task->deltas != NULL) {
+			int64_t values[DB_MAX_MEASURES];
+			int64_t *delta = task->deltas + refs->group * db_mgr->nr_measures;
+
+			db_mgr->measure_of(entry, values);
+			for (size_t m = 0; m < db_mgr->nr_measures; ++m)
+				delta[m] += values[m] - refs->measures[m];
+		}
+		return;
+	}
+
+	if (task->nr_changes == task->changes_cap) {
+		task->changes_cap = task->changes_cap ? task->changes_cap * 2 : 16;
+		task->changes = realloc(task->changes,
+								task->changes_cap * sizeof(*task->changes));
+		DIE(task->changes == NULL, "Error allocating buffer");
+	}
+	task->changes[task->nr_changes++] =
+		(struct entry_change){ .idx = idx, .refs = *refs };
+}
+
+/*
+ * @brief Update the current block of an update task through its kernel: the
+ * matching slots are selected in a single call, the live ones among them are
+ * updated in another and then tracked.
+ * @param task The update task.
+ * @param it The block iterator.
+ * @param selected Room for the positions of the slots of a block.
+ * @param refs Room for the saved values of the entries of a block.
+ */
+static void update_block(struct update_task *task, struct block_iter *it,
+						 uint32_t *selected, struct entry_refs *refs)
+{
+	struct db_manager *db_mgr = task->db_mgr;
+	// the selection also sees the removed entries, which are left out after
+	size_t count = task->kernel->select(slot_entry(it->slots), it->count,
+										db_mgr->slot_size, task->criteria,
+										selected);
+	size_t live = 0;
+
+	for (size_t j = 0; j < count; ++j) {
+		void *entry = block_iter_entry(it, selected[j]);
+		if (entry == NULL)
+			continue;
+
+		save_entry_refs(db_mgr, entry, &refs[live]);
+		selected[live++] = selected[j];
+	}
+	if (live == 0)
+		return;
+
+	task->kernel->update(slot_entry(it->slots), db_mgr->slot_size, selected,
+						 live, task->update_val);
+	block_iter_mark_dirty(it);
+
+	for (size_t j = 0; j < live; ++j)
+		track_update(task, (int64_t)(it->first_idx + selected[j]), &refs[j],
+					 block_iter_entry(it, selected[j]));
+}
+
+static void *update_range(void *arg)
+{
+	struct update_task *task = arg;
+	struct db_manager *db_mgr = task->db_mgr;
+	uint32_t *selected = NULL;
+	struct entry_refs *refs = NULL;
+	struct block_iter it;
+
+	if (task->kernel != NULL) {
+		selected = malloc(db_mgr->block_slots * sizeof(*selected));
+		refs = malloc(db_mgr->block_slots * sizeof(*refs));
+		DIE(selected == NULL || refs == NULL, "Error allocating buffer");
+	}
+
+	block_iter_init_range(&it, db_mgr, task->first_idx, task->end_idx);
+	while (block_iter_next(&it)) {
+		if (task->kernel != NULL) {
+			update_block(task, &it, selected, refs);
+			continue;
+		}
+
+		for (size_t i = 0; i < it.count; ++i) {
+			void *entry = block_iter_entry(&it, i);
+			if (entry == NULL || !task->should_update(entry, task->criteria))
+				continue;
+
+			struct entry_refs refs_before;
+			save_entry_refs(db_mgr, entry, &refs_before);
+
+			task->update(entry, task->update_val);
+			block_iter_mark_dirty(&it);
+			track_update(task, (int64_t)(it.first_idx + i), &refs_before,
+						 entry);
+		}
+	}
+
+	task->status = block_iter_end(&it);
+	free(selected);
+	free(refs);
+	return NULL;
+}
+
+/*
+ * @brief Reindex the entries whose indexed values were changed by an update
+ * task and release the collected changes.
+ * @param task The update task.
+ */
+static void apply_entry_changes(struct update_task *task)
+{
+	struct db_manager *db_mgr = task->db_mgr;
+	char *slot = NULL;
+
+	if (task->deltas != NULL) {
+		for (uint32_t id = 0; id < task->nr_groups; ++id)
+			group_index_add_sums(db_mgr->groups, id,
+								 task->deltas + id * db_mgr->nr_measures, 1);
+		free(task->deltas);
+		task->deltas = NULL;
+	}
+
+	if (task->nr_changes > 0) {
+		slot = buffer_pool_get(db_mgr->buffers, db_mgr->slot_size);
+		DIE(slot == NULL, "Error allocating buffer");
+	}
+
+	for (size_t i = 0; i < task->nr_changes; ++i) {
+		const struct entry_change *change = &task->changes[i];
+
+		DIE(read_slots(db_mgr, change->idx, slot, 1) != STATUS_OK,
+			"Error reading database");
+		reindex_entry(db_mgr, change->idx, &change->refs, slot_entry(slot));
+	}
+
+	buffer_pool_put(db_mgr->buffers, slot, db_mgr->slot_size);
+	free(task->changes);
+	task->changes = NULL;
+	task->nr_changes = 0;
+}
+
+/*
+ * @brief Update the entries of the database in a single scan, split in
+ * contiguous ranges scanned in parallel.
+ * @param db_mgr The database manager.
+ * @param update How the entries are selected and updated, copied to the task
+ * of each range.
+ * @return The status of the operation.
+ */
+static enum status scan_update(struct db_manager *db_mgr,
+							   const struct update_task *update)
+{
+	// the scan changes the entries in place, without going through the cache
+	if (drop_cache(db_mgr) != STATUS_OK)
+		return STATUS_ERROR;
+
+	unsigned nr_threads = scan_threads(db_mgr);
+	struct update_task *tasks = calloc(nr_threads, sizeof(*tasks));
+	DIE(tasks == NULL, "Error allocating update tasks");
+	uint32_t nr_groups = db_mgr->groups != NULL && db_mgr->measure_of != NULL ?
+							 group_index_nr_groups(db_mgr->groups) :
+							 0;
+
+	pthread_t *threads = calloc(nr_threads, sizeof(*threads));
+	DIE(threads == NULL, "Error allocating threads");
+
+	// split the database in contiguous ranges of whole blocks
+	uint64_t nr_blocks =
+		(db_mgr->nr_slots + db_mgr->block_slots - 1) / db_mgr->block_slots;
+	for (unsigned t = 0; t < nr_threads; ++t) {
+		tasks[t] = *update;
+		tasks[t].db_mgr = db_mgr;
+		tasks[t].first_idx = nr_blocks * t / nr_threads * db_mgr->block_slots;
+		tasks[t].end_idx =
+			nr_blocks * (t + 1) / nr_threads * db_mgr->block_slots;
+		tasks[t].nr_groups = nr_groups;
+		if (nr_groups > 0) {
+			tasks[t].deltas = calloc((size_t)nr_groups * db_mgr->nr_measures,
+									 sizeof(*tasks[t].deltas));
+			DIE(tasks[t].deltas == NULL, "Error allocating group totals");
+		}
+	}
+
+	// the calling thread handles the first range
+	for (unsigned t = 1; t < nr_threads; ++t)
+		DIE(pthread_create(&threads[t], NULL, update_range, &tasks[t]) != 0,
+			"Error creating thread");
+	update_range(&tasks[0]);
+
+	for (unsigned t = 1; t < nr_threads; ++t)
+		(void)pthread_join(threads[t], NULL);
+
+	enum status status = STATUS_OK;
+	for (unsigned t = 0; t < nr_threads; ++t) {
+		apply_entry_changes(&tasks[t]);
+		count_entries(db_mgr, 0, tasks[t].nr_updated);
+		if (tasks[t].status != STATUS_OK)
+			status = tasks[t].status;
+	}
+
+	free(threads);
+	free(tasks);
+	return end_mutation(db_mgr, status);
+}
+
+enum status update_entries(struct db_manager *db_mgr, const void *criteria,
+						   match_crit_func should_update,
+						   const void *update_val, update_func update)
+{
+	OP_SCOPE(db_mgr, DB_OP_UPDATE);
+
+	struct update_task task = { .criteria = criteria,
+								.should_update = should_update,
+								.update_val = update_val,
+								.update = update };
+	return scan_update(db_mgr, &task);
+}
+
+enum status update_entries_with(struct db_manager *db_mgr,
+								const void *criteria, const void *update_val,
+								const struct scan_kernel *kernel)
+{
+	OP_SCOPE(db_mgr, DB_OP_UPDATE);
+
+	struct update_task task = { .criteria = criteria,
+								.update_val = update_val,
+								.kernel = kernel };
+	return scan_update(db_mgr, &task);
+}
+
+/*
+ * A range of slots aggregated by fold_entries into its own partial result.
+ */
+struct fold_task {
+	struct db_manager *db_mgr;
+	uint64_t first_idx;
+	uint64_t end_idx;
+	void *partial;
+	const void *fold_val;
+	fold_func fold;
+
+	uint64_t nr_folded;
+	enum status status;
+};
+
+static void *fold_range(void *arg)
+{
+	struct fold_task *task = arg;
+	struct block_iter it;
+
+	block_iter_init_range(&it, task->db_mgr, task->first_idx, task->end_idx);
+	while (block_iter_next(&it)) {
+		for (size_t i = 0; i < it.count; ++i) {
+			const void *entry = block_iter_entry(&it, i);
+			if (entry == NULL)
+				continue;
+
+			task->fold(task->partial, entry, task->fold_val);
+			++task->nr_folded;
+		}
+	}
+
+	task->status = block_iter_end(&it);
+	return NULL;
+}
+
+enum status fold_entries(struct db_manager *db_mgr, void *result,
+						 size_t partial_size, const void *fold_val,
+						 fold_func fold, merge_func merge)
+{
+	OP_SCOPE(db_mgr, DB_OP_AGGREGATE);
+
+	if (sync_cache(db_mgr) != STATUS_OK)
+		return STATUS_ERROR;
+
+	unsigned nr_threads = scan_threads(db_mgr);
+	struct fold_task *tasks = calloc(nr_threads, sizeof(*tasks));
+	DIE(tasks == NULL, "Error allocating aggregation tasks");
+
+	pthread_t *threads = calloc(nr_threads, sizeof(*threads));
+	DIE(threads == NULL, "Error allocating threads");
+
+	// split the database in contiguous ranges of whole blocks
+	uint64_t nr_blocks =
+		(db_mgr->nr_slots + db_mgr->block_slots - 1) / db_mgr->block_slots;
+	for (unsigned t = 0; t < nr_threads; ++t) {
+		tasks[t] = (struct fold_task){
+			.db_mgr = db_mgr,
+			.first_idx = nr_blocks * t / nr_threads * db_mgr->block_slots,
+			.end_idx = nr_blocks * (t + 1) / nr_threads * db_mgr->block_slots,
+			.partial = t == 0 ? result : calloc(1, partial_size),
+			.fold_val = fold_val,
+			.fold = fold,
+		};
+		DIE(tasks[t].partial == NULL, "Error allocating partial result");
+	}
+
+	// the calling thread handles the first range
+	for (unsigned t = 1; t < nr_threads; ++t)
+		DIE(pthread_create(&threads[t], NULL, fold_range, &tasks[t]) != 0,
+			"Error creating thread");
+	fold_range(&tasks[0]);
+
+	for (unsigned t = 1; t < nr_threads; ++t)
+		(void)pthread_join(threads[t], NULL);
+
+	enum status status = STATUS_OK;
+	for (unsigned t = 0; t < nr_threads; ++t) {
+		if (t > 0) {
+			merge(result, tasks[t].partial);
+			free(tasks[t].partial);
+		}
+		count_entries(db_mgr, 0, tasks[t].nr_folded);
+		if (tasks[t].status != STATUS_OK)
+			status = tasks[t].status;
+	}
+
+	free(threads);
+	free(tasks);
+	return status;
+}
+
+enum status visit_group_totals(struct db_manager *db_mgr,
+							   group_totals_func visit, void *ctx)
+{
+	OP_SCOPE(db_mgr, DB_OP_AGGREGATE);
+
+	if (db_mgr->groups == NULL || db_mgr->measure_of == NULL)
+		return STATUS_ERROR;
+	// the names are read from the file
+	if (sync_cache(db_mgr) != STATUS_OK)
+		return STATUS_ERROR;
+
+	char *slot = buffer_pool_get(db_mgr->buffers, db_mgr->slot_size);
+	if (slot == NULL)
+		return STATUS_ERROR;
+
+	enum status status = STATUS_OK;
+	for (uint32_t id = 0; id < group_index_nr_groups(db_mgr->groups); ++id) {
+		size_t count;
+		const int64_t *slots = group_index_slots(db_mgr->groups, id, &count);
+		if (count == 0)
+			continue;
+
+		// the group is named like its first live entry, in file order, even
+		// if the entries first seen with it were removed since
+		status = read_slots(db_mgr, slots[0], slot, 1);
+		if (status != STATUS_OK)
+			break;
+		visit(ctx, db_mgr->group_of(slot_entry(slot)), count,
+			  group_index_sums(db_mgr->groups, id));
+	}
+
+	buffer_pool_put(db_mgr->buffers, slot, db_mgr->slot_size);
+	return status;
+}
+
+/*
+ * @brief Move the live slots of the database, in order, to the start of a
+ * database file, refilling the indexes with their new positions.
+ * @param db_mgr The database manager.
+ * @param dst The database the slots are written to, either db_mgr itself or a
+ * new database.
+ * @param nr_live Set to the number of live slots.
+ * @param nr_sorted Set to the number of live slots of the sorted run, which
+ * stay sorted at the start of the file.
+ * @return The status of the operation.
+ */
+static enum status pack_live_slots(struct db_manager *db_mgr,
+								   struct db_manager *dst, uint64_t *nr_live,
+								   uint64_t *nr_sorted)
+{
+	size_t slot_size = db_mgr->slot_size;
+	uint64_t write_idx = 0;
+	struct order_batch orders = { 0 };
+	struct order_batch keys = { 0 };
+	struct block_iter it;
+
+	// the live entries are moved, so the indexes are refilled along the way
+	*nr_sorted = 0;
+	if (db_mgr->index != NULL)
+		hash_index_clear(db_mgr->index);
+	if (db_mgr->delta != NULL)
+		order_index_clear(db_mgr->delta);
+	if (db_mgr->groups != NULL)
+		group_index_clear(db_mgr->groups);
+	if (db_mgr->texts != NULL)
+		text_index_clear(db_mgr->texts);
+	if (db_mgr->orders != NULL)
+		order_index_clear(db_mgr->orders);
+
+	// the live slots of each block are packed at the start of the block and
+	// then written right after the slots kept so far, which never overlaps a
+	// block that was not read yet
+	block_iter_init(&it, db_mgr);
+	while (block_iter_next(&it)) {
+		size_t live = 0;
+		for (size_t i = 0; i < it.count; ++i) {
+			char *slot = it.slots + i * slot_size;
+			if (!slot_is_live(slot))
+				continue;
+
+			if (live != i)
+				memmove(it.slots + live * slot_size, slot, slot_size);
+			if (db_mgr->index != NULL)
+				DIE(hash_index_insert(db_mgr->index,
+									  db_mgr->key_of(slot_entry(slot)),
+									  (int64_t)(write_idx + live)) != STATUS_OK,
+					"Error updating index");
+			if (it.first_idx + i < db_mgr->nr_sorted)
+				++*nr_sorted;
+			else if (db_mgr->delta != NULL)
+				order_batch_add(&keys, db_mgr->key_of(slot_entry(slot)),
+								(int64_t)(write_idx + live));
+			index_secondary(db_mgr, slot_entry(slot),
+							(int64_t)(write_idx + live), &orders);
+			++live;
+		}
+
+		bool moved = dst != db_mgr || write_idx != it.first_idx ||
+					 live != it.count;
+		if (live > 0 && moved &&
+			write_slots(dst, (int64_t)write_idx, it.slots, live) !=
+				STATUS_OK) {
+			it.status = STATUS_ERROR;
+			break;
+		}
+		write_idx += live;
+	}
+
+	if (db_mgr->orders != NULL)
+		order_batch_flush(db_mgr->orders, &orders);
+	if (db_mgr->delta != NULL)
+		order_batch_flush(db_mgr->delta, &keys);
+	*nr_live = write_idx;
+	return block_iter_end(&it);
+}
+
+static enum status sync_parent_dir(const char *path)
+{
+	const char *slash = strrchr(path, '/');
+	char *dir = slash == NULL ? strdup(".") :
+								strndup(path, slash == path ? 1 : slash - path);
+	DIE(dir == NULL, "Error allocating path");
+
+	int fd = open(dir, O_RDONLY | O_DIRECTORY);
+	free(dir);
+	if (fd < 0)
+		return STATUS_ERROR;
+
+	enum status status = fsync(fd) == 0 ? STATUS_OK : STATUS_ERROR;
+	(void)close(fd);
+	return status;
+}
+
+/*
+ * @brief Compact a database by moving its live slots to the start of its file,
+ * then truncating the file.
+ * @param db_mgr The database manager.
+ * @return The status of the operation.
+ */
+static enum status compact_in_place(struct db_manager *db_mgr)
+{
+	uint64_t nr_live;
+	uint64_t nr_sorted;
+	if (pack_live_slots(db_mgr, db_mgr, &nr_live, &nr_sorted) != STATUS_OK)
+		return STATUS_ERROR;
+
+	off_t size = file_size_for(db_mgr, nr_live);
+	if (db_mgr->map != NULL) {
+		if (resize_mapped_file(db_mgr, size) != STATUS_OK)
+			return STATUS_ERROR;
+	} else if (truncate_file(db_mgr, size) != 0) {
+		return STATUS_ERROR;
+	}
+
+	db_mgr->nr_slots = nr_live;
+	db_mgr->nr_dead = 0;
+	db_mgr->nr_sorted = nr_sorted;
+	return write_file_header(db_mgr);
+}
+
+/*
+ * @brief Compact a database with a log by copying its live slots to a new file,
+ * which then replaces the database file. A crash leaves either the old or the
+ * compacted file in place, both consistent with the empty log.
+ * @param db_mgr The database manager.
+ * @return The status of the operation.
+ */
+static enum status compact_to_copy(struct db_manager *db_mgr)
+{
+	// the copy starts from a database file holding all the mutations
+	if (commit_log(db_mgr) != STATUS_OK || checkpoint_log(db_mgr) != STATUS_OK)
+		return STATUS_ERROR;
+
+	char *tmp_path = sibling_path(db_mgr->path, TMP_FILE_EXT);
+	FILE *tmp = fopen(tmp_path, "w+b");
+	DIE(tmp == NULL, "Error creating temporary database");
+
+	struct db_manager copy = init_db_manager(tmp, db_mgr->entry_size, NULL);
+	copy.columnar = db_mgr->columnar;
+	copy.columns = db_mgr->columns;
+	copy.nr_columns = db_mgr->nr_columns;
+	// the copy is written with the buffers of the database
+	buffer_pool_destroy(copy.buffers);
+	copy.buffers = db_mgr->buffers;
+	copy.stats = db_mgr->stats;
+
+	// the header of a database with a log does not track the sorted run
+	uint64_t nr_live;
+	uint64_t nr_sorted;
+	enum status status = pack_live_slots(db_mgr, &copy, &nr_live, &nr_sorted);
+
+	copy.nr_slots = nr_live;
+	if (status == STATUS_OK &&
+		(truncate_file(&copy, file_size_for(&copy, nr_live)) != 0 ||
+		 write_file_header(&copy) != STATUS_OK || fdatasync(fileno(tmp)) != 0))
+		status = STATUS_ERROR;
+	count_io(db_mgr->stats, 0, 0, 1);
+	(void)fclose(tmp);
+
+	if (status == STATUS_OK && rename(tmp_path, db_mgr->path) != 0)
+		status = STATUS_ERROR;
+	if (status != STATUS_OK) {
+		(void)unlink(tmp_path);
+		free(tmp_path);
+		return status;
+	}
+	free(tmp_path);
+
+	bool mapped = db_mgr->map != NULL;
+	if (mapped)
+		(void)munmap(db_mgr->map, db_mgr->map_len);
+	db_mgr->map = NULL;
+	(void)fclose(db_mgr->db_file);
+
+	db_mgr->db_file = fopen(db_mgr->path, "r+b");
+	DIE(db_mgr->db_file == NULL, "Error opening database");
+	db_mgr->nr_slots = nr_live;
+	db_mgr->file_slots = nr_live;
+	db_mgr->nr_dead = 0;
+	if (mapped)
+		map_database(db_mgr);
+
+	return sync_parent_dir(db_mgr->path);
+}
+
+enum status compact_database(struct db_manager *db_mgr)
+{
+	OP_SCOPE(db_mgr, DB_OP_COMPACT);
+
+	// the snapshot refers to the slots by their position
+	if (db_mgr->snapshot != NULL) {
+		errno = EBUSY;
+		return STATUS_ERROR;
+	}
+
+	// the entries are moved to other slots
+	if (drop_cache(db_mgr) != STATUS_OK)
+		return STATUS_ERROR;
+
+	if (db_mgr->wal != NULL)
+		return compact_to_copy(db_mgr);
+
+	// the readers of a shared database wait for the slots to stay in place,
+	// then see the new layout before they start
+	lock_range(db_mgr, F_WRLCK, DB_LOCK_LAYOUT, 1);
+	enum status status = compact_in_place(db_mgr);
+	if (status == STATUS_OK && db_mgr->sorted &&
+		db_mgr->nr_sorted < db_mgr->nr_slots)
+		status = merge_delta(db_mgr);
+	if (status == STATUS_OK && db_mgr->shared)
+		status = publish_changes(db_mgr);
+	lock_range(db_mgr, F_UNLCK, DB_LOCK_LAYOUT, 1);
+
+	return status;
+}
+
+/*
+ * @brief Mark the entry at the given index as deleted.
+ * The space is reclaimed by the compaction, which is started automatically
+ * once the deleted slots make up the configured share of the database.
+ * @param db_mgr The database manager.
+ * @param idx The index of the entry to remove.
+ * @return The status of the operation.
+ */
+static enum status remove_entry_at(struct db_manager *db_mgr, int64_t idx)
+{
+	char *slot = buffer_pool_get(db_mgr->buffers, db_mgr->slot_size);
+	if (slot == NULL)
+		return STATUS_ERROR;
+
+	if (read_slots(db_mgr, idx, slot, 1) != STATUS_OK) {
+		buffer_pool_put(db_mgr->buffers, slot, db_mgr->slot_size);
+		return STATUS_ERROR;
+	}
+
+	((struct db_slot_header *)slot)->flags |= SLOT_DELETED;
+	if (write_slots(db_mgr, idx, slot, 1) != STATUS_OK) {
+		buffer_pool_put(db_mgr->buffers, slot, db_mgr->slot_size);
+		return STATUS_ERROR;
+	}
+	count_entries(db_mgr, 1, 1);
+
+	if (db_mgr->key_of != NULL)
+		unindex_key(db_mgr, db_mgr->key_of(slot_entry(slot)), idx);
+	// the callers write the entry first if it is dirty
+	if (db_mgr->cache != NULL)
+		(void)record_cache_remove(db_mgr->cache,
+								  db_mgr->key_of(slot_entry(slot)), NULL, NULL);
+	if (db_mgr->groups != NULL) {
+		uint32_t id = (uint32_t)group_index_lookup(
+			db_mgr->groups, db_mgr->group_of(slot_entry(slot)));
+
+		(void)group_index_remove(db_mgr->groups, id, idx);
+		if (db_mgr->measure_of != NULL) {
+			int64_t values[DB_MAX_MEASURES];
+
+			db_mgr->measure_of(slot_entry(slot), values);
+			group_index_add_sums(db_mgr->groups, id, values, -1);
+		}
+	}
+	if (db_mgr->texts != NULL)
+		(void)text_index_remove(db_mgr->texts, idx);
+	if (db_mgr->orders != NULL)
+		(void)order_index_remove(db_mgr->orders,
+								 db_mgr->order_of(slot_entry(slot)), idx);
+	buffer_pool_put(db_mgr->buffers, slot, db_mgr->slot_size);
+
+	++db_mgr->nr_dead;
+	enum status status = end_mutation(db_mgr, STATUS_OK);
+	// the compaction is put off while a snapshot is read
+	if (status == STATUS_OK && db_mgr->compact_percent != 0 &&
+		db_mgr->snapshot == NULL &&
+		db_mgr->nr_dead >= COMPACT_MIN_DEAD_SLOTS &&
+		db_mgr->nr_dead * 100 >= db_mgr->nr_slots * db_mgr->compact_percent)
+		return compact_database(db_mgr);
+
+	return status;
+}
+
+enum status remove_unique_entry(struct db_manager *db_mgr, const void *criteria,
+								match_crit_func matches_crit)
+{
+	OP_SCOPE(db_mgr, DB_OP_REMOVE);
+
+	if (sync_cache(db_mgr) != STATUS_OK)
+		return STATUS_ERROR;
+
+	int64_t idx = find_entry_idx(db_mgr, criteria, matches_crit);
+
+	if (idx == -1) {
+		return STATUS_ERROR;
+	}
+
+	return remove_entry_at(db_mgr, idx);
+}
+
+/*
+ * The entries selected by a dump, either by a predicate evaluated on each
+ * entry or by a filter evaluated on the values of a column.
+ */
+struct dump_query {
+	dump_entry_func dump_entry;
+	const void *criteria;
+	match_crit_func matches_crit;
+	column_filter_func filter;
+	size_t column;
+	// dump the snapshot being read instead of the current entries
+	bool snapshot;
+};
+
+// the slots past the last one dumped by a query
+static inline uint64_t dump_end(const struct db_manager *db_mgr,
+								const struct dump_query *query)
+{
+	return query->snapshot ? db_mgr->snapshot->nr_slots : db_mgr->nr_slots;
+}
+
+/*
+ * @brief Dump the entries from a range of slots selected by a predicate.
+ * @return The number of dumped entries.
+ */
+static uint64_t dump_range_rows(struct db_manager *db_mgr, uint64_t first_idx,
+								uint64_t end_idx,
+								const struct dump_query *query, FILE *out)
+{
+	struct block_iter it;
+	uint64_t cnt = 0;
+
+	iter_init(&it, db_mgr, first_idx, end_idx, query->snapshot);
+	while (block_iter_next(&it)) {
+		for (size_t i = 0; i < it.count; ++i) {
+			void *entry = block_iter_entry(&it, i);
+			if (entry == NULL)
+				continue;
+			if (query->matches_crit == NULL ||
+				query->matches_crit(entry, query->criteria)) {
+				query->dump_entry(entry, out);
+				++cnt;
+			}
+		}
+	}
+	(void)block_iter_end(&it);
+
+	return cnt;
+}
+
+/*
+ * @brief Select the live slots of a block of a columnar database whose values
+ * in the filtered column match, reading only that column and the slot headers.
+ * @return The status of the operation.
+ */
+static enum status select_block_columns(struct db_manager *db_mgr,
+										const struct dump_query *query,
+										uint64_t idx, size_t count,
+										char **parts, uint8_t *selected)
+{
+	const struct db_slot_header *hdrs = (struct db_slot_header *)parts[0];
+	size_t filter_part = query->column + 1;
+	bool any_live = false;
+
+	if (transfer_part(db_mgr, 0, idx, parts[0], count, false) != STATUS_OK)
+		return STATUS_ERROR;
+
+	for (size_t i = 0; i < count && !any_live; ++i)
+		any_live = !(hdrs[i].flags & SLOT_DELETED);
+	if (!any_live) {
+		memset(selected, 0, count);
+		return STATUS_OK;
+	}
+
+	if (transfer_part(db_mgr, filter_part, idx, parts[filter_part], count,
+					  false) != STATUS_OK)
+		return STATUS_ERROR;
+
+	query->filter(parts[filter_part], count, query->criteria, selected);
+	for (size_t i = 0; i < count; ++i)
+		if (hdrs[i].flags & SLOT_DELETED)
+			selected[i] = 0;
+
+	return STATUS_OK;
+}
+
+/*
+ * @brief Dump the entries from a range of slots of a columnar database
+ * selected by a column filter. Only the selected slots are materialized as
+ * entries, and the other columns are only read for the blocks holding
+ * selected slots.
+ * @return The number of dumped entries.
+ */
+static uint64_t dump_range_columns(struct db_manager *db_mgr,
+								   uint64_t first_idx, uint64_t end_idx,
+								   const struct dump_query *query, FILE *out)
+{
+	size_t block_slots = db_mgr->block_slots;
+	size_t nr_parts = db_mgr->nr_columns + 1;
+	uint64_t cnt = 0;
+
+	if (end_idx > db_mgr->nr_slots)
+		end_idx = db_mgr->nr_slots;
+
+	char **parts = calloc(nr_parts, sizeof(*parts));
+	uint8_t *selected = buffer_pool_get(db_mgr->buffers, block_slots);
+	char *entry = buffer_pool_get(db_mgr->buffers, db_mgr->entry_size);
+	DIE(parts == NULL || selected == NULL || entry == NULL,
+		"Error allocating column buffers");
+
+	for (size_t part = 0; part < nr_parts; ++part) {
+		parts[part] = buffer_pool_get(db_mgr->buffers,
+									  block_slots * part_size(db_mgr, part));
+		DIE(parts[part] == NULL, "Error allocating column buffers");
+	}
+
+	for (uint64_t idx = first_idx; idx < end_idx; idx += block_slots) {
+		size_t count = end_idx - idx < block_slots ? end_idx - idx :
+													   block_slots;
+		size_t filter_part = query->column + 1;
+
+		// the columns of the block are read under a single lock
+		lock_slots(db_mgr, F_RDLCK, (int64_t)idx, count);
+		enum status status = select_block_columns(db_mgr, query, idx, count,
+												  parts, selected);
+		count_entries(db_mgr, count, 0);
+
+		size_t lo = 0;
+		size_t hi = status == STATUS_OK ? count : 0;
+		while (lo < hi && !selected[lo])
+			++lo;
+		while (hi > lo && !selected[hi - 1])
+			--hi;
+
+		// only read the other columns for the span holding selected slots
+		for (size_t part = 1; part < nr_parts && status == STATUS_OK && lo < hi;
+			 ++part) {
+			if (part == filter_part)
+				continue;
+			size_t size = part_size(db_mgr, part);
+			status = transfer_part(db_mgr, part, idx + lo,
+								   parts[part] + lo * size, hi - lo, false);
+		}
+		lock_slots(db_mgr, F_UNLCK, (int64_t)idx, count);
+		if (status != STATUS_OK)
+			break;
+		if (lo == hi)
+			continue;
+
+		memset(entry, 0, db_mgr->entry_size);
+		for (size_t i = lo; i < hi; ++i) {
+			if (!selected[i])
+				continue;
+
+			for (size_t c = 0; c < db_mgr->nr_columns; ++c) {
+				const struct db_column *col = &db_mgr->columns[c];
+				memcpy(entry + col->offset, parts[c + 1] + i * col->size,
+					   col->size);
+			}
+			query->dump_entry(entry, out);
+			++cnt;
+		}
+	}
+
+	for (size_t part = 0; part < nr_parts; ++part)
+		buffer_pool_put(db_mgr->buffers, parts[part],
+						block_slots * part_size(db_mgr, part));
+	free(parts);
+	buffer_pool_put(db_mgr->buffers, selected, block_slots);
+	buffer_pool_put(db_mgr->buffers, entry, db_mgr->entry_size);
+	return cnt;
+}
+
+/*
+ * @brief Dump the entries from a range of slots of a row database selected by
+ * a column filter, gathering the values of the column from each block.
+ * @return The number of dumped entries.
+ */
+static uint64_t dump_range_gather(struct db_manager *db_mgr,
+								  uint64_t first_idx, uint64_t end_idx,
+								  const struct dump_query *query, FILE *out)
+{
+	const struct db_column *col = &db_mgr->columns[query->column];
+	char *values =
+		buffer_pool_get(db_mgr->buffers, db_mgr->block_slots * col->size);
+	uint8_t *selected = buffer_pool_get(db_mgr->buffers, db_mgr->block_slots);
+	DIE(values == NULL || selected == NULL, "Error allocating column buffers");
+
+	struct block_iter it;
+	uint64_t cnt = 0;
+
+	block_iter_init_range(&it, db_mgr, first_idx, end_idx);
+	while (block_iter_next(&it)) {
+		for (size_t i = 0; i < it.count; ++i)
+			memcpy(values + i * col->size,
+				   it.slots + i * db_mgr->slot_size +
+					   sizeof(struct db_slot_header) + col->offset,
+				   col->size);
+
+		query->filter(values, it.count, query->criteria, selected);
+		for (size_t i = 0; i < it.count; ++i) {
+			void *entry = block_iter_entry(&it, i);
+			if (entry != NULL && selected[i]) {
+				query->dump_entry(entry, out);
+				++cnt;
+			}
+		}
+	}
+	(void)block_iter_end(&it);
+
+	buffer_pool_put(db_mgr->buffers, values, db_mgr->block_slots * col->size);
+	buffer_pool_put(db_mgr->buffers, selected, db_mgr->block_slots);
+	return cnt;
+}
+
+/*
+ * @brief Dump the entries selected by a query from a range of slots.
+ * @return The number of dumped entries.
+ */
+static uint64_t dump_range(struct db_manager *db_mgr, uint64_t first_idx,
+						   uint64_t end_idx, const struct dump_query *query,
+						   FILE *out)
+{
+	if (query->filter == NULL)
+		return dump_range_rows(db_mgr, first_idx, end_idx, query, out);
+	if (db_mgr->columnar)
+		return dump_range_columns(db_mgr, first_idx, end_idx, query, out);
+	return dump_range_gather(db_mgr, first_idx, end_idx, query, out);
+}
+
+/*
+ * A thread of a parallel dump. The database is dumped in rounds: in each
+ * round, every thread dumps one block to a memory buffer, then the calling
+ * thread writes the buffers to the output in order while the dump threads
+ * wait. The memory used is thus bounded by one block of output per thread.
+ */
+struct dump_task {
+	struct db_manager *db_mgr;
+	const struct dump_query *query;
+	pthread_barrier_t *barrier;
+	unsigned id;
+	unsigned nr_threads;
+	uint64_t nr_rounds;
+
+	char *buf;
+	size_t len;
+	uint64_t cnt;
+};
+
+static void *dump_rounds(void *arg)
+{
+	struct dump_task *task = arg;
+	uint64_t block_slots = task->db_mgr->block_slots;
+
+	uint64_t end_idx = dump_end(task->db_mgr, task->query);
+
+	for (uint64_t round = 0; round < task->nr_rounds; ++round) {
+		uint64_t first_idx =
+			(round * task->nr_threads + task->id) * block_slots;
+
+		task->buf = NULL;
+		task->len = 0;
+		if (first_idx < end_idx) {
+			FILE *out = open_memstream(&task->buf, &task->len);
+			DIE(out == NULL, "Error allocating dump buffer");
+
+			uint64_t block_end = first_idx + block_slots < end_idx ?
+									first_idx + block_slots :
+									end_idx;
+			task->cnt += dump_range(task->db_mgr, first_idx, block_end,
+									task->query, out);
+			DIE(fclose(out) != 0, "Error writing dump buffer");
+		}
+
+		// wait for all the blocks of the round, then for them to be written
+		(void)pthread_barrier_wait(task->barrier);
+		(void)pthread_barrier_wait(task->barrier);
+	}
+
+	return NULL;
+}
+
+static uint64_t dump_parallel(struct db_manager *db_mgr, unsigned nr_threads,
+							  const struct dump_query *query, FILE *out)
+{
+	uint64_t round_slots = (uint64_t)nr_threads * db_mgr->block_slots;
+	uint64_t nr_rounds =
+		(dump_end(db_mgr, query) + round_slots - 1) / round_slots;
+	pthread_barrier_t barrier;
+
+	struct dump_task *tasks = calloc(nr_threads, sizeof(*tasks));
+	DIE(tasks == NULL, "Error allocating dump tasks");
+
+	pthread_t *threads = calloc(nr_threads, sizeof(*threads));
+	DIE(threads == NULL, "Error allocating threads");
+
+	// the dump threads and the calling thread, which writes the output
+	DIE(pthread_barrier_init(&barrier, NULL, nr_threads + 1) != 0,
+		"Error creating barrier");
+
+	for (unsigned t = 0; t < nr_threads; ++t) {
+		tasks[t] = (struct dump_task){
+			.db_mgr = db_mgr,
+			.query = query,
+			.barrier = &barrier,
+			.id = t,
+			.nr_threads = nr_threads,
+			.nr_rounds = nr_rounds,
+		};
+		DIE(pthread_create(&threads[t], NULL, dump_rounds, &tasks[t]) != 0,
+			"Error creating thread");
+	}
+
+	for (uint64_t round = 0; round < nr_rounds; ++round) {
+		(void)pthread_barrier_wait(&barrier);
+		for (unsigned t = 0; t < nr_threads; ++t) {
+			if (tasks[t].len > 0)
+				(void)fwrite(tasks[t].buf, 1, tasks[t].len, out);
+			free(tasks[t].buf);
+		}
+		(void)pthread_barrier_wait(&barrier);
+	}
+
+	uint64_t cnt = 0;
+	for (unsigned t = 0; t < nr_threads; ++t) {
+		(void)pthread_join(threads[t], NULL);
+		cnt += tasks[t].cnt;
+	}
+
+	(void)pthread_barrier_destroy(&barrier);
+	free(threads);
+	free(tasks);
+	return cnt;
+}
+
+static void run_dump(struct db_manager *db_mgr, const struct dump_query *query,
+					 FILE *out)
+{
+	DIE(sync_cache(db_mgr) != STATUS_OK, "Error writing database");
+
+	unsigned nr_threads = scan_threads(db_mgr);
+	uint64_t cnt;
+
+	if (nr_threads > 1)
+		cnt = dump_parallel(db_mgr, nr_threads, query, out);
+	else
+		cnt = dump_range(db_mgr, 0, dump_end(db_mgr, query), query, out);
+
+	count_entries(db_mgr, 0, cnt);
+	// the entry writer knows what an empty report looks like in its format
+	if (cnt == 0)
+		query->dump_entry(NULL, out);
+}
+
+void dump_database(struct db_manager *db_mgr, dump_entry_func dump_entry,
+				   const void *criteria, match_crit_func matches_crit,
+				   FILE *out)
+{
+	OP_SCOPE(db_mgr, DB_OP_DUMP);
+	struct dump_query query = { .dump_entry = dump_entry,
+								.criteria = criteria,
+								.matches_crit = matches_crit };
+
+	run_dump(db_mgr, &query, out);
+}
+
+enum status dump_database_by_column(struct db_manager *db_mgr,
+									dump_entry_func dump_entry, size_t column,
+									const void *criteria,
+									column_filter_func filter, FILE *out)
+{
+	OP_SCOPE(db_mgr, DB_OP_DUMP);
+
+	if (column >= db_mgr->nr_columns)
+		return STATUS_ERROR;
+
+	struct dump_query query = { .dump_entry = dump_entry,
+								.criteria = criteria,
+								.filter = filter,
+								.column = column };
+
+	run_dump(db_mgr, &query, out);
+	return STATUS_OK;
+}
+
+/*
+ * @brief Take a snapshot of the database or, in a shared database, join the
+ * snapshot read by other processes if the database did not change since it was
+ * taken.
+ * @param db_mgr The database manager.
+ * @param busy Set if another snapshot is still read, which has to be closed
+ * first.
+ * @return The status of the operation.
+ */
+static enum status take_snapshot(struct db_manager *db_mgr, bool *busy)
+{
+	OP_SCOPE(db_mgr, DB_OP_SNAPSHOT);
+	struct db_snapshot *snap = db_mgr->snapshot;
+
+	*busy = false;
+	if (db_mgr->wal != NULL || (snap != NULL && snap->reading))
+		return STATUS_ERROR;
+
+	if (snap != NULL) {
+		if (snapshot_version(snap->file) != db_mgr->generation) {
+			*busy = true;
+			return STATUS_OK;
+		}
+		lock_range(db_mgr, F_RDLCK, DB_LOCK_SNAPSHOT, 1);
+		snap->nr_slots = db_mgr->nr_slots;
+		snap->reading = true;
+		return STATUS_OK;
+	}
+
+	// the changes kept in the record cache are part of the snapshot
+	if (sync_cache(db_mgr) != STATUS_OK)
+		return STATUS_ERROR;
+
+	snap = calloc(1, sizeof(*snap));
+	DIE(snap == NULL, "Error allocating snapshot");
+
+	char *path = sibling_path(db_mgr->path, SNAPSHOT_FILE_EXT);
+	*snap = (struct db_snapshot){
+		.file = snapshot_create(path, db_mgr->nr_slots * db_mgr->slot_size,
+								snapshot_page_bytes(db_mgr),
+								db_mgr->generation),
+		.id = ++db_mgr->nr_snapshots,
+		.nr_slots = db_mgr->nr_slots,
+		.reading = true,
+	};
+	free(path);
+
+	db_mgr->snapshot = snap;
+	lock_range(db_mgr, F_RDLCK, DB_LOCK_SNAPSHOT, 1);
+	// the other processes start saving the slots they change
+	return db_mgr->shared ? write_file_header(db_mgr) : STATUS_OK;
+}
+
+enum status open_snapshot(struct db_manager *db_mgr)
+{
+	for (;;) {
+		bool busy;
+		enum status status = take_snapshot(db_mgr, &busy);
+		if (!busy)
+			return status;
+
+		// wait for the readers of the other snapshot, without keeping the
+		// writers waiting
+		lock_range(db_mgr, F_WRLCK, DB_LOCK_SNAPSHOT, 1);
+		lock_range(db_mgr, F_UNLCK, DB_LOCK_SNAPSHOT, 1);
+	}
+}
+
+enum status close_snapshot(struct db_manager *db_mgr)
+{
+	OP_SCOPE(db_mgr, DB_OP_SNAPSHOT);
+
+	if (db_mgr->snapshot == NULL || !db_mgr->snapshot->reading)
+		return STATUS_ERROR;
+
+	lock_range(db_mgr, F_UNLCK, DB_LOCK_SNAPSHOT, 1);
+	// the other readers still need the slots changed by this process
+	if (snapshot_readers(db_mgr)) {
+		db_mgr->snapshot->reading = false;
+		return STATUS_OK;
+	}
+
+	return remove_snapshot(db_mgr);
+}
+
+enum status dump_snapshot(struct db_manager *db_mgr,
+						  dump_entry_func dump_entry, const void *criteria,
+						  match_crit_func matches_crit, FILE *out)
+{
+	OP_SCOPE(db_mgr, DB_OP_DUMP_SNAPSHOT);
+
+	if (db_mgr->snapshot == NULL || !db_mgr->snapshot->reading)
+		return STATUS_ERROR;
+
+	struct dump_query query = { .dump_entry = dump_entry,
+								.criteria = criteria,
+								.matches_crit = matches_crit,
+								.snapshot = true };
+
+	run_dump(db_mgr, &query, out);
+	return STATUS_OK;
+}
+
+/*
+ * @brief Read the entry in a slot.
+ * @param db_mgr The database manager.
+ * @param idx The slot.
+ * @param entry The buffer the entry is read into(entry_size bytes).
+ * @return The status of the operation.
+ */
+static enum status read_entry(struct db_manager *db_mgr, int64_t idx,
+							  void *entry)
+{
+	count_entries(db_mgr, 1, 0);
+
+	// the slot is assembled from the columns, patched from the log batch or
+	// read under its lock
+	if (db_mgr->columnar || db_mgr->wal != NULL || db_mgr->shared) {
+		char *slot = buffer_pool_get(db_mgr->buffers, db_mgr->slot_size);
+		if (slot == NULL)
+			return STATUS_ERROR;
+
+		enum status status = read_slots(db_mgr, idx, slot, 1);
+		if (status == STATUS_OK)
+			memcpy(entry, slot_entry(slot), db_mgr->entry_size);
+		buffer_pool_put(db_mgr->buffers, slot, db_mgr->slot_size);
+		return status;
+	}
+
+	off_t offset = slot_offset(db_mgr, idx) + sizeof(struct db_slot_header);
+	if (db_mgr->map != NULL) {
+		memcpy(entry, db_mgr->map + offset, db_mgr->entry_size);
+		return STATUS_OK;
+	}
+
+	return pread_full(db_mgr->stats, db_fd(db_mgr), entry, db_mgr->entry_size,
+					  offset);
+}
+
+enum status find_entry_by_key(struct db_manager *db_mgr, int64_t key,
+							  void *entry)
+{
+	OP_SCOPE(db_mgr, DB_OP_FIND_BY_KEY);
+
+	if (db_mgr->key_of == NULL)
+		return STATUS_ERROR;
+
+	int64_t idx;
+	const void *cached =
+		db_mgr->cache != NULL ? record_cache_get(db_mgr->cache, key, &idx) :
+								NULL;
+	if (cached != NULL) {
+		memcpy(entry, cached, db_mgr->entry_size);
+		count_entries(db_mgr, 0, 1);
+		return STATUS_OK;
+	}
+
+	size_t count;
+	idx = find_key_idx(db_mgr, key, &count);
+	if (idx == -1)
+		return STATUS_NOT_FOUND;
+
+	enum status status = read_entry(db_mgr, idx, entry);
+	// the entry may have been changed by another process since it was indexed
+	if (status == STATUS_OK && db_mgr->shared &&
+		db_mgr->key_of(entry) != key)
+		return STATUS_NOT_FOUND;
+	if (status == STATUS_OK)
+		count_entries(db_mgr, 0, 1);
+	if (status == STATUS_OK && count == 1)
+		status = cache_written(db_mgr, idx, entry, true);
+	return status;
+}
+
+/*
+ * @brief Update an entry of the record cache without reading the database
+ * file. The entry is written right away in write-through mode and only when it
+ * is evicted or flushed in write-back mode.
+ * @param db_mgr The database manager.
+ * @param key The key of the entry.
+ * @param idx The slot of the entry.
+ * @param cached The cached entry.
+ * @param update_val The value used to update the entry.
+ * @param update A function that updates the entry using information from
+ * update_val.
+ * @param defer Whether to leave the entry dirty even in write-through mode,
+ * for the caller to flush the cache once its batch is done.
+ * @return The status of the operation.
+ */
+static enum status update_cached_entry(struct db_manager *db_mgr, int64_t key,
+									   int64_t idx, void *cached,
+									   const void *update_val,
+									   update_func update, bool defer)
+{
+	char *slot = live_slot(db_mgr, cached);
+	if (slot == NULL)
+		return STATUS_ERROR;
+	void *entry = slot_entry(slot);
+
+	struct entry_refs refs;
+	save_entry_refs(db_mgr, entry, &refs);
+	update(entry, update_val);
+
+	enum status status = STATUS_OK;
+	if (db_mgr->key_of(entry) != key) {
+		// the entry leaves the cache along with its old key
+		status = write_slots(db_mgr, idx, slot, 1);
+		(void)record_cache_remove(db_mgr->cache, key, NULL, NULL);
+	} else if (db_mgr->cache_write_back || defer) {
+		memcpy(cached, entry, db_mgr->entry_size);
+		record_cache_mark_dirty(db_mgr->cache, key);
+	} else {
+		status = write_slots(db_mgr, idx, slot, 1);
+		if (status == STATUS_OK)
+			memcpy(cached, entry, db_mgr->entry_size);
+	}
+
+	if (status == STATUS_OK) {
+		reindex_entry(db_mgr, idx, &refs, entry);
+		count_entries(db_mgr, 0, 1);
+	}
+	buffer_pool_put(db_mgr->buffers, slot, db_mgr->slot_size);
+	return status;
+}
+
+enum status update_entries_by_key(struct db_manager *db_mgr, int64_t key,
+								  const void *update_val, update_func update)
+{
+	OP_SCOPE(db_mgr, DB_OP_UPDATE_BY_KEY);
+
+	if (db_mgr->key_of == NULL)
+		return STATUS_ERROR;
+
+	int64_t cached_idx;
+	void *cached = db_mgr->cache != NULL ?
+					   record_cache_get(db_mgr->cache, key, &cached_idx) :
+					   NULL;
+	if (cached != NULL)
+		return end_mutation(db_mgr,
+							update_cached_entry(db_mgr, key, cached_idx,
+												cached, update_val, update,
+												false));
+
+	// collect the matches first, since updating a key changes the index
+	size_t nr_matches = 0;
+	size_t capacity = 4;
+	int64_t *matches = malloc(capacity * sizeof(*matches));
+	DIE(matches == NULL, "Error allocating buffer");
+
+	uint64_t cursor = 0;
+	int64_t idx;
+	while ((idx = next_key_slot(db_mgr, key, &cursor)) != -1) {
+		if (nr_matches == capacity) {
+			capacity *= 2;
+			matches = realloc(matches, capacity * sizeof(*matches));
+			DIE(matches == NULL, "Error allocating buffer");
+		}
+		matches[nr_matches++] = idx;
+	}
+
+	char *slot = buffer_pool_get(db_mgr->buffers, db_mgr->slot_size);
+	if (slot == NULL) {
+		free(matches);
+		return STATUS_ERROR;
+	}
+	void *entry = slot_entry(slot);
+
+	enum status status = nr_matches == 0 ? STATUS_NOT_FOUND : STATUS_OK;
+	for (size_t i = 0; i < nr_matches && status == STATUS_OK; ++i) {
+		status = read_slots(db_mgr, matches[i], slot, 1);
+		if (status != STATUS_OK)
+			break;
+
+		struct entry_refs refs;
+		save_entry_refs(db_mgr, entry, &refs);
+
+		update(entry, update_val);
+		status = write_slots(db_mgr, matches[i], slot, 1);
+		if (status == STATUS_OK) {
+			reindex_entry(db_mgr, matches[i], &refs, entry);
+			count_entries(db_mgr, 1, 1);
+		}
+	}
+
+	// the next updates of an entry with a key of its own skip the reads
+	if (status == STATUS_OK && nr_matches == 1 && db_mgr->key_of(entry) == key)
+		status = cache_written(db_mgr, matches[0], entry, true);
+
+	buffer_pool_put(db_mgr->buffers, slot, db_mgr->slot_size);
+	free(matches);
+	return end_mutation(db_mgr, status);
+}
+
+enum status remove_entry_by_key(struct db_manager *db_mgr, int64_t key)
+{
+	OP_SCOPE(db_mgr, DB_OP_REMOVE_BY_KEY);
+
+	if (db_mgr->key_of == NULL)
+		return STATUS_ERROR;
+
+	size_t count;
+	int64_t idx = find_key_idx(db_mgr, key, &count);
+	if (idx == -1)
+		return STATUS_NOT_FOUND;
+
+	// the changes of a cached entry are written before it is removed
+	if (uncache_key(db_mgr, key) != STATUS_OK)
+		return STATUS_ERROR;
+	return remove_entry_at(db_mgr, idx);
+}
+
+/*
+ * @brief Copy the posting list of a group, since updating the entries may
+ * change their groups.
+ * @return The slots of the group or NULL if the group is unknown.
+ */
+static int64_t *copy_group_slots(struct db_manager *db_mgr, const char *group,
+								 size_t *count)
+{
+	int64_t id = group_index_lookup(db_mgr->groups, group);
+
+	*count = 0;
+	if (id == -1)
+		return NULL;
+
+	const int64_t *slots =
+		group_index_slots(db_mgr->groups, (uint32_t)id, count);
+	if (*count == 0)
+		return NULL;
+
+	int64_t *copy = malloc(*count * sizeof(*copy));
+	DIE(copy == NULL, "Error allocating buffer");
+	memcpy(copy, slots, *count * sizeof(*copy));
+	return copy;
+}
+
+/*
+ * @brief Get the number of slots starting a posting list that are consecutive
+ * in the database, so they can be read with a single call.
+ */
+static size_t slot_run_len(const struct db_manager *db_mgr,
+						   const int64_t *slots, size_t count)
+{
+	size_t len = 1;
+
+	while (len < count && len < db_mgr->block_slots &&
+		   slots[len] == slots[0] + (int64_t)len)
+		++len;
+	return len;
+}
+
+/*
+ * @brief Update the entries at the given slots that match the criteria,
+ * reading consecutive slots with a single call and writing back only the runs
+ * holding updated entries.
+ * @param db_mgr The database manager.
+ * @param slots The slots of the entries, in increasing order.
+ * @param count The number of slots.
+ * @param criteria The criteria to match.
+ * @param should_update A function that determines if an entry should be updated
+ * based on the criteria(NULL updates all the entries).
+ * @param update_val The value used to update the entries.
+ * @param update A function that updates an entry using information from
+ * update_val.
+ * @return The status of the operation.
+ */
+static enum status update_slots(struct db_manager *db_mgr, const int64_t *slots,
+								size_t count, const void *criteria,
+								match_crit_func should_update,
+								const void *update_val, update_func update)
+{
+	char *buffer = NULL;
+	size_t max_run = count < db_mgr->block_slots ? count : db_mgr->block_slots;
+	struct entry_refs *refs = NULL;
+	bool *updated = NULL;
+	enum status status = sync_cache(db_mgr);
+
+	if (count > 0) {
+		buffer = buffer_pool_get(db_mgr->buffers,
+								 max_run * db_mgr->slot_size);
+		refs = malloc(max_run * sizeof(*refs));
+		updated = malloc(max_run * sizeof(*updated));
+		DIE(refs == NULL || updated == NULL, "Error allocating buffer");
+		if (buffer == NULL)
+			status = STATUS_ERROR;
+	}
+
+	for (size_t i = 0; i < count && status == STATUS_OK;) {
+		size_t run = slot_run_len(db_mgr, slots + i, count - i);
+		size_t nr_updated = 0;
+
+		status = read_slots(db_mgr, slots[i], buffer, run);
+		if (status != STATUS_OK)
+			break;
+
+		for (size_t j = 0; j < run; ++j) {
+			char *slot = buffer + j * db_mgr->slot_size;
+			void *entry = slot_entry(slot);
+
+			updated[j] = slot_is_live(slot) &&
+						 (should_update == NULL ||
+						  should_update(entry, criteria));
+			if (!updated[j])
+				continue;
+			save_entry_refs(db_mgr, entry, &refs[j]);
+			update(entry, update_val);
+			++nr_updated;
+		}
+		count_entries(db_mgr, run, nr_updated);
+
+		bool dirty = nr_updated > 0;
+
+		if (dirty)
+			status = write_slots(db_mgr, slots[i], buffer, run);
+		for (size_t j = 0; j < run && dirty && status == STATUS_OK; ++j) {
+			if (!updated[j])
+				continue;
+
+			void *entry = slot_entry(buffer + j * db_mgr->slot_size);
+			reindex_entry(db_mgr, slots[i] + (int64_t)j, &refs[j], entry);
+			(void)cache_written(db_mgr, slots[i] + (int64_t)j, entry, false);
+		}
+		i += run;
+	}
+
+	free(updated);
+	free(refs);
+	buffer_pool_put(db_mgr->buffers, buffer, max_run * db_mgr->slot_size);
+	return status;
+}
+
+enum status update_entries_by_group(struct db_manager *db_mgr,
+									const char *group, const void *update_val,
+									update_func update)
+{
+	OP_SCOPE(db_mgr, DB_OP_UPDATE_BY_GROUP);
+
+	if (db_mgr->groups == NULL)
+		return STATUS_ERROR;
+
+	size_t count;
+	int64_t *slots = copy_group_slots(db_mgr, group, &count);
+	enum status status =
+		update_slots(db_mgr, slots, count, NULL, NULL, update_val, update);
+
+	free(slots);
+	return end_mutation(db_mgr, status);
+}
+
+/*
+ * An update of a single slot, part of a batch.
+ */
+struct slot_update {
+	int64_t slot;
+	// the position of the update in its batch
+	size_t order;
+	update_func update;
+	const void *update_val;
+	// add the updated entry to the record cache, its key being held by this
+	// slot only
+	bool cache;
+};
+
+static int compare_slot_updates(const void *a, const void *b)
+{
+	const struct slot_update *x = a;
+	const struct slot_update *y = b;
+
+	if (x->slot != y->slot)
+		return (x->slot > y->slot) - (x->slot < y->slot);
+	return (x->order > y->order) - (x->order < y->order);
+}
+
+static void add_slot_update(struct slot_update **updates, size_t *count,
+							size_t *capacity, struct slot_update update)
+{
+	if (*count == *capacity) {
+		*capacity = *capacity ? *capacity * 2 : 64;
+		*updates = realloc(*updates, *capacity * sizeof(**updates));
+		DIE(*updates == NULL, "Error allocating buffer");
+	}
+	(*updates)[(*count)++] = update;
+}
+
+/*
+ * @brief Apply updates of single slots, reading and writing each updated slot
+ * once, in file order, and the consecutive slots with a single call. The
+ * updates of the same slot are applied in the order of their batch.
+ * @param db_mgr The database manager.
+ * @param updates The updates, sorted by the call.
+ * @param count The number of updates.
+ * @return The status of the operation.
+ */
+static enum status apply_slot_updates(struct db_manager *db_mgr,
+									  struct slot_update *updates,
+									  size_t count)
+{
+	if (count == 0)
+		return STATUS_OK;
+
+	qsort(updates, count, sizeof(*updates), compare_slot_updates);
+
+	// the distinct slots, in increasing order
+	size_t nr_slots = 0;
+	int64_t *slots = malloc(count * sizeof(*slots));
+	DIE(slots == NULL, "Error allocating buffer");
+	for (size_t i = 0; i < count; ++i) {
+		if (nr_slots == 0 || slots[nr_slots - 1] != updates[i].slot)
+			slots[nr_slots++] = updates[i].slot;
+	}
+
+	size_t max_run = nr_slots < db_mgr->block_slots ? nr_slots :
+													   db_mgr->block_slots;
+	char *buffer =
+		buffer_pool_get(db_mgr->buffers, max_run * db_mgr->slot_size);
+	struct entry_refs *refs = malloc(max_run * sizeof(*refs));
+	bool *cache = malloc(max_run * sizeof(*cache));
+	DIE(refs == NULL || cache == NULL, "Error allocating buffer");
+
+	enum status status = buffer != NULL ? STATUS_OK : STATUS_ERROR;
+	size_t next = 0;
+	for (size_t i = 0; i < nr_slots && status == STATUS_OK;) {
+		size_t run = slot_run_len(db_mgr, slots + i, nr_slots - i);
+
+		status = read_slots(db_mgr, slots[i], buffer, run);
+		if (status != STATUS_OK)
+			break;
+
+		for (size_t j = 0; j < run; ++j) {
+			void *entry = slot_entry(buffer + j * db_mgr->slot_size);
+
+			save_entry_refs(db_mgr, entry, &refs[j]);
+			cache[j] = false;
+			for (; next < count && updates[next].slot == slots[i + j];
+				 ++next) {
+				updates[next].update(entry, updates[next].update_val);
+				cache[j] |= updates[next].cache;
+			}
+		}
+
+		status = write_slots(db_mgr, slots[i], buffer, run);
+		count_entries(db_mgr, run, run);
+		for (size_t j = 0; j < run && status == STATUS_OK; ++j) {
+			void *entry = slot_entry(buffer + j * db_mgr->slot_size);
+
+			reindex_entry(db_mgr, slots[i] + (int64_t)j, &refs[j], entry);
+			status = cache_written(db_mgr, slots[i] + (int64_t)j, entry,
+								   cache[j]);
+		}
+		i += run;
+	}
+
+	free(cache);
+	free(refs);
+	buffer_pool_put(db_mgr->buffers, buffer, max_run * db_mgr->slot_size);
+	free(slots);
+	return status;
+}
+
+/*
+ * Open-addressing table of the keys of a batch of updates. Each key is mapped
+ * to its first update in the batch, the next ones being chained in order.
+ */
+struct key_table {
+	int64_t *keys;
+	// the first update of each key plus one, 0 for the free positions
+	size_t *first;
+	size_t *next;
+	size_t mask;
+};
+
+static inline size_t key_table_pos(const struct key_table *table, int64_t key)
+{
+	// splitmix64 finalizer
+	uint64_t x = (uint64_t)key;
+
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return (size_t)x & table->mask;
+}
+
+/*
+ * @brief Build the table of the keys of some of the updates of a batch.
+ * @param table The table.
+ * @param updates The updates of the batch.
+ * @param count The number of updates in the batch.
+ * @param pending The updates added to the table, in the order of the batch.
+ * @param nr_pending The number of updates added to the table.
+ */
+static void key_table_init(struct key_table *table,
+						   const struct key_update *updates, size_t count,
+						   const size_t *pending, size_t nr_pending)
+{
+	size_t capacity = 16;
+
+	while (capacity < 2 * nr_pending)
+		capacity *= 2;
+	table->mask = capacity - 1;
+	table->keys = malloc(capacity * sizeof(*table->keys));
+	table->first = calloc(capacity, sizeof(*table->first));
+	table->next = malloc(count * sizeof(*table->next));
+	DIE(table->keys == NULL || table->first == NULL || table->next == NULL,
+		"Error allocating buffer");
+
+	// the updates are added backward, so that each one is chained before the
+	// later updates of its key
+	for (size_t i = nr_pending; i-- > 0;) {
+		int64_t key = updates[pending[i]].key;
+		size_t pos = key_table_pos(table, key);
+
+		while (table->first[pos] != 0 && table->keys[pos] != key)
+			pos = (pos + 1) & table->mask;
+		table->next[pending[i]] =
+			table->first[pos] != 0 ? table->first[pos] - 1 : SIZE_MAX;
+		table->keys[pos] = key;
+		table->first[pos] = pending[i] + 1;
+	}
+}
+
+/*
+ * @brief Find the first update of a key in the table.
+ * @return The position of the update in its batch or SIZE_MAX if no update
+ * has the key.
+ */
+static size_t key_table_find(const struct key_table *table, int64_t key)
+{
+	for (size_t pos = key_table_pos(table, key); table->first[pos] != 0;
+		 pos = (pos + 1) & table->mask) {
+		if (table->keys[pos] == key)
+			return table->first[pos] - 1;
+	}
+	return SIZE_MAX;
+}
+
+static void key_table_free(struct key_table *table)
+{
+	free(table->keys);
+	free(table->first);
+	free(table->next);
+}
+
+/*
+ * @brief Find the slots updated by a batch of key updates with a single scan
+ * of the file, looking up the key of each live entry in a table of the keys of
+ * the batch.
+ * @param db_mgr The database manager.
+ * @param updates The updates of the batch.
+ * @param count The number of updates in the batch.
+ * @param pending The updates whose slots are searched, in the order of the
+ * batch.
+ * @param nr_pending The number of updates whose slots are searched.
+ * @param slot_updates The updates of the slots found, extended by the call.
+ * @param nr_slot_updates The number of updates of slots.
+ * @param capacity The capacity of the array of updates of slots.
+ * @param matches Set to the number of slots found for each update of the
+ * batch.
+ */
+static void scan_key_slots(struct db_manager *db_mgr,
+						   const struct key_update *updates, size_t count,
+						   const size_t *pending, size_t nr_pending,
+						   struct slot_update **slot_updates,
+						   size_t *nr_slot_updates, size_t *capacity,
+						   size_t *matches)
+{
+	struct key_table table;
+	struct block_iter it;
+
+	key_table_init(&table, updates, count, pending, nr_pending);
+	block_iter_init(&it, db_mgr);
+	while (block_iter_next(&it)) {
+		for (size_t i = 0; i < it.count; ++i) {
+			void *entry = block_iter_entry(&it, i);
+			if (entry == NULL)
+				continue;
+
+			for (size_t j = key_table_find(&table, db_mgr->key_of(entry));
+				 j != SIZE_MAX; j = table.next[j]) {
+				add_slot_update(slot_updates, nr_slot_updates, capacity,
+								(struct slot_update){
+									.slot = (int64_t)(it.first_idx + i),
+									.order = j,
+									.update = updates[j].update,
+									.update_val = updates[j].update_val });
+				++matches[j];
+			}
+		}
+	}
+	DIE(block_iter_end(&it) != STATUS_OK, "Error reading database");
+	key_table_free(&table);
+}
+
+enum status update_entries_by_keys(struct db_manager *db_mgr,
+								   const struct key_update *updates,
+								   size_t count, bool *found)
+{
+	OP_SCOPE(db_mgr, DB_OP_UPDATE_BY_KEY);
+
+	if (db_mgr->key_of == NULL)
+		return STATUS_ERROR;
+
+	struct slot_update *slot_updates = NULL;
+	size_t nr_slot_updates = 0;
+	size_t capacity = 0;
+	size_t nr_cached = 0;
+	enum status status = STATUS_OK;
+
+	// the binary searches of a sorted run cost more than a scan for large
+	// batches, whose keys are then looked up in memory
+	size_t *pending = NULL;
+	size_t nr_pending = 0;
+	if (db_mgr->sorted &&
+		count * KEY_SCAN_SLOTS_PER_KEY >= db_mgr->nr_slots) {
+		pending = malloc(count * sizeof(*pending));
+		DIE(pending == NULL, "Error allocating buffer");
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		size_t first = nr_slot_updates;
+		uint64_t cursor = 0;
+		int64_t idx;
+
+		// the cached entries are updated in memory, in the order of the batch,
+		// and written once each after the batch in write-through mode
+		void *cached =
+			db_mgr->cache != NULL ?
+				record_cache_get(db_mgr->cache, updates[i].key, &idx) :
+				NULL;
+		if (cached != NULL) {
+			if (update_cached_entry(db_mgr, updates[i].key, idx, cached,
+									updates[i].update_val, updates[i].update,
+									true) != STATUS_OK)
+				status = STATUS_ERROR;
+			if (found != NULL)
+				found[i] = true;
+			++nr_cached;
+			continue;
+		}
+		if (pending != NULL) {
+			pending[nr_pending++] = i;
+			continue;
+		}
+
+		while ((idx = next_key_slot(db_mgr, updates[i].key, &cursor)) != -1)
+			add_slot_update(&slot_updates, &nr_slot_updates, &capacity,
+							(struct slot_update){
+								.slot = idx,
+								.order = i,
+								.update = updates[i].update,
+								.update_val = updates[i].update_val });
+		if (nr_slot_updates == first + 1)
+			slot_updates[first].cache = true;
+		if (found != NULL)
+			found[i] = nr_slot_updates > first;
+	}
+
+	if (nr_pending > 0) {
+		size_t *matches = calloc(count, sizeof(*matches));
+		DIE(matches == NULL, "Error allocating buffer");
+
+		scan_key_slots(db_mgr, updates, count, pending, nr_pending,
+					   &slot_updates, &nr_slot_updates, &capacity, matches);
+		for (size_t i = 0; i < nr_slot_updates; ++i)
+			slot_updates[i].cache = matches[slot_updates[i].order] == 1;
+		for (size_t i = 0; found != NULL && i < nr_pending; ++i)
+			found[pending[i]] = matches[pending[i]] > 0;
+		free(matches);
+	}
+	free(pending);
+
+	if (nr_slot_updates == 0 && nr_cached == 0)
+		return STATUS_NOT_FOUND;
+
+	enum status slots_status =
+		apply_slot_updates(db_mgr, slot_updates, nr_slot_updates);
+	if (status == STATUS_OK)
+		status = slots_status;
+	if (nr_cached > 0 && !db_mgr->cache_write_back &&
+		sync_cache(db_mgr) != STATUS_OK)
+		status = STATUS_ERROR;
+	free(slot_updates);
+	return end_mutation(db_mgr, status);
+}
+
+enum status update_entries_by_groups(struct db_manager *db_mgr,
+									 const struct group_update *updates,
+									 size_t count, bool *found)
+{
+	OP_SCOPE(db_mgr, DB_OP_UPDATE_BY_GROUP);
+
+	if (db_mgr->groups == NULL)
+		return STATUS_ERROR;
+
+	// the entries are read from the file
+	if (sync_cache(db_mgr) != STATUS_OK)
+		return STATUS_ERROR;
+
+	struct slot_update *slot_updates = NULL;
+	size_t nr_slot_updates = 0;
+	size_t capacity = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		int64_t id = group_index_lookup(db_mgr->groups, updates[i].group);
+		size_t nr_slots = 0;
+		const int64_t *slots =
+			id == -1 ? NULL :
+					   group_index_slots(db_mgr->groups, (uint32_t)id,
+										 &nr_slots);
+
+		for (size_t j = 0; j < nr_slots; ++j)
+			add_slot_update(&slot_updates, &nr_slot_updates, &capacity,
+							(struct slot_update){
+								.slot = slots[j],
+								.order = i,
+								.update = updates[i].update,
+								.update_val = updates[i].update_val });
+		if (found != NULL)
+			found[i] = nr_slots > 0;
+	}
+
+	enum status status =
+		apply_slot_updates(db_mgr, slot_updates, nr_slot_updates);
+	free(slot_updates);
+	return end_mutation(db_mgr, status);
+}
+
+/*
+ * @brief Dump the entries at the given slots that match the criteria, reading
+ * consecutive slots with a single call.
+ * @param db_mgr The database manager.
+ * @param slots The slots of the entries, in increasing order.
+ * @param count The number of slots.
+ * @param dump_entry A function that dumps the entry to a file.
+ * @param criteria The criteria to match.
+ * @param matches_crit A function that determines if an entry matches the
+ * criteria(NULL dumps all the entries).
+ * @param out The file descriptor to dump the entries to.
+ * @return The status of the operation.
+ */
+static enum status dump_slots(struct db_manager *db_mgr, const int64_t *slots,
+							  size_t count, dump_entry_func dump_entry,
+							  const void *criteria, match_crit_func matches_crit,
+							  FILE *out)
+{
+	char *buffer = NULL;
+	size_t max_run = count < db_mgr->block_slots ? count : db_mgr->block_slots;
+	enum status status = sync_cache(db_mgr);
+	uint64_t cnt = 0;
+
+	if (count > 0) {
+		buffer = buffer_pool_get(db_mgr->buffers,
+								 max_run * db_mgr->slot_size);
+		if (buffer == NULL)
+			return STATUS_ERROR;
+	}
+
+	for (size_t i = 0; i < count && status == STATUS_OK;) {
+		size_t run = slot_run_len(db_mgr, slots + i, count - i);
+
+		status = read_slots(db_mgr, slots[i], buffer, run);
+		if (status != STATUS_OK)
+			break;
+
+		for (size_t j = 0; j < run; ++j) {
+			char *slot = buffer + j * db_mgr->slot_size;
+
+			if (!slot_is_live(slot) ||
+				(matches_crit != NULL &&
+				 !matches_crit(slot_entry(slot), criteria)))
+				continue;
+			dump_entry(slot_entry(slot), out);
+			++cnt;
+		}
+		count_entries(db_mgr, run, 0);
+		i += run;
+	}
+	count_entries(db_mgr, 0, cnt);
+
+	if (cnt == 0)
+		dump_entry(NULL, out);
+
+	buffer_pool_put(db_mgr->buffers, buffer, max_run * db_mgr->slot_size);
+	return status;
+}
+enum status dump_database_by_group(struct db_manager *db_mgr,
+								   dump_entry_func dump_entry,
+								   const char *group, FILE *out)
+{
+	OP_SCOPE(db_mgr, DB_OP_DUMP_BY_GROUP);
+
+	if (db_mgr->groups == NULL)
+		return STATUS_ERROR;
+
+	size_t count;
+	int64_t *slots = copy_group_slots(db_mgr, group, &count);
+
+	// the posting lists are sorted, so the entries are dumped in file order
+	enum status status =
+		dump_slots(db_mgr, slots, count, dump_entry, NULL, NULL, out);
+
+	free(slots);
+	return status;
+}
+
+enum status dump_database_by_text(struct db_manager *db_mgr,
+								  dump_entry_func dump_entry,
+								  const char *pattern, enum text_match mode,
+								  FILE *out)
+{
+	OP_SCOPE(db_mgr, DB_OP_DUMP_BY_TEXT);
+
+	if (db_mgr->texts == NULL)
+		return STATUS_ERROR;
+
+	int64_t *slots;
+	size_t count = text_index_find(db_mgr->texts, pattern, mode, &slots);
+	enum status status =
+		dump_slots(db_mgr, slots, count, dump_entry, NULL, NULL, out);
+
+	free(slots);
+	return status;
+}
+
+enum status update_entries_by_range(struct db_manager *db_mgr, int64_t min,
+									int64_t max, const void *update_val,
+									update_func update)
+{
+	OP_SCOPE(db_mgr, DB_OP_UPDATE_BY_RANGE);
+
+	if (db_mgr->orders == NULL)
+		return STATUS_ERROR;
+
+	int64_t *slots;
+	size_t count = order_index_find(db_mgr->orders, min, max, &slots);
+	enum status status =
+		update_slots(db_mgr, slots, count, NULL, NULL, update_val, update);
+
+	free(slots);
+	return end_mutation(db_mgr, status);
+}
+
+enum status dump_database_by_range(struct db_manager *db_mgr,
+								   dump_entry_func dump_entry, int64_t min,
+								   int64_t max, FILE *out)
+{
+	OP_SCOPE(db_mgr, DB_OP_DUMP_BY_RANGE);
+
+	if (db_mgr->orders == NULL)
+		return STATUS_ERROR;
+
+	int64_t *slots;
+	size_t count = order_index_find(db_mgr->orders, min, max, &slots);
+	enum status status =
+		dump_slots(db_mgr, slots, count, dump_entry, NULL, NULL, out);
+
+	free(slots);
+	return status;
+}
+
+void get_cache_stats(const struct db_manager *db_mgr,
+					 struct record_cache_stats *stats)
+{
+	if (db_mgr->cache == NULL) {
+		*stats = (struct record_cache_stats){ 0 };
+		return;
+	}
+
+	record_cache_get_stats(db_mgr->cache, stats);
+}
+
+uint64_t count_group_entries(struct db_manager *db_mgr, const char *group)
+{
+	if (db_mgr->groups == NULL)
+		return 0;
+
+	int64_t id = group_index_lookup(db_mgr->groups, group);
+	size_t count = 0;
+
+	if (id != -1)
+		(void)group_index_slots(db_mgr->groups, (uint32_t)id, &count);
+	return count;
+}
+
+static int compare_slots(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t *)a;
+	int64_t y = *(const int64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+uint64_t count_range_entries(struct db_manager *db_mgr, int64_t min,
+							 int64_t max)
+{
+	if (db_mgr->orders == NULL)
+		return 0;
+	return order_index_count(db_mgr->orders, min, max);
+}
+
+// the slots of the sorted run whose key is inside a range
+static void sorted_key_range(struct db_manager *db_mgr, int64_t min,
+							 int64_t max, uint64_t *first, uint64_t *end)
+{
+	*first = sorted_lower_bound(db_mgr, min);
+	*end = max == INT64_MAX ? db_mgr->nr_sorted :
+							  sorted_lower_bound(db_mgr, max + 1);
+	if (*end < *first)
+		*end = *first;
+}
+
+uint64_t count_key_range_entries(struct db_manager *db_mgr, int64_t min,
+								 int64_t max)
+{
+	uint64_t first, end;
+
+	if (!db_mgr->sorted)
+		return 0;
+
+	sorted_key_range(db_mgr, min, max, &first, &end);
+	return end - first + order_index_count(db_mgr->delta, min, max);
+}
+
+/*
+ * @brief Find the live slots of a sorted database whose key is inside a range:
+ * the slots of the sorted run between the positions of the bounds, followed by
+ * the slots of the delta.
+ * @return The slots, in increasing order.
+ */
+static int64_t *key_range_slots(struct db_manager *db_mgr, int64_t min,
+								int64_t max, size_t *count)
+{
+	int64_t *delta_slots;
+	size_t nr_delta =
+		order_index_find(db_mgr->delta, min, max, &delta_slots);
+	uint64_t first, end;
+	struct block_iter it;
+
+	sorted_key_range(db_mgr, min, max, &first, &end);
+	int64_t *slots = malloc((end - first + nr_delta + 1) * sizeof(*slots));
+	DIE(slots == NULL, "Error allocating buffer");
+
+	*count = 0;
+	block_iter_init_range(&it, db_mgr, first, end);
+	while (block_iter_next(&it)) {
+		for (size_t i = 0; i < it.count; ++i) {
+			if (block_iter_entry(&it, i) != NULL)
+				slots[(*count)++] = (int64_t)(it.first_idx + i);
+		}
+	}
+	DIE(block_iter_end(&it) != STATUS_OK, "Error reading database");
+
+	memcpy(slots + *count, delta_slots, nr_delta * sizeof(*slots));
+	*count += nr_delta;
+	free(delta_slots);
+	return slots;
+}
+
+/*
+ * @brief Find the slots selected by an index lookup.
+ * @return The slots, in increasing order, or NULL if none was found.
+ */
+static int64_t *lookup_slots(struct db_manager *db_mgr,
+							 const struct db_lookup *lookup, size_t *count)
+{
+	int64_t *slots = NULL;
+	size_t capacity = 0;
+	uint64_t cursor = 0;
+	int64_t idx;
+
+	*count = 0;
+	switch (lookup->kind) {
+	case DB_LOOKUP_KEY:
+		while ((idx = next_key_slot(db_mgr, lookup->key, &cursor)) != -1) {
+			if (*count == capacity) {
+				capacity = capacity ? capacity * 2 : 4;
+				slots = realloc(slots, capacity * sizeof(*slots));
+				DIE(slots == NULL, "Error allocating buffer");
+			}
+			slots[(*count)++] = idx;
+		}
+		// the hash index yields the slots of a key in no particular order
+		if (!db_mgr->sorted)
+			qsort(slots, *count, sizeof(*slots), compare_slots);
+		return slots;
+	case DB_LOOKUP_GROUP:
+		return copy_group_slots(db_mgr, lookup->pattern, count);
+	case DB_LOOKUP_TEXT:
+		*count = text_index_find(db_mgr->texts, lookup->pattern, lookup->mode,
+								 &slots);
+		return slots;
+	case DB_LOOKUP_RANGE:
+		*count = order_index_find(db_mgr->orders, lookup->min, lookup->max,
+								  &slots);
+		return slots;
+	case DB_LOOKUP_KEY_RANGE:
+		return key_range_slots(db_mgr, lookup->min, lookup->max, count);
+	}
+	return NULL;
+}
+
+enum status select_entries(struct db_manager *db_mgr,
+						   const struct db_lookup *lookup,
+						   struct db_selection *selection)
+{
+	OP_SCOPE(db_mgr, DB_OP_SELECT);
+
+	if ((lookup->kind == DB_LOOKUP_KEY && db_mgr->key_of == NULL) ||
+		(lookup->kind == DB_LOOKUP_GROUP && db_mgr->groups == NULL) ||
+		(lookup->kind == DB_LOOKUP_TEXT && db_mgr->texts == NULL) ||
+		(lookup->kind == DB_LOOKUP_RANGE && db_mgr->orders == NULL) ||
+		(lookup->kind == DB_LOOKUP_KEY_RANGE && !db_mgr->sorted))
+		return STATUS_ERROR;
+
+	size_t count;
+	int64_t *slots = lookup_slots(db_mgr, lookup, &count);
+	count_entries(db_mgr, 0, count);
+
+	if (selection->count == 0) {
+		free(selection->slots);
+		selection->slots = slots;
+		selection->count = count;
+		return STATUS_OK;
+	}
+
+	// merge the two sorted lists, dropping the slots selected twice
+	int64_t *merged =
+		malloc((selection->count + count) * sizeof(*merged));
+	DIE(merged == NULL, "Error allocating buffer");
+
+	size_t i = 0, j = 0, len = 0;
+	while (i < selection->count || j < count) {
+		int64_t next;
+
+		if (j == count ||
+			(i < selection->count && selection->slots[i] <= slots[j]))
+			next = selection->slots[i++];
+		else
+			next = slots[j++];
+		if (len == 0 || merged[len - 1] != next)
+			merged[len++] = next;
+	}
+
+	free(slots);
+	free(selection->slots);
+	selection->slots = merged;
+	selection->count = len;
+	return STATUS_OK;
+}
+
+void free_selection(struct db_selection *selection)
+{
+	free(selection->slots);
+	selection->slots = NULL;
+	selection->count = 0;
+}
+
+enum status dump_selection(struct db_manager *db_mgr,
+						   const struct db_selection *selection,
+						   dump_entry_func dump_entry, const void *criteria,
+						   match_crit_func matches_crit, FILE *out)
+{
+	OP_SCOPE(db_mgr, DB_OP_DUMP_SELECTION);
+
+	return dump_slots(db_mgr, selection->slots, selection->count, dump_entry,
+					  criteria, matches_crit, out);
+}
+
+enum status update_selection(struct db_manager *db_mgr,
+							 const struct db_selection *selection,
+							 const void *criteria,
+							 match_crit_func should_update,
+							 const void *update_val, update_func update)
+{
+	OP_SCOPE(db_mgr, DB_OP_UPDATE_SELECTION);
+	enum status status =
+		update_slots(db_mgr, selection->slots, selection->count, criteria,
+					 should_update, update_val, update);
+	return end_mutation(db_mgr, status);
 }
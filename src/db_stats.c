@@ -0,0 +1,210 @@
+#include "db_stats.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define COUNTER_ADD(counter, n) \
+	((void)__atomic_fetch_add(&(counter), (n), __ATOMIC_RELAXED))
+
+struct db_stats {
+	struct db_op_stats ops[DB_NR_OPS];
+	// the outermost operation being measured and its start
+	enum db_op current;
+	unsigned depth;
+	uint64_t start_ns;
+};
+
+static const char *const op_names[DB_NR_OPS] = {
+	[DB_OP_OTHER] = "other",
+	[DB_OP_APPEND] = "append",
+	[DB_OP_APPEND_BATCH] = "append_batch",
+	[DB_OP_FIND_BY_KEY] = "find_by_key",
+	[DB_OP_UPDATE] = "update",
+	[DB_OP_UPDATE_BY_KEY] = "update_by_key",
+	[DB_OP_UPDATE_BY_GROUP] = "update_by_group",
+	[DB_OP_UPDATE_BY_RANGE] = "update_by_range",
+	[DB_OP_UPDATE_SELECTION] = "update_selection",
+	[DB_OP_REMOVE] = "remove",
+	[DB_OP_REMOVE_BY_KEY] = "remove_by_key",
+	[DB_OP_DUMP] = "dump",
+	[DB_OP_DUMP_BY_GROUP] = "dump_by_group",
+	[DB_OP_DUMP_BY_TEXT] = "dump_by_text",
+	[DB_OP_DUMP_BY_RANGE] = "dump_by_range",
+	[DB_OP_DUMP_SELECTION] = "dump_selection",
+	[DB_OP_DUMP_SNAPSHOT] = "dump_snapshot",
+	[DB_OP_SELECT] = "select",
+	[DB_OP_AGGREGATE] = "aggregate",
+	[DB_OP_COMPACT] = "compact",
+	[DB_OP_COMMIT] = "commit",
+	[DB_OP_SNAPSHOT] = "snapshot",
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+struct db_stats *db_stats_create(void)
+{
+	struct db_stats *stats = calloc(1, sizeof(*stats));
+	DIE(stats == NULL, "Error allocating statistics");
+
+	return stats;
+}
+
+void db_stats_destroy(struct db_stats *stats)
+{
+	free(stats);
+}
+
+void db_stats_reset(struct db_stats *stats)
+{
+	memset(stats->ops, 0, sizeof(stats->ops));
+}
+
+const char *db_op_name(enum db_op op)
+{
+	return op < DB_NR_OPS ? op_names[op] : "unknown";
+}
+
+bool db_op_parse(const char *name, enum db_op *op)
+{
+	for (int i = 0; i < DB_NR_OPS; ++i) {
+		if (strcmp(op_names[i], name) == 0) {
+			*op = (enum db_op)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+void db_stats_begin(struct db_stats *stats, enum db_op op)
+{
+	if (stats->depth++ > 0)
+		return;
+
+	stats->current = op;
+	stats->start_ns = now_ns();
+}
+
+// the bucket of a latency: the number of bits of its microseconds
+static unsigned latency_bucket(uint64_t ns)
+{
+	uint64_t us = ns / 1000;
+	unsigned bucket = 0;
+
+	while (us > 0 && bucket < DB_STATS_LATENCY_BUCKETS - 1) {
+		us >>= 1;
+		++bucket;
+	}
+	return bucket;
+}
+
+void db_stats_end(struct db_stats *stats)
+{
+	if (stats->depth == 0 || --stats->depth > 0)
+		return;
+
+	struct db_op_stats *op_stats = &stats->ops[stats->current];
+	uint64_t ns = now_ns() - stats->start_ns;
+
+	++op_stats->count;
+	op_stats->total_ns += ns;
+	if (ns > op_stats->max_ns)
+		op_stats->max_ns = ns;
+	++op_stats->latency[latency_bucket(ns)];
+	stats->current = DB_OP_OTHER;
+}
+
+void db_stats_add_entries(struct db_stats *stats, uint64_t scanned,
+						  uint64_t matched)
+{
+	struct db_op_stats *op_stats = &stats->ops[stats->current];
+
+	COUNTER_ADD(op_stats->scanned, scanned);
+	COUNTER_ADD(op_stats->matched, matched);
+}
+
+void db_stats_add_io(struct db_stats *stats, uint64_t bytes_read,
+					 uint64_t bytes_written, uint64_t syscalls)
+{
+	struct db_op_stats *op_stats = &stats->ops[stats->current];
+
+	COUNTER_ADD(op_stats->bytes_read, bytes_read);
+	COUNTER_ADD(op_stats->bytes_written, bytes_written);
+	COUNTER_ADD(op_stats->syscalls, syscalls);
+}
+
+void db_stats_get(const struct db_stats *stats, enum db_op op,
+				  struct db_op_stats *op_stats)
+{
+	*op_stats = stats->ops[op];
+}
+
+double db_stats_percentile(const struct db_op_stats *op_stats, double p)
+{
+	if (op_stats->count == 0)
+		return 0;
+
+	uint64_t rank = (uint64_t)(p * (double)op_stats->count);
+	if (rank == 0)
+		rank = 1;
+
+	uint64_t seen = 0;
+	for (unsigned b = 0; b < DB_STATS_LATENCY_BUCKETS; ++b) {
+		seen += op_stats->latency[b];
+		if (seen >= rank)
+			return (double)((uint64_t)1 << b);
+	}
+	return (double)op_stats->max_ns / 1000;
+}
+
+void db_stats_write_text(const struct db_stats *stats, FILE *out)
+{
+	fprintf(out, "%-17s %8s %12s %12s %14s %14s %10s %10s %10s %10s\n",
+			"operatie", "numar", "parcurse", "gasite", "octeti_cititi",
+			"octeti_scrisi", "apeluri", "p50_us", "p99_us", "max_us");
+
+	for (int op = 0; op < DB_NR_OPS; ++op) {
+		const struct db_op_stats *s = &stats->ops[op];
+		if (s->count == 0 && s->syscalls == 0 && s->bytes_read == 0 &&
+			s->bytes_written == 0)
+			continue;
+
+		fprintf(out,
+				"%-17s %8" PRIu64 " %12" PRIu64 " %12" PRIu64 " %14" PRIu64
+				" %14" PRIu64 " %10" PRIu64 " %10.0f %10.0f %10.0f\n",
+				op_names[op], s->count, s->scanned, s->matched, s->bytes_read,
+				s->bytes_written, s->syscalls, db_stats_percentile(s, 0.5),
+				db_stats_percentile(s, 0.99), (double)s->max_ns / 1000);
+	}
+}
+
+enum status db_stats_write_json(const struct db_stats *stats, FILE *out)
+{
+	fprintf(out, "{");
+	for (int op = 0; op < DB_NR_OPS; ++op) {
+		const struct db_op_stats *s = &stats->ops[op];
+
+		fprintf(out,
+				"%s\n  \"%s\": {\"count\": %" PRIu64 ", \"scanned\": %" PRIu64
+				", \"matched\": %" PRIu64 ", \"bytes_read\": %" PRIu64
+				", \"bytes_written\": %" PRIu64 ", \"syscalls\": %" PRIu64
+				", \"total_ns\": %" PRIu64 ", \"max_ns\": %" PRIu64
+				", \"latency_us_log2\": [",
+				op == 0 ? "" : ",", op_names[op], s->count, s->scanned,
+				s->matched, s->bytes_read, s->bytes_written, s->syscalls,
+				s->total_ns, s->max_ns);
+		for (unsigned b = 0; b < DB_STATS_LATENCY_BUCKETS; ++b)
+			fprintf(out, "%s%" PRIu64, b == 0 ? "" : ", ", s->latency[b]);
+		fprintf(out, "]}");
+	}
+	fprintf(out, "\n}\n");
+
+	return ferror(out) ? STATUS_ERROR : STATUS_OK;
+}
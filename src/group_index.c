@@ -0,0 +1,342 @@
+#define _GNU_SOURCE
+
+#include "group_index.h"
+
+#include "error.h"
+#include "posting_list.h"
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#define GROUP_INDEX_MAGIC "DBGIDX02"
+#define GROUP_TABLE_MIN_CAPACITY 64
+#define GROUP_EMPTY UINT32_MAX
+
+/*
+ * The index file holds the header, followed by each group in id order: the
+ * length of its name, the name, the number of slots, the slots and the running
+ * sums of the group.
+ */
+struct group_file_header {
+	char magic[8];
+	uint64_t nr_groups;
+	uint64_t data_size;
+	uint64_t data_mtime;
+	uint32_t clean;
+	uint32_t nr_sums;
+};
+
+struct group_index {
+	char *path;
+	// the names as first seen, indexed by id
+	char **names;
+	struct posting_list *postings;
+	// nr_sums running sums per group, indexed by id
+	int64_t *sums;
+	uint32_t nr_sums;
+	uint32_t nr_groups;
+	uint32_t groups_capacity;
+	// open addressing table of ids, hashed by name
+	uint32_t *table;
+	uint32_t table_capacity;
+};
+
+static char *copy_name(const char *name)
+{
+	char *copy = strdup(name);
+	DIE(copy == NULL, "Error allocating group name");
+
+	return copy;
+}
+
+static uint64_t hash_name(const char *name)
+{
+	// FNV-1a over the case folded name
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	for (; *name != '\0'; ++name) {
+		hash ^= (uint8_t)tolower((unsigned char)*name);
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static void table_place(struct group_index *gi, uint32_t id)
+{
+	uint32_t mask = gi->table_capacity - 1;
+	uint32_t pos = hash_name(gi->names[id]) & mask;
+
+	while (gi->table[pos] != GROUP_EMPTY)
+		pos = (pos + 1) & mask;
+	gi->table[pos] = id;
+}
+
+static void table_resize(struct group_index *gi, uint32_t capacity)
+{
+	free(gi->table);
+	gi->table = malloc(capacity * sizeof(*gi->table));
+	DIE(gi->table == NULL, "Error allocating group table");
+
+	gi->table_capacity = capacity;
+	memset(gi->table, 0xff, capacity * sizeof(*gi->table));
+	for (uint32_t id = 0; id < gi->nr_groups; ++id)
+		table_place(gi, id);
+}
+
+/*
+ * @brief Add a name to the dictionary, taking ownership of it.
+ * @return The id of the name.
+ */
+static uint32_t add_group(struct group_index *gi, char *name)
+{
+	if (gi->nr_groups == gi->groups_capacity) {
+		gi->groups_capacity =
+			gi->groups_capacity ? gi->groups_capacity * 2 : 16;
+		gi->names =
+			realloc(gi->names, gi->groups_capacity * sizeof(*gi->names));
+		gi->postings = realloc(gi->postings,
+							   gi->groups_capacity * sizeof(*gi->postings));
+		gi->sums = realloc(gi->sums, (size_t)gi->groups_capacity *
+										 gi->nr_sums * sizeof(*gi->sums));
+		DIE(gi->names == NULL || gi->postings == NULL ||
+				(gi->sums == NULL && gi->nr_sums > 0),
+			"Error allocating group dictionary");
+	}
+
+	uint32_t id = gi->nr_groups++;
+	gi->names[id] = name;
+	gi->postings[id] = (struct posting_list){ 0 };
+	if (gi->nr_sums > 0)
+		memset(gi->sums + (size_t)id * gi->nr_sums, 0,
+			   gi->nr_sums * sizeof(*gi->sums));
+
+	// keep the table at most half full
+	if (gi->nr_groups * 2 > gi->table_capacity)
+		table_resize(gi, gi->table_capacity * 2);
+	else
+		table_place(gi, id);
+
+	return id;
+}
+
+static struct group_index *alloc_group_index(const char *path,
+											 uint32_t nr_sums)
+{
+	struct group_index *gi = calloc(1, sizeof(*gi));
+	DIE(gi == NULL, "Error allocating group index");
+
+	gi->path = strdup(path);
+	DIE(gi->path == NULL, "Error allocating group index");
+	gi->nr_sums = nr_sums;
+	table_resize(gi, GROUP_TABLE_MIN_CAPACITY);
+
+	return gi;
+}
+
+static void free_group_index(struct group_index *gi)
+{
+	for (uint32_t id = 0; id < gi->nr_groups; ++id) {
+		free(gi->names[id]);
+		posting_list_free(&gi->postings[id]);
+	}
+	free(gi->names);
+	free(gi->postings);
+	free(gi->sums);
+	free(gi->table);
+	free(gi->path);
+	free(gi);
+}
+
+/*
+ * @brief Write a header marking the index file as out of sync with the data
+ * file, until the index is closed.
+ */
+static void mark_unclean(FILE *file)
+{
+	struct group_file_header hdr = { 0 };
+	memcpy(hdr.magic, GROUP_INDEX_MAGIC, sizeof(hdr.magic));
+
+	DIE(fseek(file, 0, SEEK_SET) != 0 ||
+			fwrite(&hdr, sizeof(hdr), 1, file) != 1 || fflush(file) != 0,
+		"Error writing group index");
+}
+
+static bool read_group(struct group_index *gi, FILE *file)
+{
+	uint32_t name_len;
+
+	if (fread(&name_len, sizeof(name_len), 1, file) != 1)
+		return false;
+
+	char *name = malloc((size_t)name_len + 1);
+	DIE(name == NULL, "Error allocating group name");
+
+	if (fread(name, 1, name_len, file) != name_len) {
+		free(name);
+		return false;
+	}
+	name[name_len] = '\0';
+
+	uint32_t id = add_group(gi, name);
+	return posting_list_read(&gi->postings[id], file) &&
+		   (gi->nr_sums == 0 ||
+			fread(gi->sums + (size_t)id * gi->nr_sums, sizeof(*gi->sums),
+				  gi->nr_sums, file) == gi->nr_sums);
+}
+
+struct group_index *group_index_open(const char *path, size_t nr_sums,
+									 uint64_t data_size, uint64_t data_mtime)
+{
+	FILE *file = fopen(path, "r+b");
+	if (file == NULL)
+		return NULL;
+
+	struct group_file_header hdr;
+	if (fread(&hdr, sizeof(hdr), 1, file) != 1 ||
+		memcmp(hdr.magic, GROUP_INDEX_MAGIC, sizeof(hdr.magic)) != 0 ||
+		!hdr.clean || hdr.nr_sums != nr_sums || hdr.data_size != data_size ||
+		hdr.data_mtime != data_mtime) {
+		(void)fclose(file);
+		return NULL;
+	}
+
+	struct group_index *gi = alloc_group_index(path, hdr.nr_sums);
+	for (uint64_t i = 0; i < hdr.nr_groups; ++i) {
+		if (!read_group(gi, file)) {
+			free_group_index(gi);
+			(void)fclose(file);
+			return NULL;
+		}
+	}
+
+	mark_unclean(file);
+	(void)fclose(file);
+	return gi;
+}
+
+struct group_index *group_index_create(const char *path, size_t nr_sums)
+{
+	FILE *file = fopen(path, "wb");
+	DIE(file == NULL, "Error creating group index");
+
+	mark_unclean(file);
+	(void)fclose(file);
+	return alloc_group_index(path, (uint32_t)nr_sums);
+}
+
+void group_index_close(struct group_index *gi, uint64_t data_size,
+					   uint64_t data_mtime)
+{
+	if (gi == NULL)
+		return;
+
+	FILE *file = fopen(gi->path, "wb");
+	DIE(file == NULL, "Error writing group index");
+
+	struct group_file_header hdr = { .nr_groups = gi->nr_groups,
+									 .data_size = data_size,
+									 .data_mtime = data_mtime,
+									 .nr_sums = gi->nr_sums };
+	memcpy(hdr.magic, GROUP_INDEX_MAGIC, sizeof(hdr.magic));
+	DIE(fwrite(&hdr, sizeof(hdr), 1, file) != 1, "Error writing group index");
+
+	for (uint32_t id = 0; id < gi->nr_groups; ++id) {
+		uint32_t name_len = (uint32_t)strlen(gi->names[id]);
+
+		DIE(fwrite(&name_len, sizeof(name_len), 1, file) != 1 ||
+				fwrite(gi->names[id], 1, name_len, file) != name_len ||
+				!posting_list_write(&gi->postings[id], file) ||
+				(gi->nr_sums > 0 &&
+				 fwrite(gi->sums + (size_t)id * gi->nr_sums, sizeof(*gi->sums),
+						gi->nr_sums, file) != gi->nr_sums),
+			"Error writing group index");
+	}
+
+	// only mark the index as clean once all the groups are on disk
+	DIE(fflush(file) != 0 || fdatasync(fileno(file)) != 0,
+		"Error writing group index");
+	hdr.clean = 1;
+	DIE(fseek(file, 0, SEEK_SET) != 0 ||
+			fwrite(&hdr, sizeof(hdr), 1, file) != 1,
+		"Error writing group index");
+	(void)fclose(file);
+
+	free_group_index(gi);
+}
+
+int64_t group_index_lookup(const struct group_index *gi, const char *name)
+{
+	uint32_t mask = gi->table_capacity - 1;
+	uint32_t pos = hash_name(name) & mask;
+
+	for (; gi->table[pos] != GROUP_EMPTY; pos = (pos + 1) & mask) {
+		if (strcasecmp(gi->names[gi->table[pos]], name) == 0)
+			return gi->table[pos];
+	}
+
+	return -1;
+}
+
+uint32_t group_index_intern(struct group_index *gi, const char *name)
+{
+	int64_t id = group_index_lookup(gi, name);
+
+	if (id != -1)
+		return (uint32_t)id;
+	return add_group(gi, copy_name(name));
+}
+
+void group_index_insert(struct group_index *gi, uint32_t id, int64_t slot)
+{
+	posting_list_insert(&gi->postings[id], slot);
+}
+
+enum status group_index_remove(struct group_index *gi, uint32_t id,
+							   int64_t slot)
+{
+	return posting_list_remove(&gi->postings[id], slot);
+}
+
+const int64_t *group_index_slots(const struct group_index *gi, uint32_t id,
+								 size_t *count)
+{
+	*count = gi->postings[id].len;
+	return gi->postings[id].slots;
+}
+
+void group_index_add_sums(struct group_index *gi, uint32_t id,
+						  const int64_t *values, int64_t factor)
+{
+	int64_t *sums = gi->sums + (size_t)id * gi->nr_sums;
+
+	for (uint32_t i = 0; i < gi->nr_sums; ++i)
+		sums[i] += factor * values[i];
+}
+
+const int64_t *group_index_sums(const struct group_index *gi, uint32_t id)
+{
+	return gi->sums + (size_t)id * gi->nr_sums;
+}
+
+uint32_t group_index_nr_groups(const struct group_index *gi)
+{
+	return gi->nr_groups;
+}
+
+const char *group_index_name(const struct group_index *gi, uint32_t id)
+{
+	return gi->names[id];
+}
+
+void group_index_clear(struct group_index *gi)
+{
+	for (uint32_t id = 0; id < gi->nr_groups; ++id)
+		gi->postings[id].len = 0;
+	if (gi->nr_groups > 0 && gi->nr_sums > 0)
+		memset(gi->sums, 0,
+			   (size_t)gi->nr_groups * gi->nr_sums * sizeof(*gi->sums));
+}
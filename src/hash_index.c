@@ -0,0 +1,283 @@
+#define _GNU_SOURCE
+
+#include "hash_index.h"
+
+#include "error.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define HASH_INDEX_MAGIC "DBHIDX01"
+#define HASH_INDEX_MIN_CAPACITY 1024
+// maximum percentage of non-empty buckets before the table is rehashed
+#define HASH_INDEX_MAX_LOAD 70
+
+#define BUCKET_EMPTY (-1)
+#define BUCKET_DELETED (-2)
+
+struct index_header {
+	char magic[8];
+	uint64_t capacity;
+	uint64_t used;
+	uint64_t deleted;
+	uint64_t data_size;
+	uint64_t data_mtime;
+	uint32_t clean;
+	uint32_t reserved[3];
+};
+
+struct index_bucket {
+	int64_t key;
+	int64_t slot;
+};
+
+struct hash_index {
+	int fd;
+	size_t map_len;
+	struct index_header *hdr;
+	struct index_bucket *buckets;
+};
+
+static uint64_t hash_key(int64_t key)
+{
+	// splitmix64 finalizer
+	uint64_t x = (uint64_t)key;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+static size_t map_len_for(uint64_t capacity)
+{
+	return sizeof(struct index_header) +
+		   capacity * sizeof(struct index_bucket);
+}
+
+static void set_mapping(struct hash_index *idx, void *map, size_t map_len)
+{
+	idx->map_len = map_len;
+	idx->hdr = map;
+	idx->buckets = (struct index_bucket *)(idx->hdr + 1);
+}
+
+static uint64_t capacity_for(uint64_t keys)
+{
+	uint64_t capacity = HASH_INDEX_MIN_CAPACITY;
+	while (capacity * HASH_INDEX_MAX_LOAD / 100 <= keys)
+		capacity <<= 1;
+	return capacity;
+}
+
+struct hash_index *hash_index_open(const char *path, uint64_t data_size,
+								   uint64_t data_mtime)
+{
+	int fd = open(path, O_RDWR);
+	if (fd < 0)
+		return NULL;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 ||
+		(size_t)st.st_size < map_len_for(HASH_INDEX_MIN_CAPACITY)) {
+		(void)close(fd);
+		return NULL;
+	}
+
+	void *map =
+		mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		(void)close(fd);
+		return NULL;
+	}
+
+	const struct index_header *hdr = map;
+	if (memcmp(hdr->magic, HASH_INDEX_MAGIC, sizeof(hdr->magic)) != 0 ||
+		!hdr->clean || hdr->data_size != data_size ||
+		hdr->data_mtime != data_mtime ||
+		map_len_for(hdr->capacity) != (size_t)st.st_size) {
+		(void)munmap(map, st.st_size);
+		(void)close(fd);
+		return NULL;
+	}
+
+	struct hash_index *idx = malloc(sizeof(*idx));
+	DIE(idx == NULL, "Error allocating index");
+
+	idx->fd = fd;
+	set_mapping(idx, map, st.st_size);
+	// the index will be out of sync with the data file until it is closed
+	idx->hdr->clean = 0;
+
+	return idx;
+}
+
+struct hash_index *hash_index_create(const char *path, uint64_t expected_keys)
+{
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	DIE(fd < 0, "Error creating index");
+
+	uint64_t capacity = capacity_for(expected_keys);
+	size_t map_len = map_len_for(capacity);
+	DIE(ftruncate(fd, (off_t)map_len) != 0, "Error resizing index");
+
+	void *map = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	DIE(map == MAP_FAILED, "Error mapping index");
+
+	struct hash_index *idx = malloc(sizeof(*idx));
+	DIE(idx == NULL, "Error allocating index");
+
+	idx->fd = fd;
+	set_mapping(idx, map, map_len);
+
+	memcpy(idx->hdr->magic, HASH_INDEX_MAGIC, sizeof(idx->hdr->magic));
+	idx->hdr->capacity = capacity;
+	// every bucket starts out empty(key and slot set to -1)
+	memset(idx->buckets, 0xff, capacity * sizeof(struct index_bucket));
+
+	return idx;
+}
+
+void hash_index_close(struct hash_index *idx, uint64_t data_size,
+					  uint64_t data_mtime)
+{
+	if (idx == NULL)
+		return;
+
+	idx->hdr->data_size = data_size;
+	idx->hdr->data_mtime = data_mtime;
+	(void)msync(idx->hdr, idx->map_len, MS_SYNC);
+	// only mark the index as clean once all the buckets are on disk
+	idx->hdr->clean = 1;
+	(void)munmap(idx->hdr, idx->map_len);
+	(void)close(idx->fd);
+	free(idx);
+}
+
+static void place_key(struct hash_index *idx, int64_t key, int64_t slot)
+{
+	uint64_t mask = idx->hdr->capacity - 1;
+	uint64_t pos = hash_key(key) & mask;
+
+	while (idx->buckets[pos].slot >= 0)
+		pos = (pos + 1) & mask;
+
+	if (idx->buckets[pos].slot == BUCKET_DELETED)
+		--idx->hdr->deleted;
+
+	idx->buckets[pos].key = key;
+	idx->buckets[pos].slot = slot;
+	++idx->hdr->used;
+}
+
+/*
+ * @brief Rebuild the table with enough capacity for the used buckets plus the
+ * given number of keys, dropping the deleted buckets.
+ * @param idx The index.
+ * @param extra_keys The number of keys about to be inserted.
+ */
+static void rehash(struct hash_index *idx, uint64_t extra_keys)
+{
+	uint64_t old_capacity = idx->hdr->capacity;
+	uint64_t new_capacity = capacity_for(idx->hdr->used + extra_keys);
+	size_t old_size = old_capacity * sizeof(struct index_bucket);
+
+	struct index_bucket *old = malloc(old_size);
+	DIE(old == NULL, "Error allocating rehash buffer");
+	memcpy(old, idx->buckets, old_size);
+
+	size_t new_len = map_len_for(new_capacity);
+	if (new_len != idx->map_len) {
+		DIE(ftruncate(idx->fd, (off_t)new_len) != 0, "Error resizing index");
+		void *map = mremap(idx->hdr, idx->map_len, new_len, MREMAP_MAYMOVE);
+		DIE(map == MAP_FAILED, "Error remapping index");
+		set_mapping(idx, map, new_len);
+	}
+
+	idx->hdr->capacity = new_capacity;
+	idx->hdr->used = 0;
+	idx->hdr->deleted = 0;
+	memset(idx->buckets, 0xff, new_capacity * sizeof(struct index_bucket));
+
+	for (uint64_t i = 0; i < old_capacity; ++i) {
+		if (old[i].slot >= 0)
+			place_key(idx, old[i].key, old[i].slot);
+	}
+
+	free(old);
+}
+
+enum status hash_index_insert(struct hash_index *idx, int64_t key,
+							  int64_t slot)
+{
+	if (slot < 0)
+		return STATUS_ERROR;
+
+	if ((idx->hdr->used + idx->hdr->deleted + 1) * 100 >
+		idx->hdr->capacity * HASH_INDEX_MAX_LOAD)
+		rehash(idx, 1);
+
+	place_key(idx, key, slot);
+	return STATUS_OK;
+}
+
+void hash_index_reserve(struct hash_index *idx, uint64_t nr_keys)
+{
+	if ((idx->hdr->used + idx->hdr->deleted + nr_keys) * 100 >
+		idx->hdr->capacity * HASH_INDEX_MAX_LOAD)
+		rehash(idx, nr_keys);
+}
+
+enum status hash_index_remove(struct hash_index *idx, int64_t key,
+							  int64_t slot)
+{
+	uint64_t mask = idx->hdr->capacity - 1;
+	uint64_t pos = hash_key(key) & mask;
+
+	for (uint64_t i = 0; i < idx->hdr->capacity; ++i) {
+		struct index_bucket *bucket = &idx->buckets[pos];
+		if (bucket->slot == BUCKET_EMPTY)
+			break;
+		if (bucket->slot == slot && bucket->key == key) {
+			bucket->slot = BUCKET_DELETED;
+			--idx->hdr->used;
+			++idx->hdr->deleted;
+			return STATUS_OK;
+		}
+		pos = (pos + 1) & mask;
+	}
+
+	return STATUS_NOT_FOUND;
+}
+
+int64_t hash_index_next(const struct hash_index *idx, int64_t key,
+						uint64_t *cursor)
+{
+	uint64_t capacity = idx->hdr->capacity;
+	uint64_t mask = capacity - 1;
+	uint64_t start = hash_key(key) & mask;
+
+	for (; *cursor < capacity; ++*cursor) {
+		const struct index_bucket *bucket =
+			&idx->buckets[(start + *cursor) & mask];
+		if (bucket->slot == BUCKET_EMPTY)
+			break;
+		if (bucket->slot >= 0 && bucket->key == key) {
+			++*cursor;
+			return bucket->slot;
+		}
+	}
+
+	*cursor = capacity;
+	return -1;
+}
+
+void hash_index_clear(struct hash_index *idx)
+{
+	idx->hdr->used = 0;
+	idx->hdr->deleted = 0;
+	memset(idx->buckets, 0xff,
+		   idx->hdr->capacity * sizeof(struct index_bucket));
+}
@@ -1,10 +1,21 @@
 #include "cli.h"
+#include "script.h"
 
-int main(void)
+int main(int argc, char **argv)
 {
 	struct cli_program *cli_prog = create_cli_program();
-	while (cli_process_next_op(cli_prog) != STATUS_EXIT)
-		;
+	if (cli_parse_args(cli_prog, argc, argv) != STATUS_OK) {
+		destroy_cli_program(cli_prog);
+		return EXIT_FAILURE;
+	}
+
+	enum status status = STATUS_OK;
+	if (cli_prog->script_path != NULL)
+		status = script_run_file(cli_prog, cli_prog->script_path);
+	else
+		while (cli_process_next_op(cli_prog) != STATUS_EXIT)
+			;
 
 	destroy_cli_program(cli_prog);
+	return status == STATUS_OK ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,406 @@
+#define _GNU_SOURCE
+
+#include "order_index.h"
+
+#include "error.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define ORDER_INDEX_MAGIC "DBOIDX01"
+// the new values are sorted apart and merged with the others in batches
+#define ORDER_DELTA_MAX 4096
+
+/*
+ * The index file holds the header, followed by the (value, slot) pairs in
+ * sorted order.
+ */
+struct order_file_header {
+	char magic[8];
+	uint64_t nr_entries;
+	uint64_t data_size;
+	uint64_t data_mtime;
+	uint32_t clean;
+	uint32_t reserved;
+};
+
+struct order_entry {
+	int64_t value;
+	// the slot of the entry, complemented(negative) once it was removed
+	int64_t slot;
+};
+
+struct sorted_values {
+	struct order_entry *entries;
+	size_t len;
+	size_t capacity;
+};
+
+struct order_index {
+	char *path;
+	// sorted by value and slot; the removed entries are only dropped when the
+	// new values are merged in
+	struct sorted_values main;
+	size_t main_removed;
+	// the values added since the last merge, sorted by value and slot
+	struct sorted_values delta;
+};
+
+static inline int64_t entry_slot(const struct order_entry *entry)
+{
+	return entry->slot < 0 ? ~entry->slot : entry->slot;
+}
+
+static int compare_entry(int64_t value, int64_t slot,
+						 const struct order_entry *entry)
+{
+	int64_t other = entry_slot(entry);
+
+	if (value != entry->value)
+		return (value > entry->value) - (value < entry->value);
+	return (slot > other) - (slot < other);
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+	const struct order_entry *x = a;
+
+	return compare_entry(x->value, entry_slot(x), b);
+}
+
+/*
+ * @brief Find the first entry not smaller than (value, slot).
+ */
+static size_t lower_bound(const struct sorted_values *values, int64_t value,
+						  int64_t slot)
+{
+	size_t lo = 0;
+	size_t hi = values->len;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (compare_entry(value, slot, &values->entries[mid]) > 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/*
+ * @brief Get the range of the entries whose value is between min and max.
+ */
+static void value_range(const struct sorted_values *values, int64_t min,
+						int64_t max, size_t *first, size_t *end)
+{
+	*first = lower_bound(values, min, INT64_MIN);
+	*end = max == INT64_MAX ? values->len :
+							  lower_bound(values, max + 1, INT64_MIN);
+	if (*end < *first)
+		*end = *first;
+}
+
+static void reserve_values(struct sorted_values *values, size_t capacity)
+{
+	if (capacity <= values->capacity)
+		return;
+
+	values->entries =
+		realloc(values->entries, capacity * sizeof(*values->entries));
+	DIE(values->entries == NULL, "Error allocating order index");
+	values->capacity = capacity;
+}
+
+/*
+ * @brief Merge sorted values into the main run, dropping the removed entries
+ * of the run.
+ */
+static void merge_values(struct order_index *oi,
+						 const struct sorted_values *values)
+{
+	size_t len = oi->main.len - oi->main_removed + values->len;
+	struct order_entry *merged = malloc((len ? len : 1) * sizeof(*merged));
+	DIE(merged == NULL, "Error allocating order index");
+
+	size_t i = 0, j = 0, k = 0;
+	while (i < oi->main.len || j < values->len) {
+		if (i < oi->main.len && oi->main.entries[i].slot < 0) {
+			++i;
+			continue;
+		}
+		if (j == values->len ||
+			(i < oi->main.len &&
+			 compare_entries(&oi->main.entries[i], &values->entries[j]) < 0))
+			merged[k++] = oi->main.entries[i++];
+		else
+			merged[k++] = values->entries[j++];
+	}
+
+	free(oi->main.entries);
+	oi->main = (struct sorted_values){ .entries = merged,
+									   .len = k,
+									   .capacity = len ? len : 1 };
+	oi->main_removed = 0;
+}
+
+static void merge_delta(struct order_index *oi)
+{
+	merge_values(oi, &oi->delta);
+	oi->delta.len = 0;
+}
+
+static struct order_index *alloc_order_index(const char *path)
+{
+	struct order_index *oi = calloc(1, sizeof(*oi));
+	DIE(oi == NULL, "Error allocating order index");
+
+	if (path != NULL) {
+		oi->path = strdup(path);
+		DIE(oi->path == NULL, "Error allocating order index");
+	}
+	return oi;
+}
+
+static void free_order_index(struct order_index *oi)
+{
+	free(oi->main.entries);
+	free(oi->delta.entries);
+	free(oi->path);
+	free(oi);
+}
+
+/*
+ * @brief Write a header marking the index file as out of sync with the data
+ * file, until the index is closed.
+ */
+static void mark_unclean(FILE *file)
+{
+	struct order_file_header hdr = { 0 };
+	memcpy(hdr.magic, ORDER_INDEX_MAGIC, sizeof(hdr.magic));
+
+	DIE(fseek(file, 0, SEEK_SET) != 0 ||
+			fwrite(&hdr, sizeof(hdr), 1, file) != 1 || fflush(file) != 0,
+		"Error writing order index");
+}
+
+struct order_index *order_index_open(const char *path, uint64_t data_size,
+									 uint64_t data_mtime)
+{
+	FILE *file = fopen(path, "r+b");
+	if (file == NULL)
+		return NULL;
+
+	struct order_file_header hdr;
+	if (fread(&hdr, sizeof(hdr), 1, file) != 1 ||
+		memcmp(hdr.magic, ORDER_INDEX_MAGIC, sizeof(hdr.magic)) != 0 ||
+		!hdr.clean || hdr.data_size != data_size ||
+		hdr.data_mtime != data_mtime) {
+		(void)fclose(file);
+		return NULL;
+	}
+
+	struct order_index *oi = alloc_order_index(path);
+	reserve_values(&oi->main, hdr.nr_entries ? hdr.nr_entries : 1);
+	if (fread(oi->main.entries, sizeof(*oi->main.entries), hdr.nr_entries,
+			  file) != hdr.nr_entries) {
+		free_order_index(oi);
+		(void)fclose(file);
+		return NULL;
+	}
+	oi->main.len = hdr.nr_entries;
+
+	mark_unclean(file);
+	(void)fclose(file);
+	return oi;
+}
+
+struct order_index *order_index_create(const char *path)
+{
+	if (path == NULL)
+		return alloc_order_index(NULL);
+
+	FILE *file = fopen(path, "wb");
+	DIE(file == NULL, "Error creating order index");
+
+	mark_unclean(file);
+	(void)fclose(file);
+	return alloc_order_index(path);
+}
+
+void order_index_close(struct order_index *oi, uint64_t data_size,
+					   uint64_t data_mtime)
+{
+	if (oi == NULL)
+		return;
+	if (oi->path == NULL) {
+		free_order_index(oi);
+		return;
+	}
+
+	// a single sorted run without removed entries is written
+	merge_delta(oi);
+
+	FILE *file = fopen(oi->path, "wb");
+	DIE(file == NULL, "Error writing order index");
+
+	struct order_file_header hdr = { .nr_entries = oi->main.len,
+									 .data_size = data_size,
+									 .data_mtime = data_mtime };
+	memcpy(hdr.magic, ORDER_INDEX_MAGIC, sizeof(hdr.magic));
+	DIE(fwrite(&hdr, sizeof(hdr), 1, file) != 1 ||
+			fwrite(oi->main.entries, sizeof(*oi->main.entries), oi->main.len,
+				   file) != oi->main.len,
+		"Error writing order index");
+
+	// only mark the index as clean once all the values are on disk
+	DIE(fflush(file) != 0 || fdatasync(fileno(file)) != 0,
+		"Error writing order index");
+	hdr.clean = 1;
+	DIE(fseek(file, 0, SEEK_SET) != 0 ||
+			fwrite(&hdr, sizeof(hdr), 1, file) != 1,
+		"Error writing order index");
+	(void)fclose(file);
+
+	free_order_index(oi);
+}
+
+void order_index_insert(struct order_index *oi, int64_t value, int64_t slot)
+{
+	struct sorted_values *delta = &oi->delta;
+
+	if (delta->len == ORDER_DELTA_MAX)
+		merge_delta(oi);
+	reserve_values(delta, ORDER_DELTA_MAX);
+
+	size_t pos = lower_bound(delta, value, slot);
+	memmove(&delta->entries[pos + 1], &delta->entries[pos],
+			(delta->len - pos) * sizeof(*delta->entries));
+	delta->entries[pos] = (struct order_entry){ .value = value, .slot = slot };
+	++delta->len;
+}
+
+void order_index_insert_many(struct order_index *oi, const int64_t *values,
+							 const int64_t *slots, size_t count)
+{
+	if (count < ORDER_DELTA_MAX) {
+		for (size_t i = 0; i < count; ++i)
+			order_index_insert(oi, values[i], slots[i]);
+		return;
+	}
+
+	struct sorted_values batch = { 0 };
+	reserve_values(&batch, count);
+	for (size_t i = 0; i < count; ++i)
+		batch.entries[i] =
+			(struct order_entry){ .value = values[i], .slot = slots[i] };
+	batch.len = count;
+	qsort(batch.entries, count, sizeof(*batch.entries), compare_entries);
+
+	// the whole batch is merged at once, instead of ORDER_DELTA_MAX values at
+	// a time
+	if (oi->delta.len > 0)
+		merge_delta(oi);
+	merge_values(oi, &batch);
+	free(batch.entries);
+}
+
+enum status order_index_remove(struct order_index *oi, int64_t value,
+							   int64_t slot)
+{
+	struct sorted_values *delta = &oi->delta;
+	size_t pos = lower_bound(delta, value, slot);
+
+	if (pos < delta->len &&
+		compare_entry(value, slot, &delta->entries[pos]) == 0) {
+		memmove(&delta->entries[pos], &delta->entries[pos + 1],
+				(delta->len - pos - 1) * sizeof(*delta->entries));
+		--delta->len;
+		return STATUS_OK;
+	}
+
+	pos = lower_bound(&oi->main, value, slot);
+	if (pos == oi->main.len || oi->main.entries[pos].slot < 0 ||
+		compare_entry(value, slot, &oi->main.entries[pos]) != 0)
+		return STATUS_NOT_FOUND;
+
+	oi->main.entries[pos].slot = ~slot;
+	// drop the removed entries once they make up half of the run
+	if (++oi->main_removed * 2 > oi->main.len)
+		merge_delta(oi);
+	return STATUS_OK;
+}
+
+static int compare_slots(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t *)a;
+	int64_t y = *(const int64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+size_t order_index_find(const struct order_index *oi, int64_t min,
+						int64_t max, int64_t **slots)
+{
+	size_t main_first, main_end, delta_first, delta_end;
+
+	value_range(&oi->main, min, max, &main_first, &main_end);
+	value_range(&oi->delta, min, max, &delta_first, &delta_end);
+
+	size_t capacity = main_end - main_first + delta_end - delta_first;
+	*slots = malloc((capacity ? capacity : 1) * sizeof(**slots));
+	DIE(*slots == NULL, "Error allocating buffer");
+
+	size_t count = 0;
+	for (size_t i = main_first; i < main_end; ++i) {
+		if (oi->main.entries[i].slot >= 0)
+			(*slots)[count++] = oi->main.entries[i].slot;
+	}
+	for (size_t i = delta_first; i < delta_end; ++i)
+		(*slots)[count++] = oi->delta.entries[i].slot;
+
+	// the entries are sorted by value, the slots are returned in file order
+	qsort(*slots, count, sizeof(**slots), compare_slots);
+	return count;
+}
+
+int64_t order_index_next(const struct order_index *oi, int64_t value,
+						 int64_t slot)
+{
+	int64_t found = -1;
+
+	// the removed entries of the run are skipped
+	for (size_t i = lower_bound(&oi->main, value, slot);
+		 i < oi->main.len && oi->main.entries[i].value == value; ++i) {
+		if (oi->main.entries[i].slot >= 0) {
+			found = oi->main.entries[i].slot;
+			break;
+		}
+	}
+
+	size_t pos = lower_bound(&oi->delta, value, slot);
+	if (pos < oi->delta.len && oi->delta.entries[pos].value == value &&
+		(found == -1 || oi->delta.entries[pos].slot < found))
+		found = oi->delta.entries[pos].slot;
+	return found;
+}
+
+uint64_t order_index_count(const struct order_index *oi, int64_t min,
+						   int64_t max)
+{
+	size_t main_first, main_end, delta_first, delta_end;
+
+	value_range(&oi->main, min, max, &main_first, &main_end);
+	value_range(&oi->delta, min, max, &delta_first, &delta_end);
+	return main_end - main_first + delta_end - delta_first;
+}
+
+void order_index_clear(struct order_index *oi)
+{
+	oi->main.len = 0;
+	oi->main_removed = 0;
+	oi->delta.len = 0;
+}
@@ -0,0 +1,97 @@
+#include "posting_list.h"
+
+#include "error.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * @brief Get the position of the first slot not lower than the given one.
+ */
+static size_t lower_bound(const struct posting_list *list, int64_t slot)
+{
+	size_t lo = 0;
+	size_t hi = list->len;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (list->slots[mid] < slot)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static void reserve(struct posting_list *list, size_t capacity)
+{
+	if (capacity <= list->capacity)
+		return;
+
+	list->capacity = capacity;
+	list->slots = realloc(list->slots, capacity * sizeof(*list->slots));
+	DIE(list->slots == NULL, "Error allocating posting list");
+}
+
+void posting_list_insert(struct posting_list *list, int64_t slot)
+{
+	if (list->len == list->capacity)
+		reserve(list, list->capacity ? list->capacity * 2 : 4);
+
+	// new entries are appended at the end of the file, so most slots go last
+	size_t pos = list->len;
+	if (pos > 0 && list->slots[pos - 1] > slot) {
+		pos = lower_bound(list, slot);
+		memmove(list->slots + pos + 1, list->slots + pos,
+				(list->len - pos) * sizeof(*list->slots));
+	}
+
+	list->slots[pos] = slot;
+	++list->len;
+}
+
+enum status posting_list_remove(struct posting_list *list, int64_t slot)
+{
+	size_t pos = lower_bound(list, slot);
+
+	if (pos == list->len || list->slots[pos] != slot)
+		return STATUS_NOT_FOUND;
+
+	memmove(list->slots + pos, list->slots + pos + 1,
+			(list->len - pos - 1) * sizeof(*list->slots));
+	--list->len;
+	return STATUS_OK;
+}
+
+bool posting_list_contains(const struct posting_list *list, int64_t slot)
+{
+	size_t pos = lower_bound(list, slot);
+
+	return pos < list->len && list->slots[pos] == slot;
+}
+
+void posting_list_free(struct posting_list *list)
+{
+	free(list->slots);
+	*list = (struct posting_list){ 0 };
+}
+
+bool posting_list_write(const struct posting_list *list, FILE *file)
+{
+	uint64_t len = list->len;
+
+	return fwrite(&len, sizeof(len), 1, file) == 1 &&
+		   fwrite(list->slots, sizeof(*list->slots), len, file) == len;
+}
+
+bool posting_list_read(struct posting_list *list, FILE *file)
+{
+	uint64_t len;
+
+	if (fread(&len, sizeof(len), 1, file) != 1)
+		return false;
+
+	reserve(list, len ? len : 1);
+	list->len = len;
+	return fread(list->slots, sizeof(*list->slots), len, file) == len;
+}
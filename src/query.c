@@ -0,0 +1,787 @@
+#define _GNU_SOURCE
+#include "query.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// longest word or value of a query
+#define QUERY_MAX_WORD_LEN 64
+
+// estimated share of the entries matched by the conditions that are not
+// answered by the statistics of an index
+#define SELECTIVITY_NAME_EQ 0.001
+#define SELECTIVITY_PREFIX 0.01
+#define SELECTIVITY_CONTAINS 0.05
+#define SELECTIVITY_VALUE_EQ 0.01
+#define SELECTIVITY_RANGE 0.33
+
+static const struct {
+	const char *name;
+	enum query_field field;
+} query_fields[] = {
+	{ "barcode", QUERY_BARCODE },
+	{ "name", QUERY_NAME },
+	{ "category", QUERY_CATEGORY },
+	{ "price", QUERY_PRICE },
+	{ "quantity", QUERY_QUANTITY },
+	{ "expiry", QUERY_EXPIRY },
+	{ "expiry_date", QUERY_EXPIRY },
+};
+
+// the operators, the longer ones first so that "<=" is not read as "<"
+static const struct {
+	const char *text;
+	enum query_op op;
+} query_ops[] = {
+	{ "<=", QUERY_LE }, { ">=", QUERY_GE }, { "!=", QUERY_NE },
+	{ "^=", QUERY_PREFIX }, { "==", QUERY_EQ }, { "=", QUERY_EQ },
+	{ "<", QUERY_LT }, { ">", QUERY_GT }, { "~", QUERY_CONTAINS },
+};
+
+static const char *const field_names[] = {
+	[QUERY_BARCODE] = "barcode",   [QUERY_NAME] = "name",
+	[QUERY_CATEGORY] = "category", [QUERY_PRICE] = "price",
+	[QUERY_QUANTITY] = "quantity", [QUERY_EXPIRY] = "expiry",
+};
+
+static const char *const op_names[] = {
+	[QUERY_EQ] = "=",
+	[QUERY_NE] = "!=",
+	[QUERY_LT] = "<",
+	[QUERY_LE] = "<=",
+	[QUERY_GT] = ">",
+	[QUERY_GE] = ">=",
+	[QUERY_PREFIX] = "^=",
+	[QUERY_CONTAINS] = "~",
+};
+
+static const char *skip_spaces(const char *pos)
+{
+	while (isspace((unsigned char)*pos))
+		++pos;
+	return pos;
+}
+
+/*
+ * @brief Read a word made of letters and underscores.
+ * @return The position after the word or NULL if there is no word.
+ */
+static const char *read_word(const char *pos, char *word)
+{
+	size_t len = 0;
+
+	while (isalpha((unsigned char)pos[len]) || pos[len] == '_') {
+		if (len + 1 == QUERY_MAX_WORD_LEN)
+			return NULL;
+		word[len] = pos[len];
+		++len;
+	}
+	word[len] = '\0';
+	return len == 0 ? NULL : pos + len;
+}
+
+/*
+ * @brief Read a value, either quoted or running up to the next space.
+ * @return The position after the value or NULL if it is invalid.
+ */
+static const char *read_value(const char *pos, char *value)
+{
+	size_t len = 0;
+
+	if (*pos != '"') {
+		while (*pos != '\0' && !isspace((unsigned char)*pos)) {
+			if (len + 1 == QUERY_MAX_WORD_LEN)
+				return NULL;
+			value[len++] = *pos++;
+		}
+		value[len] = '\0';
+		return len == 0 ? NULL : pos;
+	}
+
+	for (++pos; *pos != '"'; ++pos) {
+		if (*pos == '\0' || len + 1 == QUERY_MAX_WORD_LEN)
+			return NULL;
+		if (*pos == '\\' && (pos[1] == '"' || pos[1] == '\\'))
+			++pos;
+		value[len++] = *pos;
+	}
+	value[len] = '\0';
+	return pos + 1;
+}
+
+static bool parse_number(const char *str, int64_t *val)
+{
+	char *end;
+
+	errno = 0;
+	long long parsed = strtoll(str, &end, 10);
+	if (end == str || *end != '\0' || errno == ERANGE || parsed < 0)
+		return false;
+
+	*val = parsed;
+	return true;
+}
+
+static bool parse_value(const char *str, struct query_cond *cond)
+{
+	bool is_text = cond->field == QUERY_NAME || cond->field == QUERY_CATEGORY;
+	int64_t number;
+	struct date date;
+	char *end;
+
+	// ^= and ~ only make sense on texts, <, <=, > and >= only on values
+	if (is_text ? cond->op >= QUERY_LT && cond->op <= QUERY_GE :
+				  cond->op == QUERY_PREFIX || cond->op == QUERY_CONTAINS)
+		return false;
+
+	switch (cond->field) {
+	case QUERY_BARCODE:
+		return parse_number(str, &cond->value.barcode);
+	case QUERY_QUANTITY:
+		if (!parse_number(str, &number))
+			return false;
+		cond->value.quantity = (uint64_t)number;
+		return true;
+	case QUERY_PRICE:
+		errno = 0;
+		cond->value.price = strtof(str, &end);
+		return end != str && *end == '\0' && errno != ERANGE &&
+			   isfinite(cond->value.price);
+	case QUERY_EXPIRY:
+		if (!parse_date(str, &date))
+			return false;
+		cond->value.date = pack_date(&date);
+		return true;
+	case QUERY_NAME:
+	case QUERY_CATEGORY:
+		if (*str == '\0' || strlen(str) >= sizeof(cond->value.text))
+			return false;
+		strcpy(cond->value.text, str);
+		return true;
+	}
+	return false;
+}
+
+/*
+ * @brief Parse a condition: a field, an operator and a value.
+ * @return The position after the condition or NULL if it is invalid.
+ */
+static const char *parse_cond(const char *pos, struct query_cond *cond)
+{
+	char word[QUERY_MAX_WORD_LEN];
+	size_t i;
+
+	pos = read_word(skip_spaces(pos), word);
+	if (pos == NULL)
+		return NULL;
+	for (i = 0; i < sizeof(query_fields) / sizeof(*query_fields); ++i) {
+		if (strcasecmp(word, query_fields[i].name) == 0)
+			break;
+	}
+	if (i == sizeof(query_fields) / sizeof(*query_fields))
+		return NULL;
+	cond->field = query_fields[i].field;
+
+	pos = skip_spaces(pos);
+	for (i = 0; i < sizeof(query_ops) / sizeof(*query_ops); ++i) {
+		size_t len = strlen(query_ops[i].text);
+
+		if (strncmp(pos, query_ops[i].text, len) == 0) {
+			pos += len;
+			break;
+		}
+	}
+	if (i == sizeof(query_ops) / sizeof(*query_ops))
+		return NULL;
+	cond->op = query_ops[i].op;
+
+	pos = read_value(skip_spaces(pos), word);
+	if (pos == NULL || !parse_value(word, cond))
+		return NULL;
+	return pos;
+}
+
+bool query_parse(const char *text, struct query *query)
+{
+	*query = (struct query){ .nr_terms = 1 };
+
+	for (const char *pos = text;;) {
+		char word[QUERY_MAX_WORD_LEN];
+
+		if (query->nr_conds == QUERY_MAX_CONDS)
+			return false;
+		pos = parse_cond(pos, &query->conds[query->nr_conds]);
+		if (pos == NULL)
+			return false;
+		++query->nr_conds;
+		++query->term_len[query->nr_terms - 1];
+
+		pos = skip_spaces(pos);
+		if (*pos == '\0')
+			return true;
+
+		pos = read_word(pos, word);
+		if (pos == NULL)
+			return false;
+		if (strcasecmp(word, "or") == 0)
+			++query->nr_terms;
+		else if (strcasecmp(word, "and") != 0)
+			return false;
+	}
+}
+
+/*
+ * @brief Get the range of expiry dates or barcodes matched by a condition.
+ * @return True if the condition matches a range of expiry dates or barcodes.
+ */
+static bool cond_range(const struct query_cond *cond, int64_t *min,
+					   int64_t *max)
+{
+	int64_t value;
+
+	if (cond->field == QUERY_EXPIRY)
+		value = cond->value.date;
+	else if (cond->field == QUERY_BARCODE)
+		value = cond->value.barcode;
+	else
+		return false;
+
+	*min = INT64_MIN;
+	*max = INT64_MAX;
+	switch (cond->op) {
+	case QUERY_EQ:
+		*min = *max = value;
+		return true;
+	case QUERY_LT:
+		if (value == INT64_MIN)
+			return false;
+		*max = value - 1;
+		return true;
+	case QUERY_LE:
+		*max = value;
+		return true;
+	case QUERY_GT:
+		if (value == INT64_MAX)
+			return false;
+		*min = value + 1;
+		return true;
+	case QUERY_GE:
+		*min = value;
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * @brief Combine the conditions of a conjunction on the expiry date or on the
+ * barcode into a single range.
+ * @param term The conditions of the conjunction.
+ * @param len The number of conditions.
+ * @param field The field of the range.
+ * @param range Set to the range, whose kind is left unchanged.
+ * @return True if the conjunction has a range condition on the field.
+ */
+static bool term_range(const struct query_cond *term, size_t len,
+					   enum query_field field, struct db_lookup *range)
+{
+	bool has_range = false;
+
+	range->min = INT64_MIN;
+	range->max = INT64_MAX;
+	for (size_t i = 0; i < len; ++i) {
+		int64_t min, max;
+
+		if (term[i].field != field || !cond_range(&term[i], &min, &max))
+			continue;
+		has_range = true;
+		range->min = min > range->min ? min : range->min;
+		range->max = max < range->max ? max : range->max;
+	}
+	return has_range;
+}
+
+/*
+ * @brief Estimate the share of the entries matched by a condition.
+ */
+static double estimate_selectivity(struct db_manager *db_mgr,
+								   const struct query_cond *cond,
+								   uint64_t nr_live)
+{
+	double eq;
+
+	switch (cond->field) {
+	case QUERY_BARCODE:
+		eq = 1.0 / (double)nr_live;
+		// the sorted run counts the barcodes in a range
+		if (db_mgr->sorted && cond->op != QUERY_EQ && cond->op != QUERY_NE) {
+			int64_t min, max;
+
+			if (!cond_range(cond, &min, &max))
+				return 0;
+			return (double)count_key_range_entries(db_mgr, min, max) /
+				   (double)nr_live;
+		}
+		break;
+	case QUERY_CATEGORY:
+		eq = db_mgr->groups != NULL ?
+				 (double)count_group_entries(db_mgr, cond->value.text) /
+					 (double)nr_live :
+				 SELECTIVITY_VALUE_EQ;
+		break;
+	case QUERY_NAME:
+		eq = SELECTIVITY_NAME_EQ;
+		break;
+	case QUERY_EXPIRY:
+		// the expiry index counts the dates in a range
+		if (db_mgr->orders == NULL)
+			eq = SELECTIVITY_VALUE_EQ;
+		else if (cond->op == QUERY_NE)
+			eq = (double)count_range_entries(db_mgr, cond->value.date,
+											 cond->value.date) /
+				 (double)nr_live;
+		else {
+			int64_t min, max;
+
+			(void)cond_range(cond, &min, &max);
+			return (double)count_range_entries(db_mgr, min, max) /
+				   (double)nr_live;
+		}
+		break;
+	default:
+		eq = SELECTIVITY_VALUE_EQ;
+		break;
+	}
+
+	switch (cond->op) {
+	case QUERY_EQ:
+		return eq;
+	case QUERY_NE:
+		return 1 - eq;
+	case QUERY_PREFIX:
+		return SELECTIVITY_PREFIX;
+	case QUERY_CONTAINS:
+		return SELECTIVITY_CONTAINS;
+	default:
+		return SELECTIVITY_RANGE;
+	}
+}
+
+/*
+ * @brief Get the index lookup answering a condition, if the database has the
+ * index.
+ * @return True if the condition is answered by an index.
+ */
+static bool cond_lookup(const struct db_manager *db_mgr,
+						const struct query_cond *cond,
+						struct db_lookup *lookup)
+{
+	switch (cond->field) {
+	case QUERY_BARCODE:
+		*lookup = (struct db_lookup){ .kind = DB_LOOKUP_KEY,
+									  .key = cond->value.barcode };
+		return cond->op == QUERY_EQ &&
+			   (db_mgr->index != NULL || db_mgr->sorted);
+	case QUERY_CATEGORY:
+		*lookup = (struct db_lookup){ .kind = DB_LOOKUP_GROUP,
+									  .pattern = cond->value.text };
+		return cond->op == QUERY_EQ && db_mgr->groups != NULL;
+	case QUERY_NAME:
+		*lookup = (struct db_lookup){ .kind = DB_LOOKUP_TEXT,
+									  .pattern = cond->value.text };
+		if (cond->op == QUERY_EQ)
+			lookup->mode = TEXT_MATCH_EXACT;
+		else if (cond->op == QUERY_PREFIX)
+			lookup->mode = TEXT_MATCH_PREFIX;
+		else if (cond->op == QUERY_CONTAINS)
+			lookup->mode = TEXT_MATCH_SUBSTRING;
+		else
+			return false;
+		return db_mgr->texts != NULL;
+	default:
+		return false;
+	}
+}
+
+enum status query_plan(struct db_manager *db_mgr, struct query *query)
+{
+	uint64_t nr_live = db_mgr->nr_slots - db_mgr->nr_dead;
+	struct db_lookup lookups[QUERY_MAX_CONDS];
+	double candidates = 0;
+	bool indexed = true;
+
+	if (nr_live == 0)
+		nr_live = 1;
+	free_selection(&query->selection);
+	query->use_index = false;
+
+	struct query_cond *term = query->conds;
+	for (size_t t = 0; t < query->nr_terms; term += query->term_len[t++]) {
+		size_t len = query->term_len[t];
+		double best = 2;
+
+		for (size_t i = 0; i < len; ++i)
+			term[i].selectivity =
+				estimate_selectivity(db_mgr, &term[i], nr_live);
+
+		// the conjunctions are short, an insertion sort keeps the order of
+		// the conditions as written among equally selective ones
+		for (size_t i = 1; i < len; ++i) {
+			struct query_cond cond = term[i];
+			size_t j = i;
+
+			for (; j > 0 && term[j - 1].selectivity > cond.selectivity; --j)
+				term[j] = term[j - 1];
+			term[j] = cond;
+		}
+
+		// the first indexed condition is the most selective one
+		for (size_t i = 0; i < len && best > 1; ++i) {
+			if (cond_lookup(db_mgr, &term[i], &lookups[t]))
+				best = term[i].selectivity;
+		}
+
+		// the conditions on the expiry date are combined into a single
+		// range of the expiry index
+		struct db_lookup range = { .kind = DB_LOOKUP_RANGE };
+		if (db_mgr->orders != NULL &&
+			term_range(term, len, QUERY_EXPIRY, &range)) {
+			double selectivity =
+				(double)count_range_entries(db_mgr, range.min, range.max) /
+				(double)nr_live;
+
+			if (selectivity < best) {
+				best = selectivity;
+				lookups[t] = range;
+			}
+		}
+
+		// and those on the barcode into a range of the sorted run
+		struct db_lookup key_range = { .kind = DB_LOOKUP_KEY_RANGE };
+		if (db_mgr->sorted &&
+			term_range(term, len, QUERY_BARCODE, &key_range)) {
+			double selectivity =
+				(double)count_key_range_entries(db_mgr, key_range.min,
+												key_range.max) /
+				(double)nr_live;
+
+			if (selectivity < best) {
+				best = selectivity;
+				lookups[t] = key_range;
+			}
+		}
+		indexed = indexed && best <= 1;
+		candidates += best * (double)nr_live;
+	}
+
+	if (!indexed || candidates > (double)nr_live / QUERY_INDEX_MAX_SHARE)
+		return STATUS_OK;
+
+	for (size_t t = 0; t < query->nr_terms; ++t) {
+		enum status status =
+			select_entries(db_mgr, &lookups[t], &query->selection);
+		if (status != STATUS_OK) {
+			free_selection(&query->selection);
+			return status;
+		}
+	}
+	query->use_index = true;
+	return STATUS_OK;
+}
+
+static bool compare_text(const char *field, const struct query_cond *cond)
+{
+	// the fields are not always null terminated
+	char text[ITEM_NAME_MAX_LEN + 1];
+
+	switch (cond->op) {
+	case QUERY_EQ:
+		return strncasecmp(field, cond->value.text, ITEM_NAME_MAX_LEN) == 0;
+	case QUERY_NE:
+		return strncasecmp(field, cond->value.text, ITEM_NAME_MAX_LEN) != 0;
+	case QUERY_PREFIX:
+		return strncasecmp(field, cond->value.text,
+						   strlen(cond->value.text)) == 0;
+	case QUERY_CONTAINS:
+		memcpy(text, field, ITEM_NAME_MAX_LEN);
+		text[ITEM_NAME_MAX_LEN] = '\0';
+		return strcasestr(text, cond->value.text) != NULL;
+	default:
+		return false;
+	}
+}
+
+#define COMPARE_VALUES(a, op, b)     \
+	({                               \
+		bool _res = false;           \
+		switch (op) {                \
+		case QUERY_EQ:               \
+			_res = (a) == (b);       \
+			break;                   \
+		case QUERY_NE:               \
+			_res = (a) != (b);       \
+			break;                   \
+		case QUERY_LT:               \
+			_res = (a) < (b);        \
+			break;                   \
+		case QUERY_LE:               \
+			_res = (a) <= (b);       \
+			break;                   \
+		case QUERY_GT:               \
+			_res = (a) > (b);        \
+			break;                   \
+		case QUERY_GE:               \
+			_res = (a) >= (b);       \
+			break;                   \
+		default:                     \
+			break;                   \
+		}                            \
+		_res;                        \
+	})
+
+static bool matches_cond(const struct store_item *item,
+						 const struct query_cond *cond)
+{
+	switch (cond->field) {
+	case QUERY_BARCODE:
+		return COMPARE_VALUES(item->barcode, cond->op, cond->value.barcode);
+	case QUERY_NAME:
+		return compare_text(item->name, cond);
+	case QUERY_CATEGORY:
+		return compare_text(item->category, cond);
+	case QUERY_PRICE:
+		return COMPARE_VALUES(item->price, cond->op, cond->value.price);
+	case QUERY_QUANTITY:
+		return COMPARE_VALUES((uint64_t)item->quantity, cond->op,
+							  cond->value.quantity);
+	case QUERY_EXPIRY:
+		return COMPARE_VALUES(pack_date(&item->expiry_date), cond->op,
+							  cond->value.date);
+	}
+	return false;
+}
+
+bool matches_query(const void *entry, const void *query)
+{
+	const struct query *q = query;
+	const struct query_cond *term = q->conds;
+
+	for (size_t t = 0; t < q->nr_terms; term += q->term_len[t++]) {
+		size_t i = 0;
+
+		while (i < q->term_len[t] && matches_cond(entry, &term[i]))
+			++i;
+		if (i == q->term_len[t])
+			return true;
+	}
+	return false;
+}
+
+/*
+ * A scan answered by a filter on a single column of the items.
+ */
+struct column_scan {
+	enum store_item_column column;
+	column_filter_func filter;
+	union {
+		int64_t barcode;
+		struct price_range prices;
+		struct date date;
+	} criteria;
+};
+
+/*
+ * @brief Combine the conditions of a conjunction on the price into a single
+ * closed range.
+ * @return True if all the conditions are ranges on the price.
+ */
+static bool term_price_range(const struct query_cond *term, size_t len,
+							 struct price_range *range)
+{
+	range->min = -INFINITY;
+	range->max = INFINITY;
+	for (size_t i = 0; i < len; ++i) {
+		float value = term[i].value.price;
+
+		if (term[i].field != QUERY_PRICE)
+			return false;
+		switch (term[i].op) {
+		case QUERY_EQ:
+			range->min = fmaxf(range->min, value);
+			range->max = fminf(range->max, value);
+			break;
+		case QUERY_LT:
+			range->max = fminf(range->max, nextafterf(value, -INFINITY));
+			break;
+		case QUERY_LE:
+			range->max = fminf(range->max, value);
+			break;
+		case QUERY_GT:
+			range->min = fmaxf(range->min, nextafterf(value, INFINITY));
+			break;
+		case QUERY_GE:
+			range->min = fmaxf(range->min, value);
+			break;
+		default:
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * @brief Find a column filter selecting exactly the items matching a query: a
+ * single conjunction of ranges on the price, or a single condition barcode =
+ * or expiry < and <=.
+ * @param query the query
+ * @param scan set to the filter and its criteria
+ * @return true if the query is answered by a column filter
+ */
+static bool query_column_scan(const struct query *query,
+							  struct column_scan *scan)
+{
+	const struct query_cond *cond = query->conds;
+	int64_t date;
+
+	if (query->nr_terms != 1)
+		return false;
+
+	if (term_price_range(cond, query->nr_conds, &scan->criteria.prices)) {
+		scan->column = ITEM_COLUMN_PRICE;
+		scan->filter = select_price_range;
+		return true;
+	}
+	if (query->nr_conds != 1)
+		return false;
+
+	switch (cond->field) {
+	case QUERY_BARCODE:
+		scan->column = ITEM_COLUMN_BARCODE;
+		scan->filter = select_barcode;
+		scan->criteria.barcode = cond->value.barcode;
+		return cond->op == QUERY_EQ;
+	case QUERY_EXPIRY:
+		if (cond->op != QUERY_LT && cond->op != QUERY_LE)
+			return false;
+		// the day after the date is still ordered right when it is not a
+		// valid date, as the dates are compared field by field
+		date = cond->value.date + (cond->op == QUERY_LE);
+		scan->column = ITEM_COLUMN_EXPIRY_DATE;
+		scan->filter = select_expiry_before;
+		scan->criteria.date = (struct date){
+			.day = (int8_t)(date % 100),
+			.month = (int8_t)(date / 100 % 100),
+			.year = (int32_t)(date / 10000),
+		};
+		return true;
+	default:
+		return false;
+	}
+}
+
+enum status query_dump(struct db_manager *db_mgr, struct query *query,
+					   dump_entry_func dump_entry, FILE *out)
+{
+	enum status status = query_plan(db_mgr, query);
+	if (status != STATUS_OK)
+		return status;
+
+	if (query->use_index)
+		return dump_selection(db_mgr, &query->selection, dump_entry, query,
+							  matches_query, out);
+
+	// only the column of the condition is read to select the items
+	struct column_scan scan;
+	if (query_column_scan(query, &scan))
+		return dump_database_by_column(db_mgr, dump_entry, scan.column,
+									   &scan.criteria, scan.filter, out);
+
+	dump_database(db_mgr, dump_entry, query, matches_query, out);
+	return STATUS_OK;
+}
+
+enum status query_update(struct db_manager *db_mgr, struct query *query,
+						 const void *update_val, update_func update)
+{
+	enum status status = query_plan(db_mgr, query);
+	if (status != STATUS_OK)
+		return status;
+
+	if (query->use_index)
+		return update_selection(db_mgr, &query->selection, query,
+								matches_query, update_val, update);
+
+	// a single condition barcode = or category = is checked by the kernels
+	// compiled for the store items
+	const struct query_cond *cond = query->conds;
+	if (query->nr_conds == 1 && cond->op == QUERY_EQ) {
+		if (cond->field == QUERY_BARCODE)
+			return update_items_matching(db_mgr, &cond->value.barcode,
+										 matches_barcode, update_val, update);
+		if (cond->field == QUERY_CATEGORY)
+			return update_items_matching(db_mgr, cond->value.text,
+										 matches_category, update_val, update);
+	}
+	return update_entries(db_mgr, query, matches_query, update_val, update);
+}
+
+static void explain_cond(const struct query_cond *cond, FILE *out)
+{
+	fprintf(out, "%s %s ", field_names[cond->field], op_names[cond->op]);
+	switch (cond->field) {
+	case QUERY_BARCODE:
+		fprintf(out, "%" PRId64, cond->value.barcode);
+		break;
+	case QUERY_NAME:
+	case QUERY_CATEGORY:
+		fprintf(out, "\"%s\"", cond->value.text);
+		break;
+	case QUERY_PRICE:
+		fprintf(out, "%.2f", cond->value.price);
+		break;
+	case QUERY_QUANTITY:
+		fprintf(out, "%" PRIu64, cond->value.quantity);
+		break;
+	case QUERY_EXPIRY:
+		fprintf(out, "%02d/%02d/%04d", (int)(cond->value.date % 100),
+				(int)(cond->value.date / 100 % 100),
+				(int)(cond->value.date / 10000));
+		break;
+	}
+}
+
+void query_explain(const struct query *query, FILE *out)
+{
+	const struct query_cond *term = query->conds;
+
+	for (size_t t = 0; t < query->nr_terms; term += query->term_len[t++]) {
+		fprintf(out, "%s", t == 0 ? "Conditii: " : "    sau: ");
+		for (size_t i = 0; i < query->term_len[t]; ++i) {
+			if (i > 0)
+				fprintf(out, " si ");
+			explain_cond(&term[i], out);
+		}
+		fprintf(out, "\n");
+	}
+
+	struct column_scan scan;
+	if (query->use_index)
+		fprintf(out, "Produse citite din indecsi: %zu\n",
+				query->selection.count);
+	else if (query_column_scan(query, &scan))
+		fprintf(out, "Produsele sunt cautate doar in coloana %s\n",
+				field_names[query->conds[0].field]);
+	else
+		fprintf(out, "Produsele sunt cautate in toata baza de date\n");
+}
+
+void query_free(struct query *query)
+{
+	free_selection(&query->selection);
+	query->use_index = false;
+}
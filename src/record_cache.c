@@ -0,0 +1,338 @@
+#define _GNU_SOURCE
+
+#include "record_cache.h"
+
+#include "error.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_NODE SIZE_MAX
+
+/*
+ * The cached entries live in a fixed array of nodes, chained in the buckets of
+ * a hash table by key and in a list ordered from the most to the least
+ * recently used. The unused nodes are chained in a free list and the dirty
+ * ones are listed apart, so a flush does not go through the clean ones.
+ */
+struct cache_node {
+	int64_t key;
+	int64_t slot;
+	// next node in the same bucket
+	size_t chain;
+	// neighbours in the recency list(next is also used by the free list)
+	size_t prev;
+	size_t next;
+	// position in the list of dirty nodes(NO_NODE for a clean node)
+	size_t dirty_pos;
+};
+
+struct record_cache {
+	size_t capacity;
+	size_t entry_size;
+	struct cache_node *nodes;
+	// the entry of each node, stored contiguously
+	char *entries;
+	size_t *buckets;
+	size_t bucket_mask;
+	// most and least recently used nodes
+	size_t head;
+	size_t tail;
+	size_t free_list;
+	size_t len;
+	size_t *dirty;
+	size_t nr_dirty;
+	struct record_cache_stats stats;
+};
+
+static size_t hash_key(int64_t key)
+{
+	// splitmix64 finalizer
+	uint64_t x = (uint64_t)key;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return (size_t)(x ^ (x >> 31));
+}
+
+static inline void *node_entry(const struct record_cache *rc, size_t node)
+{
+	return rc->entries + node * rc->entry_size;
+}
+
+static inline bool node_dirty(const struct record_cache *rc, size_t node)
+{
+	return rc->nodes[node].dirty_pos != NO_NODE;
+}
+
+static void set_dirty(struct record_cache *rc, size_t node)
+{
+	if (node_dirty(rc, node))
+		return;
+
+	rc->nodes[node].dirty_pos = rc->nr_dirty;
+	rc->dirty[rc->nr_dirty++] = node;
+}
+
+static void set_clean(struct record_cache *rc, size_t node)
+{
+	size_t pos = rc->nodes[node].dirty_pos;
+
+	if (pos == NO_NODE)
+		return;
+
+	// the last dirty node takes the place of the cleaned one
+	size_t last = rc->dirty[--rc->nr_dirty];
+	rc->dirty[pos] = last;
+	rc->nodes[last].dirty_pos = pos;
+	rc->nodes[node].dirty_pos = NO_NODE;
+}
+
+struct record_cache *record_cache_create(size_t capacity, size_t entry_size)
+{
+	struct record_cache *rc = calloc(1, sizeof(*rc));
+	DIE(rc == NULL, "Error allocating record cache");
+
+	if (capacity == 0)
+		capacity = 1;
+
+	// at most half of the buckets are used
+	size_t nr_buckets = 1;
+	while (nr_buckets < 2 * capacity)
+		nr_buckets <<= 1;
+
+	rc->capacity = capacity;
+	rc->entry_size = entry_size;
+	rc->nodes = malloc(capacity * sizeof(*rc->nodes));
+	rc->entries = malloc(capacity * entry_size);
+	rc->buckets = malloc(nr_buckets * sizeof(*rc->buckets));
+	rc->dirty = malloc(capacity * sizeof(*rc->dirty));
+	DIE(rc->nodes == NULL || rc->entries == NULL || rc->buckets == NULL ||
+			rc->dirty == NULL,
+		"Error allocating record cache");
+	rc->bucket_mask = nr_buckets - 1;
+
+	record_cache_clear(rc);
+	return rc;
+}
+
+void record_cache_destroy(struct record_cache *rc)
+{
+	if (rc == NULL)
+		return;
+
+	free(rc->dirty);
+	free(rc->buckets);
+	free(rc->entries);
+	free(rc->nodes);
+	free(rc);
+}
+
+static size_t find_node(const struct record_cache *rc, int64_t key)
+{
+	size_t node = rc->buckets[hash_key(key) & rc->bucket_mask];
+
+	while (node != NO_NODE && rc->nodes[node].key != key)
+		node = rc->nodes[node].chain;
+	return node;
+}
+
+static void unlink_recent(struct record_cache *rc, size_t node)
+{
+	struct cache_node *n = &rc->nodes[node];
+
+	if (n->prev != NO_NODE)
+		rc->nodes[n->prev].next = n->next;
+	else
+		rc->head = n->next;
+	if (n->next != NO_NODE)
+		rc->nodes[n->next].prev = n->prev;
+	else
+		rc->tail = n->prev;
+}
+
+static void push_recent(struct record_cache *rc, size_t node)
+{
+	struct cache_node *n = &rc->nodes[node];
+
+	n->prev = NO_NODE;
+	n->next = rc->head;
+	if (rc->head != NO_NODE)
+		rc->nodes[rc->head].prev = node;
+	else
+		rc->tail = node;
+	rc->head = node;
+}
+
+/*
+ * @brief Unlink a node from its bucket and from the recency list and return it
+ * to the free list.
+ */
+static void release_node(struct record_cache *rc, size_t node)
+{
+	size_t *link = &rc->buckets[hash_key(rc->nodes[node].key) &
+								rc->bucket_mask];
+
+	while (*link != node)
+		link = &rc->nodes[*link].chain;
+	*link = rc->nodes[node].chain;
+
+	unlink_recent(rc, node);
+	set_clean(rc, node);
+
+	rc->nodes[node].next = rc->free_list;
+	rc->free_list = node;
+	--rc->len;
+}
+
+void *record_cache_get(struct record_cache *rc, int64_t key, int64_t *slot)
+{
+	size_t node = find_node(rc, key);
+
+	if (node == NO_NODE) {
+		++rc->stats.misses;
+		return NULL;
+	}
+
+	++rc->stats.hits;
+	if (rc->head != node) {
+		unlink_recent(rc, node);
+		push_recent(rc, node);
+	}
+	*slot = rc->nodes[node].slot;
+	return node_entry(rc, node);
+}
+
+enum status record_cache_put(struct record_cache *rc, int64_t key,
+							 int64_t slot, const void *entry,
+							 record_write_func write, void *ctx)
+{
+	enum status status = STATUS_OK;
+	size_t node = find_node(rc, key);
+
+	if (node != NO_NODE) {
+		unlink_recent(rc, node);
+		set_clean(rc, node);
+	} else {
+		if (rc->len == rc->capacity) {
+			size_t victim = rc->tail;
+
+			if (node_dirty(rc, victim)) {
+				status = write(ctx, rc->nodes[victim].slot,
+							   node_entry(rc, victim));
+				++rc->stats.write_backs;
+			}
+			release_node(rc, victim);
+			++rc->stats.evictions;
+		}
+
+		node = rc->free_list;
+		rc->free_list = rc->nodes[node].next;
+		++rc->len;
+
+		size_t *bucket = &rc->buckets[hash_key(key) & rc->bucket_mask];
+		rc->nodes[node].key = key;
+		rc->nodes[node].chain = *bucket;
+		rc->nodes[node].dirty_pos = NO_NODE;
+		*bucket = node;
+	}
+
+	rc->nodes[node].slot = slot;
+	memcpy(node_entry(rc, node), entry, rc->entry_size);
+	push_recent(rc, node);
+	return status;
+}
+
+void record_cache_refresh(struct record_cache *rc, int64_t key, int64_t slot,
+						  const void *entry)
+{
+	size_t node = find_node(rc, key);
+
+	if (node == NO_NODE || rc->nodes[node].slot != slot)
+		return;
+
+	set_clean(rc, node);
+	memcpy(node_entry(rc, node), entry, rc->entry_size);
+}
+
+void record_cache_mark_dirty(struct record_cache *rc, int64_t key)
+{
+	size_t node = find_node(rc, key);
+
+	if (node != NO_NODE)
+		set_dirty(rc, node);
+}
+
+enum status record_cache_remove(struct record_cache *rc, int64_t key,
+								record_write_func write, void *ctx)
+{
+	size_t node = find_node(rc, key);
+	enum status status = STATUS_OK;
+
+	if (node == NO_NODE)
+		return STATUS_OK;
+
+	if (node_dirty(rc, node) && write != NULL) {
+		status = write(ctx, rc->nodes[node].slot, node_entry(rc, node));
+		++rc->stats.write_backs;
+	}
+	release_node(rc, node);
+	return status;
+}
+
+static int compare_node_slots(const void *a, const void *b, void *arg)
+{
+	const struct cache_node *nodes = arg;
+	int64_t x = nodes[*(const size_t *)a].slot;
+	int64_t y = nodes[*(const size_t *)b].slot;
+
+	return (x > y) - (x < y);
+}
+
+enum status record_cache_flush(struct record_cache *rc,
+							   record_write_func write, void *ctx)
+{
+	// the entries are written in file order
+	qsort_r(rc->dirty, rc->nr_dirty, sizeof(*rc->dirty), compare_node_slots,
+			rc->nodes);
+
+	// the entries that could not be written stay dirty
+	enum status status = STATUS_OK;
+	size_t nr_failed = 0;
+	for (size_t i = 0; i < rc->nr_dirty; ++i) {
+		size_t node = rc->dirty[i];
+
+		if (write(ctx, rc->nodes[node].slot, node_entry(rc, node)) !=
+			STATUS_OK) {
+			status = STATUS_ERROR;
+			rc->nodes[node].dirty_pos = nr_failed;
+			rc->dirty[nr_failed++] = node;
+			continue;
+		}
+		rc->nodes[node].dirty_pos = NO_NODE;
+		++rc->stats.write_backs;
+	}
+
+	rc->nr_dirty = nr_failed;
+	return status;
+}
+
+void record_cache_clear(struct record_cache *rc)
+{
+	for (size_t b = 0; b <= rc->bucket_mask; ++b)
+		rc->buckets[b] = NO_NODE;
+	for (size_t node = 0; node < rc->capacity; ++node)
+		rc->nodes[node].next = node + 1 < rc->capacity ? node + 1 : NO_NODE;
+
+	rc->free_list = 0;
+	rc->head = NO_NODE;
+	rc->tail = NO_NODE;
+	rc->len = 0;
+	rc->nr_dirty = 0;
+}
+
+void record_cache_get_stats(const struct record_cache *rc,
+							struct record_cache_stats *stats)
+{
+	*stats = rc->stats;
+}
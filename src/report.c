@@ -0,0 +1,137 @@
+#include "report.h"
+
+#include <math.h>
+#include <strings.h>
+
+FILE *report_open(const char *path)
+{
+	FILE *out = fopen(path, "w");
+	if (out == NULL)
+		return NULL;
+
+	// a failed setvbuf only leaves the default buffer in place
+	(void)setvbuf(out, NULL, _IOFBF, REPORT_BUFFER_SIZE);
+	return out;
+}
+
+enum report_format report_format_of(const char *path)
+{
+	const char *ext = strrchr(path, '.');
+
+	if (ext == NULL)
+		return REPORT_BLOCK;
+	if (strcasecmp(ext, ".csv") == 0)
+		return REPORT_CSV;
+	if (strcasecmp(ext, ".json") == 0 || strcasecmp(ext, ".jsonl") == 0)
+		return REPORT_JSON_LINES;
+	return REPORT_BLOCK;
+}
+
+char *report_put_str(char *dst, const char *str, size_t max_len)
+{
+	size_t len = strnlen(str, max_len);
+
+	memcpy(dst, str, len);
+	return dst + len;
+}
+
+char *report_put_uint(char *dst, uint64_t value)
+{
+	char digits[20];
+	size_t len = 0;
+
+	do {
+		digits[len++] = (char)('0' + value % 10);
+		value /= 10;
+	} while (value != 0);
+
+	while (len > 0)
+		*dst++ = digits[--len];
+	return dst;
+}
+
+char *report_put_int(char *dst, int64_t value, unsigned width)
+{
+	uint64_t abs_value = value < 0 ? -(uint64_t)value : (uint64_t)value;
+	char digits[20];
+	unsigned len = 0;
+
+	do {
+		digits[len++] = (char)('0' + abs_value % 10);
+		abs_value /= 10;
+	} while (abs_value != 0);
+
+	if (value < 0) {
+		*dst++ = '-';
+		if (width > 0)
+			--width;
+	}
+	for (; width > len; --width)
+		*dst++ = '0';
+	while (len > 0)
+		*dst++ = digits[--len];
+	return dst;
+}
+
+char *report_put_price(char *dst, float value)
+{
+	// a float times 100 is exact as a double, so rounding it to an integer in
+	// the current rounding mode gives the same digits as printf
+	double scaled = fabs((double)value) * 100;
+
+	if (!isfinite(scaled) || scaled >= 1e18)
+		return dst + snprintf(dst, REPORT_NUMBER_MAX_LEN, "%.2f", value);
+
+	uint64_t cents = (uint64_t)llrint(scaled);
+	if (signbit(value))
+		*dst++ = '-';
+	dst = report_put_uint(dst, cents / 100);
+	*dst++ = '.';
+	*dst++ = (char)('0' + cents % 100 / 10);
+	*dst++ = (char)('0' + cents % 10);
+	return dst;
+}
+
+char *report_put_csv(char *dst, const char *str, size_t max_len)
+{
+	size_t len = strnlen(str, max_len);
+	size_t plain = 0;
+
+	while (plain < len && strchr(",\"\r\n", str[plain]) == NULL)
+		++plain;
+	if (plain == len)
+		return report_put_str(dst, str, len);
+
+	*dst++ = '"';
+	for (size_t i = 0; i < len; ++i) {
+		if (str[i] == '"')
+			*dst++ = '"';
+		*dst++ = str[i];
+	}
+	*dst++ = '"';
+	return dst;
+}
+
+char *report_put_json(char *dst, const char *str, size_t max_len)
+{
+	static const char hex[] = "0123456789abcdef";
+	size_t len = strnlen(str, max_len);
+
+	*dst++ = '"';
+	for (size_t i = 0; i < len; ++i) {
+		unsigned char c = (unsigned char)str[i];
+
+		if (c == '"' || c == '\\') {
+			*dst++ = '\\';
+			*dst++ = (char)c;
+		} else if (c < 0x20) {
+			dst = REPORT_PUT_LITERAL(dst, "\\u00");
+			*dst++ = hex[c >> 4];
+			*dst++ = hex[c & 0xf];
+		} else {
+			*dst++ = (char)c;
+		}
+	}
+	*dst++ = '"';
+	return dst;
+}
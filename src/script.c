@@ -0,0 +1,800 @@
+#include "script.h"
+
+#include "aggregate.h"
+#include "database.h"
+#include "query.h"
+#include "report.h"
+#include "store_manager.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// maximum number of words on a line: the command and its arguments
+#define SCRIPT_MAX_WORDS 7
+// maximum number of consecutive operations applied together
+#define SCRIPT_MAX_BATCH 65536
+#define SCRIPT_DETAIL_LEN 256
+
+/*
+ * The kinds of operations applied together.
+ */
+enum script_batch {
+	BATCH_NONE,
+	BATCH_ADD,
+	BATCH_KEY,
+	BATCH_GROUP,
+};
+
+/*
+ * An operation waiting in the current batch.
+ */
+struct script_op {
+	uint64_t line;
+	const char *cmd;
+	int64_t key;
+	char group[ITEM_CATEGORY_MAX_LEN];
+	union {
+		float price;
+		int quantity;
+		struct date date;
+		float discount;
+	} val;
+	update_func update;
+};
+
+struct script {
+	struct cli_program *cli_prog;
+	FILE *out;
+	enum script_batch batch;
+	struct script_op *ops;
+	// the items of the add operations in the batch
+	struct store_item *items;
+	size_t len;
+	bool failed;
+};
+
+/*
+ * @brief A function that parses the arguments of an operation applied in a
+ * batch.
+ * @return True if the arguments are valid.
+ */
+typedef bool (*script_parse_func)(struct script *, char **, struct script_op *);
+
+/*
+ * @brief A function that runs an operation on its own.
+ * @param cli_prog The CLI program.
+ * @param args The arguments of the operation.
+ * @param nr_args The number of arguments.
+ * @param detail Set to the details of the result, if any.
+ * @return The status of the operation.
+ */
+typedef enum status (*script_run_func)(struct cli_program *, char **, size_t,
+									   char *);
+
+struct script_cmd {
+	const char *name;
+	size_t min_args;
+	size_t max_args;
+	bool needs_db;
+	enum script_batch batch;
+	script_parse_func parse;
+	script_run_func run;
+};
+
+static const char *const status_names[] = {
+	[STATUS_OK] = "ok",
+	[STATUS_ERROR] = "error",
+	[STATUS_NOT_FOUND] = "not-found",
+	[STATUS_EXIT] = "ok",
+};
+
+/*
+ * @brief Split a line into words in place. The words are separated by spaces,
+ * unless they are between double quotes.
+ * @return The number of words, at most max + 1 if there are too many.
+ */
+static size_t split_words(char *line, char **words, size_t max)
+{
+	size_t nr_words = 0;
+	char *src = line;
+
+	for (;;) {
+		while (isspace((unsigned char)*src))
+			++src;
+		if (*src == '\0')
+			return nr_words;
+		if (nr_words == max)
+			return max + 1;
+
+		char *dst = src;
+		bool quoted = false;
+
+		words[nr_words++] = dst;
+		for (; *src != '\0' && (quoted || !isspace((unsigned char)*src));
+			 ++src) {
+			if (*src == '"') {
+				quoted = !quoted;
+				continue;
+			}
+			if (quoted && *src == '\\' && (src[1] == '"' || src[1] == '\\'))
+				++src;
+			*dst++ = *src;
+		}
+		if (*src != '\0')
+			++src;
+		*dst = '\0';
+	}
+}
+
+static bool parse_key(const char *str, int64_t *key)
+{
+	char *end;
+
+	errno = 0;
+	long long val = strtoll(str, &end, 10);
+	if (end == str || *end != '\0' || errno == ERANGE || val < 0)
+		return false;
+
+	*key = val;
+	return true;
+}
+
+static bool parse_float(const char *str, float *val)
+{
+	char *end;
+
+	errno = 0;
+	*val = strtof(str, &end);
+	return end != str && *end == '\0' && errno != ERANGE && isfinite(*val);
+}
+
+/*
+ * @brief Parse a discount given in percents, as the fraction of the price
+ * taken by discount_price.
+ */
+static bool parse_discount(const char *str, float *discount)
+{
+	if (!parse_float(str, discount) || *discount < 0 || *discount > 100)
+		return false;
+
+	*discount /= 100;
+	return true;
+}
+
+static void print_result(struct script *script, uint64_t line,
+						 const char *cmd, enum status status,
+						 const char *detail)
+{
+	if (status == STATUS_ERROR)
+		script->failed = true;
+
+	(void)fprintf(script->out, "%" PRIu64 "\t%s\t%s", line,
+				  status_names[status], cmd);
+	if (detail != NULL && detail[0] != '\0')
+		(void)fprintf(script->out, "\t%s", detail);
+	(void)fputc('\n', script->out);
+}
+
+static void flush_adds(struct script *script)
+{
+	enum status status = append_entries(&script->cli_prog->db_mgr,
+										script->items, script->len);
+
+	for (size_t i = 0; i < script->len; ++i)
+		print_result(script, script->ops[i].line, script->ops[i].cmd, status,
+					 NULL);
+}
+
+static void print_batch_results(struct script *script, enum status status,
+								const bool *found)
+{
+	for (size_t i = 0; i < script->len; ++i) {
+		enum status op_status = status;
+
+		if (status != STATUS_ERROR)
+			op_status = found[i] ? STATUS_OK : STATUS_NOT_FOUND;
+		print_result(script, script->ops[i].line, script->ops[i].cmd,
+					 op_status, NULL);
+	}
+}
+
+static void flush_key_updates(struct script *script)
+{
+	struct key_update *updates = malloc(script->len * sizeof(*updates));
+	bool *found = malloc(script->len * sizeof(*found));
+	DIE(updates == NULL || found == NULL, "Error allocating batch");
+
+	for (size_t i = 0; i < script->len; ++i)
+		updates[i] = (struct key_update){
+			.key = script->ops[i].key,
+			.update = script->ops[i].update,
+			.update_val = &script->ops[i].val,
+		};
+
+	print_batch_results(script,
+						update_entries_by_keys(&script->cli_prog->db_mgr,
+											   updates, script->len, found),
+						found);
+	free(found);
+	free(updates);
+}
+
+static void flush_group_updates(struct script *script)
+{
+	struct group_update *updates = malloc(script->len * sizeof(*updates));
+	bool *found = malloc(script->len * sizeof(*found));
+	DIE(updates == NULL || found == NULL, "Error allocating batch");
+
+	for (size_t i = 0; i < script->len; ++i)
+		updates[i] = (struct group_update){
+			.group = script->ops[i].group,
+			.update = script->ops[i].update,
+			.update_val = &script->ops[i].val,
+		};
+
+	print_batch_results(script,
+						update_entries_by_groups(&script->cli_prog->db_mgr,
+												 updates, script->len, found),
+						found);
+	free(found);
+	free(updates);
+}
+
+/*
+ * @brief Apply the operations waiting in the current batch and write their
+ * results, in the order of the script.
+ */
+static void flush_batch(struct script *script)
+{
+	if (script->len > 0) {
+		switch (script->batch) {
+		case BATCH_ADD:
+			flush_adds(script);
+			break;
+		case BATCH_KEY:
+			flush_key_updates(script);
+			break;
+		case BATCH_GROUP:
+			flush_group_updates(script);
+			break;
+		default:
+			break;
+		}
+	}
+
+	script->batch = BATCH_NONE;
+	script->len = 0;
+}
+
+static bool parse_add(struct script *script, char **args, struct script_op *op)
+{
+	(void)op;
+	return parse_store_item(args, &script->items[script->len]);
+}
+
+static bool parse_update_price(struct script *script, char **args,
+							   struct script_op *op)
+{
+	(void)script;
+	op->update = update_price;
+	return parse_key(args[0], &op->key) && parse_float(args[1], &op->val.price);
+}
+
+static bool parse_update_quantity(struct script *script, char **args,
+								  struct script_op *op)
+{
+	int64_t quantity;
+
+	(void)script;
+	op->update = update_quantity;
+	if (!parse_key(args[0], &op->key) || !parse_key(args[1], &quantity) ||
+		quantity > INT_MAX)
+		return false;
+
+	op->val.quantity = (int)quantity;
+	return true;
+}
+
+static bool parse_update_expiry(struct script *script, char **args,
+								struct script_op *op)
+{
+	(void)script;
+	op->update = update_expiry_date;
+	return parse_key(args[0], &op->key) && parse_date(args[1], &op->val.date);
+}
+
+static bool parse_discount_product(struct script *script, char **args,
+								   struct script_op *op)
+{
+	(void)script;
+	op->update = discount_price;
+	return parse_key(args[0], &op->key) &&
+		   parse_discount(args[1], &op->val.discount);
+}
+
+static bool parse_discount_category(struct script *script, char **args,
+									struct script_op *op)
+{
+	size_t len = strlen(args[0]);
+
+	(void)script;
+	if (len == 0 || len >= sizeof(op->group))
+		return false;
+
+	memcpy(op->group, args[0], len + 1);
+	op->update = discount_price;
+	return parse_discount(args[1], &op->val.discount);
+}
+
+static enum status run_create(struct cli_program *cli_prog, char **args,
+							  size_t nr_args, char *detail)
+{
+	(void)nr_args;
+	if (cli_prog->db_mgr.db_file != NULL) {
+		strcpy(detail, "database-open");
+		return STATUS_ERROR;
+	}
+
+	cli_prog->db_mgr = create_database(args[0], sizeof(struct store_item),
+									   &cli_prog->db_config);
+	return STATUS_OK;
+}
+
+static enum status run_open(struct cli_program *cli_prog, char **args,
+							size_t nr_args, char *detail)
+{
+	(void)nr_args;
+	if (cli_prog->db_mgr.db_file != NULL) {
+		strcpy(detail, "database-open");
+		return STATUS_ERROR;
+	}
+
+	cli_prog->db_mgr = open_database(args[0], sizeof(struct store_item),
+									 &cli_prog->db_config);
+	return STATUS_OK;
+}
+
+static enum status run_close(struct cli_program *cli_prog, char **args,
+							 size_t nr_args, char *detail)
+{
+	(void)args;
+	(void)nr_args;
+	(void)detail;
+	close_database(&cli_prog->db_mgr);
+	return STATUS_OK;
+}
+
+static enum status run_delete(struct cli_program *cli_prog, char **args,
+							  size_t nr_args, char *detail)
+{
+	int64_t barcode;
+
+	(void)nr_args;
+	if (!parse_key(args[0], &barcode)) {
+		strcpy(detail, "invalid-arguments");
+		return STATUS_ERROR;
+	}
+	return remove_entry_by_key(&cli_prog->db_mgr, barcode);
+}
+
+static enum status run_report(struct cli_program *cli_prog, char **args,
+							  size_t nr_args, char *detail)
+{
+	FILE *out = report_open(args[0]);
+	if (out == NULL) {
+		strcpy(detail, "open-failed");
+		return STATUS_ERROR;
+	}
+
+	enum report_format format = report_format_of(args[0]);
+
+	dump_store_item_header(format, out);
+	enum status status = dump_store_items(&cli_prog->db_mgr, format,
+										  nr_args == 2 ? args[1] : NULL, out);
+
+	if (fclose(out) != 0)
+		status = STATUS_ERROR;
+	return status;
+}
+
+static enum status run_aggregate(struct cli_program *cli_prog, char **args,
+								 size_t nr_args, char *detail)
+{
+	int64_t low_stock = AGGREGATE_DEFAULT_LOW_STOCK;
+
+	if (nr_args == 2 && !parse_key(args[1], &low_stock)) {
+		strcpy(detail, "invalid-arguments");
+		return STATUS_ERROR;
+	}
+
+	FILE *out = report_open(args[0]);
+	if (out == NULL) {
+		strcpy(detail, "open-failed");
+		return STATUS_ERROR;
+	}
+
+	struct inventory_stats stats;
+	enum status status =
+		aggregate_inventory(&cli_prog->db_mgr, (uint64_t)low_stock, &stats);
+	if (status == STATUS_OK)
+		status = write_inventory_stats(&stats, report_format_of(args[0]),
+									   out);
+	(void)snprintf(detail, SCRIPT_DETAIL_LEN,
+				   "categories=%zu items=%" PRIu64, stats.nr_categories,
+				   stats.total.count);
+	inventory_stats_free(&stats);
+
+	if (fclose(out) != 0)
+		status = STATUS_ERROR;
+	return status;
+}
+
+static enum status run_totals(struct cli_program *cli_prog, char **args,
+							  size_t nr_args, char *detail)
+{
+	(void)nr_args;
+
+	FILE *out = report_open(args[0]);
+	if (out == NULL) {
+		strcpy(detail, "open-failed");
+		return STATUS_ERROR;
+	}
+
+	struct inventory_stats stats;
+	enum status status = inventory_totals(&cli_prog->db_mgr, &stats);
+	if (status == STATUS_OK) {
+		status =
+			write_inventory_totals(&stats, report_format_of(args[0]), out);
+		(void)snprintf(detail, SCRIPT_DETAIL_LEN,
+					   "categories=%zu items=%" PRIu64, stats.nr_categories,
+					   stats.total.count);
+	} else {
+		strcpy(detail, "no-totals");
+	}
+	inventory_stats_free(&stats);
+
+	if (fclose(out) != 0)
+		status = STATUS_ERROR;
+	return status;
+}
+
+/*
+ * @brief Describe how the entries of a planned query were found.
+ */
+static void describe_plan(const struct query *query, char *detail)
+{
+	if (query->use_index)
+		(void)snprintf(detail, SCRIPT_DETAIL_LEN, "plan=index selected=%zu",
+					   query->selection.count);
+	else
+		strcpy(detail, "plan=scan");
+}
+
+static enum status run_query(struct cli_program *cli_prog, char **args,
+							 size_t nr_args, char *detail)
+{
+	struct query query;
+
+	(void)nr_args;
+	if (!query_parse(args[1], &query)) {
+		strcpy(detail, "invalid-query");
+		return STATUS_ERROR;
+	}
+
+	FILE *out = report_open(args[0]);
+	if (out == NULL) {
+		strcpy(detail, "open-failed");
+		return STATUS_ERROR;
+	}
+
+	enum report_format format = report_format_of(args[0]);
+
+	dump_store_item_header(format, out);
+	enum status status = query_dump(&cli_prog->db_mgr, &query,
+									store_item_dumper(format), out);
+	describe_plan(&query, detail);
+	query_free(&query);
+
+	if (fclose(out) != 0)
+		status = STATUS_ERROR;
+	return status;
+}
+
+static enum status run_discount_query(struct cli_program *cli_prog,
+									  char **args, size_t nr_args,
+									  char *detail)
+{
+	struct query query;
+	float discount;
+
+	(void)nr_args;
+	if (!parse_discount(args[1], &discount)) {
+		strcpy(detail, "invalid-arguments");
+		return STATUS_ERROR;
+	}
+	if (!query_parse(args[0], &query)) {
+		strcpy(detail, "invalid-query");
+		return STATUS_ERROR;
+	}
+
+	enum status status = query_update(&cli_prog->db_mgr, &query, &discount,
+									  discount_price);
+	describe_plan(&query, detail);
+	query_free(&query);
+	return status;
+}
+
+static enum status run_discount_expiring(struct cli_program *cli_prog,
+										 char **args, size_t nr_args,
+										 char *detail)
+{
+	struct date date;
+	float discount;
+
+	(void)nr_args;
+	if (!parse_date(args[0], &date) || !parse_discount(args[1], &discount)) {
+		strcpy(detail, "invalid-arguments");
+		return STATUS_ERROR;
+	}
+	return discount_expiring_before(&cli_prog->db_mgr, &date, discount);
+}
+
+static enum status run_import(struct cli_program *cli_prog, char **args,
+							  size_t nr_args, char *detail)
+{
+	(void)nr_args;
+	FILE *in = fopen(args[0], "r");
+	if (in == NULL) {
+		strcpy(detail, "open-failed");
+		return STATUS_ERROR;
+	}
+
+	struct import_stats stats;
+	enum status status = import_store_items(&cli_prog->db_mgr, in, &stats);
+	(void)fclose(in);
+
+	(void)snprintf(detail, SCRIPT_DETAIL_LEN,
+				   "imported=%" PRIu64 " rejected=%" PRIu64, stats.imported,
+				   stats.rejected);
+	return status;
+}
+
+static enum status run_update_file(struct cli_program *cli_prog, char **args,
+								   size_t nr_args, char *detail)
+{
+	(void)nr_args;
+	FILE *in = fopen(args[0], "r");
+	if (in == NULL) {
+		strcpy(detail, "open-failed");
+		return STATUS_ERROR;
+	}
+
+	struct update_stats stats;
+	enum status status = update_store_items(&cli_prog->db_mgr, in, &stats);
+	(void)fclose(in);
+
+	(void)snprintf(detail, SCRIPT_DETAIL_LEN,
+				   "updated=%" PRIu64 " not-found=%" PRIu64
+				   " rejected=%" PRIu64,
+				   stats.applied, stats.not_found, stats.rejected);
+	return status;
+}
+
+static enum status run_compact(struct cli_program *cli_prog, char **args,
+							   size_t nr_args, char *detail)
+{
+	(void)args;
+	(void)nr_args;
+	(void)detail;
+	return compact_database(&cli_prog->db_mgr);
+}
+
+static enum status run_commit(struct cli_program *cli_prog, char **args,
+							  size_t nr_args, char *detail)
+{
+	(void)args;
+	(void)nr_args;
+	(void)detail;
+	return commit_database(&cli_prog->db_mgr);
+}
+
+static enum status run_cache_stats(struct cli_program *cli_prog, char **args,
+								   size_t nr_args, char *detail)
+{
+	struct record_cache_stats stats;
+
+	(void)args;
+	(void)nr_args;
+	get_cache_stats(&cli_prog->db_mgr, &stats);
+	(void)snprintf(detail, SCRIPT_DETAIL_LEN,
+				   "hits=%" PRIu64 " misses=%" PRIu64 " evictions=%" PRIu64
+				   " write-backs=%" PRIu64,
+				   stats.hits, stats.misses, stats.evictions,
+				   stats.write_backs);
+	return STATUS_OK;
+}
+
+static enum status run_stats(struct cli_program *cli_prog, char **args,
+							 size_t nr_args, char *detail)
+{
+	const struct db_stats *stats = cli_prog->db_config.stats;
+	struct db_op_stats total = { 0 };
+	enum db_op op;
+
+	if (stats == NULL) {
+		(void)snprintf(detail, SCRIPT_DETAIL_LEN, "stats-disabled");
+		return STATUS_ERROR;
+	}
+	if (nr_args == 1 && !db_op_parse(args[0], &op)) {
+		(void)snprintf(detail, SCRIPT_DETAIL_LEN, "unknown-operation");
+		return STATUS_ERROR;
+	}
+
+	// without an operation, the counters of all the operations are summed
+	for (int i = 0; i < DB_NR_OPS; ++i) {
+		struct db_op_stats op_stats;
+
+		if (nr_args == 1 && i != (int)op)
+			continue;
+		db_stats_get(stats, (enum db_op)i, &op_stats);
+		total.count += op_stats.count;
+		total.scanned += op_stats.scanned;
+		total.matched += op_stats.matched;
+		total.bytes_read += op_stats.bytes_read;
+		total.bytes_written += op_stats.bytes_written;
+		total.syscalls += op_stats.syscalls;
+		total.total_ns += op_stats.total_ns;
+	}
+
+	(void)snprintf(detail, SCRIPT_DETAIL_LEN,
+				   "ops=%" PRIu64 " scanned=%" PRIu64 " matched=%" PRIu64
+				   " read=%" PRIu64 " written=%" PRIu64 " syscalls=%" PRIu64
+				   " time_us=%" PRIu64,
+				   total.count, total.scanned, total.matched, total.bytes_read,
+				   total.bytes_written, total.syscalls, total.total_ns / 1000);
+	return STATUS_OK;
+}
+
+static const struct script_cmd script_cmds[] = {
+	{ "create", 1, 1, false, BATCH_NONE, NULL, run_create },
+	{ "open", 1, 1, false, BATCH_NONE, NULL, run_open },
+	{ "close", 0, 0, true, BATCH_NONE, NULL, run_close },
+	{ "add", 6, 6, true, BATCH_ADD, parse_add, NULL },
+	{ "update-price", 2, 2, true, BATCH_KEY, parse_update_price, NULL },
+	{ "update-quantity", 2, 2, true, BATCH_KEY, parse_update_quantity, NULL },
+	{ "update-expiry", 2, 2, true, BATCH_KEY, parse_update_expiry, NULL },
+	{ "discount", 2, 2, true, BATCH_KEY, parse_discount_product, NULL },
+	{ "discount-category", 2, 2, true, BATCH_GROUP, parse_discount_category,
+	  NULL },
+	{ "delete", 1, 1, true, BATCH_NONE, NULL, run_delete },
+	{ "report", 1, 2, true, BATCH_NONE, NULL, run_report },
+	{ "query", 2, 2, true, BATCH_NONE, NULL, run_query },
+	{ "discount-query", 2, 2, true, BATCH_NONE, NULL, run_discount_query },
+	{ "discount-expiring", 2, 2, true, BATCH_NONE, NULL,
+	  run_discount_expiring },
+	{ "import", 1, 1, true, BATCH_NONE, NULL, run_import },
+	{ "update-file", 1, 1, true, BATCH_NONE, NULL, run_update_file },
+	{ "aggregate", 1, 2, true, BATCH_NONE, NULL, run_aggregate },
+	{ "totals", 1, 1, true, BATCH_NONE, NULL, run_totals },
+	{ "compact", 0, 0, true, BATCH_NONE, NULL, run_compact },
+	{ "commit", 0, 0, true, BATCH_NONE, NULL, run_commit },
+	{ "cache-stats", 0, 0, true, BATCH_NONE, NULL, run_cache_stats },
+	{ "stats", 0, 1, false, BATCH_NONE, NULL, run_stats },
+};
+
+static const struct script_cmd *find_cmd(const char *name)
+{
+	for (size_t i = 0; i < sizeof(script_cmds) / sizeof(*script_cmds); ++i) {
+		if (strcmp(script_cmds[i].name, name) == 0)
+			return &script_cmds[i];
+	}
+	return NULL;
+}
+
+static void fail_line(struct script *script, uint64_t line, const char *cmd,
+					  const char *detail)
+{
+	flush_batch(script);
+	print_result(script, line, cmd, STATUS_ERROR, detail);
+}
+
+static void run_line(struct script *script, uint64_t line, char **words,
+					 size_t nr_words)
+{
+	const struct script_cmd *cmd = find_cmd(words[0]);
+	size_t nr_args = nr_words - 1;
+
+	if (cmd == NULL) {
+		fail_line(script, line, words[0], "unknown-command");
+		return;
+	}
+	if (nr_args < cmd->min_args || nr_args > cmd->max_args) {
+		fail_line(script, line, cmd->name, "invalid-arguments");
+		return;
+	}
+	if (cmd->needs_db && script->cli_prog->db_mgr.db_file == NULL) {
+		fail_line(script, line, cmd->name, "no-database");
+		return;
+	}
+
+	if (cmd->batch == BATCH_NONE) {
+		char detail[SCRIPT_DETAIL_LEN] = "";
+
+		flush_batch(script);
+		enum status status =
+			cmd->run(script->cli_prog, words + 1, nr_args, detail);
+		print_result(script, line, cmd->name, status, detail);
+		return;
+	}
+
+	if (script->batch != cmd->batch || script->len == SCRIPT_MAX_BATCH)
+		flush_batch(script);
+
+	struct script_op *op = &script->ops[script->len];
+	*op = (struct script_op){ .line = line, .cmd = cmd->name };
+	if (!cmd->parse(script, words + 1, op)) {
+		fail_line(script, line, cmd->name, "invalid-arguments");
+		return;
+	}
+
+	script->batch = cmd->batch;
+	++script->len;
+}
+
+enum status script_run(struct cli_program *cli_prog, FILE *in, FILE *out)
+{
+	struct script script = { .cli_prog = cli_prog, .out = out };
+
+	script.ops = malloc(SCRIPT_MAX_BATCH * sizeof(*script.ops));
+	script.items = malloc(SCRIPT_MAX_BATCH * sizeof(*script.items));
+	DIE(script.ops == NULL || script.items == NULL, "Error allocating batch");
+
+	char *line = NULL;
+	size_t line_capacity = 0;
+	uint64_t line_nr = 0;
+
+	while (getline(&line, &line_capacity, in) != -1) {
+		char *words[SCRIPT_MAX_WORDS];
+		size_t nr_words = split_words(line, words, SCRIPT_MAX_WORDS);
+
+		++line_nr;
+		if (nr_words == 0 || words[0][0] == '#')
+			continue;
+		if (nr_words > SCRIPT_MAX_WORDS) {
+			fail_line(&script, line_nr, words[0], "invalid-arguments");
+			continue;
+		}
+		run_line(&script, line_nr, words, nr_words);
+	}
+	flush_batch(&script);
+
+	if (ferror(in))
+		script.failed = true;
+
+	free(line);
+	free(script.items);
+	free(script.ops);
+	return script.failed ? STATUS_ERROR : STATUS_OK;
+}
+
+enum status script_run_file(struct cli_program *cli_prog, const char *path)
+{
+	bool use_stdin = strcmp(path, "-") == 0;
+	FILE *in = use_stdin ? stdin : fopen(path, "r");
+
+	if (in == NULL) {
+		fprintf(stderr, "Eroare la deschiderea fisierului\n");
+		return STATUS_ERROR;
+	}
+
+	enum status status = script_run(cli_prog, in, stdout);
+	if (!use_stdin)
+		(void)fclose(in);
+	return status;
+}
@@ -0,0 +1,277 @@
+#define _GNU_SOURCE
+
+#include "snapshot.h"
+
+#include "error.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define SNAPSHOT_MAGIC "SEQSNP01"
+
+/*
+ * The snapshot file holds the header and the map of the saved pages, padded to
+ * a whole number of memory pages, followed by the saved pages at their offset
+ * in the file. The pages that were not saved are holes.
+ */
+struct snapshot_file_header {
+	char magic[8];
+	uint64_t size;
+	uint64_t page_size;
+	uint64_t version;
+};
+
+struct snapshot {
+	int fd;
+	struct snapshot_file_header hdr;
+	uint64_t nr_pages;
+	// the header and the map of the saved pages, shared with the other
+	// processes
+	char *map;
+	size_t map_len;
+
+	// protects the saving of the pages against concurrent writers
+	pthread_mutex_t lock;
+	char *page;
+};
+
+static enum status pread_full(int fd, void *buf, size_t len, off_t offset)
+{
+	while (len > 0) {
+		ssize_t ret = pread(fd, buf, len, offset);
+		if (ret <= 0)
+			return STATUS_ERROR;
+		buf = (char *)buf + ret;
+		len -= ret;
+		offset += ret;
+	}
+
+	return STATUS_OK;
+}
+
+static enum status pwrite_full(int fd, const void *buf, size_t len,
+							   off_t offset)
+{
+	while (len > 0) {
+		ssize_t ret = pwrite(fd, buf, len, offset);
+		if (ret <= 0)
+			return STATUS_ERROR;
+		buf = (const char *)buf + ret;
+		len -= ret;
+		offset += ret;
+	}
+
+	return STATUS_OK;
+}
+
+static inline uint8_t *saved_map(const struct snapshot *snap)
+{
+	return (uint8_t *)snap->map + sizeof(struct snapshot_file_header);
+}
+
+static inline bool page_saved(const struct snapshot *snap, uint64_t page)
+{
+	return __atomic_load_n(&saved_map(snap)[page], __ATOMIC_ACQUIRE) != 0;
+}
+
+// size of a page, smaller for the last one
+static inline size_t page_len(const struct snapshot *snap, uint64_t page)
+{
+	uint64_t offset = page * snap->hdr.page_size;
+
+	return snap->hdr.size - offset < snap->hdr.page_size ?
+			   (size_t)(snap->hdr.size - offset) :
+			   snap->hdr.page_size;
+}
+
+/*
+ * @brief Set up a snapshot once its header is known. The header and the map of
+ * the saved pages are mapped by the caller.
+ */
+static struct snapshot *snapshot_init(int fd,
+									  const struct snapshot_file_header *hdr)
+{
+	struct snapshot *snap = calloc(1, sizeof(*snap));
+	DIE(snap == NULL, "Error allocating snapshot");
+
+	long mem_page = sysconf(_SC_PAGESIZE);
+	snap->fd = fd;
+	snap->hdr = *hdr;
+	snap->nr_pages = (hdr->size + hdr->page_size - 1) / hdr->page_size;
+	snap->map_len = (sizeof(*hdr) + snap->nr_pages + mem_page - 1) /
+					mem_page * mem_page;
+	DIE(pthread_mutex_init(&snap->lock, NULL) != 0,
+		"Error creating snapshot lock");
+
+	return snap;
+}
+
+// position of a part of the file in the snapshot file
+static inline off_t page_offset(const struct snapshot *snap, uint64_t offset)
+{
+	return (off_t)(snap->map_len + offset);
+}
+
+struct snapshot *snapshot_create(const char *path, uint64_t size,
+								 size_t page_size, uint64_t version)
+{
+	struct snapshot_file_header hdr = { .size = size,
+										.page_size = page_size,
+										.version = version };
+	memcpy(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic));
+
+	// the processes still using an older snapshot keep their own file
+	(void)unlink(path);
+	int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+	DIE(fd < 0, "Error creating snapshot");
+
+	struct snapshot *snap = snapshot_init(fd, &hdr);
+	DIE(ftruncate(fd, (off_t)snap->map_len) != 0 ||
+			pwrite_full(fd, &hdr, sizeof(hdr), 0) != STATUS_OK,
+		"Error writing snapshot");
+
+	snap->map = mmap(NULL, snap->map_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+					 fd, 0);
+	DIE(snap->map == MAP_FAILED, "Error mapping snapshot");
+	return snap;
+}
+
+struct snapshot *snapshot_open(const char *path)
+{
+	struct snapshot_file_header hdr;
+
+	int fd = open(path, O_RDWR);
+	if (fd < 0)
+		return NULL;
+
+	if (pread_full(fd, &hdr, sizeof(hdr), 0) != STATUS_OK ||
+		memcmp(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic)) != 0 ||
+		hdr.page_size == 0) {
+		(void)close(fd);
+		return NULL;
+	}
+
+	struct snapshot *snap = snapshot_init(fd, &hdr);
+	snap->map = mmap(NULL, snap->map_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+					 fd, 0);
+	DIE(snap->map == MAP_FAILED, "Error mapping snapshot");
+	return snap;
+}
+
+void snapshot_close(struct snapshot *snap)
+{
+	if (snap == NULL)
+		return;
+
+	(void)munmap(snap->map, snap->map_len);
+	(void)close(snap->fd);
+	(void)pthread_mutex_destroy(&snap->lock);
+	free(snap->page);
+	free(snap);
+}
+
+uint64_t snapshot_version(const struct snapshot *snap)
+{
+	return snap->hdr.version;
+}
+
+/*
+ * @brief Save the old image of a page, unless another thread saved it first.
+ * @return The status of the operation.
+ */
+static enum status save_page(struct snapshot *snap, uint64_t page,
+							 snapshot_read_func read_part, void *ctx,
+							 bool *saved)
+{
+	uint64_t offset = page * snap->hdr.page_size;
+	size_t len = page_len(snap, page);
+	enum status status = STATUS_OK;
+
+	pthread_mutex_lock(&snap->lock);
+	*saved = false;
+	if (page_saved(snap, page))
+		goto out;
+
+	if (snap->page == NULL) {
+		snap->page = malloc(snap->hdr.page_size);
+		DIE(snap->page == NULL, "Error allocating snapshot page");
+	}
+
+	status = read_part(ctx, offset, snap->page, len);
+	if (status == STATUS_OK)
+		status = pwrite_full(snap->fd, snap->page, len,
+							 page_offset(snap, offset));
+	// the readers only use the image once it is complete
+	if (status == STATUS_OK) {
+		__atomic_store_n(&saved_map(snap)[page], 1, __ATOMIC_RELEASE);
+		*saved = true;
+	}
+
+out:
+	pthread_mutex_unlock(&snap->lock);
+	return status;
+}
+
+enum status snapshot_preserve(struct snapshot *snap, uint64_t offset,
+							  size_t len, snapshot_read_func read_part,
+							  void *ctx, size_t *nr_saved)
+{
+	*nr_saved = 0;
+	if (len == 0 || offset >= snap->hdr.size)
+		return STATUS_OK;
+
+	uint64_t end = offset + len < snap->hdr.size ? offset + len :
+												   snap->hdr.size;
+	uint64_t last = (end - 1) / snap->hdr.page_size;
+
+	for (uint64_t page = offset / snap->hdr.page_size; page <= last; ++page) {
+		bool saved;
+
+		if (page_saved(snap, page))
+			continue;
+		if (save_page(snap, page, read_part, ctx, &saved) != STATUS_OK)
+			return STATUS_ERROR;
+		*nr_saved += saved;
+	}
+
+	return STATUS_OK;
+}
+
+enum status snapshot_patch(struct snapshot *snap, uint64_t offset, void *buf,
+						   size_t len, size_t *nr_patched)
+{
+	*nr_patched = 0;
+	if (len == 0 || offset >= snap->hdr.size)
+		return STATUS_OK;
+
+	uint64_t end = offset + len < snap->hdr.size ? offset + len :
+												   snap->hdr.size;
+	uint64_t last = (end - 1) / snap->hdr.page_size;
+
+	for (uint64_t page = offset / snap->hdr.page_size; page <= last; ++page) {
+		if (!page_saved(snap, page))
+			continue;
+
+		// the part of the page inside the range
+		uint64_t first = page * snap->hdr.page_size;
+		uint64_t stop = first + page_len(snap, page);
+		if (first < offset)
+			first = offset;
+		if (stop > end)
+			stop = end;
+
+		if (pread_full(snap->fd, (char *)buf + (first - offset),
+					   (size_t)(stop - first),
+					   page_offset(snap, first)) != STATUS_OK)
+			return STATUS_ERROR;
+		++*nr_patched;
+	}
+
+	return STATUS_OK;
+}
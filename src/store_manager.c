@@ -2,25 +2,156 @@
 
 #include "database.h"
 #include "error.h"
+#include "report.h"
 
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 
-enum status add_item(struct db_manager db_mgr, const struct store_item *item)
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#define ITEM_COLUMN(field)                                \
+	{ .offset = offsetof(struct store_item, field),       \
+	  .size = sizeof(((struct store_item *)NULL)->field) }
+
+// longest report entry: the labels, the numbers and the escaped(JSON) names
+#define STORE_ITEM_REPORT_MAX_LEN                           \
+	(256 + 4 * REPORT_NUMBER_MAX_LEN + 6 * ITEM_NAME_MAX_LEN + \
+	 6 * ITEM_CATEGORY_MAX_LEN)
+
+// number of imported items appended to the database at once
+#define IMPORT_BATCH_ITEMS (1UL << 18)
+
+// the fields of an imported line, in order
+enum import_field {
+	IMPORT_BARCODE,
+	IMPORT_NAME,
+	IMPORT_CATEGORY,
+	IMPORT_PRICE,
+	IMPORT_QUANTITY,
+	IMPORT_EXPIRY_DATE,
+	IMPORT_NR_FIELDS,
+};
+
+// number of updates read from a file applied to the database at once
+#define UPDATE_BATCH_ITEMS (1UL << 16)
+
+// the fields of a line of updates, in order
+enum update_field {
+	UPDATE_BARCODE,
+	UPDATE_FIELD,
+	UPDATE_VALUE,
+	UPDATE_NR_FIELDS,
+};
+
+/*
+ * A batch of updates read from a file, with the values they point to.
+ */
+struct update_batch {
+	struct key_update *updates;
+	union {
+		float price;
+		int quantity;
+		struct date date;
+		float discount;
+	} *vals;
+	bool *found;
+	size_t len;
+};
+
+const struct db_column store_item_columns[ITEM_NR_COLUMNS] = {
+	[ITEM_COLUMN_PRICE] = ITEM_COLUMN(price),
+	[ITEM_COLUMN_BARCODE] = ITEM_COLUMN(barcode),
+	[ITEM_COLUMN_QUANTITY] = ITEM_COLUMN(quantity),
+	[ITEM_COLUMN_EXPIRY_DATE] = ITEM_COLUMN(expiry_date),
+	[ITEM_COLUMN_NAME] = ITEM_COLUMN(name),
+	[ITEM_COLUMN_CATEGORY] = ITEM_COLUMN(category),
+};
+
+enum status add_item(struct db_manager *db_mgr, const struct store_item *item)
 {
 	return append_entry(db_mgr, (void *)item);
 }
 
+bool is_valid_date(const struct date *date)
+{
+	return date->day > 0 && date->day <= 31 && date->month > 0 &&
+		   date->month <= 12 && date->year > 0;
+}
+
+int64_t get_barcode(const void *entry)
+{
+	return ((const struct store_item *)entry)->barcode;
+}
+
+const char *get_category(const void *entry)
+{
+	return ((const struct store_item *)entry)->category;
+}
+
+const char *get_name(const void *entry)
+{
+	return ((const struct store_item *)entry)->name;
+}
+
+int64_t pack_date(const struct date *date)
+{
+	return (int64_t)date->year * 10000 + date->month * 100 + date->day;
+}
+
+int64_t get_expiry_key(const void *entry)
+{
+	return pack_date(&((const struct store_item *)entry)->expiry_date);
+}
+
+void get_item_measures(const void *entry, int64_t *values)
+{
+	const struct store_item *item = entry;
+
+	values[ITEM_MEASURE_QUANTITY] = (int64_t)item->quantity;
+	values[ITEM_MEASURE_PRICE] = llroundf(item->price * 100);
+	// rounded once per item, so the error does not grow with the quantity
+	values[ITEM_MEASURE_VALUE] =
+		llround((double)item->price * (double)item->quantity * 100);
+}
+
+static inline bool item_has_barcode(const struct store_item *item,
+									const int64_t *barcode)
+{
+	return item->barcode == *barcode;
+}
+
+// the ASCII letters folded to lower case, like strcasecmp does in the C locale
+static inline unsigned char fold_char(unsigned char c)
+{
+	return c + ((unsigned char)(c - 'A') < 26) * ('a' - 'A');
+}
+
+static inline bool item_in_category(const struct store_item *item,
+									const char *category)
+{
+	for (const char *c = item->category;; ++c, ++category) {
+		if (fold_char(*c) != fold_char(*category))
+			return false;
+		if (*c == '\0')
+			return true;
+	}
+}
+
 bool matches_barcode(const void *entry, const void *barcode)
 {
-	return ((const struct store_item *)entry)->barcode ==
-		   *(const int64_t *)barcode;
+	return item_has_barcode(entry, barcode);
 }
 
 bool matches_category(const void *entry, const void *category)
 {
-	return strcasecmp(((const struct store_item *)entry)->category,
-					  (const char *)category) == 0;
+	return item_in_category(entry, category);
 }
 
 bool matches_name(const void *entry, const void *name)
@@ -29,38 +160,638 @@ bool matches_name(const void *entry, const void *name)
 					  (const char *)name) == 0;
 }
 
+static inline void set_price(struct store_item *item, const float *price)
+{
+	item->price = *price;
+}
+
+static inline void set_quantity(struct store_item *item, const int *quantity)
+{
+	item->quantity = *quantity;
+}
+
+static inline void set_expiry_date(struct store_item *item,
+								   const struct date *expiry_date)
+{
+	memmove(&item->expiry_date, expiry_date, sizeof(struct date));
+}
+
+static inline void apply_discount(struct store_item *item,
+								  const float *discount)
+{
+	item->price *= 1 - *discount;
+}
+
 void update_price(void *entry, const void *price)
 {
-	((struct store_item *)entry)->price = *(const float *)price;
+	set_price(entry, price);
 }
 
 void update_quantity(void *entry, const void *quantity)
 {
-	((struct store_item *)entry)->quantity = *(const int *)quantity;
+	set_quantity(entry, quantity);
 }
 
 void update_expiry_date(void *entry, const void *expiry_date)
 {
-	memmove(&((struct store_item *)entry)->expiry_date, expiry_date,
-			sizeof(struct date));
+	set_expiry_date(entry, expiry_date);
 }
 
 void discount_price(void *entry, const void *discount)
 {
-	((struct store_item *)entry)->price *= 1 - *(const float *)discount;
+	apply_discount(entry, discount);
+}
+
+DEFINE_SELECT_KERNEL(select_barcode_block, struct store_item, item_has_barcode)
+DEFINE_SELECT_KERNEL(select_category_block, struct store_item,
+					 item_in_category)
+DEFINE_UPDATE_KERNEL(update_price_block, struct store_item, set_price)
+DEFINE_UPDATE_KERNEL(update_quantity_block, struct store_item, set_quantity)
+DEFINE_UPDATE_KERNEL(update_expiry_block, struct store_item, set_expiry_date)
+DEFINE_UPDATE_KERNEL(discount_block, struct store_item, apply_discount)
+
+#define ITEM_KERNEL(match_fn, select_fn, update_fn, block_fn)    \
+	{ .matches = match_fn, .update = update_fn,                 \
+	  .kernel = { .select = select_fn, .update = block_fn } }
+
+/*
+ * The kernels of a pair of a predicate and an update.
+ */
+struct item_kernel {
+	match_crit_func matches;
+	update_func update;
+	struct scan_kernel kernel;
+};
+
+static const struct item_kernel item_kernels[] = {
+	ITEM_KERNEL(matches_barcode, select_barcode_block, update_price,
+				update_price_block),
+	ITEM_KERNEL(matches_barcode, select_barcode_block, update_quantity,
+				update_quantity_block),
+	ITEM_KERNEL(matches_barcode, select_barcode_block, update_expiry_date,
+				update_expiry_block),
+	ITEM_KERNEL(matches_barcode, select_barcode_block, discount_price,
+				discount_block),
+	ITEM_KERNEL(matches_category, select_category_block, update_price,
+				update_price_block),
+	ITEM_KERNEL(matches_category, select_category_block, update_quantity,
+				update_quantity_block),
+	ITEM_KERNEL(matches_category, select_category_block, update_expiry_date,
+				update_expiry_block),
+	ITEM_KERNEL(matches_category, select_category_block, discount_price,
+				discount_block),
+};
+
+const struct scan_kernel *find_item_kernel(match_crit_func matches,
+										   update_func update)
+{
+	for (size_t i = 0; i < sizeof(item_kernels) / sizeof(*item_kernels); ++i) {
+		if (item_kernels[i].matches == matches &&
+			item_kernels[i].update == update)
+			return &item_kernels[i].kernel;
+	}
+	return NULL;
+}
+
+enum status update_items_matching(struct db_manager *db_mgr,
+								  const void *criteria, match_crit_func matches,
+								  const void *update_val, update_func update)
+{
+	const struct scan_kernel *kernel = find_item_kernel(matches, update);
+
+	if (kernel == NULL)
+		return update_entries(db_mgr, criteria, matches, update_val, update);
+	return update_entries_with(db_mgr, criteria, update_val, kernel);
+}
+
+enum status discount_expiring_before(struct db_manager *db_mgr,
+									 const struct date *date, float discount)
+{
+	return update_entries_by_range(db_mgr, INT64_MIN, pack_date(date) - 1,
+								   &discount, discount_price);
+}
+
+void select_barcode(const void *barcodes, size_t count, const void *barcode,
+					uint8_t *selected)
+{
+	const int64_t *values = barcodes;
+	int64_t ref = *(const int64_t *)barcode;
+	size_t i = 0;
+
+#ifdef __AVX2__
+	__m256i ref_vec = _mm256_set1_epi64x(ref);
+	for (; i + 4 <= count; i += 4) {
+		__m256i vec = _mm256_loadu_si256((const __m256i *)(values + i));
+		int mask = _mm256_movemask_pd(
+			_mm256_castsi256_pd(_mm256_cmpeq_epi64(vec, ref_vec)));
+		for (int j = 0; j < 4; ++j)
+			selected[i + j] = (mask >> j) & 1;
+	}
+#endif
+
+	for (; i < count; ++i)
+		selected[i] = values[i] == ref;
+}
+
+void select_price_range(const void *prices, size_t count, const void *range,
+						uint8_t *selected)
+{
+	const float *values = prices;
+	const struct price_range *ref = range;
+	size_t i = 0;
+
+#ifdef __AVX2__
+	__m256 min_vec = _mm256_set1_ps(ref->min);
+	__m256 max_vec = _mm256_set1_ps(ref->max);
+	for (; i + 8 <= count; i += 8) {
+		__m256 vec = _mm256_loadu_ps(values + i);
+		__m256 above_min = _mm256_cmp_ps(vec, min_vec, _CMP_GE_OQ);
+		__m256 below_max = _mm256_cmp_ps(vec, max_vec, _CMP_LE_OQ);
+		int mask = _mm256_movemask_ps(_mm256_and_ps(above_min, below_max));
+		for (int j = 0; j < 8; ++j)
+			selected[i + j] = (mask >> j) & 1;
+	}
+#endif
+
+	for (; i < count; ++i)
+		selected[i] = values[i] >= ref->min && values[i] <= ref->max;
+}
+
+/*
+ * @brief order the dates as integers: the year is kept in the upper half, the
+ * month and the day in the lower bytes, as they are laid out in struct date
+ */
+static inline int64_t date_key(const struct date *date)
+{
+	return (int64_t)((uint64_t)(uint32_t)date->year << 32 |
+					 (uint64_t)(uint8_t)date->month << 8 |
+					 (uint8_t)date->day);
+}
+
+/*
+ * @brief write a date as zi/luna/an, like printf's "%02d/%02d/%d"
+ */
+static char *put_date(char *dst, const struct date *date)
+{
+	dst = report_put_int(dst, date->day, 2);
+	*dst++ = '/';
+	dst = report_put_int(dst, date->month, 2);
+	*dst++ = '/';
+	return report_put_int(dst, date->year, 0);
+}
+
+void select_expiry_before(const void *dates, size_t count, const void *date,
+						  uint8_t *selected)
+{
+	const struct date *values = dates;
+	int64_t ref = date_key(date);
+	size_t i = 0;
+
+#if defined(__AVX2__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	_Static_assert(sizeof(struct date) == 8 &&
+					   offsetof(struct date, year) == 4,
+				   "unexpected struct date layout");
+	// loading a date as an integer yields its key once the padding is masked
+	__m256i key_mask = _mm256_set1_epi64x((int64_t)0xffffffff0000ffffULL);
+	__m256i ref_vec = _mm256_set1_epi64x(ref);
+	for (; i + 4 <= count; i += 4) {
+		__m256i vec = _mm256_and_si256(
+			_mm256_loadu_si256((const __m256i *)(values + i)), key_mask);
+		int mask = _mm256_movemask_pd(
+			_mm256_castsi256_pd(_mm256_cmpgt_epi64(ref_vec, vec)));
+		for (int j = 0; j < 4; ++j)
+			selected[i + j] = (mask >> j) & 1;
+	}
+#endif
+
+	for (; i < count; ++i)
+		selected[i] = date_key(&values[i]) < ref;
 }
 
 void dump_store_item_info(const void *entry, FILE *out)
 {
-	(void)fprintf(out, "-----------------\n");
 	const struct store_item *item = (const struct store_item *)entry;
-	(void)fprintf(out, "Cod produs: %ld\n", item->barcode);
-	(void)fprintf(out, "Nume produs: %s\n", item->name);
-	(void)fprintf(out, "Categorie: %s\n", item->category);
-	(void)fprintf(out, "Pret: %.2f\n", item->price);
-	(void)fprintf(out, "Cantitate: %zu\n", item->quantity);
-	(void)fprintf(out, "Data de expirare: %02d/%02d/%d\n",
-				  item->expiry_date.day, item->expiry_date.month,
-				  item->expiry_date.year);
-	(void)fprintf(out, "-----------------\n");
+	char buf[STORE_ITEM_REPORT_MAX_LEN];
+	char *pos = buf;
+
+	if (item == NULL) {
+		(void)fputs("Nicio intrare gasita\n", out);
+		return;
+	}
+
+	pos = REPORT_PUT_LITERAL(pos, "-----------------\nCod produs: ");
+	pos = report_put_int(pos, item->barcode, 0);
+	pos = REPORT_PUT_LITERAL(pos, "\nNume produs: ");
+	pos = report_put_str(pos, item->name, ITEM_NAME_MAX_LEN);
+	pos = REPORT_PUT_LITERAL(pos, "\nCategorie: ");
+	pos = report_put_str(pos, item->category, ITEM_CATEGORY_MAX_LEN);
+	pos = REPORT_PUT_LITERAL(pos, "\nPret: ");
+	pos = report_put_price(pos, item->price);
+	pos = REPORT_PUT_LITERAL(pos, "\nCantitate: ");
+	pos = report_put_uint(pos, item->quantity);
+	pos = REPORT_PUT_LITERAL(pos, "\nData de expirare: ");
+	pos = put_date(pos, &item->expiry_date);
+	pos = REPORT_PUT_LITERAL(pos, "\n-----------------\n");
+
+	(void)fwrite(buf, 1, pos - buf, out);
+}
+
+void dump_store_item_csv(const void *entry, FILE *out)
+{
+	const struct store_item *item = (const struct store_item *)entry;
+	char buf[STORE_ITEM_REPORT_MAX_LEN];
+	char *pos = buf;
+
+	// an empty report is only made of its header
+	if (item == NULL)
+		return;
+
+	pos = report_put_int(pos, item->barcode, 0);
+	*pos++ = ',';
+	pos = report_put_csv(pos, item->name, ITEM_NAME_MAX_LEN);
+	*pos++ = ',';
+	pos = report_put_csv(pos, item->category, ITEM_CATEGORY_MAX_LEN);
+	*pos++ = ',';
+	pos = report_put_price(pos, item->price);
+	*pos++ = ',';
+	pos = report_put_uint(pos, item->quantity);
+	*pos++ = ',';
+	pos = put_date(pos, &item->expiry_date);
+	*pos++ = '\n';
+
+	(void)fwrite(buf, 1, pos - buf, out);
+}
+
+void dump_store_item_json(const void *entry, FILE *out)
+{
+	const struct store_item *item = (const struct store_item *)entry;
+	char buf[STORE_ITEM_REPORT_MAX_LEN];
+	char *pos = buf;
+
+	// an empty report is only made of its header
+	if (item == NULL)
+		return;
+
+	pos = REPORT_PUT_LITERAL(pos, "{\"barcode\":");
+	pos = report_put_int(pos, item->barcode, 0);
+	pos = REPORT_PUT_LITERAL(pos, ",\"name\":");
+	pos = report_put_json(pos, item->name, ITEM_NAME_MAX_LEN);
+	pos = REPORT_PUT_LITERAL(pos, ",\"category\":");
+	pos = report_put_json(pos, item->category, ITEM_CATEGORY_MAX_LEN);
+	pos = REPORT_PUT_LITERAL(pos, ",\"price\":");
+	pos = report_put_price(pos, item->price);
+	pos = REPORT_PUT_LITERAL(pos, ",\"quantity\":");
+	pos = report_put_uint(pos, item->quantity);
+	pos = REPORT_PUT_LITERAL(pos, ",\"expiry_date\":\"");
+	pos = put_date(pos, &item->expiry_date);
+	pos = REPORT_PUT_LITERAL(pos, "\"}\n");
+
+	(void)fwrite(buf, 1, pos - buf, out);
+}
+
+dump_entry_func store_item_dumper(enum report_format format)
+{
+	switch (format) {
+	case REPORT_CSV:
+		return dump_store_item_csv;
+	case REPORT_JSON_LINES:
+		return dump_store_item_json;
+	default:
+		return dump_store_item_info;
+	}
+}
+
+void dump_store_item_header(enum report_format format, FILE *out)
+{
+	if (format == REPORT_CSV)
+		(void)fputs("barcode,name,category,price,quantity,expiry_date\n",
+					out);
+}
+
+enum status dump_store_items(struct db_manager *db_mgr,
+							 enum report_format format, const char *category,
+							 FILE *out)
+{
+	dump_entry_func dump_entry = store_item_dumper(format);
+
+	if (db_mgr->shared) {
+		if (open_snapshot(db_mgr) != STATUS_OK)
+			return STATUS_ERROR;
+
+		enum status status =
+			dump_snapshot(db_mgr, dump_entry, category,
+						  category != NULL ? matches_category : NULL, out);
+		if (close_snapshot(db_mgr) != STATUS_OK)
+			status = STATUS_ERROR;
+		return status;
+	}
+
+	if (category != NULL)
+		return dump_database_by_group(db_mgr, dump_entry, category, out);
+
+	dump_database(db_mgr, dump_entry, NULL, NULL, out);
+	return STATUS_OK;
+}
+
+/*
+ * @brief split a line into its fields in place, removing the quotes around the
+ * quoted fields("" stands for a quote inside them)
+ * @return the number of fields, at most max + 1 if there are too many
+ */
+static size_t split_fields(char *line, char sep, char **fields, size_t max)
+{
+	size_t nr_fields = 0;
+	char *src = line;
+
+	for (;;) {
+		char *dst = src;
+
+		if (nr_fields == max)
+			return max + 1;
+		fields[nr_fields++] = dst;
+
+		if (*src == '"') {
+			for (++src; *src != '\0'; ++src) {
+				if (*src == '"' && *++src != '"')
+					break;
+				*dst++ = *src;
+			}
+		}
+		while (*src != sep && *src != '\0')
+			*dst++ = *src++;
+
+		char end = *src;
+		*dst = '\0';
+		if (end == '\0')
+			return nr_fields;
+		++src;
+	}
+}
+
+static bool parse_int(const char *str, int64_t min, int64_t max,
+					  int64_t *value)
+{
+	char *end;
+
+	errno = 0;
+	long long val = strtoll(str, &end, 10);
+	if (end == str || *end != '\0' || errno == ERANGE || val < min ||
+		val > max)
+		return false;
+
+	*value = val;
+	return true;
+}
+
+bool parse_date(const char *str, struct date *date)
+{
+	long parts[3];
+
+	for (int i = 0; i < 3; ++i) {
+		char *end;
+
+		errno = 0;
+		parts[i] = strtol(str, &end, 10);
+		if (end == str || errno == ERANGE || parts[i] < 0 ||
+			parts[i] > INT32_MAX)
+			return false;
+		if (i < 2 && (*end == '\0' || strchr("/.- ", *end) == NULL))
+			return false;
+		if (i == 2 && *end != '\0')
+			return false;
+		str = end + 1;
+	}
+
+	if (parts[0] > 31 || parts[1] > 12)
+		return false;
+
+	*date = (struct date){ .day = (int8_t)parts[0],
+						   .month = (int8_t)parts[1],
+						   .year = (int32_t)parts[2] };
+	return is_valid_date(date);
+}
+
+static bool parse_text(const char *str, char *dst, size_t size)
+{
+	size_t len = strlen(str);
+
+	if (len == 0 || len >= size)
+		return false;
+
+	memcpy(dst, str, len + 1);
+	return true;
+}
+
+bool parse_store_item(char **fields, struct store_item *item)
+{
+	int64_t quantity;
+	char *end;
+
+	*item = (struct store_item){ 0 };
+	if (!parse_int(fields[IMPORT_BARCODE], 0, INT64_MAX, &item->barcode) ||
+		!parse_text(fields[IMPORT_NAME], item->name, sizeof(item->name)) ||
+		!parse_text(fields[IMPORT_CATEGORY], item->category,
+					sizeof(item->category)) ||
+		!parse_int(fields[IMPORT_QUANTITY], 0, INT64_MAX, &quantity) ||
+		!parse_date(fields[IMPORT_EXPIRY_DATE], &item->expiry_date))
+		return false;
+	item->quantity = (size_t)quantity;
+
+	errno = 0;
+	item->price = strtof(fields[IMPORT_PRICE], &end);
+	return end != fields[IMPORT_PRICE] && *end == '\0' && errno != ERANGE &&
+		   isfinite(item->price) && item->price >= 0;
+}
+
+enum status import_store_items(struct db_manager *db_mgr, FILE *in,
+							   struct import_stats *stats)
+{
+	struct store_item *batch = malloc(IMPORT_BATCH_ITEMS * sizeof(*batch));
+	DIE(batch == NULL, "Error allocating import buffer");
+
+	char *line = NULL;
+	size_t line_capacity = 0;
+	size_t batch_len = 0;
+	uint64_t line_nr = 0;
+	char sep = ',';
+	enum status status = STATUS_OK;
+	ssize_t len;
+
+	*stats = (struct import_stats){ 0 };
+	while (status == STATUS_OK &&
+		   (len = getline(&line, &line_capacity, in)) != -1) {
+		++line_nr;
+		while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+			line[--len] = '\0';
+		if (len == 0)
+			continue;
+
+		if (line_nr == 1 && strchr(line, '\t') != NULL)
+			sep = '\t';
+
+		char *fields[IMPORT_NR_FIELDS];
+		size_t nr_fields = split_fields(line, sep, fields, IMPORT_NR_FIELDS);
+		if (nr_fields == IMPORT_NR_FIELDS &&
+			parse_store_item(fields, &batch[batch_len])) {
+			++stats->imported;
+			if (++batch_len == IMPORT_BATCH_ITEMS) {
+				status = append_entries(db_mgr, batch, batch_len);
+				batch_len = 0;
+			}
+			continue;
+		}
+
+		int64_t barcode;
+		if (line_nr == 1 &&
+			!parse_int(fields[IMPORT_BARCODE], 0, INT64_MAX, &barcode))
+			continue;
+
+		++stats->rejected;
+		if (stats->first_bad_line == 0)
+			stats->first_bad_line = line_nr;
+	}
+
+	if (status == STATUS_OK && ferror(in))
+		status = STATUS_ERROR;
+	if (status == STATUS_OK && batch_len > 0)
+		status = append_entries(db_mgr, batch, batch_len);
+
+	free(line);
+	free(batch);
+	return status;
+}
+
+/*
+ * @brief parse the field and the value of a line of updates into an update of
+ * the batch
+ * @return true if the field is known and the value is valid for it
+ */
+static bool parse_update(char **fields, struct update_batch *batch)
+{
+	struct key_update *update = &batch->updates[batch->len];
+	const char *field = fields[UPDATE_FIELD];
+	const char *value = fields[UPDATE_VALUE];
+	char *end;
+
+	if (!parse_int(fields[UPDATE_BARCODE], 0, INT64_MAX, &update->key))
+		return false;
+	update->update_val = &batch->vals[batch->len];
+
+	if (strcmp(field, "quantity") == 0) {
+		int64_t quantity;
+
+		update->update = update_quantity;
+		if (!parse_int(value, 0, INT_MAX, &quantity))
+			return false;
+		batch->vals[batch->len].quantity = (int)quantity;
+		return true;
+	}
+	if (strcmp(field, "expiry") == 0) {
+		update->update = update_expiry_date;
+		return parse_date(value, &batch->vals[batch->len].date);
+	}
+
+	float val;
+	if (strcmp(field, "price") == 0)
+		update->update = update_price;
+	else if (strcmp(field, "discount") == 0)
+		update->update = discount_price;
+	else
+		return false;
+
+	errno = 0;
+	val = strtof(value, &end);
+	if (end == value || *end != '\0' || errno == ERANGE || !isfinite(val) ||
+		val < 0)
+		return false;
+	if (update->update == discount_price) {
+		if (val > 100)
+			return false;
+		val /= 100;
+	}
+	batch->vals[batch->len].price = val;
+	return true;
+}
+
+/*
+ * @brief apply the updates waiting in the batch with a single call and count
+ * their outcome
+ */
+static enum status flush_updates(struct db_manager *db_mgr,
+								 struct update_batch *batch,
+								 struct update_stats *stats)
+{
+	enum status status = update_entries_by_keys(db_mgr, batch->updates,
+												batch->len, batch->found);
+
+	if (status != STATUS_ERROR) {
+		for (size_t i = 0; i < batch->len; ++i) {
+			if (batch->found[i])
+				++stats->applied;
+			else
+				++stats->not_found;
+		}
+		status = STATUS_OK;
+	}
+	batch->len = 0;
+	return status;
+}
+
+enum status update_store_items(struct db_manager *db_mgr, FILE *in,
+							   struct update_stats *stats)
+{
+	struct update_batch batch = { 0 };
+	batch.updates = malloc(UPDATE_BATCH_ITEMS * sizeof(*batch.updates));
+	batch.vals = malloc(UPDATE_BATCH_ITEMS * sizeof(*batch.vals));
+	batch.found = malloc(UPDATE_BATCH_ITEMS * sizeof(*batch.found));
+	DIE(batch.updates == NULL || batch.vals == NULL || batch.found == NULL,
+		"Error allocating update buffer");
+
+	char *line = NULL;
+	size_t line_capacity = 0;
+	uint64_t line_nr = 0;
+	char sep = ',';
+	enum status status = STATUS_OK;
+	ssize_t len;
+
+	*stats = (struct update_stats){ 0 };
+	while (status == STATUS_OK &&
+		   (len = getline(&line, &line_capacity, in)) != -1) {
+		++line_nr;
+		while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+			line[--len] = '\0';
+		if (len == 0)
+			continue;
+
+		if (line_nr == 1 && strchr(line, '\t') != NULL)
+			sep = '\t';
+
+		char *fields[UPDATE_NR_FIELDS];
+		size_t nr_fields = split_fields(line, sep, fields, UPDATE_NR_FIELDS);
+		if (nr_fields == UPDATE_NR_FIELDS && parse_update(fields, &batch)) {
+			if (++batch.len == UPDATE_BATCH_ITEMS)
+				status = flush_updates(db_mgr, &batch, stats);
+			continue;
+		}
+
+		int64_t barcode;
+		if (line_nr == 1 &&
+			!parse_int(fields[UPDATE_BARCODE], 0, INT64_MAX, &barcode))
+			continue;
+
+		++stats->rejected;
+		if (stats->first_bad_line == 0)
+			stats->first_bad_line = line_nr;
+	}
+
+	if (status == STATUS_OK && ferror(in))
+		status = STATUS_ERROR;
+	if (status == STATUS_OK && batch.len > 0)
+		status = flush_updates(db_mgr, &batch, stats);
+
+	free(line);
+	free(batch.found);
+	free(batch.vals);
+	free(batch.updates);
+	return status;
 }
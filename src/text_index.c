@@ -0,0 +1,819 @@
+#define _GNU_SOURCE
+
+#include "text_index.h"
+
+#include "error.h"
+#include "posting_list.h"
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEXT_INDEX_MAGIC "DBTIDX01"
+// the new texts are sorted apart and merged with the others in batches
+#define TEXT_DELTA_MAX 1024
+#define TABLE_MIN_CAPACITY 1024
+// maximum percentage of non-empty buckets before a table is grown
+#define TABLE_MAX_LOAD 70
+
+#define BUCKET_EMPTY (-1)
+#define BUCKET_DELETED (-2)
+// trigrams are built from non-zero bytes, so no trigram is 0
+#define GRAM_EMPTY 0
+
+/*
+ * The index file holds the header, followed by the texts in sorted order(the
+ * slot, the length of the text and the text) and by the trigrams(the trigram
+ * and its posting list).
+ */
+struct text_file_header {
+	char magic[8];
+	uint64_t nr_texts;
+	uint64_t nr_grams;
+	uint64_t data_size;
+	uint64_t data_mtime;
+	uint32_t clean;
+	uint32_t reserved;
+};
+
+struct text_entry {
+	// case folded text, owned by the entry
+	char *text;
+	// the slot of the entry or BUCKET_EMPTY once it was removed
+	int64_t slot;
+};
+
+struct sorted_texts {
+	struct text_entry *entries;
+	size_t len;
+	size_t capacity;
+};
+
+struct slot_bucket {
+	int64_t slot;
+	const char *text;
+};
+
+struct gram_bucket {
+	uint32_t gram;
+	struct posting_list list;
+};
+
+struct text_index {
+	char *path;
+	// sorted by text and slot; the removed entries are only dropped when the
+	// new texts are merged in
+	struct sorted_texts main;
+	size_t main_removed;
+	// the texts added since the last merge, sorted by text and slot
+	struct sorted_texts delta;
+
+	// open addressing table mapping each slot to its text
+	struct slot_bucket *slots;
+	uint64_t slots_capacity;
+	uint64_t slots_used;
+	uint64_t slots_deleted;
+
+	// open addressing table of the trigram posting lists
+	struct gram_bucket *grams;
+	uint64_t grams_capacity;
+	uint64_t grams_used;
+};
+
+static char *fold_text(const char *text)
+{
+	char *folded = strdup(text);
+	DIE(folded == NULL, "Error allocating text");
+
+	for (char *c = folded; *c != '\0'; ++c)
+		*c = (char)tolower((unsigned char)*c);
+	return folded;
+}
+
+uint64_t text_index_hash(const char *text)
+{
+	// FNV-1a over the case folded text
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	for (; *text != '\0'; ++text) {
+		hash ^= (uint8_t)tolower((unsigned char)*text);
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static uint64_t hash_int(uint64_t x)
+{
+	// splitmix64 finalizer
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+static int compare_entry(const char *text, int64_t slot,
+						 const struct text_entry *entry)
+{
+	int cmp = strcmp(text, entry->text);
+
+	if (cmp != 0)
+		return cmp;
+	return (slot > entry->slot) - (slot < entry->slot);
+}
+
+/*
+ * @brief Get the position of the first entry whose text is not lower than the
+ * given one.
+ */
+static size_t text_lower_bound(const struct sorted_texts *texts,
+							   const char *text)
+{
+	size_t lo = 0;
+	size_t hi = texts->len;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (strcmp(texts->entries[mid].text, text) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/*
+ * @brief Find the entry of a slot among the entries with the same text.
+ * @return The position of the entry or texts->len if it is missing.
+ */
+static size_t find_entry(const struct sorted_texts *texts, const char *text,
+						 int64_t slot)
+{
+	for (size_t pos = text_lower_bound(texts, text);
+		 pos < texts->len && strcmp(texts->entries[pos].text, text) == 0;
+		 ++pos) {
+		if (texts->entries[pos].slot == slot)
+			return pos;
+	}
+	return texts->len;
+}
+
+static void reserve_texts(struct sorted_texts *texts, size_t capacity)
+{
+	if (capacity <= texts->capacity)
+		return;
+
+	texts->capacity = capacity;
+	texts->entries =
+		realloc(texts->entries, capacity * sizeof(*texts->entries));
+	DIE(texts->entries == NULL, "Error allocating text index");
+}
+
+/*
+ * @brief Merge sorted new texts into the main ones, dropping the removed
+ * entries.
+ * @param ti The index.
+ * @param delta The new texts, emptied by the merge.
+ */
+static void merge_texts(struct text_index *ti, struct sorted_texts *delta)
+{
+	struct sorted_texts *main = &ti->main;
+
+	// without removed entries, the new texts are merged in place from the end,
+	// galloping over the runs of main entries between two new ones
+	if (ti->main_removed == 0) {
+		size_t i = main->len;
+		size_t k = main->len + delta->len;
+
+		reserve_texts(main, k + 1);
+		for (size_t j = delta->len; j-- > 0;) {
+			const struct text_entry *entry = &delta->entries[j];
+			size_t hi = i;
+			size_t step = 1;
+
+			while (step <= hi &&
+				   compare_entry(main->entries[hi - step].text,
+								 main->entries[hi - step].slot, entry) > 0) {
+				hi -= step;
+				step *= 2;
+			}
+
+			size_t lo = step <= hi ? hi - step : 0;
+			while (lo < hi) {
+				size_t mid = lo + (hi - lo) / 2;
+				if (compare_entry(main->entries[mid].text,
+								  main->entries[mid].slot, entry) < 0)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+
+			k -= i - lo;
+			memmove(main->entries + k, main->entries + lo,
+					(i - lo) * sizeof(*main->entries));
+			i = lo;
+			main->entries[--k] = *entry;
+		}
+
+		main->len += delta->len;
+		delta->len = 0;
+		return;
+	}
+
+	struct sorted_texts merged = { 0 };
+	size_t i = 0;
+	size_t j = 0;
+
+	reserve_texts(&merged, main->len - ti->main_removed + delta->len + 1);
+	while (i < main->len || j < delta->len) {
+		if (i < main->len && main->entries[i].slot == BUCKET_EMPTY) {
+			free(main->entries[i++].text);
+			continue;
+		}
+
+		if (j == delta->len ||
+			(i < main->len &&
+			 compare_entry(main->entries[i].text, main->entries[i].slot,
+						   &delta->entries[j]) < 0))
+			merged.entries[merged.len++] = main->entries[i++];
+		else
+			merged.entries[merged.len++] = delta->entries[j++];
+	}
+
+	free(main->entries);
+	*main = merged;
+	ti->main_removed = 0;
+	delta->len = 0;
+}
+
+static struct slot_bucket *find_slot(const struct text_index *ti, int64_t slot)
+{
+	uint64_t mask = ti->slots_capacity - 1;
+	uint64_t pos = hash_int((uint64_t)slot) & mask;
+
+	for (; ti->slots[pos].slot != BUCKET_EMPTY; pos = (pos + 1) & mask) {
+		if (ti->slots[pos].slot == slot)
+			return &ti->slots[pos];
+	}
+	return NULL;
+}
+
+static void place_slot(struct text_index *ti, int64_t slot, const char *text)
+{
+	uint64_t mask = ti->slots_capacity - 1;
+	uint64_t pos = hash_int((uint64_t)slot) & mask;
+
+	while (ti->slots[pos].slot >= 0)
+		pos = (pos + 1) & mask;
+
+	if (ti->slots[pos].slot == BUCKET_DELETED)
+		--ti->slots_deleted;
+	ti->slots[pos] = (struct slot_bucket){ .slot = slot, .text = text };
+	++ti->slots_used;
+}
+
+static void resize_slots(struct text_index *ti, uint64_t capacity)
+{
+	struct slot_bucket *old = ti->slots;
+	uint64_t old_capacity = ti->slots_capacity;
+
+	ti->slots = malloc(capacity * sizeof(*ti->slots));
+	DIE(ti->slots == NULL, "Error allocating text index");
+	ti->slots_capacity = capacity;
+	ti->slots_used = 0;
+	ti->slots_deleted = 0;
+	for (uint64_t i = 0; i < capacity; ++i)
+		ti->slots[i].slot = BUCKET_EMPTY;
+
+	for (uint64_t i = 0; i < old_capacity; ++i) {
+		if (old[i].slot >= 0)
+			place_slot(ti, old[i].slot, old[i].text);
+	}
+	free(old);
+}
+
+/*
+ * @brief Make room in the slot table for the given number of new slots.
+ */
+static void reserve_slots(struct text_index *ti, uint64_t nr_slots)
+{
+	if ((ti->slots_used + ti->slots_deleted + nr_slots) * 100 >
+		ti->slots_capacity * TABLE_MAX_LOAD) {
+		uint64_t capacity = ti->slots_capacity;
+		while ((ti->slots_used + nr_slots) * 100 >
+			   capacity * TABLE_MAX_LOAD / 2)
+			capacity <<= 1;
+		resize_slots(ti, capacity);
+	}
+}
+
+static void put_slot(struct text_index *ti, int64_t slot, const char *text)
+{
+	reserve_slots(ti, 1);
+	place_slot(ti, slot, text);
+}
+
+static struct gram_bucket *find_gram(const struct text_index *ti,
+									 uint32_t gram)
+{
+	uint64_t mask = ti->grams_capacity - 1;
+	uint64_t pos = hash_int(gram) & mask;
+
+	for (; ti->grams[pos].gram != GRAM_EMPTY; pos = (pos + 1) & mask) {
+		if (ti->grams[pos].gram == gram)
+			return &ti->grams[pos];
+	}
+	return NULL;
+}
+
+static struct gram_bucket *place_gram(struct text_index *ti, uint32_t gram)
+{
+	uint64_t mask = ti->grams_capacity - 1;
+	uint64_t pos = hash_int(gram) & mask;
+
+	while (ti->grams[pos].gram != GRAM_EMPTY)
+		pos = (pos + 1) & mask;
+
+	ti->grams[pos].gram = gram;
+	++ti->grams_used;
+	return &ti->grams[pos];
+}
+
+static void resize_grams(struct text_index *ti, uint64_t capacity)
+{
+	struct gram_bucket *old = ti->grams;
+	uint64_t old_capacity = ti->grams_capacity;
+
+	ti->grams = calloc(capacity, sizeof(*ti->grams));
+	DIE(ti->grams == NULL, "Error allocating text index");
+	ti->grams_capacity = capacity;
+	ti->grams_used = 0;
+
+	for (uint64_t i = 0; i < old_capacity; ++i) {
+		if (old[i].gram != GRAM_EMPTY)
+			place_gram(ti, old[i].gram)->list = old[i].list;
+	}
+	free(old);
+}
+
+static struct gram_bucket *get_gram(struct text_index *ti, uint32_t gram)
+{
+	struct gram_bucket *bucket = find_gram(ti, gram);
+	if (bucket != NULL)
+		return bucket;
+
+	if ((ti->grams_used + 1) * 100 > ti->grams_capacity * TABLE_MAX_LOAD)
+		resize_grams(ti, ti->grams_capacity * 2);
+	return place_gram(ti, gram);
+}
+
+static int compare_grams(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * @brief Get the distinct trigrams of a case folded text.
+ * @param text The text.
+ * @param grams Set to the trigrams, which must be freed by the caller.
+ * @return The number of trigrams.
+ */
+static size_t text_grams(const char *text, uint32_t **grams)
+{
+	size_t len = strlen(text);
+	size_t count = 0;
+
+	*grams = NULL;
+	if (len < 3)
+		return 0;
+
+	*grams = malloc((len - 2) * sizeof(**grams));
+	DIE(*grams == NULL, "Error allocating trigrams");
+
+	for (size_t i = 0; i + 3 <= len; ++i)
+		(*grams)[i] = (uint32_t)(uint8_t)text[i] << 16 |
+					  (uint32_t)(uint8_t)text[i + 1] << 8 |
+					  (uint8_t)text[i + 2];
+
+	qsort(*grams, len - 2, sizeof(**grams), compare_grams);
+	for (size_t i = 0; i < len - 2; ++i) {
+		if (count == 0 || (*grams)[count - 1] != (*grams)[i])
+			(*grams)[count++] = (*grams)[i];
+	}
+	return count;
+}
+
+static struct text_index *alloc_text_index(const char *path)
+{
+	struct text_index *ti = calloc(1, sizeof(*ti));
+	DIE(ti == NULL, "Error allocating text index");
+
+	ti->path = strdup(path);
+	DIE(ti->path == NULL, "Error allocating text index");
+	resize_slots(ti, TABLE_MIN_CAPACITY);
+	resize_grams(ti, TABLE_MIN_CAPACITY);
+
+	return ti;
+}
+
+static void free_texts(struct sorted_texts *texts)
+{
+	for (size_t i = 0; i < texts->len; ++i)
+		free(texts->entries[i].text);
+	texts->len = 0;
+}
+
+static void free_text_index(struct text_index *ti)
+{
+	free_texts(&ti->main);
+	free_texts(&ti->delta);
+	free(ti->main.entries);
+	free(ti->delta.entries);
+	for (uint64_t i = 0; i < ti->grams_capacity; ++i)
+		posting_list_free(&ti->grams[i].list);
+	free(ti->grams);
+	free(ti->slots);
+	free(ti->path);
+	free(ti);
+}
+
+/*
+ * @brief Write a header marking the index file as out of sync with the data
+ * file, until the index is closed.
+ */
+static void mark_unclean(FILE *file)
+{
+	struct text_file_header hdr = { 0 };
+	memcpy(hdr.magic, TEXT_INDEX_MAGIC, sizeof(hdr.magic));
+
+	DIE(fseek(file, 0, SEEK_SET) != 0 ||
+			fwrite(&hdr, sizeof(hdr), 1, file) != 1 || fflush(file) != 0,
+		"Error writing text index");
+}
+
+static bool read_text(struct text_index *ti, FILE *file)
+{
+	int64_t slot;
+	uint32_t len;
+
+	if (fread(&slot, sizeof(slot), 1, file) != 1 ||
+		fread(&len, sizeof(len), 1, file) != 1)
+		return false;
+
+	char *text = malloc((size_t)len + 1);
+	DIE(text == NULL, "Error allocating text");
+	if (fread(text, 1, len, file) != len) {
+		free(text);
+		return false;
+	}
+	text[len] = '\0';
+
+	// the texts were written in sorted order
+	ti->main.entries[ti->main.len++] =
+		(struct text_entry){ .text = text, .slot = slot };
+	put_slot(ti, slot, text);
+	return true;
+}
+
+static bool read_gram(struct text_index *ti, FILE *file)
+{
+	uint32_t gram;
+
+	return fread(&gram, sizeof(gram), 1, file) == 1 && gram != GRAM_EMPTY &&
+		   find_gram(ti, gram) == NULL &&
+		   posting_list_read(&get_gram(ti, gram)->list, file);
+}
+
+struct text_index *text_index_open(const char *path, uint64_t data_size,
+								   uint64_t data_mtime)
+{
+	FILE *file = fopen(path, "r+b");
+	if (file == NULL)
+		return NULL;
+
+	struct text_file_header hdr;
+	if (fread(&hdr, sizeof(hdr), 1, file) != 1 ||
+		memcmp(hdr.magic, TEXT_INDEX_MAGIC, sizeof(hdr.magic)) != 0 ||
+		!hdr.clean || hdr.data_size != data_size ||
+		hdr.data_mtime != data_mtime) {
+		(void)fclose(file);
+		return NULL;
+	}
+
+	struct text_index *ti = alloc_text_index(path);
+	bool ok = true;
+
+	reserve_texts(&ti->main, hdr.nr_texts + 1);
+	for (uint64_t i = 0; i < hdr.nr_texts && ok; ++i)
+		ok = read_text(ti, file);
+	for (uint64_t i = 0; i < hdr.nr_grams && ok; ++i)
+		ok = read_gram(ti, file);
+
+	if (!ok) {
+		free_text_index(ti);
+		(void)fclose(file);
+		return NULL;
+	}
+
+	mark_unclean(file);
+	(void)fclose(file);
+	return ti;
+}
+
+struct text_index *text_index_create(const char *path)
+{
+	FILE *file = fopen(path, "wb");
+	DIE(file == NULL, "Error creating text index");
+
+	mark_unclean(file);
+	(void)fclose(file);
+	return alloc_text_index(path);
+}
+
+void text_index_close(struct text_index *ti, uint64_t data_size,
+					  uint64_t data_mtime)
+{
+	if (ti == NULL)
+		return;
+
+	merge_texts(ti, &ti->delta);
+
+	FILE *file = fopen(ti->path, "wb");
+	DIE(file == NULL, "Error writing text index");
+
+	struct text_file_header hdr = { .nr_texts = ti->main.len,
+									.data_size = data_size,
+									.data_mtime = data_mtime };
+	memcpy(hdr.magic, TEXT_INDEX_MAGIC, sizeof(hdr.magic));
+	for (uint64_t i = 0; i < ti->grams_capacity; ++i)
+		hdr.nr_grams += ti->grams[i].gram != GRAM_EMPTY;
+	DIE(fwrite(&hdr, sizeof(hdr), 1, file) != 1, "Error writing text index");
+
+	for (size_t i = 0; i < ti->main.len; ++i) {
+		const struct text_entry *entry = &ti->main.entries[i];
+		uint32_t len = (uint32_t)strlen(entry->text);
+
+		DIE(fwrite(&entry->slot, sizeof(entry->slot), 1, file) != 1 ||
+				fwrite(&len, sizeof(len), 1, file) != 1 ||
+				fwrite(entry->text, 1, len, file) != len,
+			"Error writing text index");
+	}
+
+	for (uint64_t i = 0; i < ti->grams_capacity; ++i) {
+		const struct gram_bucket *bucket = &ti->grams[i];
+		if (bucket->gram == GRAM_EMPTY)
+			continue;
+
+		DIE(fwrite(&bucket->gram, sizeof(bucket->gram), 1, file) != 1 ||
+				!posting_list_write(&bucket->list, file),
+			"Error writing text index");
+	}
+
+	// only mark the index as clean once everything is on disk
+	DIE(fflush(file) != 0 || fdatasync(fileno(file)) != 0,
+		"Error writing text index");
+	hdr.clean = 1;
+	DIE(fseek(file, 0, SEEK_SET) != 0 ||
+			fwrite(&hdr, sizeof(hdr), 1, file) != 1,
+		"Error writing text index");
+	(void)fclose(file);
+
+	free_text_index(ti);
+}
+
+static void index_grams(struct text_index *ti, const char *folded,
+						int64_t slot)
+{
+	uint32_t *grams;
+	size_t nr_grams = text_grams(folded, &grams);
+
+	for (size_t i = 0; i < nr_grams; ++i)
+		posting_list_insert(&get_gram(ti, grams[i])->list, slot);
+	free(grams);
+}
+
+void text_index_insert(struct text_index *ti, const char *text, int64_t slot)
+{
+	char *folded = fold_text(text);
+	struct sorted_texts *delta = &ti->delta;
+
+	if (delta->len == TEXT_DELTA_MAX)
+		merge_texts(ti, delta);
+	reserve_texts(delta, TEXT_DELTA_MAX);
+
+	size_t pos = text_lower_bound(delta, folded);
+	while (pos < delta->len &&
+		   compare_entry(folded, slot, &delta->entries[pos]) > 0)
+		++pos;
+	memmove(delta->entries + pos + 1, delta->entries + pos,
+			(delta->len - pos) * sizeof(*delta->entries));
+	delta->entries[pos] = (struct text_entry){ .text = folded, .slot = slot };
+	++delta->len;
+
+	put_slot(ti, slot, folded);
+	index_grams(ti, folded, slot);
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+	const struct text_entry *entry = a;
+
+	return compare_entry(entry->text, entry->slot, b);
+}
+
+void text_index_insert_many(struct text_index *ti, const char *const *texts,
+							int64_t first_slot, size_t count)
+{
+	// a few texts are cheaper to add to the delta than to merge
+	if (count < TEXT_DELTA_MAX) {
+		for (size_t i = 0; i < count; ++i)
+			text_index_insert(ti, texts[i], first_slot + (int64_t)i);
+		return;
+	}
+
+	struct sorted_texts batch = { 0 };
+	reserve_texts(&batch, count);
+	reserve_slots(ti, count);
+	for (size_t i = 0; i < count; ++i) {
+		int64_t slot = first_slot + (int64_t)i;
+		char *folded = fold_text(texts[i]);
+
+		batch.entries[batch.len++] =
+			(struct text_entry){ .text = folded, .slot = slot };
+		put_slot(ti, slot, folded);
+		index_grams(ti, folded, slot);
+	}
+	qsort(batch.entries, batch.len, sizeof(*batch.entries), compare_entries);
+
+	// the whole batch is merged at once, instead of TEXT_DELTA_MAX texts at a
+	// time
+	if (ti->delta.len > 0)
+		merge_texts(ti, &ti->delta);
+	merge_texts(ti, &batch);
+	free(batch.entries);
+}
+
+enum status text_index_remove(struct text_index *ti, int64_t slot)
+{
+	struct slot_bucket *bucket = find_slot(ti, slot);
+	if (bucket == NULL)
+		return STATUS_NOT_FOUND;
+
+	const char *text = bucket->text;
+	bucket->slot = BUCKET_DELETED;
+	--ti->slots_used;
+	++ti->slots_deleted;
+
+	uint32_t *grams;
+	size_t nr_grams = text_grams(text, &grams);
+	for (size_t i = 0; i < nr_grams; ++i)
+		(void)posting_list_remove(&find_gram(ti, grams[i])->list, slot);
+	free(grams);
+
+	size_t pos = find_entry(&ti->delta, text, slot);
+	if (pos < ti->delta.len) {
+		free(ti->delta.entries[pos].text);
+		memmove(ti->delta.entries + pos, ti->delta.entries + pos + 1,
+				(ti->delta.len - pos - 1) * sizeof(*ti->delta.entries));
+		--ti->delta.len;
+		return STATUS_OK;
+	}
+
+	// the text is kept until the next merge, to keep the entries sorted
+	pos = find_entry(&ti->main, text, slot);
+	ti->main.entries[pos].slot = BUCKET_EMPTY;
+	if (++ti->main_removed * 2 > ti->main.len)
+		merge_texts(ti, &ti->delta);
+
+	return STATUS_OK;
+}
+
+void text_index_clear(struct text_index *ti)
+{
+	free_texts(&ti->main);
+	free_texts(&ti->delta);
+	ti->main_removed = 0;
+
+	for (uint64_t i = 0; i < ti->slots_capacity; ++i)
+		ti->slots[i].slot = BUCKET_EMPTY;
+	ti->slots_used = 0;
+	ti->slots_deleted = 0;
+
+	for (uint64_t i = 0; i < ti->grams_capacity; ++i)
+		ti->grams[i].list.len = 0;
+}
+
+struct slot_vec {
+	int64_t *slots;
+	size_t len;
+	size_t capacity;
+};
+
+static void push_slot(struct slot_vec *vec, int64_t slot)
+{
+	if (vec->len == vec->capacity) {
+		vec->capacity = vec->capacity ? vec->capacity * 2 : 16;
+		vec->slots = realloc(vec->slots, vec->capacity * sizeof(*vec->slots));
+		DIE(vec->slots == NULL, "Error allocating search results");
+	}
+	vec->slots[vec->len++] = slot;
+}
+
+static int compare_slots(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t *)a;
+	int64_t y = *(const int64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void find_sorted(const struct sorted_texts *texts, const char *pattern,
+						enum text_match mode, struct slot_vec *found)
+{
+	size_t len = strlen(pattern);
+
+	for (size_t pos = text_lower_bound(texts, pattern); pos < texts->len;
+		 ++pos) {
+		const struct text_entry *entry = &texts->entries[pos];
+		if (mode == TEXT_MATCH_EXACT ? strcmp(entry->text, pattern) != 0 :
+									   strncmp(entry->text, pattern, len) != 0)
+			break;
+		if (entry->slot >= 0)
+			push_slot(found, entry->slot);
+	}
+}
+
+static void find_substring(const struct text_index *ti, const char *pattern,
+						   struct slot_vec *found)
+{
+	uint32_t *grams;
+	size_t nr_grams = text_grams(pattern, &grams);
+
+	// too short for a trigram, every text is checked
+	if (nr_grams == 0) {
+		for (uint64_t i = 0; i < ti->slots_capacity; ++i) {
+			if (ti->slots[i].slot >= 0 &&
+				strstr(ti->slots[i].text, pattern) != NULL)
+				push_slot(found, ti->slots[i].slot);
+		}
+		qsort(found->slots, found->len, sizeof(*found->slots),
+			  compare_slots);
+		return;
+	}
+
+	// the candidates are the slots holding all the trigrams of the pattern,
+	// taken from the shortest posting list
+	const struct posting_list **lists = malloc(nr_grams * sizeof(*lists));
+	DIE(lists == NULL, "Error allocating search buffer");
+
+	size_t shortest = 0;
+	for (size_t i = 0; i < nr_grams; ++i) {
+		const struct gram_bucket *bucket = find_gram(ti, grams[i]);
+		if (bucket == NULL || bucket->list.len == 0) {
+			free(lists);
+			free(grams);
+			return;
+		}
+		lists[i] = &bucket->list;
+		if (lists[i]->len < lists[shortest]->len)
+			shortest = i;
+	}
+
+	for (size_t i = 0; i < lists[shortest]->len; ++i) {
+		int64_t slot = lists[shortest]->slots[i];
+		bool candidate = true;
+
+		for (size_t j = 0; j < nr_grams && candidate; ++j)
+			candidate = j == shortest || posting_list_contains(lists[j], slot);
+
+		// the trigrams may appear in another order in the text
+		if (candidate && strstr(find_slot(ti, slot)->text, pattern) != NULL)
+			push_slot(found, slot);
+	}
+
+	free(lists);
+	free(grams);
+}
+
+size_t text_index_find(const struct text_index *ti, const char *pattern,
+					   enum text_match mode, int64_t **slots)
+{
+	char *folded = fold_text(pattern);
+	struct slot_vec found = { 0 };
+
+	if (mode == TEXT_MATCH_SUBSTRING) {
+		find_substring(ti, folded, &found);
+	} else {
+		find_sorted(&ti->main, folded, mode, &found);
+		find_sorted(&ti->delta, folded, mode, &found);
+		qsort(found.slots, found.len, sizeof(*found.slots), compare_slots);
+	}
+
+	free(folded);
+	*slots = found.slots;
+	return found.len;
+}
@@ -0,0 +1,435 @@
+#define _GNU_SOURCE
+
+#include "wal.h"
+
+#include "error.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define WAL_MAGIC "SEQWAL01"
+#define WAL_TABLE_MIN_CAPACITY 64
+#define WAL_EMPTY SIZE_MAX
+
+/*
+ * The log file holds the header, followed by the committed batches. A batch is
+ * a sequence of records, each made of a record header and its data: the page
+ * records, one metadata record and the commit record.
+ */
+struct wal_file_header {
+	char magic[8];
+	uint64_t page_size;
+};
+
+enum wal_record_type {
+	WAL_RECORD_PAGES = 1,
+	WAL_RECORD_META,
+	WAL_RECORD_COMMIT,
+};
+
+struct wal_record {
+	uint32_t type;
+	uint32_t reserved;
+	// the first page of a page record or the checksum of the batch for the
+	// commit record
+	uint64_t arg;
+	// size of the data following the record header
+	uint64_t len;
+};
+
+// the latest image of a page written in the current batch
+struct wal_page {
+	uint64_t page;
+	size_t offset;
+};
+
+struct wal {
+	int fd;
+	size_t page_size;
+	// size of the committed batches in the log file
+	uint64_t log_bytes;
+
+	// protects the current batch against concurrent writers and readers
+	pthread_mutex_t lock;
+	char *batch;
+	size_t batch_len;
+	size_t batch_capacity;
+	struct wal_page *pages;
+	size_t nr_pages;
+	size_t pages_capacity;
+	// open addressing table of positions in pages, hashed by page
+	size_t *table;
+	size_t table_capacity;
+};
+
+static enum status pwrite_full(int fd, const void *buf, size_t len,
+							   off_t offset)
+{
+	while (len > 0) {
+		ssize_t ret = pwrite(fd, buf, len, offset);
+		if (ret <= 0)
+			return STATUS_ERROR;
+		buf = (const char *)buf + ret;
+		len -= ret;
+		offset += ret;
+	}
+
+	return STATUS_OK;
+}
+
+static uint64_t checksum(const char *data, size_t len)
+{
+	// FNV-1a over 8 bytes at a time
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	uint64_t word;
+	size_t i = 0;
+
+	for (; i + sizeof(word) <= len; i += sizeof(word)) {
+		memcpy(&word, data + i, sizeof(word));
+		hash = (hash ^ word) * 0x100000001b3ULL;
+	}
+	for (; i < len; ++i)
+		hash = (hash ^ (uint8_t)data[i]) * 0x100000001b3ULL;
+
+	return hash;
+}
+
+static inline size_t hash_page(uint64_t page, size_t mask)
+{
+	return (size_t)((page * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+}
+
+static void table_resize(struct wal *wal, size_t capacity)
+{
+	free(wal->table);
+	wal->table = malloc(capacity * sizeof(*wal->table));
+	DIE(wal->table == NULL, "Error allocating log table");
+
+	wal->table_capacity = capacity;
+	memset(wal->table, 0xff, capacity * sizeof(*wal->table));
+	for (size_t i = 0; i < wal->nr_pages; ++i) {
+		size_t pos = hash_page(wal->pages[i].page, capacity - 1);
+		while (wal->table[pos] != WAL_EMPTY)
+			pos = (pos + 1) & (capacity - 1);
+		wal->table[pos] = i;
+	}
+}
+
+/*
+ * @brief Find the position of a page in the table.
+ * @return The position holding the page or the empty position where it should
+ * be added.
+ */
+static size_t table_find(const struct wal *wal, uint64_t page)
+{
+	size_t mask = wal->table_capacity - 1;
+	size_t pos = hash_page(page, mask);
+
+	while (wal->table[pos] != WAL_EMPTY &&
+		   wal->pages[wal->table[pos]].page != page)
+		pos = (pos + 1) & mask;
+	return pos;
+}
+
+static void set_page(struct wal *wal, uint64_t page, size_t offset)
+{
+	size_t pos = table_find(wal, page);
+
+	if (wal->table[pos] != WAL_EMPTY) {
+		wal->pages[wal->table[pos]].offset = offset;
+		return;
+	}
+
+	if (wal->nr_pages == wal->pages_capacity) {
+		wal->pages_capacity = wal->pages_capacity ? wal->pages_capacity * 2 :
+													WAL_TABLE_MIN_CAPACITY;
+		wal->pages =
+			realloc(wal->pages, wal->pages_capacity * sizeof(*wal->pages));
+		DIE(wal->pages == NULL, "Error allocating log pages");
+	}
+
+	wal->pages[wal->nr_pages] = (struct wal_page){ page, offset };
+	wal->table[pos] = wal->nr_pages++;
+
+	// keep the table at most half full
+	if (wal->nr_pages * 2 > wal->table_capacity)
+		table_resize(wal, wal->table_capacity * 2);
+}
+
+/*
+ * @brief Add a record to the current batch.
+ * @return The offset of the data of the record in the batch.
+ */
+static size_t add_record(struct wal *wal, uint32_t type, uint64_t arg,
+						 const void *data, size_t len)
+{
+	size_t needed = wal->batch_len + sizeof(struct wal_record) + len;
+
+	if (needed > wal->batch_capacity) {
+		size_t capacity = wal->batch_capacity ? wal->batch_capacity : 4096;
+		while (capacity < needed)
+			capacity *= 2;
+		wal->batch = realloc(wal->batch, capacity);
+		DIE(wal->batch == NULL, "Error allocating log batch");
+		wal->batch_capacity = capacity;
+	}
+
+	struct wal_record rec = { .type = type, .arg = arg, .len = len };
+	memcpy(wal->batch + wal->batch_len, &rec, sizeof(rec));
+	wal->batch_len += sizeof(rec);
+
+	size_t offset = wal->batch_len;
+	if (len > 0)
+		memcpy(wal->batch + offset, data, len);
+	wal->batch_len += len;
+
+	return offset;
+}
+
+static void clear_batch(struct wal *wal)
+{
+	wal->batch_len = 0;
+	wal->nr_pages = 0;
+	if (wal->table_capacity > WAL_TABLE_MIN_CAPACITY)
+		table_resize(wal, WAL_TABLE_MIN_CAPACITY);
+	else
+		memset(wal->table, 0xff, wal->table_capacity * sizeof(*wal->table));
+}
+
+/*
+ * @brief Write the records of a batch to their final location, up to its
+ * commit record.
+ * @return The status of the operation.
+ */
+static enum status replay_batch(const struct wal *wal, const char *batch,
+								size_t len, wal_pages_func write_pages,
+								wal_meta_func write_meta, void *ctx)
+{
+	size_t pos = 0;
+
+	while (pos + sizeof(struct wal_record) <= len) {
+		struct wal_record rec;
+		memcpy(&rec, batch + pos, sizeof(rec));
+		pos += sizeof(rec);
+
+		enum status status = STATUS_OK;
+		if (rec.type == WAL_RECORD_PAGES)
+			status = write_pages(ctx, rec.arg, batch + pos,
+								 rec.len / wal->page_size);
+		else if (rec.type == WAL_RECORD_META)
+			status = write_meta(ctx, batch + pos, rec.len);
+		else
+			break;
+		if (status != STATUS_OK)
+			return status;
+
+		pos += rec.len;
+	}
+
+	return STATUS_OK;
+}
+
+/*
+ * @brief Write a fresh header, dropping all the records of the log file.
+ */
+static enum status reset_file(struct wal *wal)
+{
+	struct wal_file_header hdr = { .page_size = wal->page_size };
+	memcpy(hdr.magic, WAL_MAGIC, sizeof(hdr.magic));
+
+	wal->log_bytes = 0;
+	if (ftruncate(wal->fd, sizeof(hdr)) != 0 ||
+		pwrite_full(wal->fd, &hdr, sizeof(hdr), 0) != STATUS_OK ||
+		fdatasync(wal->fd) != 0)
+		return STATUS_ERROR;
+
+	return STATUS_OK;
+}
+
+struct wal *wal_open(const char *path, size_t page_size, bool truncate)
+{
+	struct wal *wal = calloc(1, sizeof(*wal));
+	DIE(wal == NULL, "Error allocating log");
+
+	wal->fd = open(path, O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0), 0644);
+	DIE(wal->fd < 0, "Error opening log");
+	wal->page_size = page_size;
+	DIE(pthread_mutex_init(&wal->lock, NULL) != 0, "Error creating log lock");
+	table_resize(wal, WAL_TABLE_MIN_CAPACITY);
+
+	struct wal_file_header hdr;
+	struct stat st;
+	DIE(fstat(wal->fd, &st) != 0, "Error reading log attributes");
+
+	if (st.st_size < (off_t)sizeof(hdr) ||
+		pread(wal->fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+		memcmp(hdr.magic, WAL_MAGIC, sizeof(hdr.magic)) != 0 ||
+		hdr.page_size != page_size)
+		DIE(reset_file(wal) != STATUS_OK, "Error writing log");
+	else
+		wal->log_bytes = (uint64_t)st.st_size - sizeof(hdr);
+
+	return wal;
+}
+
+void wal_close(struct wal *wal)
+{
+	if (wal == NULL)
+		return;
+
+	(void)close(wal->fd);
+	(void)pthread_mutex_destroy(&wal->lock);
+	free(wal->batch);
+	free(wal->pages);
+	free(wal->table);
+	free(wal);
+}
+
+void wal_write_pages(struct wal *wal, uint64_t first, const void *pages,
+					 size_t count)
+{
+	pthread_mutex_lock(&wal->lock);
+
+	size_t offset = add_record(wal, WAL_RECORD_PAGES, first, pages,
+							   count * wal->page_size);
+	for (size_t i = 0; i < count; ++i)
+		set_page(wal, first + i, offset + i * wal->page_size);
+
+	pthread_mutex_unlock(&wal->lock);
+}
+
+size_t wal_read_pages(struct wal *wal, uint64_t first, size_t count,
+					  size_t offset, size_t len, void *dst, size_t stride)
+{
+	char *out = dst;
+	size_t found = 0;
+
+	pthread_mutex_lock(&wal->lock);
+
+	// walk whichever is shorter, the pending pages or the requested ones
+	if (wal->nr_pages < count) {
+		for (size_t i = 0; i < wal->nr_pages; ++i) {
+			const struct wal_page *p = &wal->pages[i];
+			if (p->page < first || p->page - first >= count)
+				continue;
+
+			memcpy(out + (p->page - first) * stride,
+				   wal->batch + p->offset + offset, len);
+			++found;
+		}
+	} else {
+		for (size_t i = 0; i < count; ++i) {
+			size_t pos = table_find(wal, first + i);
+			if (wal->table[pos] == WAL_EMPTY)
+				continue;
+
+			memcpy(out + i * stride,
+				   wal->batch + wal->pages[wal->table[pos]].offset + offset,
+				   len);
+			++found;
+		}
+	}
+
+	pthread_mutex_unlock(&wal->lock);
+	return found;
+}
+
+size_t wal_pending_bytes(const struct wal *wal)
+{
+	return wal->batch_len;
+}
+
+uint64_t wal_log_bytes(const struct wal *wal)
+{
+	return wal->log_bytes;
+}
+
+enum status wal_commit(struct wal *wal, const void *meta, size_t len)
+{
+	(void)add_record(wal, WAL_RECORD_META, 0, meta, len);
+	(void)add_record(wal, WAL_RECORD_COMMIT,
+					 checksum(wal->batch, wal->batch_len), NULL, 0);
+
+	// the whole batch is made durable with one sequential write and one fsync
+	if (pwrite_full(wal->fd, wal->batch, wal->batch_len,
+					(off_t)(sizeof(struct wal_file_header) +
+							wal->log_bytes)) != STATUS_OK ||
+		fdatasync(wal->fd) != 0)
+		return STATUS_ERROR;
+
+	wal->log_bytes += wal->batch_len;
+	return STATUS_OK;
+}
+
+enum status wal_apply(struct wal *wal, wal_pages_func write_pages,
+					  wal_meta_func write_meta, void *ctx)
+{
+	enum status status = replay_batch(wal, wal->batch, wal->batch_len,
+									  write_pages, write_meta, ctx);
+
+	clear_batch(wal);
+	return status;
+}
+
+enum status wal_recover(struct wal *wal, wal_pages_func write_pages,
+						wal_meta_func write_meta, void *ctx,
+						uint64_t *nr_batches)
+{
+	size_t len = (size_t)wal->log_bytes;
+	enum status status = STATUS_OK;
+
+	*nr_batches = 0;
+	if (len == 0)
+		return STATUS_OK;
+
+	char *log = malloc(len);
+	DIE(log == NULL, "Error allocating log buffer");
+
+	ssize_t ret = pread(wal->fd, log, len, sizeof(struct wal_file_header));
+	if (ret > 0)
+		len = (size_t)ret;
+	else
+		len = 0;
+
+	size_t batch_start = 0;
+	size_t pos = 0;
+	while (status == STATUS_OK && pos + sizeof(struct wal_record) <= len) {
+		struct wal_record rec;
+		memcpy(&rec, log + pos, sizeof(rec));
+
+		// a record past the end of the file was torn by a crash
+		if (rec.len > len - pos - sizeof(rec))
+			break;
+
+		if (rec.type == WAL_RECORD_COMMIT) {
+			if (rec.arg != checksum(log + batch_start, pos - batch_start))
+				break;
+
+			status = replay_batch(wal, log + batch_start, pos - batch_start,
+								  write_pages, write_meta, ctx);
+			++*nr_batches;
+			pos += sizeof(rec);
+			batch_start = pos;
+		} else if (rec.type == WAL_RECORD_PAGES ||
+				   rec.type == WAL_RECORD_META) {
+			pos += sizeof(rec) + rec.len;
+		} else {
+			break;
+		}
+	}
+
+	// the batches after the last complete one are dropped
+	wal->log_bytes = batch_start;
+	free(log);
+	return status;
+}
+
+enum status wal_reset(struct wal *wal)
+{
+	return reset_file(wal);
+}